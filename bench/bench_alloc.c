@@ -0,0 +1,58 @@
+/*
+ * Allocation counter of sv_bench: with glibc, malloc() and the like are
+ * replaced, in the benchmark executable only, by versions that count the
+ * calls and bytes before handing over to the C library's own. Elsewhere
+ * nothing is counted and bench_allocs() tells so.
+ */
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "bench_alloc.h"
+
+#if defined(__GLIBC__)
+extern void* __libc_malloc(size_t n);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t n);
+extern void __libc_free(void* p);
+
+static volatile long long allocs, alloc_bytes;
+
+void* malloc(size_t n)
+{
+    __sync_fetch_and_add(&allocs, 1);
+    __sync_fetch_and_add(&alloc_bytes, (long long)n);
+    return __libc_malloc(n);
+}
+
+void* calloc(size_t n, size_t size)
+{
+    __sync_fetch_and_add(&allocs, 1);
+    __sync_fetch_and_add(&alloc_bytes, (long long)(n * size));
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t n)
+{
+    __sync_fetch_and_add(&allocs, 1);
+    __sync_fetch_and_add(&alloc_bytes, (long long)n);
+    return __libc_realloc(p, n);
+}
+
+void free(void* p)
+{
+    __libc_free(p);
+}
+
+int bench_allocs(long long* n, long long* bytes)
+{
+    *n = allocs;
+    *bytes = alloc_bytes;
+    return 1;
+}
+#else
+int bench_allocs(long long* n, long long* bytes)
+{
+    *n = *bytes = 0;
+    return 0;
+}
+#endif
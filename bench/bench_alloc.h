@@ -0,0 +1,16 @@
+#ifndef __BENCH_ALLOC_H__
+#define __BENCH_ALLOC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Allocations (malloc, calloc, realloc) so far, and their bytes; 0 if
+   they can't be counted on this platform */
+int bench_allocs(long long* n, long long* bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __BENCH_ALLOC_H__
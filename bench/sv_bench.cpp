@@ -0,0 +1,386 @@
+/*
+  ============================================================================
+   File: SV_BENCH.CPP                                         19.Oct.26 v1.1
+  ============================================================================
+
+                    UGST/ITU-T SPEECH VOLTMETER BENCHMARKS
+
+   Description:
+   ~~~~~~~~~~~~
+   Times the speech voltmeter, the sample conversions, the FFT and the
+   sampling rate converter on synthetic, deterministic speech-like
+   signals, and prints per benchmark the samples per second, the speed
+   against real time and the allocations per run, as a table or as JSON.
+
+   Usage:
+   ~~~~~~
+   sv_bench [-seconds s] [-min-time s] [-filter text] [-json]
+   where:
+   -seconds s    length of the test signals, in seconds [10]
+   -min-time s   each benchmark is run again until s seconds [0.5]
+   -filter text  only the benchmarks whose name has `text'
+   -json         JSON output, for tracking from one revision to the next
+
+   History:
+   19.Oct.26    v1.0    First version.
+   19.Oct.26    v1.1    sh2fl_alt(), and the G.192 bitstream conversions.
+
+  ============================================================================
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "sv-p56.h"
+}
+#include "sv56.h"
+extern "C" {
+#include "ugst-utl.h"
+}
+#include "bench_alloc.h"
+
+/* Rate converter internals, from ssrc.cpp */
+extern int quiet;
+double upsample(WAV_file *wfi, WAV_out *fpo, int nch, int snch, const REAL *mixm, int bps, int dbps, int sfrq, int dfrq, double gain, unsigned long long chanklen, int twopass, int dither);
+double downsample(WAV_file *wfi, WAV_out *fpo, int nch, int snch, const REAL *mixm, int bps, int dbps, int sfrq, int dfrq, double gain, unsigned long long chanklen, int twopass, int dither);
+int init_shaper(int freq, int nch, int min, int max, int dtype, int pdf, double noiseamp);
+int do_shaping(double s, double *peak, int dtype, int ch);
+void quit_shaper(int nch);
+
+#if defined(_WIN32)
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+#define BLOCK   256     /* samples per call of the voltmeter */
+
+/* One benchmark: run() does one run over `samples' samples, `duration'
+   seconds of signal (0 where speed against real time makes no sense) */
+struct bench {
+    std::string name;
+    long long samples;
+    double duration;
+    std::function<void()> run;
+};
+
+/* Options */
+static double seconds = 10;
+static double min_time = 0.5;
+static const char* filter = NULL;
+static int json = 0;
+
+/*
+  ============================================================================
+
+        void speech (short *x, long n, int nch, double rate, unsigned seed);
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Fills x with n frames of nch interleaved channels of a speech-like
+        signal: harmonics of a gliding pitch around 150 Hz, weighted by
+        three formants, in syllables of about 200 ms, with pauses and a
+        low noise floor. The same seed always gives the same signal, on
+        any platform, by its own random generator.
+
+  ============================================================================
+*/
+static unsigned lcg(unsigned* s)
+{
+    *s = *s * 1664525u + 1013904223u;
+    return *s >> 8;
+}
+
+static double uniform(unsigned* s)
+{
+    return lcg(s) / 16777216.0;
+}
+
+static void speech(short* x, long n, int nch, double rate, unsigned seed)
+{
+    static const double formant[3] = { 500, 1500, 2500 };
+    double phase = 0, env = 0, target = 0, f0;
+    long i, syllable = 0, len = (long)(0.2 * rate);
+    int ch, k, kmax;
+
+    for (i = 0; i < n; i++) {
+        /* A new syllable, or a pause, every 200 ms */
+        if (--syllable <= 0) {
+            syllable = len / 2 + (long)(uniform(&seed) * len);
+            target = uniform(&seed) < 0.25 ? 0 : 0.3 + 0.7 * uniform(&seed);
+        }
+        env += (target - env) * (50.0 / rate);
+
+        f0 = 150 * (1 + 0.1 * sin(2 * M_PI * 3 * i / rate));
+        phase += 2 * M_PI * f0 / rate;
+        if (phase > 2 * M_PI)
+            phase -= 2 * M_PI;
+
+        double s = 0;
+        kmax = (int)(4000 / 150);
+        for (k = 1; k <= kmax && k * f0 < rate / 2; k++) {
+            double g = 0, d;
+            for (int j = 0; j < 3; j++) {
+                d = (k * f0 - formant[j]) / 200;
+                g += exp(-d * d) / (j + 1);
+            }
+            s += g * sin(k * phase) / k;
+        }
+        for (ch = 0; ch < nch; ch++) {
+            double noise = (uniform(&seed) - 0.5) * 20;
+            x[i * nch + ch] = (short)(6000 * env * s * (ch ? 0.7 : 1) + noise);
+        }
+    }
+}
+
+/* Writes a 16-bit wave file of x, for the rate converter */
+static int write_wav(const char* name, const short* x, long n, int nch, long rate)
+{
+    FILE* fp = fopen(name, "w+b");
+
+    if (fp == NULL)
+        return -1;
+    wav_write_header(fp, WAV_RIFF, WAV_FORMAT_PCM, nch, rate, 16);
+    fwrite(x, sizeof(short) * nch, n, fp);
+    wav_write_sizes(fp, WAV_RIFF, nch * 2);
+    fclose(fp);
+    return 0;
+}
+
+/* Builds the benchmark list, with the signals they run over */
+static void add_benches(std::vector<bench>& list, std::vector<std::string>& temps)
+{
+    const long rate = 16000;
+    const long n = (long)(seconds * rate);
+    static std::vector<short> x;
+    static std::vector<float> f, g;
+    static std::vector<short> y;
+
+    x.resize(n);
+    f.resize(n);
+    g.resize(n);
+    y.resize(n);
+    speech(&x[0], n, 1, rate, 1);
+    sh2fl(n, &x[0], &f[0], 16, 1);
+
+    /* Speech voltmeter */
+    list.push_back({ "voltmeter/float", n, seconds, [n]() {
+        SVP56_state st;
+        init_speech_voltmeter(&st, rate);
+        for (long i = 0; i < n; i += BLOCK)
+            speech_voltmeter(&f[i], n - i < BLOCK ? n - i : BLOCK, &st);
+    } });
+    list.push_back({ "voltmeter/int16", n, seconds, [n]() {
+        SVP56_state st;
+        init_speech_voltmeter(&st, rate);
+        for (long i = 0; i < n; i += BLOCK)
+            speech_voltmeter_int(&x[i], n - i < BLOCK ? n - i : BLOCK, 16, &st);
+    } });
+
+    /* Conversions */
+    list.push_back({ "convert/sh2fl", n, seconds, [n]() {
+        sh2fl(n, &x[0], &g[0], 16, 1);
+    } });
+    list.push_back({ "convert/sh2fl_alt", n, seconds, [n]() {
+        sh2fl_alt(n, &x[0], &g[0], (short)0xFFFF);
+    } });
+    list.push_back({ "convert/fl2sh_round", n, seconds, [n]() {
+        fl2sh(n, &f[0], &y[0], 0.5, (short)0xFFFF);
+    } });
+    list.push_back({ "convert/fl2sh_trunc", n, seconds, [n]() {
+        fl2sh(n, &f[0], &y[0], 0.0, (short)0xFFFF);
+    } });
+    list.push_back({ "convert/scale", n, seconds, [n]() {
+        scale(&g[0], n, 1.0);
+    } });
+    list.push_back({ "convert/sh2sh_scale", n, seconds, [n]() {
+        sh2sh_scale(n, &x[0], &y[0], 1.5, 16, (short)0xFFFF);
+    } });
+
+    /* G.192 bitstreams of 20 ms frames at 16 kHz, sync words included,
+       for samples of 4, 8 and 16 bits */
+    const long frame = 320;
+    for (long resol = 4; resol <= 16; resol *= 2) {
+        const long frames = n / frame, len = frame * resol + 2;
+        std::shared_ptr<std::vector<short> > bs(new std::vector<short>((size_t)(frames + 1) * len));
+        std::shared_ptr<std::vector<short> > bs0(new std::vector<short>((size_t)(frames + 1) * len));
+        for (long i = 0; i < frames; i++)
+            serialize_left_justified(&x[i * frame], &(*bs0)[i * len], frame, resol, 1);
+        list.push_back({ "g192/serialize_" + std::to_string(resol), frames * frame, seconds, [=]() {
+            for (long i = 0; i < frames; i++)
+                serialize_left_justified(&x[i * frame], &(*bs)[i * len], frame, resol, 1);
+        } });
+        list.push_back({ "g192/parallelize_" + std::to_string(resol), frames * frame, seconds, [=]() {
+            for (long i = 0; i < frames; i++)
+                parallelize_left_justified(&(*bs0)[i * len], &y[i * frame], len, resol, 1);
+        } });
+    }
+
+    /* FFT, forward and back */
+    for (int size = 256; size <= 65536; size *= 4) {
+        std::shared_ptr<std::vector<REAL> > a(new std::vector<REAL>(size)), a0(new std::vector<REAL>(size));
+        std::shared_ptr<std::vector<REAL> > w(new std::vector<REAL>(size / 2));
+        std::shared_ptr<std::vector<int> > ip(new std::vector<int>(2 + (int)sqrt((double)size)));
+        for (int i = 0; i < size; i++)
+            (*a0)[i] = f[i % n];
+        (*ip)[0] = 0;
+        list.push_back({ "fft/rdft_" + std::to_string(size), size, 0, [=]() {
+            memcpy(&(*a)[0], &(*a0)[0], size * sizeof(REAL));
+            rdft(size, 1, &(*a)[0], &(*ip)[0], &(*w)[0]);
+            rdft(size, -1, &(*a)[0], &(*ip)[0], &(*w)[0]);
+        } });
+    }
+
+    /* Rate converter, straight from a wave file to the null device */
+    static const int pairs[][2] = {
+        { 8000, 16000 }, { 16000, 48000 }, { 44100, 48000 },
+        { 48000, 44100 }, { 48000, 16000 }, { 16000, 8000 } };
+    for (size_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); p++) {
+        for (int nch = 1; nch <= 2; nch++) {
+            int sfrq = pairs[p][0], dfrq = pairs[p][1];
+            long frames = (long)(seconds * sfrq);
+            std::vector<short> s((size_t)frames * nch);
+            std::string name = "sv_bench_" + std::to_string(sfrq) + "_" + std::to_string(nch) + ".wav";
+
+            speech(&s[0], frames, nch, sfrq, 2);
+            if (write_wav(name.c_str(), &s[0], frames, nch, sfrq) != 0)
+                continue;
+            temps.push_back(name);
+            list.push_back({ "ssrc/" + std::to_string(sfrq) + "_" + std::to_string(dfrq) +
+                             (nch == 1 ? "_mono" : "_stereo"), (long long)frames * nch, seconds,
+                             [=]() {
+                WAV_file wfi;
+                WAV_out wo;
+                FILE* fo;
+                if (wav_open((char*)name.c_str(), 0, &wfi) != 0)
+                    return;
+                fo = fopen(NULL_DEVICE, "wb");
+                wav_out_open(&wo, fo, 0, 0);
+                if (dfrq > sfrq)
+                    upsample(&wfi, &wo, nch, nch, NULL, 2, 2, sfrq, dfrq, 1, wfi.data_bytes, 0, 0);
+                else
+                    downsample(&wfi, &wo, nch, nch, NULL, 2, 2, sfrq, dfrq, 1, wfi.data_bytes, 0, 0);
+                wav_out_close(&wo);
+                fclose(fo);
+                wav_close(&wfi);
+            } });
+        }
+    }
+
+    /* Requantization, TPDF dither and noise shaping (shaped with
+       the coefficients of 44.1 kHz) */
+    for (int dtype = 1; dtype <= 3; dtype += 2) {
+        list.push_back({ dtype == 1 ? "dither/tpdf" : "dither/shaped", n, seconds, [n, dtype]() {
+            double peak = 0;
+            init_shaper(44100, 1, -32768, 32767, dtype, 1, 0.18);
+            for (long i = 0; i < n; i++)
+                y[i] = (short)do_shaping(f[i] * 32767.0, &peak, dtype, 0);
+            quit_shaper(1);
+        } });
+    }
+}
+
+/* Runs b until min_time, and prints its figures */
+static void run_bench(const bench& b, int first)
+{
+    typedef std::chrono::steady_clock clock;
+    long long a0, b0, a1, b1;
+    long runs = 0;
+    double t;
+    int counted;
+
+    b.run();                            /* warm up */
+    counted = bench_allocs(&a0, &b0);
+    clock::time_point start = clock::now();
+    do {
+        b.run();
+        runs++;
+        t = std::chrono::duration<double>(clock::now() - start).count();
+    } while (t < min_time);
+    bench_allocs(&a1, &b1);
+
+    double per_run = t / runs;
+    double sps = b.samples / per_run;
+    double allocs = counted ? (double)(a1 - a0) / runs : -1;
+    double bytes = counted ? (double)(b1 - b0) / runs : -1;
+
+    if (json) {
+        printf("%s    {\"name\": \"%s\", \"samples\": %lld, \"runs\": %ld, "
+               "\"seconds_per_run\": %.9g, \"samples_per_second\": %.6g, ",
+               first ? "" : ",\n", b.name.c_str(), b.samples, runs, per_run, sps);
+        if (b.duration > 0)
+            printf("\"x_realtime\": %.6g, ", b.duration / per_run);
+        else
+            printf("\"x_realtime\": null, ");
+        if (counted)
+            printf("\"allocs_per_run\": %.6g, \"alloc_bytes_per_run\": %.6g}", allocs, bytes);
+        else
+            printf("\"allocs_per_run\": null, \"alloc_bytes_per_run\": null}");
+    } else {
+        printf("%-24s %12.3f %14.4g", b.name.c_str(), per_run * 1e3, sps);
+        if (b.duration > 0)
+            printf(" %10.1f", b.duration / per_run);
+        else
+            printf(" %10s", "-");
+        if (counted)
+            printf(" %10.1f %12.0f\n", allocs, bytes);
+        else
+            printf(" %10s %12s\n", "-", "-");
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<bench> list;
+    std::vector<std::string> temps;
+    int i, first = 1;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-seconds") == 0 && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-min-time") == 0 && i + 1 < argc)
+            min_time = atof(argv[++i]);
+        else if (strcmp(argv[i], "-filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "-json") == 0)
+            json = 1;
+        else {
+            fprintf(stderr, "Usage: sv_bench [-seconds s] [-min-time s] [-filter text] [-json]\n");
+            return 1;
+        }
+    }
+    if (seconds <= 0)
+        seconds = 10;
+
+    quiet = 1;
+    add_benches(list, temps);
+
+    if (json)
+        printf("{\n  \"signal_seconds\": %g,\n  \"min_time\": %g,\n  \"benchmarks\": [\n", seconds, min_time);
+    else
+        printf("%-24s %12s %14s %10s %10s %12s\n",
+               "benchmark", "ms/run", "samples/s", "x realtime", "allocs", "alloc bytes");
+    for (const bench& b : list) {
+        if (filter != NULL && b.name.find(filter) == std::string::npos)
+            continue;
+        run_bench(b, first);
+        first = 0;
+    }
+    if (json)
+        printf("\n  ]\n}\n");
+
+    for (const std::string& name : temps)
+        remove(name.c_str());
+    return 0;
+}
+/* ......................... End of SV_BENCH.CPP ......................... */
@@ -5,9 +5,10 @@ Python bindings of webrtc audio processing
 """
 
 from glob import glob
+import os
 import platform
 import sys
-from setuptools import setup, Extension, find_packages
+from setuptools import setup, Extension, find_packages, Command
 
 
 with open('README.md') as f:
@@ -15,6 +16,7 @@ with open('README.md') as f:
 
 include_dirs = ['src', 'sv56']
 extra_compile_args = ['-std=c++11']
+libraries = [] if platform.system() == 'Windows' else ['pthread']
 
 ap_sources = []
 ap_dir_prefix = 'sv56/'
@@ -29,6 +31,69 @@ sources = (
     ['src\\pysv.cpp', 'src\\pysv.i']
 )
 
+bench_sources = glob(os.path.join('bench', '*.c*'))
+test_sources = glob(os.path.join('tests', '*.c*'))
+
+
+def build_programs(build_dir, programs, extra_include_dirs=[]):
+    """Compiles the library sources once into build_dir, and links every
+    program of `programs' (name: list of its own sources) with them"""
+    from distutils.ccompiler import new_compiler
+    from distutils.sysconfig import customize_compiler
+
+    compiler = new_compiler()
+    customize_compiler(compiler)
+    optimize = ['/O2'] if os.name == 'nt' else ['-O2']
+
+    def compile(srcs):
+        objects = []
+        for src in srcs:
+            args = extra_compile_args if src.endswith('.cpp') else []
+            objects += compiler.compile([src], output_dir=build_dir,
+                                        include_dirs=include_dirs + extra_include_dirs,
+                                        extra_postargs=args + optimize)
+        return objects
+
+    library = compile(ap_sources)
+    for name, srcs in programs.items():
+        compiler.link_executable(compile(srcs) + library, name, output_dir=build_dir,
+                                 libraries=libraries + ([] if os.name == 'nt' else ['m']),
+                                 target_lang='c++')
+
+
+class build_bench(Command):
+    """Builds the benchmark executable, build/bench/sv_bench, from the
+    library sources and bench/"""
+    description = 'build the sv_bench benchmark executable'
+    user_options = []
+
+    def initialize_options(self):
+        pass
+
+    def finalize_options(self):
+        pass
+
+    def run(self):
+        build_programs(os.path.join('build', 'bench'), {'sv_bench': bench_sources}, ['bench'])
+
+
+class build_tests(Command):
+    """Builds one check executable per tests/*.c file, build/tests/<name>,
+    against the library sources"""
+    description = 'build the C checks of tests/'
+    user_options = []
+
+    def initialize_options(self):
+        pass
+
+    def finalize_options(self):
+        pass
+
+    def run(self):
+        build_programs(os.path.join('build', 'tests'),
+                       dict((os.path.splitext(os.path.basename(src))[0], [src]) for src in test_sources))
+
+
 swig_opts = (
     ['-c++'] +
     ['-I' + h for h in include_dirs]
@@ -51,6 +116,7 @@ setup(
             sources=sources,
             swig_opts=swig_opts,
             include_dirs=include_dirs,
+            libraries=libraries,
             extra_compile_args=extra_compile_args
         )
     ],
@@ -64,5 +130,9 @@ setup(
     keywords=['sv56', 'G.191', 'P.56', 'speech voltmeter', 'normalization'],
     package_dir={
         'pysv': 'src'
+    },
+    cmdclass={
+        'build_bench': build_bench,
+        'build_tests': build_tests
     }
 )
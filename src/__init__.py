@@ -1,2 +1,11 @@
 # from .pysv import normalize, calculate
-from .pysv import calculate, normalize, samplerate_change
\ No newline at end of file
+from .pysv import calculate, calculate_channels, calculate_index, calculate_range, calculate_segments, calculate_timeline, calculate_resume, merge_states, normalize, normalize_inplace, normalize_corpus, samplerate_change, samplerate_change_matrix, samplerate_change_pcm, set_io_pipeline, set_result_cache
+from .pysv import MIX_NONE, MIX_AVERAGE, MIX_SELECT
+from .pysv import stats_names, stats_values, stats_reset, trace_start, trace_stop
+
+
+def stats():
+    # Timers and counters of the last call, and of the process so far
+    names = stats_names()
+    return {'call': dict(zip(names, stats_values(False))),
+            'process': dict(zip(names, stats_values(True)))}
@@ -0,0 +1,90 @@
+"""
+Client of the local pysv service (python -m pysv.server): the calls of
+pysv, run by the service, on files or on 16-bit samples in memory, which
+go through shared memory.
+"""
+import json
+import os
+import socket
+import struct
+import uuid
+import wave
+
+from .server import DEFAULT_SOCKET, SHM_DIR
+
+
+class Client(object):
+    def __init__(self, path=DEFAULT_SOCKET):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.rfile = self.sock.makefile('rb')
+
+    def close(self):
+        self.rfile.close()
+        self.sock.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def request(self, **req):
+        self.sock.sendall((json.dumps(req) + '\n').encode())
+        line = self.rfile.readline()
+        if not line:
+            raise ConnectionError('pysv server closed the connection')
+        reply = json.loads(line.decode())
+        if not reply['ok']:
+            raise RuntimeError(reply['error'])
+        return reply['result']
+
+    # Files: paths are made absolute, the server has its own directory
+
+    def calculate(self, FileIn):
+        return self.request(op='measure', file=os.path.abspath(FileIn))
+
+    def normalize(self, FileIn, FileOut, targetdB=-26):
+        return self.request(op='normalize', file=os.path.abspath(FileIn), out=os.path.abspath(FileOut),
+                            level=targetdB)
+
+    def samplerate_change(self, FileIn, FileOut, out_samplerate, mix=0, channel=0, float_out=False):
+        self.request(op='resample', file=os.path.abspath(FileIn), out=os.path.abspath(FileOut),
+                     rate=out_samplerate, mix=mix, channel=channel, float=float_out)
+
+    # Samples: interleaved 16-bit, as bytes, array('h') or an int16 numpy array
+
+    def calculate_samples(self, samples, rate, channels=1):
+        return self._with_samples(samples, rate, channels, dict(op='measure'))[0]
+
+    def normalize_samples(self, samples, rate, channels=1, targetdB=-26):
+        # Returns the state and the normalized samples, as bytes
+        return self._with_samples(samples, rate, channels, dict(op='normalize', level=targetdB), True)
+
+    def samplerate_change_samples(self, samples, rate, out_samplerate, channels=1):
+        # Returns the resampled samples, as bytes
+        return self._with_samples(samples, rate, channels, dict(op='resample', rate=out_samplerate), True)[1]
+
+    def _with_samples(self, samples, rate, channels, req, out=False):
+        from multiprocessing import shared_memory
+
+        data = memoryview(samples).cast('B')
+        header = struct.pack('<4sI4s4sIHHIIHH4sI', b'RIFF', 36 + len(data), b'WAVE', b'fmt ', 16, 1,
+                             channels, rate, rate * channels * 2, channels * 2, 16, b'data', len(data))
+        shm = shared_memory.SharedMemory(create=True, size=len(header) + len(data))
+        out_name = 'pysv_%s.wav' % uuid.uuid4().hex if out else None
+        try:
+            shm.buf[:len(header)] = header
+            shm.buf[len(header):len(header) + len(data)] = data
+            if out:
+                req['out_shm'] = out_name
+            result = self.request(shm=shm.name, **req)
+            if not out:
+                return result, None
+            with open(os.path.join(SHM_DIR, out_name), 'rb') as f, wave.open(f) as w:
+                return result, w.readframes(w.getnframes())
+        finally:
+            shm.close()
+            shm.unlink()
+            if out_name is not None and os.path.exists(os.path.join(SHM_DIR, out_name)):
+                os.unlink(os.path.join(SHM_DIR, out_name))
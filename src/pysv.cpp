@@ -1,15 +1,23 @@
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <stdexcept>
 
 #include "pysv.h"
 #include "sv-p56.h"
 #include "sv56.h"
+#include "svstats.h"
 
 pysv_state calculate(char *FileIn)
 {
     pysv_state state;
     SVP56_state sv_state;
 
+    sv_stats_begin();
+
+    /* A file that can't be measured gives n = 0 */
+    memset(&sv_state, 0, sizeof(sv_state));
     actlevel(FileIn, &sv_state);
 
     // print_act_short_summary(stderr, FileIn, &sv_state, sv_state.ActiveSpeechLevel, ActiveLeveldB, Overflow, gain);
@@ -41,6 +49,7 @@ pysv_state calculate(char *FileIn)
     state.ActiveSpeechLevel = sv_state.ActiveSpeechLevel;
     state.rmsPkF = sv_state.rmsPkF;
     state.ActPkF = sv_state.ActPkF;
+    state.Gain = sv_state.Gain;
 
     return state;
 }
@@ -50,9 +59,12 @@ pysv_state normalize(char *FileIn, char *FileOut, double targetdB)
     pysv_state state;
     SVP56_state sv_state;
 
-    sv56demo(FileIn, FileOut, targetdB);
+    sv_stats_begin();
 
-    actlevel(FileOut, &sv_state);
+    /* A failed equalization leaves no output, and gives n = 0 */
+    memset(&sv_state, 0, sizeof(sv_state));
+    if (sv56demo(FileIn, FileOut, targetdB) == 0)
+        actlevel(FileOut, &sv_state);
     state.f = sv_state.f;
     state.n = sv_state.n;
     state.s = sv_state.s;
@@ -69,11 +81,338 @@ pysv_state normalize(char *FileIn, char *FileOut, double targetdB)
     state.ActiveSpeechLevel = sv_state.ActiveSpeechLevel;
     state.rmsPkF = sv_state.rmsPkF;
     state.ActPkF = sv_state.ActPkF;
+    state.Gain = sv_state.Gain;
 
     return state;
 }
 
-void samplerate_change(char *FileIn, char *FileOut, int out_samplerate)
+static pysv_state to_pysv_state(const SVP56_state &sv_state)
+{
+    pysv_state state;
+
+    state.f = sv_state.f;
+    state.n = sv_state.n;
+    state.s = sv_state.s;
+    state.sq = sv_state.sq;
+    state.p = sv_state.p;
+    state.q = sv_state.q;
+    state.max = sv_state.max;
+    state.refdB = sv_state.refdB;
+    state.rmsdB = sv_state.rmsdB;
+    state.maxN = sv_state.maxN;
+    state.maxP = sv_state.maxP;
+    state.DClevel = sv_state.DClevel;
+    state.ActivityFactor = sv_state.ActivityFactor;
+    state.ActiveSpeechLevel = sv_state.ActiveSpeechLevel;
+    state.rmsPkF = sv_state.rmsPkF;
+    state.ActPkF = sv_state.ActPkF;
+    state.Gain = sv_state.Gain;
+
+    return state;
+}
+
+pysv_state normalize_inplace(char *File, double targetdB)
+{
+    SVP56_state sv_state;
+
+    sv_stats_begin();
+
+    /* Only the samples are rewritten; headers and other chunks stay.
+       A failed run gives n = 0 */
+    memset(&sv_state, 0, sizeof(sv_state));
+    if (sv56demo_inplace(File, targetdB) == 0)
+        actlevel(File, &sv_state);
+    return to_pysv_state(sv_state);
+}
+
+std::vector<pysv_state> normalize_corpus(const std::vector<std::string> &FilesIn, const std::vector<std::string> &FilesOut, double targetdB, int threads)
+{
+    std::vector<pysv_state> states;
+    std::vector<SVP56_state> sv_states(FilesIn.size());
+    std::vector<char *> in, out;
+    SVP56_state sv_corpus;
+
+    sv_stats_begin();
+
+    /* One state per output, from the gain, followed by that of the corpus */
+    if (FilesIn.empty() || FilesOut.size() != FilesIn.size())
+        return states;
+    for (size_t i = 0; i < FilesIn.size(); i++) {
+        in.push_back(const_cast<char *>(FilesIn[i].c_str()));
+        out.push_back(const_cast<char *>(FilesOut[i].c_str()));
+    }
+    if (sv56demo_corpus(&in[0], &out[0], (long)in.size(), targetdB, threads, &sv_states[0], &sv_corpus) != 0)
+        return states;
+    for (size_t i = 0; i < sv_states.size(); i++)
+        states.push_back(to_pysv_state(sv_states[i]));
+    states.push_back(to_pysv_state(sv_corpus));
+
+    return states;
+}
+
+/* Channels of the wave file FileIn, 0 when they can't be known ahead:
+   stdin or a pipe, which are read once, or a file that can't be opened */
+static int input_channels(char *FileIn)
+{
+    struct stat st;
+    WAV_file wf;
+    int nch;
+
+    if (strcmp(FileIn, "-") == 0 || stat(FileIn, &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG)
+        return 0;
+    if (wav_open(FileIn, 0, &wf) < 0)
+        return 0;
+    nch = wf.channels;
+    wav_close(&wf);
+    return nch;
+}
+
+std::vector<pysv_state> calculate_channels(char *FileIn, bool mixed)
+{
+    std::vector<pysv_state> states;
+    std::vector<SVP56_state> sv_states;
+    SVP56_state sv_mixed;
+    int nch;
+
+    sv_stats_begin();
+
+    /* One entry per channel, as many as the header has, followed by the
+       channel average when mixed */
+    if ((nch = input_channels(FileIn)) <= 0)
+        return states;
+    sv_states.resize(nch);
+    nch = actlevel_multi(FileIn, &sv_states[0], (long)sv_states.size(), mixed ? &sv_mixed : NULL);
+    for (int ch = 0; ch < nch && ch < (int)sv_states.size(); ch++)
+        states.push_back(to_pysv_state(sv_states[ch]));
+    if (nch > 0 && mixed)
+        states.push_back(to_pysv_state(sv_mixed));
+
+    return states;
+}
+
+int calculate_index(char *FileIn, long block)
+{
+    sv_stats_begin();
+
+    /* Checkpoints every `block' samples, in FileIn.p56 */
+    return actlevel_index(FileIn, block);
+}
+
+pysv_state calculate_range(char *FileIn, unsigned long long start, unsigned long long count)
+{
+    SVP56_state sv_state;
+
+    sv_stats_begin();
+
+    /* Made from the index, which is built first when missing or stale */
+    actlevel_range(FileIn, start, count, &sv_state);
+    return to_pysv_state(sv_state);
+}
+
+std::vector<pysv_state> calculate_segments(char *FileIn, const std::vector<unsigned long long> &starts, const std::vector<unsigned long long> &ends)
+{
+    std::vector<pysv_state> states;
+    std::vector<unsigned long long> s(starts), e(ends);
+    std::vector<SVP56_state> sv_states;
+    int nseg;
+
+    sv_stats_begin();
+
+    /* One entry per segment, all measured in one pass over the file */
+    s.resize(starts.size() < ends.size() ? starts.size() : ends.size());
+    e.resize(s.size());
+    if (s.empty())
+        return states;
+    sv_states.resize(s.size());
+    nseg = actlevel_segments(FileIn, &s[0], &e[0], (long)s.size(), &sv_states[0]);
+    for (int i = 0; i < nseg; i++)
+        states.push_back(to_pysv_state(sv_states[i]));
+
+    return states;
+}
+
+std::vector<double> calculate_timeline(char *FileIn, double frame_ms)
+{
+    std::vector<double> rows;
+    std::vector<SVP56_frame> frames;
+    SVP56_state sv_state;
+    WAV_file wf;
+    size_t len;
+    long count;
+    int raw;
+
+    sv_stats_begin();
+
+    /* Room for every frame, from the size and rate of the file */
+    len = strlen(FileIn);
+    raw = len > 4 && (strcmp(FileIn + len - 4, ".pcm") == 0 || strcmp(FileIn + len - 4, ".PCM") == 0);
+    if (wav_open(FileIn, raw, &wf) < 0)
+        return rows;
+    len = (size_t)floor(frame_ms * (wf.sample_rate > 0 ? wf.sample_rate : 16000) / 1000 + 0.5);
+    if (len > 65535) {
+        /* The longest frame of init_speech_timeline() */
+        wav_close(&wf);
+        throw std::invalid_argument("frame_ms makes frames of more than 65535 samples");
+    }
+    frames.resize((size_t)(wav_frames_left(&wf) / (len > 0 ? len : 1)) + 1);
+    wav_close(&wf);
+
+    /* Rows of envelope, rms and peak in dBov, and activity, one per frame */
+    count = actlevel_timeline(FileIn, frame_ms, &frames[0], (long)frames.size(), &sv_state);
+    for (long i = 0; i < count && i < (long)frames.size(); i++) {
+        rows.push_back(frames[i].envdB);
+        rows.push_back(frames[i].rmsdB);
+        rows.push_back(frames[i].peakdB);
+        rows.push_back(frames[i].active);
+    }
+
+    return rows;
+}
+
+pysv_state calculate_resume(char *FileIn, char *FileState, unsigned long long every)
+{
+    SVP56_state sv_state;
+
+    sv_stats_begin();
+
+    /* Goes on from the checkpoint in FileState, if any, and leaves the final state there */
+    actlevel_resume(FileIn, FileState, every, &sv_state);
+    return to_pysv_state(sv_state);
+}
+
+pysv_state merge_states(const std::vector<std::string> &FileStates)
 {
-    ssrc(FileIn, FileOut, out_samplerate);
-}
\ No newline at end of file
+    SVP56_state sv_state;
+    std::vector<char *> names;
+
+    sv_stats_begin();
+
+    /* State files of consecutive parts, in order */
+    for (size_t i = 0; i < FileStates.size(); i++)
+        names.push_back(const_cast<char *>(FileStates[i].c_str()));
+    if (names.empty() || actlevel_merge(&names[0], (long)names.size(), &sv_state) != 0)
+        memset(&sv_state, 0, sizeof(sv_state));
+    return to_pysv_state(sv_state);
+}
+
+void samplerate_change(char *FileIn, char *FileOut, int out_samplerate, int mix, int channel, bool float_out)
+{
+    ssrc_mix m;
+    int nch;
+
+    if (mix != MIX_NONE && mix != MIX_AVERAGE && mix != MIX_SELECT)
+        throw std::invalid_argument("mix must be MIX_NONE, MIX_AVERAGE or MIX_SELECT");
+    nch = input_channels(FileIn);
+    if (mix == MIX_SELECT && (channel < 0 || (nch > 0 && channel >= nch)))
+        throw std::invalid_argument("channel is not a channel of the input");
+
+    sv_stats_begin();
+
+    m.type = mix;
+    m.channel = channel;
+    m.out_channels = 0;
+    m.in_channels = 0;
+    m.weights = NULL;
+    if (ssrc_stream(FileIn, FileOut, out_samplerate, &m, NULL, float_out ? SSRC_OUT_FLOAT : SSRC_OUT_AUTO) != 0)
+        throw std::invalid_argument("mix doesn't fit the channels of the input");
+}
+
+void samplerate_change_matrix(char *FileIn, char *FileOut, int out_samplerate, int in_channels, const std::vector<double> &weights)
+{
+    ssrc_mix m;
+    int nch;
+
+    /* weights holds one row of in_channels gains per output channel */
+    if (in_channels <= 0 || weights.empty() || weights.size() % in_channels != 0)
+        throw std::invalid_argument("weights must hold in_channels gains per output channel");
+    nch = input_channels(FileIn);
+    if (nch > 0 && in_channels != nch)
+        throw std::invalid_argument("in_channels is not the number of channels of the input");
+
+    sv_stats_begin();
+
+    m.type = SSRC_MIX_MATRIX;
+    m.channel = 0;
+    m.in_channels = in_channels;
+    m.out_channels = (int)(weights.size() / in_channels);
+    m.weights = &weights[0];
+    if (ssrc_mixed(FileIn, FileOut, out_samplerate, &m) != 0)
+        throw std::invalid_argument("in_channels is not the number of channels of the input");
+}
+
+void samplerate_change_pcm(char *FileIn, char *FileOut, int out_samplerate, int in_samplerate, int in_channels, int in_bits, bool wav_out, bool in_float)
+{
+    ssrc_pcm raw;
+
+    sv_stats_begin();
+
+    /* Headerless input, e.g. a pipe from another tool; "-" is stdin/stdout */
+    raw.sample_rate = in_samplerate;
+    raw.channels = in_channels;
+    raw.bits = in_bits;
+    raw.format = in_float ? WAV_FORMAT_FLOAT : WAV_FORMAT_PCM;
+    ssrc_stream(FileIn, FileOut, out_samplerate, NULL, &raw, wav_out ? SSRC_OUT_WAV : SSRC_OUT_RAW);
+}
+
+void set_io_pipeline(int queue_depth, long block_size)
+{
+    /* queue_depth 0 reads and writes in the calling thread */
+    wav_set_pipeline(queue_depth, block_size);
+}
+
+int set_result_cache(char *CacheDir)
+{
+    /* calculate() then looks up, and keeps, its results in CacheDir; "" stops */
+    return actlevel_cache(CacheDir);
+}
+
+std::vector<std::string> stats_names()
+{
+    std::vector<std::string> names;
+
+    /* Wall time, then seconds and calls of each stage, then the counters */
+    names.push_back("wall");
+    for (int i = 0; i < SV_STAGES; i++)
+        names.push_back(std::string(sv_stats_stage_name(i)) + "_seconds");
+    for (int i = 0; i < SV_STAGES; i++)
+        names.push_back(std::string(sv_stats_stage_name(i)) + "_entries");
+    for (int i = 0; i < SV_COUNTERS; i++)
+        names.push_back(sv_stats_counter_name(i));
+
+    return names;
+}
+
+std::vector<double> stats_values(bool total)
+{
+    std::vector<double> values;
+    sv_stats call, process;
+
+    /* Same order as stats_names(), of the last call or of the process */
+    sv_stats_get(&call, &process);
+    const sv_stats &st = total ? process : call;
+    values.push_back(st.wall);
+    for (int i = 0; i < SV_STAGES; i++)
+        values.push_back(st.seconds[i]);
+    for (int i = 0; i < SV_STAGES; i++)
+        values.push_back((double)st.calls[i]);
+    for (int i = 0; i < SV_COUNTERS; i++)
+        values.push_back((double)st.count[i]);
+
+    return values;
+}
+
+void stats_reset()
+{
+    sv_stats_reset();
+}
+
+int trace_start(char *FileTrace)
+{
+    /* Written out by trace_stop(), or when the process ends */
+    return sv_trace_start(FileTrace);
+}
+
+int trace_stop()
+{
+    return sv_trace_stop();
+}
@@ -1,14 +1,24 @@
 #ifndef __PYSV_MODULE_H__
 #define __PYSV_MODULE_H__
+#include <string>
+#include <vector>
 #include "sv-p56.h"
+#include "sv56.h"
+
+/* Channel mixing for samplerate_change(), applied before resampling */
+enum {
+    MIX_NONE = SSRC_MIX_NONE,         /* resample every channel */
+    MIX_AVERAGE = SSRC_MIX_AVERAGE,   /* average all channels into mono */
+    MIX_SELECT = SSRC_MIX_SELECT      /* keep only `channel' (0-based) */
+};
 
 /* State for speech voltmeter function */
 typedef struct {
     float f;                      /* sampling frequency, in Hz */
-    unsigned long a[15];          /* activity count */
+    unsigned long long a[15];     /* activity count */
     double c[15];                 /* threshold level; 15 is the no.of thres. */
-    unsigned long hang[15];       /* hangover count */
-    unsigned long n;              /* number of samples read since last reset */
+    unsigned long long hang[15];  /* hangover count */
+    unsigned long long n;         /* number of samples read since last reset */
     double s;                     /* sum of all samples since last reset */
     double sq;                    /* squared sum of samples since last reset */
     double p;                     /* intermediate quantities */
@@ -27,6 +37,24 @@ typedef struct {
 
 pysv_state calculate(char *FileIn);
 pysv_state normalize(char *FileIn, char *FileOut, double targetdB);
-void samplerate_change(char *FileIn, char *FileOut, int out_samplerate);
+pysv_state normalize_inplace(char *File, double targetdB);
+std::vector<pysv_state> normalize_corpus(const std::vector<std::string> &FilesIn, const std::vector<std::string> &FilesOut, double targetdB = -26, int threads = 0);
+std::vector<pysv_state> calculate_channels(char *FileIn, bool mixed = true);
+int calculate_index(char *FileIn, long block = 0);
+pysv_state calculate_range(char *FileIn, unsigned long long start, unsigned long long count = 0);
+std::vector<double> calculate_timeline(char *FileIn, double frame_ms = 10);
+pysv_state calculate_resume(char *FileIn, char *FileState, unsigned long long every = 0);
+pysv_state merge_states(const std::vector<std::string> &FileStates);
+std::vector<pysv_state> calculate_segments(char *FileIn, const std::vector<unsigned long long> &starts, const std::vector<unsigned long long> &ends);
+void samplerate_change(char *FileIn, char *FileOut, int out_samplerate, int mix = MIX_NONE, int channel = 0, bool float_out = false);
+void samplerate_change_matrix(char *FileIn, char *FileOut, int out_samplerate, int in_channels, const std::vector<double> &weights);
+void samplerate_change_pcm(char *FileIn, char *FileOut, int out_samplerate, int in_samplerate, int in_channels, int in_bits = 16, bool wav_out = true, bool in_float = false);
+void set_io_pipeline(int queue_depth = WAV_QUEUE_DEPTH, long block_size = WAV_BLOCK_SIZE);
+int set_result_cache(char *CacheDir);
+std::vector<std::string> stats_names();
+std::vector<double> stats_values(bool total = false);
+void stats_reset();
+int trace_start(char *FileTrace);
+int trace_stop();
 
 #endif // __PYSV_MODULE_H__
\ No newline at end of file
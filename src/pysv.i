@@ -6,11 +6,26 @@
     #define SWIG_FILE_WITH_INIT
 %}
 
-// %include "std_string.i"
+%include "exception.i"
+%include "std_string.i"
+%include "std_vector.i"
+%template(DoubleVector) std::vector<double>;
+%template(StringVector) std::vector<std::string>;
+%template(ULongLongVector) std::vector<unsigned long long>;
 
 %{
 #include "pysv.h"
 %}
 
+%exception {
+    try {
+        $action
+    } catch (const std::invalid_argument &e) {
+        SWIG_exception(SWIG_ValueError, e.what());
+    }
+}
+
 %include "pysv.h"
 
+%template(PysvStateVector) std::vector<pysv_state>;
+
@@ -0,0 +1,147 @@
+"""
+Local pysv service: a long-running process whose workers keep the
+extension loaded and the rate converter filters they designed, so that a
+job sends a request instead of starting an interpreter.
+
+    $ python -m pysv.server [--socket PATH] [--workers N] [--cache DIR]
+
+Requests and replies are JSON objects, one per line, over a Unix domain
+socket:
+    {"op": "measure", "file": "/abs/in.wav"}
+    {"op": "normalize", "file": "/abs/in.wav", "out": "/abs/out.wav", "level": -26}
+    {"op": "resample", "file": "/abs/in.wav", "out": "/abs/out.wav", "rate": 16000}
+    {"op": "ping"}
+"shm" and "out_shm" in place of "file" and "out" name POSIX shared
+memory segments (Linux), holding wave files: pysv.client puts samples in
+them. The reply is {"ok": true, "result": ...} or {"ok": false,
+"error": "..."}.
+"""
+import argparse
+import getpass
+import json
+import os
+import socket
+import socketserver
+import tempfile
+import threading
+from concurrent.futures import ProcessPoolExecutor
+from concurrent.futures.process import BrokenProcessPool
+
+from . import calculate, normalize, samplerate_change, set_result_cache, MIX_NONE
+
+DEFAULT_SOCKET = os.path.join(tempfile.gettempdir(), 'pysv-%s.sock' % getpass.getuser())
+SHM_DIR = '/dev/shm'
+
+STATE_FIELDS = ('f', 'n', 's', 'sq', 'p', 'q', 'max', 'refdB', 'rmsdB', 'maxP', 'maxN', 'DClevel',
+                'ActivityFactor', 'ActiveSpeechLevel', 'rmsPkF', 'ActPkF', 'Gain')
+
+
+def _state(state):
+    return dict((name, getattr(state, name)) for name in STATE_FIELDS)
+
+
+def _path(req, key, shm_key):
+    # A file, or a shared memory segment by its name
+    if key in req:
+        return str(req[key])
+    name = str(req.get(shm_key, '')).lstrip('/')
+    if not name or os.path.basename(name) != name:
+        raise ValueError('"%s" or "%s" expected' % (key, shm_key))
+    return os.path.join(SHM_DIR, name)
+
+
+def _run(req):
+    # In a worker: the filters designed here are kept for its next requests
+    op = req.get('op')
+    src = _path(req, 'file', 'shm')
+    if not os.path.isfile(src):
+        raise ValueError('no file %s' % src)
+    if op == 'measure':
+        return _state(calculate(src))
+    if op == 'normalize':
+        return _state(normalize(src, _path(req, 'out', 'out_shm'), float(req.get('level', -26))))
+    if op == 'resample':
+        samplerate_change(src, _path(req, 'out', 'out_shm'), int(req['rate']), int(req.get('mix', MIX_NONE)),
+                          int(req.get('channel', 0)), bool(req.get('float', False)))
+        return None
+    raise ValueError('unknown op %r' % op)
+
+
+class _Handler(socketserver.StreamRequestHandler):
+    def handle(self):
+        for line in self.rfile:
+            try:
+                reply = {'ok': True, 'result': self.server.run(json.loads(line.decode()))}
+            except Exception as e:
+                reply = {'ok': False, 'error': str(e) or e.__class__.__name__}
+            self.wfile.write((json.dumps(reply) + '\n').encode())
+
+
+class Server(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    daemon_threads = True
+
+    def __init__(self, path=DEFAULT_SOCKET, workers=None, cache=None):
+        # A socket left by a server that is gone is replaced, a live one is not
+        if os.path.exists(path):
+            probe = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            try:
+                probe.connect(path)
+                raise RuntimeError('a server is running on %s' % path)
+            except (ConnectionRefusedError, FileNotFoundError):
+                os.unlink(path)
+            finally:
+                probe.close()
+        socketserver.UnixStreamServer.__init__(self, path, _Handler)
+        os.chmod(path, 0o600)
+        self.path = path
+        self.workers = workers or os.cpu_count() or 1
+        self.cache = cache
+        self.lock = threading.Lock()
+        self.pool = self._start()
+
+    def _start(self):
+        # Workers started and the extension loaded ahead of the first request
+        pool = ProcessPoolExecutor(self.workers, initializer=set_result_cache if self.cache else None,
+                                   initargs=(self.cache,) if self.cache else ())
+        pool.submit(int).result()
+        return pool
+
+    def run(self, req):
+        if req.get('op') == 'ping':
+            return {'pid': os.getpid(), 'workers': self.workers}
+        pool = self.pool
+        try:
+            return pool.submit(_run, req).result()
+        except BrokenProcessPool:
+            # The library exits on some errors (bad header, unsupported
+            # rates): the requests in the lost workers fail, new ones start
+            with self.lock:
+                if self.pool is pool:
+                    self.pool = self._start()
+            raise RuntimeError('worker exited on %s' % json.dumps(req))
+
+    def server_close(self):
+        socketserver.UnixStreamServer.server_close(self)
+        self.pool.shutdown()
+        if os.path.exists(self.path):
+            os.unlink(self.path)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(prog='python -m pysv.server', description='Local pysv service')
+    parser.add_argument('--socket', default=DEFAULT_SOCKET, help='socket path [%(default)s]')
+    parser.add_argument('--workers', type=int, default=None, help='worker processes [CPUs]')
+    parser.add_argument('--cache', default=None, help='result cache of measure, see set_result_cache()')
+    args = parser.parse_args(argv)
+
+    server = Server(args.socket, args.workers, args.cache)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.server_close()
+
+
+if __name__ == '__main__':
+    main()
@@ -75,6 +75,8 @@
             (scaling) algorithm of scale() and the data type
         conversion functions sh2fl() and fl2sh(). Prototypes
         are in `ugst-utl.h'.
+  > wavfile.c:  wave file reader, wav_open(), wav_read() and
+            wav_close(). Prototypes are in `wavfile.h'.
 
   Exit values:
   ~~~~~~~~~~~~
@@ -125,6 +127,51 @@
                            characters and changing strcpy() to
                            strncpy() in the filename copy process.
                            <simao>
+  19.Oct.26     2.5        Added actlevel_multi(), measuring all channels
+                           of an interleaved wave file in one pass.
+  19.Oct.26     2.6        actlevel() measures the 16-bit samples with
+                           speech_voltmeter_int(), without converting
+                           them to float.
+  19.Oct.26     2.7        Files are read through the memory-mapped
+                           reader of wavfile.c, opened once.
+  19.Oct.26     2.8        RF64/Wave64 input; sample counts are 64-bit.
+  19.Oct.26     2.9        Input prefetched by an I/O thread, see
+                           wav_set_pipeline().
+  19.Oct.26     2.10       32-bit float wave files measured as they are,
+                           with no conversion.
+  19.Oct.26     2.11       Level index: actlevel_index() keeps checkpoints
+                           of the voltmeter in a sidecar file, from which
+                           actlevel_range() measures any segment reading
+                           only the blocks at its ends. The -start, -n
+                           and -end options are measured that way.
+  19.Oct.26     2.12       actlevel_segments(): a list of segments, each
+                           measured as a file of its own, in one pass.
+  19.Oct.26     2.13       actlevel_timeline(): per-frame envelope, rms,
+                           peak and activity, in the same pass.
+  19.Oct.26     2.14       actlevel_resume(): checkpoints to a state file,
+                           from which a stopped measurement goes on;
+                           actlevel_merge() of the states of consecutive
+                           parts.
+  19.Oct.26     2.15       The voltmeter runs at the sampling rate of the
+                           wave header, no longer at 16 kHz whatever the
+                           file; 16 kHz is kept for *.pcm files.
+  19.Oct.26     2.16       Sidecar hits and misses of actlevel_range()
+                           counted (svstats.h).
+  19.Oct.26     2.17       actlevel() traced as a span, with the file
+                           name.
+  19.Oct.26     2.18       Result cache: actlevel_cache() names a
+                           directory where actlevel() keeps its results
+                           by the hash of the samples, for any process.
+  19.Oct.26     2.19       actlevel_volt(): actlevel(), with the state of
+                           the voltmeter, to be merged with others.
+  19.Oct.26     2.20       actlevel_merge() refuses parts of another
+                           sampling rate.
+  19.Oct.26     2.21       Result cache: a file it doesn't know is hashed
+                           while it is measured, not read twice.
+  19.Oct.26     2.22       actlevel() and actlevel_volt() return -1 for a
+                           file with no samples, instead of calling exit().
+  19.Oct.26     2.23       actlevel_multi() returns -1 for a file with no
+                           samples, and when out of memory.
   ============================================================================
 */
 #define _CRT_SECURE_NO_WARNINGS
@@ -151,8 +198,18 @@
 #include <sys/stat.h>
 #endif
 
+/* ... Includes for the result cache ... */
+#include <time.h>
+#if defined(_WIN32)
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
 /* ... Include of speech-voltmeter-related routines ... */
 #include "sv-p56.h"
+#include "sv-p56m.h"
 
 /* ... Include of utilities ... */
 #include "ugst-utl.h"
@@ -160,6 +217,9 @@
 /* ... Include of wav header informations ... */
 #include "sv56.h"
 
+/* ... Include of stage timers, counters and trace ... */
+#include "svstats.h"
+
 /* ... Local definitions ... */
 #define DEF_BLK_LEN 256         /* samples per block */
 #define MIN_LOG_OFFSET 1.0e-20  /* To avoid sigularity with log(0.0) */
@@ -384,7 +444,7 @@ void print_act_short_summary(FILE* out, char* file, SVP56_state state, double al
         - state.refdB;
 
     /* Report number of samples */
-    fprintf(out, "Samples: %5ld, ", state.n);
+    fprintf(out, "Samples: %5llu, ", state.n);
 
     /* Skip if filesize is zero */
     if (state.n == 0) {
@@ -561,10 +621,14 @@ int main(int argc, char* argv[])
         argc--;
     }
 
-    actlevel(FileIn, &sv_state);
+    /* A range of blocks is measured through the level index */
+    if (N1 > 1 || N2 > 0)
+        actlevel_range(FileIn, (unsigned long long)(N1 - 1) * N, (unsigned long long)N2 * N, &sv_state);
+    else
+        actlevel(FileIn, &sv_state);
 
     fprintf(stderr, "FIle: \t%s\n", FileIn);
-    fprintf(stderr, "Samples: %5ld\n", sv_state.n);
+    fprintf(stderr, "Samples: %5llu\n", sv_state.n);
     fprintf(stderr, "Min: %5.0f\n", sv_state.maxN);
     fprintf(stderr, "Max: %5.0f\n", sv_state.maxP);
     fprintf(stderr, "DC: %7.2f\n", sv_state.DClevel);
@@ -597,11 +661,59 @@ int main(int argc, char* argv[])
 }
 #endif
 
-int actlevel(char* FileIn, SVP56_state* sv_state)
+/*
+  ============================================================================
+
+       void report_state (SVP56_state *sv_state, SVP56_state *state,
+       ~~~~~~~~~~~~~~~~~  double al_dB, double ratio, double gain);
+
+       Copy the P.56 statistics of `state' to the caller's `sv_state',
+       with the levels scaled back to the input sample range.
+
+       Parameter:
+       ~~~~~~~~~~
+       sv_state . statistics returned to the caller
+       state .... P.56 state variable after the measurement
+       al_dB .... active level in dB
+       ratio .... overflow point of the input samples, as in
+                  print_act_short_summary()
+       gain ..... equalization factor to be reported
+
+       Returns
+       ~~~~~~~
+       None
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Split from actlevel(), shared with actlevel_multi().
+
+  ============================================================================
+*/
+static void report_state(SVP56_state* sv_state, SVP56_state* state, double al_dB, double ratio, double gain) {
+    double abs_max_dB;
+    abs_max_dB = 20 * log10(SVP56_get_abs_max(*state) + MIN_LOG_OFFSET);
+
+    sv_state->maxN = ratio * state->maxN;
+    sv_state->maxP = ratio * state->maxP;
+    sv_state->DClevel = ratio * state->DClevel;
+    sv_state->rmsdB = state->rmsdB;
+    sv_state->ActiveSpeechLevel = al_dB;
+    sv_state->ActivityFactor = state->ActivityFactor * 100;
+    sv_state->rmsPkF = abs_max_dB - state->rmsdB;
+    sv_state->ActPkF = abs_max_dB - al_dB;
+    sv_state->Gain = gain;
+    sv_state->n = state->n;
+}
+
+/* Sees the samples actlevel_mono() meters, as they are read, e.g. to
+   hash them for the result cache in the same pass */
+typedef void (*mono_tap)(void* arg, WAV_file* wf, const void* data, long frames);
+
+static int actlevel_mono(char* FileIn, SVP56_state* sv_state, SVP56_state* volt, mono_tap tap, void* tap_arg)
 {
     /* Parameters for operation */
     double Overflow;              /* Max.positive value for AD_resolution bits */
-    long N = DEF_BLK_LEN, N1 = 1, N2 = 0, i, l;
+    long N = DEF_BLK_LEN, l;
 
     wav_header header;
     int header_offset = 0;
@@ -611,20 +723,17 @@ int actlevel(char* FileIn, SVP56_state* sv_state)
 
     /* File-related variables */
     //char FileIn[256];
-    FILE* Fi;                     /* input file pointer */
+    WAV_file wf;                  /* input file, mapped */
     FILE* out = stdout;           /* where to print the statistical results */
-#ifdef VMS
-    char mrs[15];
-#endif
 
     /* Other variables */
-    short buffer[4096];
-    float Buf[4096];
+    const void* buffer;           /* samples, in place in the mapping */
+    float Buf[DEF_BLK_LEN];       /* float samples, when unaligned in place */
     long bitno = 16;
-    double sf = 16000;            /* Hz */
-    double ActiveLeveldB, level = 0, gain = 0;
+    double sf = 16000;            /* Hz, for *.pcm files */
+    double ActiveLeveldB = -100.0, level = 0, gain = 0;
     char use_active_level = 1;
-    int name_len;
+    int name_len, raw = 0;
 
     char FileLog[256] = "log.txt";
 
@@ -641,72 +750,67 @@ int actlevel(char* FileIn, SVP56_state* sv_state)
     /* Overflow (saturation) point */
     Overflow = pow((double)2.0, (double)(bitno - 1));
 
-    /* Reset variables for speech level measurements */
-    init_speech_voltmeter(&state, sf);
-
-    /* check file extension */
-    /* Read wave header and offset */
+    /* check file extension: *.pcm files have no header */
     name_len = strlen(FileIn);
     if (name_len > 4)
-    {
-        if ((strcmp(FileIn + name_len - 4, ".wav") == 0) || (strcmp(FileIn + name_len - 4, ".WAV") == 0))
-            header_offset = wav_header_read(FileIn, &header);
-        if ((strcmp(FileIn + name_len - 4, ".PCM") == 0) || (strcmp(FileIn + name_len - 4, ".pcm") == 0)) 
-        {
-            header_offset = 0;
-            struct stat st;
-            stat(FileIn, &st);
-            header.data_bytes = st.st_size;
-        }
-    }
+        raw = (strcmp(FileIn + name_len - 4, ".PCM") == 0) || (strcmp(FileIn + name_len - 4, ".pcm") == 0);
 
     /* ......... FILE PREPARATION ......... */
 
-    /* Opening input file; abort if there's any problem */
-#ifdef VMS
-    sprintf(mrs, "mrs=%d", 2 * N);
-#endif
-    if ((Fi = fopen(FileIn, "rb")) == NULL)
-        KILL(FileIn, 2);
+    /* Opening input file and reading its wave header, at once */
+    header_offset = wav_open(FileIn, raw, &wf);
+    if (header_offset == 0) {
+        if (raw)
+            header.num_channels = 1;
+        else if ((header_offset = wav_header_check(&wf, &header)) < 0)
+            wav_close(&wf);
+    }
 
-    /* Initialize number of blocks to all samples */
-    N2 = (long)ceil(header.data_bytes / (double)(N * sizeof(short)));
+    /* Bad header, or an interleaved file: see actlevel_multi() for those */
+    if (header_offset < 0) {
+        if (out != stdout)
+            fclose(out);
+        return header_offset;
+    }
+    if (header.num_channels != 1) {
+        fprintf(stderr, "not MONO channel\n");
+        wav_close(&wf);
+        if (out != stdout)
+            fclose(out);
+        return WAV_HEADER_NOT_MONO;
+    }
 
-    /* Move pointer after wave header */
-    if (fseek(Fi, header_offset, 0) < 0l)
-        KILL(FileIn, 4);
+    /* Reset variables for speech level measurements, at the rate of the file */
+    init_speech_voltmeter(&state, wav_rate(&wf, sf));
 
     /* ... MEASUREMENT OF ACTIVE SPEECH LEVEL ACCORDING P.56 ... */
-    int total_samples = header.data_bytes / 2;
-    int no_samples = 0;
-
-    /* Read samples ... */
-    for (i = 0; i < (N2 - 1); i++) {
-        if ((l = fread(buffer, sizeof(short), N, Fi)) > 0) {
-            /* ... Convert samples to float */
-            sh2fl((long)l, buffer, Buf, bitno, 1);
-
-            /* ... Get the active level */
-            ActiveLeveldB = speech_voltmeter(Buf, (long)l, &state);
-            total_samples -= l;
-            no_samples += l;
-        }
-        else {
-            KILL(FileIn, 5);
-        }
+    if (wav_frames_left(&wf) == 0) {
+        fprintf(stderr, "%s: no samples\n", FileIn);
+        wav_close(&wf);
+        if (out != stdout)
+            fclose(out);
+        return -1;
     }
-    // for the last block samples, no < N
-    if ((l = fread(buffer, sizeof(short), total_samples, Fi)) > 0) {
-        /* ... Convert samples to float */
-        sh2fl((long)l, buffer, Buf, bitno, 1);
 
-        /* ... Get the active level */
-        ActiveLeveldB = speech_voltmeter(Buf, (long)l, &state);
-        total_samples -= l;
-        no_samples += l;
+    /* Reads overlap with the metering */
+    wav_prefetch(&wf, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+
+    /* Get the active level, straight from the 16-bit or float samples */
+    if (wf.format == WAV_FORMAT_FLOAT) {
+        while ((l = wav_read(&wf, N, &buffer)) > 0) {
+            if (tap != NULL)
+                tap(tap_arg, &wf, buffer, l);
+            if ((size_t)buffer % sizeof(float) != 0)
+                buffer = memcpy(Buf, buffer, l * sizeof(float));
+            ActiveLeveldB = speech_voltmeter((float*)buffer, l, &state);
+        }
     }
     else {
-        KILL(FileIn, 5);
+        while ((l = wav_read(&wf, N, &buffer)) > 0) {
+            if (tap != NULL)
+                tap(tap_arg, &wf, buffer, l);
+            ActiveLeveldB = speech_voltmeter_int((void*)buffer, l, 16, &state);
+        }
     }
 
     if (level != 0) {
@@ -719,21 +823,11 @@ int actlevel(char* FileIn, SVP56_state* sv_state)
 
     print_act_short_summary(out, FileIn, state, ActiveLeveldB, Overflow, gain);
 
-    double abs_max_dB;
-    abs_max_dB = 20 * log10(SVP56_get_abs_max(state) + MIN_LOG_OFFSET);
-
-    sv_state->maxN = Overflow * state.maxN;
-    sv_state->maxP = Overflow * state.maxP;
-    sv_state->DClevel = Overflow * state.DClevel;
-    sv_state->rmsdB = state.rmsdB;
-    sv_state->ActiveSpeechLevel = ActiveLeveldB;
-    sv_state->ActivityFactor = state.ActivityFactor * 100;
-    sv_state->rmsPkF = abs_max_dB - SVP56_get_rms_dB(state);
-    sv_state->ActPkF = abs_max_dB - ActiveLeveldB;
-    sv_state->Gain = gain;
-    sv_state->n = state.n;
+    report_state(sv_state, &state, ActiveLeveldB, Overflow, gain);
+    if (volt != NULL)
+        *volt = state;
     /* Close current file */
-    fclose(Fi);
+    wav_close(&wf);
 
     /* FINALIZATIONS */
     /* ... Close log file, if it is the case */
@@ -746,3 +840,1526 @@ int actlevel(char* FileIn, SVP56_state* sv_state)
     return (0);
 #endif
 }
+
+static int actlevel_cached(char* FileIn, SVP56_state* sv_state, SVP56_state* volt);
+static char rc_dir[FILENAME_MAX];
+
+int actlevel(char* FileIn, SVP56_state* sv_state)
+{
+    return actlevel_volt(FileIn, sv_state, NULL);
+}
+
+
+/*
+  ============================================================================
+
+       int actlevel_volt (char *FileIn, SVP56_state *sv_state,
+       ~~~~~~~~~~~~~~~~~  SVP56_state *volt);
+
+       actlevel(), returning as well the state of the voltmeter at the
+       end of the file (sums, peaks and activity counts, in the
+       normalized range), e.g. to merge the states of many files with
+       speech_voltmeter_merge(). A result found in the result cache
+       comes with its state.
+
+       Parameter:
+       ~~~~~~~~~~
+       FileIn ... wave (or headerless *.pcm) file, 16-bit or float mono
+       sv_state . statistics, as from actlevel()
+       volt ..... state of the voltmeter, or NULL
+
+       Returns
+       ~~~~~~~
+       As actlevel().
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int actlevel_volt(char* FileIn, SVP56_state* sv_state, SVP56_state* volt)
+{
+    int err;
+
+    SV_TRACE_BEGIN("actlevel", FileIn);
+    if (rc_dir[0] != 0)
+        err = actlevel_cached(FileIn, sv_state, volt);
+    else
+        err = actlevel_mono(FileIn, sv_state, volt, NULL, NULL);
+    SV_TRACE_END();
+    return err;
+}
+
+
+/*
+  ============================================================================
+
+       int actlevel_multi (char *FileIn, SVP56_state *sv_state, long max_ch,
+       ~~~~~~~~~~~~~~~~~~  SVP56_state *mixed);
+
+       Measure every channel of an interleaved 16-bit wave file in a
+       single pass, with the same results as measuring each channel
+       on its own with actlevel(). When `mixed' is not NULL, the
+       average of all channels is measured as well.
+
+       Parameter:
+       ~~~~~~~~~~
+       FileIn ... wave file name
+       sv_state . statistics of the first `max_ch' channels
+       max_ch ... number of entries in `sv_state'
+       mixed .... statistics of the channel average, or NULL
+
+       Returns
+       ~~~~~~~
+       The number of channels in the file, or a negative value on error
+       (among them a file with no samples).
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.1	32-bit float wave files.
+       19.Oct.26	v1.2	-1 for no samples, or no memory, not exit().
+
+  ============================================================================
+*/
+int actlevel_multi(char* FileIn, SVP56_state* sv_state, long max_ch, SVP56_state* mixed)
+{
+    double Overflow;
+    long N = DEF_BLK_LEN, nch, ch, l;
+
+    wav_header header;
+    int header_offset;
+
+    SVP56_multi_state state;
+    SVP56_state lane;
+
+    WAV_file wf;
+    FILE* out;
+
+    const void* buffer;
+    float* Buf, * x;
+    long bitno = 16;
+    double sf = 16000;            /* Hz */
+    double ActiveLeveldB;
+
+    char FileLog[256] = "log.txt";
+
+    /* Only wave files tell the number of channels */
+    if ((header_offset = wav_open(FileIn, 0, &wf)) < 0)
+        return header_offset;
+    if ((header_offset = wav_header_check(&wf, &header)) < 0) {
+        wav_close(&wf);
+        return header_offset;
+    }
+    nch = header.num_channels;
+
+    if ((out = fopen(FileLog, "at")) == NULL) {
+        fprintf(stderr, "log file open error.\n");
+        wav_close(&wf);
+        return -1;
+    }
+
+    /* Overflow (saturation) point */
+    Overflow = pow((double)2.0, (double)(bitno - 1));
+
+    if (wav_frames_left(&wf) == 0) {
+        fprintf(stderr, "%s: no samples\n", FileIn);
+        wav_close(&wf);
+        fclose(out);
+        return -1;
+    }
+
+    /* Reset variables for speech level measurements, one lane per channel */
+    if (init_speech_voltmeter_multi(&state, wav_rate(&wf, sf), nch, mixed != NULL) < 0) {
+        fprintf(stderr, "Can't allocate memory for the speech voltmeter\n");
+        wav_close(&wf);
+        fclose(out);
+        return -1;
+    }
+
+    Buf = (float*)malloc(N * nch * sizeof(float));
+    if (Buf == NULL) {
+        fprintf(stderr, "Can't allocate memory for data buffers\n");
+        wav_close(&wf);
+        fclose(out);
+        free_speech_voltmeter_multi(&state);
+        return -1;
+    }
+
+    /* ... MEASUREMENT OF ACTIVE SPEECH LEVEL ACCORDING P.56 ... */
+    wav_prefetch(&wf, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+    while ((l = wav_read(&wf, N, &buffer)) > 0) {
+        /* ... Convert samples to float, all channels at once; float
+               samples are taken in place, or copied when unaligned */
+        x = Buf;
+        if (wf.format != WAV_FORMAT_FLOAT)
+            sh2fl(l * nch, (short*)buffer, Buf, bitno, 1);
+        else if ((size_t)buffer % sizeof(float) != 0)
+            memcpy(Buf, buffer, l * nch * sizeof(float));
+        else
+            x = (float*)buffer;
+
+        /* ... Accumulate every channel */
+        speech_voltmeter_multi(x, l, &state);
+    }
+
+    /* Channels first, then the mix in the last lane */
+    for (ch = 0; ch < state.lanes; ch++) {
+        ActiveLeveldB = speech_voltmeter_lane(&state, ch, &lane);
+        print_act_short_summary(out, FileIn, lane, ActiveLeveldB, Overflow, 0);
+
+        if (ch == nch)
+            report_state(mixed, &lane, ActiveLeveldB, Overflow, 0);
+        else if (ch < max_ch)
+            report_state(&sv_state[ch], &lane, ActiveLeveldB, Overflow, 0);
+    }
+
+    /* FINALIZATIONS */
+    wav_close(&wf);
+    fclose(out);
+    free(Buf);
+    free_speech_voltmeter_multi(&state);
+
+    return (int)nch;
+}
+
+
+/*
+ * .................... LEVEL INDEX ....................
+ *
+ * A sidecar next to the file ("<file>.p56") keeps the state of the
+ * speech voltmeter at the end of every block of one actlevel() pass
+ * over it, and the peaks within each block. The level of a segment
+ * then costs the metering of at most two blocks: the state at either
+ * end of the segment is that of the checkpoint before it, carried on
+ * to the exact sample, and the counts and sums of the segment are the
+ * differences of the two. The envelope and the hangover run on across
+ * the start of the segment, so that the statistics are those of the
+ * segment within the recording; for a segment from the first sample
+ * they are exactly those of actlevel().
+ */
+#define IDX_BLOCK 16384         /* samples per checkpoint, by default */
+#define IDX_MAGIC "SV56IDX1"
+
+/* Sidecar header, followed by `blocks' idx_block records */
+typedef struct {
+    char magic[8];                /* IDX_MAGIC */
+    unsigned long long file_size; /* of the indexed file */
+    unsigned long long data_offset, data_bytes; /* of its samples */
+    long long mtime;              /* its modification time */
+    int format;                   /* WAV_FORMAT_PCM or WAV_FORMAT_FLOAT */
+    long block;                   /* samples per block */
+    unsigned long long blocks;    /* whole blocks in the file */
+} idx_header;
+
+/* Voltmeter state at the end of a block, and the peaks within it */
+typedef struct {
+    double s, sq;                 /* sums from the first sample */
+    double p, q;                  /* envelope */
+    SVP56_count a[15];            /* activity counts from the first sample */
+    unsigned int hang[15];        /* hangover counts */
+    float maxP, maxN;             /* peaks of the block */
+} idx_block;
+
+/* Open a mono 16-bit or float file as actlevel() does */
+static int mono_open(char* FileIn, WAV_file* wf) {
+    wav_header header;
+    int name_len, raw = 0, header_offset;
+
+    /* *.pcm files have no header */
+    name_len = strlen(FileIn);
+    if (name_len > 4)
+        raw = (strcmp(FileIn + name_len - 4, ".PCM") == 0) || (strcmp(FileIn + name_len - 4, ".pcm") == 0);
+
+    header_offset = wav_open(FileIn, raw, wf);
+    if (header_offset == 0) {
+        if (raw)
+            header.num_channels = 1;
+        else if ((header_offset = wav_header_check(wf, &header)) < 0)
+            wav_close(wf);
+    }
+    if (header_offset < 0)
+        return header_offset;
+    if (header.num_channels != 1) {
+        fprintf(stderr, "%s: not MONO channel\n", FileIn);
+        wav_close(wf);
+        return WAV_HEADER_NOT_MONO;
+    }
+    return 0;
+}
+
+/* Meter `l' samples just read; Buf is room for them, if not aligned */
+static void mono_meter(const void* buffer, long l, int format, float* Buf, SVP56_state* state) {
+    if (format == WAV_FORMAT_FLOAT) {
+        if ((size_t)buffer % sizeof(float) != 0)
+            buffer = memcpy(Buf, buffer, l * sizeof(float));
+        speech_voltmeter((float*)buffer, l, state);
+    }
+    else
+        speech_voltmeter_int((void*)buffer, l, 16, state);
+}
+
+/* Open a file to index, and fill in what identifies it */
+static int idx_open(char* FileIn, WAV_file* wf, idx_header* h) {
+    struct stat st;
+    int err;
+
+    if ((err = mono_open(FileIn, wf)) < 0)
+        return err;
+    if (wf->stream || stat(FileIn, &st) != 0) {
+        fprintf(stderr, "%s: can't index a stream\n", FileIn);
+        wav_close(wf);
+        return WAV_HEADER_NOK;
+    }
+
+    memset(h, 0, sizeof(idx_header));
+    memcpy(h->magic, IDX_MAGIC, 8);
+    h->file_size = wf->file_size;
+    h->data_offset = wf->data_offset;
+    h->data_bytes = wf->data_bytes;
+    h->mtime = (long long)st.st_mtime;
+    h->format = wf->format;
+    return 0;
+}
+
+/* Meter the next `frames' frames, read DEF_BLK_LEN at a time as in actlevel() */
+static unsigned long long idx_meter(WAV_file* wf, SVP56_state* state, unsigned long long frames) {
+    const void* buffer;
+    float Buf[DEF_BLK_LEN];
+    unsigned long long done = 0;
+    long l;
+
+    while (done < frames) {
+        l = (long)(frames - done < DEF_BLK_LEN ? frames - done : DEF_BLK_LEN);
+        if ((l = wav_read(wf, l, &buffer)) <= 0)
+            break;
+        mono_meter(buffer, l, wf->format, Buf, state);
+        done += l;
+    }
+    return done;
+}
+
+/* The voltmeter as it was at the end of block k (-1: before the first),
+   with its peaks reset; the record is read from the sidecar */
+static int idx_restore(FILE* fx, idx_header* h, long long k, SVP56_state* state, double sf) {
+    idx_block r;
+    int j;
+
+    init_speech_voltmeter(state, sf);
+    if (k < 0)
+        return 0;
+    if (WAV_FSEEK(fx, sizeof(idx_header) + k * sizeof(idx_block), SEEK_SET) != 0 ||
+        fread(&r, sizeof(idx_block), 1, fx) != 1)
+        return -1;
+    state->n = (SVP56_count)(k + 1) * h->block;
+    state->s = r.s;
+    state->sq = r.sq;
+    state->p = r.p;
+    state->q = r.q;
+    for (j = 0; j < 15; j++) {
+        state->a[j] = r.a[j];
+        state->hang[j] = r.hang[j];
+    }
+    return 0;
+}
+
+/* Peaks of another part merged into `to' */
+static void idx_peaks(SVP56_state* to, double maxP, double maxN) {
+    if (maxP > to->maxP)
+        to->maxP = maxP;
+    if (maxN < to->maxN)
+        to->maxN = maxN;
+}
+
+
+/*
+  ============================================================================
+
+       int actlevel_index (char *FileIn, long block);
+       ~~~~~~~~~~~~~~~~~~
+
+       Meter a file once, as actlevel() does, and write the state of
+       the voltmeter every `block' samples to the sidecar "<FileIn>.p56"
+       for actlevel_range(). Each block takes sizeof(idx_block) bytes
+       of the sidecar, some 220 bytes.
+
+       Parameter:
+       ~~~~~~~~~~
+       FileIn ... wave (or headerless *.pcm) file, 16-bit or float mono
+       block .... samples per checkpoint, rounded up to a multiple of
+                  DEF_BLK_LEN; 0 for IDX_BLOCK
+
+       Returns
+       ~~~~~~~
+       0 on success, or a WAV_HEADER_* error code, or -1.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int actlevel_index(char* FileIn, long block)
+{
+    SVP56_state state;
+    WAV_file wf;
+    idx_header h, blank;
+    idx_block r;
+    FILE* fx;
+    char* FileIdx;
+    double sf = 16000;            /* Hz, for *.pcm files */
+    unsigned long long k;
+    int err, j;
+
+    if ((err = idx_open(FileIn, &wf, &h)) < 0)
+        return err;
+
+    /* Blocks made of whole reads, so that the pass is that of actlevel() */
+    if (block <= 0)
+        block = IDX_BLOCK;
+    h.block = (block + DEF_BLK_LEN - 1) / DEF_BLK_LEN * DEF_BLK_LEN;
+    h.blocks = wav_frames_left(&wf) / h.block;
+
+    FileIdx = (char*)malloc(strlen(FileIn) + 5);
+    if (FileIdx == NULL) {
+        wav_close(&wf);
+        return -1;
+    }
+    sprintf(FileIdx, "%s.p56", FileIn);
+    if ((fx = fopen(FileIdx, "wb")) == NULL) {
+        fprintf(stderr, "%s: can't create the index\n", FileIdx);
+        free(FileIdx);
+        wav_close(&wf);
+        return -1;
+    }
+
+    /* The header is written last, so that a sidecar cut short is never valid */
+    memset(&blank, 0, sizeof(blank));
+    err = fwrite(&blank, sizeof(idx_header), 1, fx) != 1 ? -1 : 0;
+
+    init_speech_voltmeter(&state, wav_rate(&wf, sf));
+    wav_prefetch(&wf, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+    for (k = 0; k < h.blocks && err == 0; k++) {
+        state.maxP = -32768.;
+        state.maxN = 32767.;
+        if (idx_meter(&wf, &state, h.block) != (unsigned long long)h.block) {
+            err = -1;
+            break;
+        }
+        r.s = state.s;
+        r.sq = state.sq;
+        r.p = state.p;
+        r.q = state.q;
+        for (j = 0; j < 15; j++) {
+            r.a[j] = state.a[j];
+            r.hang[j] = (unsigned int)state.hang[j];
+        }
+        r.maxP = (float)state.maxP;
+        r.maxN = (float)state.maxN;
+        if (fwrite(&r, sizeof(idx_block), 1, fx) != 1)
+            err = -1;
+    }
+
+    if (err == 0 && (fseek(fx, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(idx_header), 1, fx) != 1))
+        err = -1;
+    if (fclose(fx) != 0)
+        err = -1;
+    if (err < 0)
+        remove(FileIdx);
+
+    free(FileIdx);
+    wav_close(&wf);
+    return err;
+}
+
+
+/*
+  ============================================================================
+
+       int actlevel_range (char *FileIn, unsigned long long start,
+       ~~~~~~~~~~~~~~~~~~  unsigned long long count, SVP56_state *sv_state);
+
+       Active level of the `count' samples of a file from sample
+       `start', e.g. an utterance of a long recording, through the
+       sidecar of actlevel_index(): only the blocks at either end of
+       the segment are read. The sidecar is made first when there is
+       none, or when the file has changed since.
+
+       Parameter:
+       ~~~~~~~~~~
+       FileIn ... wave (or headerless *.pcm) file, 16-bit or float mono
+       start .... first sample of the segment
+       count .... number of samples; 0, or past the end, for all the rest
+       sv_state . statistics of the segment, as from actlevel()
+
+       Returns
+       ~~~~~~~
+       0 on success, or a WAV_HEADER_* error code, or -1.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int actlevel_range(char* FileIn, unsigned long long start, unsigned long long count, SVP56_state* sv_state)
+{
+    SVP56_state state, at, seg;
+    WAV_file wf;
+    idx_header h, hx;
+    idx_block r;
+    FILE* fx, * out;
+    char* FileIdx;
+    double sf = 16000;            /* Hz, for *.pcm files */
+    double Overflow, ActiveLeveldB;
+    unsigned long long frames, end, k, m;
+    long bitno = 16;
+    int err, j, built = 0;
+
+    if ((err = idx_open(FileIn, &wf, &h)) < 0)
+        return err;
+    sf = wav_rate(&wf, sf);
+    frames = wav_frames_left(&wf);
+    if (start > frames)
+        start = frames;
+    end = (count == 0 || count > frames - start) ? frames : start + count;
+    if (end == start) {
+        wav_close(&wf);
+        return -1;
+    }
+
+    FileIdx = (char*)malloc(strlen(FileIn) + 5);
+    if (FileIdx == NULL) {
+        wav_close(&wf);
+        return -1;
+    }
+    sprintf(FileIdx, "%s.p56", FileIn);
+
+    /* The sidecar must be of this very file */
+    for (;;) {
+        if ((fx = fopen(FileIdx, "rb")) != NULL) {
+            if (fread(&hx, sizeof(idx_header), 1, fx) == 1 && memcmp(hx.magic, IDX_MAGIC, 8) == 0 &&
+                hx.file_size == h.file_size && hx.data_offset == h.data_offset &&
+                hx.data_bytes == h.data_bytes && hx.mtime == h.mtime && hx.format == h.format &&
+                hx.block > 0 && hx.blocks == frames / hx.block)
+                break;
+            fclose(fx);
+            fx = NULL;
+        }
+        if (built++ || (err = actlevel_index(FileIn, 0)) < 0)
+            break;
+    }
+    SV_COUNT(built ? SV_COUNT_CACHE_MISSES : SV_COUNT_CACHE_HITS, 1);
+    if (fx == NULL) {
+        free(FileIdx);
+        wav_close(&wf);
+        return err < 0 ? err : -1;
+    }
+    h = hx;
+
+    /* State at `start': checkpoint of the block before, then the samples up to it */
+    k = start / h.block;
+    err = idx_restore(fx, &h, (long long)k - 1, &state, sf);
+    if (err == 0)
+        err = wav_seek(&wf, k * h.block);
+    if (err == 0 && idx_meter(&wf, &state, start - k * h.block) != start - k * h.block)
+        err = -1;
+    at = state;
+
+    /* Peaks of the segment: the ends metered, the blocks in between from the sidecar */
+    state.maxP = -32768.;
+    state.maxN = 32767.;
+    m = end / h.block;
+    if (err == 0 && m == k) {
+        if (idx_meter(&wf, &state, end - start) != end - start)
+            err = -1;
+    }
+    else if (err == 0) {
+        if (idx_meter(&wf, &state, (k + 1) * h.block - start) != (k + 1) * h.block - start)
+            err = -1;
+        seg = state;
+        if (k + 1 < m && WAV_FSEEK(fx, sizeof(idx_header) + (k + 1) * sizeof(idx_block), SEEK_SET) != 0)
+            err = -1;
+        for (k++; err == 0 && k < m; k++) {
+            if (fread(&r, sizeof(idx_block), 1, fx) != 1)
+                err = -1;
+            idx_peaks(&seg, r.maxP, r.maxN);
+        }
+        if (err == 0)
+            err = idx_restore(fx, &h, (long long)m - 1, &state, sf);
+        if (err == 0)
+            err = wav_seek(&wf, m * h.block);
+        if (err == 0 && idx_meter(&wf, &state, end - m * h.block) != end - m * h.block)
+            err = -1;
+        idx_peaks(&state, seg.maxP, seg.maxN);
+    }
+    fclose(fx);
+    wav_close(&wf);
+    free(FileIdx);
+    if (err < 0)
+        return err;
+
+    /* The segment: differences of the sums and counts at its two ends */
+    init_speech_voltmeter(&seg, sf);
+    seg.n = state.n - at.n;
+    seg.s = state.s - at.s;
+    seg.sq = state.sq - at.sq;
+    for (j = 0; j < 15; j++)
+        seg.a[j] = state.a[j] - at.a[j];
+    seg.maxP = state.maxP;
+    seg.maxN = state.maxN;
+    seg.max = (seg.maxP > -seg.maxN) ? seg.maxP : -seg.maxN;
+
+    ActiveLeveldB = active_speech_level(&seg);
+
+    Overflow = pow((double)2.0, (double)(bitno - 1));
+    if ((out = fopen("log.txt", "at")) != NULL) {
+        print_act_short_summary(out, FileIn, seg, ActiveLeveldB, Overflow, 0);
+        fclose(out);
+    }
+    report_state(sv_state, &seg, ActiveLeveldB, Overflow, 0);
+    return 0;
+}
+
+#undef IDX_MAGIC
+#undef IDX_BLOCK
+/* ....................... End of level index ....................... */
+
+
+/*
+ * .................... SEGMENT LISTS ....................
+ *
+ * Many segments of one file, possibly overlapping, measured in a single
+ * pass. Each segment starts with a voltmeter of its own, as if it were
+ * a file by itself; the voltmeters (lanes) of all open segments are fed
+ * the same samples, which are read once. Two lanes whose envelope and
+ * hangover counts have become the same, to the last bit, go on the
+ * same from then on, so they are merged and their segments share one
+ * lane, each keeping the difference of the counts and sums as an
+ * offset: on speech, lanes started at different times merge within a
+ * second or so, and the cost follows the length of the file rather than
+ * the sum of the lengths of the segments. Stretches where no segment is
+ * open are skipped.
+ */
+
+/* Segment boundary, sorted by position */
+typedef struct {
+    unsigned long long pos;       /* sample */
+    long seg;                     /* segment number */
+} seg_event;
+
+static int seg_event_cmp(const void* a, const void* b) {
+    const seg_event* x = (const seg_event*)a, * y = (const seg_event*)b;
+
+    return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : (int)(x->seg - y->seg);
+}
+
+/* Counts and sums of lane `from' less those of lane `to', added to `off' */
+static void seg_offset(SVP56_state* off, SVP56_state* from, SVP56_state* to) {
+    int j;
+
+    off->n += from->n - to->n;
+    off->s += from->s - to->s;
+    off->sq += from->sq - to->sq;
+    for (j = 0; j < 15; j++)
+        off->a[j] += from->a[j] - to->a[j];
+}
+
+
+/*
+  ============================================================================
+
+       int actlevel_segments (char *FileIn, unsigned long long *start,
+       ~~~~~~~~~~~~~~~~~~~~~  unsigned long long *end, long nseg,
+                              SVP56_state *sv_state);
+
+       Active level of each of the `nseg' segments [start[i], end[i])
+       of a file (e.g. the turns of a diarization) in one pass over the
+       file, with the results of cutting each segment out to a file of
+       its own and measuring it with actlevel().
+
+       Parameter:
+       ~~~~~~~~~~
+       FileIn ... wave (or headerless *.pcm) file, 16-bit or float mono
+       start .... first sample of each segment
+       end ...... sample after the last of each segment; clipped to the
+                  end of the file
+       nseg ..... number of segments
+       sv_state . statistics of each segment, as from actlevel(); an
+                  empty segment has n = 0 and a level of -100 dB
+
+       Returns
+       ~~~~~~~
+       The number of segments, or a WAV_HEADER_* error code, or -1.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int actlevel_segments(char* FileIn, unsigned long long* start, unsigned long long* end, long nseg, SVP56_state* sv_state)
+{
+    SVP56_state* lane, * off, seg;
+    long* on, * users, * open;
+    seg_event* starts, * ends;
+    WAV_file wf;
+    FILE* out;
+    const void* buffer;
+    float Buf[DEF_BLK_LEN];
+    double sf = 16000;            /* Hz, for *.pcm files */
+    double Overflow, ActiveLeveldB;
+    unsigned long long frames, pos = 0, next;
+    long bitno = 16, nopen = 0, nlane = 0, si = 0, ei = 0, i, j, k, s, l;
+    int err;
+
+    if (nseg <= 0)
+        return 0;
+    if ((err = mono_open(FileIn, &wf)) < 0)
+        return err;
+    sf = wav_rate(&wf, sf);
+    frames = wav_frames_left(&wf);
+
+    lane = (SVP56_state*)malloc(nseg * sizeof(SVP56_state));
+    off = (SVP56_state*)malloc(nseg * sizeof(SVP56_state));
+    on = (long*)malloc(3 * nseg * sizeof(long));
+    starts = (seg_event*)malloc(2 * nseg * sizeof(seg_event));
+    if (lane == NULL || off == NULL || on == NULL || starts == NULL) {
+        free(lane);
+        free(off);
+        free(on);
+        free(starts);
+        wav_close(&wf);
+        return -1;
+    }
+    users = on + nseg;            /* open segments metered by each lane */
+    open = users + nseg;          /* the open segments */
+    ends = starts + nseg;
+
+    /* Boundaries in the order they are met */
+    for (i = 0; i < nseg; i++) {
+        starts[i].pos = start[i] < frames ? start[i] : frames;
+        ends[i].pos = end[i] < frames ? end[i] : frames;
+        if (ends[i].pos < starts[i].pos)
+            ends[i].pos = starts[i].pos;
+        starts[i].seg = ends[i].seg = i;
+        users[i] = 0;
+        off[i].maxP = -32768.;
+        off[i].maxN = 32767.;
+    }
+    qsort(starts, nseg, sizeof(seg_event), seg_event_cmp);
+    qsort(ends, nseg, sizeof(seg_event), seg_event_cmp);
+
+    wav_prefetch(&wf, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+    for (err = 0;;) {
+        /* Segments starting here, on a new voltmeter, or on one started here too */
+        for (; si < nseg && starts[si].pos == pos; si++) {
+            s = starts[si].seg;
+            for (k = 0; k < nlane && (users[k] == 0 || lane[k].n != 0); k++);
+            if (k == nlane) {
+                for (k = 0; users[k] != 0; k++);
+                init_speech_voltmeter(&lane[k], sf);
+                nlane = (k + 1 > nlane) ? k + 1 : nlane;
+            }
+            users[k]++;
+            on[s] = k;
+            off[s].n = 0;
+            off[s].s = off[s].sq = 0;
+            for (j = 0; j < 15; j++)
+                off[s].a[j] = 0;
+            open[nopen++] = s;
+        }
+
+        /* Segments ending here: their counts are those of the lane, less the offset */
+        for (; ei < nseg && ends[ei].pos == pos; ei++) {
+            s = ends[ei].seg;
+            for (i = 0; open[i] != s; i++);
+            open[i] = open[--nopen];
+            users[on[s]]--;
+            off[s].n += lane[on[s]].n;
+            off[s].s += lane[on[s]].s;
+            off[s].sq += lane[on[s]].sq;
+            for (j = 0; j < 15; j++)
+                off[s].a[j] += lane[on[s]].a[j];
+        }
+        if (ei == nseg)
+            break;
+
+        /* Nothing open: on to the next start */
+        if (nopen == 0) {
+            if (wav_seek(&wf, starts[si].pos) == 0)
+                pos = starts[si].pos;
+            else
+                for (; pos < starts[si].pos; pos += l)
+                    if ((l = wav_read(&wf, (long)(starts[si].pos - pos < DEF_BLK_LEN ? starts[si].pos - pos : DEF_BLK_LEN), &buffer)) <= 0)
+                        break;
+            if (pos != starts[si].pos) {
+                err = -1;
+                break;
+            }
+            continue;
+        }
+
+        /* Samples up to the next boundary */
+        next = ends[ei].pos;
+        if (si < nseg && starts[si].pos < next)
+            next = starts[si].pos;
+        if (next - pos > DEF_BLK_LEN)
+            next = pos + DEF_BLK_LEN;
+        if ((l = wav_read(&wf, (long)(next - pos), &buffer)) <= 0) {
+            err = -1;
+            break;
+        }
+        pos += l;
+
+        /* Every lane in use meters them; the peaks go to the open segments */
+        for (k = 0, j = -1; k < nlane; k++)
+            if (users[k] != 0) {
+                lane[k].maxP = -32768.;
+                lane[k].maxN = 32767.;
+                mono_meter(buffer, l, wf.format, Buf, &lane[k]);
+                j = k;
+            }
+        for (i = 0; i < nopen; i++)
+            idx_peaks(&off[open[i]], lane[j].maxP, lane[j].maxN);
+
+        /* Lanes that have become the same are merged */
+        for (k = 0; k < nlane; k++) {
+            for (j = k + 1; users[k] != 0 && j < nlane; j++) {
+                if (users[j] == 0 || lane[j].p != lane[k].p || lane[j].q != lane[k].q ||
+                    memcmp(lane[j].hang, lane[k].hang, sizeof(lane[k].hang)) != 0)
+                    continue;
+                for (i = 0; i < nopen; i++)
+                    if (on[open[i]] == j) {
+                        seg_offset(&off[open[i]], &lane[j], &lane[k]);
+                        on[open[i]] = k;
+                    }
+                users[k] += users[j];
+                users[j] = 0;
+            }
+        }
+    }
+    wav_close(&wf);
+
+    /* Statistics of each segment */
+    Overflow = pow((double)2.0, (double)(bitno - 1));
+    out = (err == 0) ? fopen("log.txt", "at") : NULL;
+    for (i = 0; i < nseg && err == 0; i++) {
+        init_speech_voltmeter(&seg, sf);
+        seg.n = off[i].n;
+        seg.s = off[i].s;
+        seg.sq = off[i].sq;
+        for (j = 0; j < 15; j++)
+            seg.a[j] = off[i].a[j];
+        seg.maxP = off[i].maxP;
+        seg.maxN = off[i].maxN;
+        seg.max = (seg.maxP > -seg.maxN) ? seg.maxP : -seg.maxN;
+        if (seg.n == 0) {
+            seg.maxP = seg.maxN = seg.max = seg.DClevel = seg.ActivityFactor = 0;
+            seg.rmsdB = ActiveLeveldB = -100.0;
+        }
+        else
+            ActiveLeveldB = active_speech_level(&seg);
+        if (out != NULL)
+            print_act_short_summary(out, FileIn, seg, ActiveLeveldB, Overflow, 0);
+        report_state(&sv_state[i], &seg, ActiveLeveldB, Overflow, 0);
+    }
+    if (out != NULL)
+        fclose(out);
+
+    free(lane);
+    free(off);
+    free(on);
+    free(starts);
+    return err < 0 ? err : (int)nseg;
+}
+/* ..................... End of actlevel_segments() ..................... */
+
+
+/*
+  ============================================================================
+
+       long actlevel_timeline (char *FileIn, double frame_ms,
+       ~~~~~~~~~~~~~~~~~~~~~~  SVP56_frame *frame, long max_frames,
+                               SVP56_state *sv_state);
+
+       actlevel(), with the timeline of the voltmeter kept in the same
+       pass: for every frame of `frame_ms' milliseconds, the envelope,
+       rms level and peak, in dBov, and the activity at the final
+       threshold of P.56 (see speech_voltmeter_timeline()).
+
+       Parameter:
+       ~~~~~~~~~~
+       FileIn ..... wave (or headerless *.pcm) file, 16-bit or float mono
+       frame_ms ... length of a frame, in ms
+       frame ...... timeline, `max_frames' frames; may be NULL
+       max_frames . room in `frame'
+       sv_state ... statistics of the whole file, as from actlevel()
+
+       Returns
+       ~~~~~~~
+       The number of frames in the file, stored or not, or a
+       WAV_HEADER_* error code.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+long actlevel_timeline(char* FileIn, double frame_ms, SVP56_frame* frame, long max_frames, SVP56_state* sv_state)
+{
+    SVP56_state state;
+    SVP56_timeline tl;
+    WAV_file wf;
+    FILE* out;
+    const void* buffer;
+    float Buf[DEF_BLK_LEN];
+    double sf = 16000;            /* Hz, for *.pcm files */
+    double Overflow, ActiveLeveldB = -100.0;
+    long bitno = 16, l, count;
+    int err;
+
+    if ((err = mono_open(FileIn, &wf)) < 0)
+        return err;
+    sf = wav_rate(&wf, sf);
+
+    init_speech_voltmeter(&state, sf);
+    init_speech_timeline(&tl, &state, (long)floor(frame_ms * sf / 1000 + 0.5), frame, max_frames);
+
+    /* The samples are metered a frame at a time, as they are read */
+    wav_prefetch(&wf, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+    while ((l = wav_read(&wf, DEF_BLK_LEN, &buffer)) > 0) {
+        if (wf.format == WAV_FORMAT_FLOAT) {
+            if ((size_t)buffer % sizeof(float) != 0)
+                buffer = memcpy(Buf, buffer, l * sizeof(float));
+            ActiveLeveldB = speech_voltmeter_timeline((void*)buffer, l, 0, &state, &tl);
+        }
+        else
+            ActiveLeveldB = speech_voltmeter_timeline((void*)buffer, l, 16, &state, &tl);
+    }
+    wav_close(&wf);
+    count = speech_timeline_end(&tl, &state);
+
+    Overflow = pow((double)2.0, (double)(bitno - 1));
+    if ((out = fopen("log.txt", "at")) != NULL) {
+        print_act_short_summary(out, FileIn, state, ActiveLeveldB, Overflow, 0);
+        fclose(out);
+    }
+    report_state(sv_state, &state, ActiveLeveldB, Overflow, 0);
+    return count;
+}
+/* ..................... End of actlevel_timeline() ..................... */
+
+
+/*
+ * .................... CHECKPOINTS ....................
+ *
+ * The state of the voltmeter and the position reached in the input are
+ * saved every so often as a blob of speech_voltmeter_save() to a state
+ * file, in one of two slots written in turn and flushed to the disk, so
+ * that a worker stopped at any point finds the last good checkpoint in
+ * one slot or the other. The file is left with the final state, which
+ * can also be merged with those of the inputs that follow it.
+ */
+#define CKP_EVERY 60            /* seconds between checkpoints */
+
+/* Latest good checkpoint of a state file; -1 if there is none */
+static int ckp_read(char* FileState, SVP56_state* state, unsigned long long* pos) {
+    unsigned char blob[2][SVP56_STATE_BYTES];
+    unsigned long long at[2];
+    SVP56_state st[2];
+    FILE* fs;
+    size_t len;
+    int slot, best = -1;
+
+    if ((fs = fopen(FileState, "rb")) == NULL)
+        return -1;
+    len = fread(blob, 1, sizeof(blob), fs);
+    fclose(fs);
+    for (slot = 0; slot < 2; slot++) {
+        if (len < (size_t)(slot + 1) * SVP56_STATE_BYTES ||
+            speech_voltmeter_restore(&st[slot], &at[slot], blob[slot], SVP56_STATE_BYTES) != 0)
+            continue;
+        if (best < 0 || at[slot] > at[best])
+            best = slot;
+    }
+    if (best < 0)
+        return -1;
+    *state = st[best];
+    *pos = at[best];
+    return 0;
+}
+
+/* Checkpoint number `seq' to its slot, then to the disk */
+static int ckp_write(FILE* fs, long seq, SVP56_state* state, unsigned long long pos) {
+    unsigned char blob[SVP56_STATE_BYTES];
+
+    speech_voltmeter_save(state, pos, blob, SVP56_STATE_BYTES);
+    if (fseek(fs, (seq & 1) * SVP56_STATE_BYTES, SEEK_SET) != 0 ||
+        fwrite(blob, 1, SVP56_STATE_BYTES, fs) != SVP56_STATE_BYTES)
+        return -1;
+    return wav_flush(fs);
+}
+
+
+/*
+  ============================================================================
+
+       int actlevel_resume (char *FileIn, char *FileState,
+       ~~~~~~~~~~~~~~~~~~~  unsigned long long every,
+                            SVP56_state *sv_state);
+
+       actlevel(), checkpointed every `every' samples to the state file
+       `FileState'. When the state file already holds a checkpoint, the
+       measurement goes on from it: the samples already metered are
+       skipped (or, on a stream, read and thrown away), and the result
+       is the same as that of a pass with no stop. At the end the state
+       file holds the state of the whole input. A state file belongs to
+       one input: it is not checked against another.
+
+       Parameter:
+       ~~~~~~~~~~
+       FileIn .... wave (or headerless *.pcm) file, 16-bit or float mono
+       FileState . state file, created when missing
+       every ..... samples between checkpoints; 0 for CKP_EVERY seconds
+       sv_state .. statistics, as from actlevel()
+
+       Returns
+       ~~~~~~~
+       0 on success, -1 on an I/O error, or a WAV_HEADER_* error code.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int actlevel_resume(char* FileIn, char* FileState, unsigned long long every, SVP56_state* sv_state)
+{
+    SVP56_state state;
+    WAV_file wf;
+    FILE* out, * fs;
+    const void* buffer;
+    float Buf[DEF_BLK_LEN];
+    double sf = 16000;            /* Hz, for *.pcm files */
+    double Overflow, ActiveLeveldB;
+    unsigned long long pos = 0, next;
+    long bitno = 16, seq = 0, l;
+    int err;
+
+    if ((err = mono_open(FileIn, &wf)) < 0)
+        return err;
+    sf = wav_rate(&wf, sf);
+    every = (every == 0) ? (unsigned long long)(CKP_EVERY * sf) : every;
+
+    /* From the last checkpoint, if any */
+    if (ckp_read(FileState, &state, &pos) != 0 || pos > wav_frames_left(&wf) || wav_seek(&wf, pos) != 0) {
+        for (next = pos, pos = 0; pos < next; pos += l)
+            if ((l = wav_read(&wf, (long)(next - pos < DEF_BLK_LEN ? next - pos : DEF_BLK_LEN), &buffer)) <= 0)
+                break;
+        if (pos != next || next == 0) {
+            wav_rewind(&wf);
+            init_speech_voltmeter(&state, sf);
+            pos = 0;
+        }
+    }
+    if ((fs = fopen(FileState, "r+b")) == NULL && (fs = fopen(FileState, "w+b")) == NULL) {
+        fprintf(stderr, "%s: can't write the state\n", FileState);
+        wav_close(&wf);
+        return -1;
+    }
+
+    /* Metered as by actlevel(), checkpointed on the way */
+    wav_prefetch(&wf, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+    for (next = pos + every; err == 0 && (l = wav_read(&wf, DEF_BLK_LEN, &buffer)) > 0;) {
+        mono_meter(buffer, l, wf.format, Buf, &state);
+        if ((pos += l) >= next) {
+            err = ckp_write(fs, seq++, &state, pos);
+            next = pos + every;
+        }
+    }
+    wav_close(&wf);
+    if (err == 0)
+        err = ckp_write(fs, seq, &state, pos);
+    if (fclose(fs) != 0 || err != 0)
+        return -1;
+
+    ActiveLeveldB = active_speech_level(&state);
+    Overflow = pow((double)2.0, (double)(bitno - 1));
+    if ((out = fopen("log.txt", "at")) != NULL) {
+        print_act_short_summary(out, FileIn, state, ActiveLeveldB, Overflow, 0);
+        fclose(out);
+    }
+    report_state(sv_state, &state, ActiveLeveldB, Overflow, 0);
+    return 0;
+}
+/* ...................... End of actlevel_resume() ...................... */
+
+
+/*
+  ============================================================================
+
+       int actlevel_merge (char **FileState, long nstate,
+       ~~~~~~~~~~~~~~~~~~  SVP56_state *sv_state);
+
+       Statistics of consecutive parts of one signal (e.g. the pieces of
+       a stream, measured on different workers by actlevel_resume()),
+       from their state files, merged in order by
+       speech_voltmeter_merge(): the count, sums and peaks are exact,
+       while each part after the first, being metered from a fresh
+       voltmeter, may differ in activity around its start. Each part
+       must be metered from its own start, not go on from the state
+       of the parts before it, and at the sampling rate of the first.
+
+       Parameter:
+       ~~~~~~~~~~
+       FileState . state files, in the order of the parts
+       nstate .... number of state files
+       sv_state .. statistics of the whole, as from actlevel()
+
+       Returns
+       ~~~~~~~
+       0 on success, or -1 when a state file has no good checkpoint,
+       or one of another sampling rate.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.1	Parts of another sampling rate refused.
+
+  ============================================================================
+*/
+int actlevel_merge(char** FileState, long nstate, SVP56_state* sv_state)
+{
+    SVP56_state state, part;
+    FILE* out;
+    double Overflow, ActiveLeveldB;
+    unsigned long long pos;
+    long bitno = 16, i;
+
+    if (nstate <= 0)
+        return -1;
+    for (i = 0; i < nstate; i++) {
+        if (ckp_read(FileState[i], (i == 0) ? &state : &part, &pos) != 0) {
+            fprintf(stderr, "%s: no state to merge\n", FileState[i]);
+            return -1;
+        }
+        if (i > 0 && speech_voltmeter_merge(&state, &part) != 0) {
+            fprintf(stderr, "%s: sampling rate %g Hz, not %g Hz as %s\n", FileState[i], part.f, state.f, FileState[0]);
+            return -1;
+        }
+    }
+
+    ActiveLeveldB = active_speech_level(&state);
+    Overflow = pow((double)2.0, (double)(bitno - 1));
+    if ((out = fopen("log.txt", "at")) != NULL) {
+        print_act_short_summary(out, FileState[0], state, ActiveLeveldB, Overflow, 0);
+        fclose(out);
+    }
+    report_state(sv_state, &state, ActiveLeveldB, Overflow, 0);
+    return 0;
+}
+
+#undef CKP_EVERY
+/* ....................... End of checkpoints ....................... */
+
+
+/*
+ * .................... RESULT CACHE ....................
+ *
+ * actlevel_cache() names a directory in which actlevel() keeps its
+ * results by content: the key of a result is a 128-bit hash of the
+ * samples of the data chunk and of the parameters of the measurement
+ * (sampling rate, format and bits of the file, block length, versions
+ * of the voltmeter, of its state and of this file). A second kind of
+ * entry maps what stat() tells of a file (name, size, times, inode) to
+ * the key of its result, so that an unchanged file is answered without
+ * being opened; any other file is measured, its samples hashed in the
+ * same pass, so that it is read once either way. Each entry is written to a name of its own, then
+ * renamed, and never changed after: any number of processes read and
+ * add to the cache at once, with no locks, and a reader sees a whole
+ * entry or none.
+ */
+#if defined(_WIN32)
+#define RC_MKDIR(d) _mkdir(d)
+#define RC_PID() _getpid()
+#else
+#define RC_MKDIR(d) mkdir((d), 0777)
+#define RC_PID() getpid()
+#endif
+
+#define RC_MAGIC "SV56RC01"     /* result entry: the state of the voltmeter */
+#define RC_STAT_MAGIC "SV56RS01" /* stat entry: the key of a result */
+#define RC_VERSION 218          /* of this file, 2.18 */
+#define RC_RACY 2               /* seconds: files changed since then are not
+                                 * keyed by stat(), as a change within the
+                                 * same second would go unseen */
+
+/* xxHash64 primes */
+#define RC_P1 0x9E3779B185EBCA87ull
+#define RC_P2 0xC2B2AE3D27D4EB4Full
+#define RC_P3 0x165667B19E3779F9ull
+#define RC_P4 0x85EBCA77C2B2AE63ull
+#define RC_P5 0x27D4EB2F165667C5ull
+#define RC_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+typedef struct {
+    unsigned long long h[2];
+} rc_key;
+
+/* Two xxHash64 of the same bytes, seeds 0 and 1, in one pass */
+typedef struct {
+    unsigned long long v[2][4];   /* lanes, for either seed */
+    unsigned char buf[32];        /* bytes short of a stripe */
+    unsigned long fill;           /* bytes in buf */
+    unsigned long long len;       /* bytes so far */
+} rc_hash;
+
+static unsigned long long rc_read64(const unsigned char* p) {
+    unsigned long long v;
+
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static unsigned long long rc_round(unsigned long long acc, unsigned long long in) {
+    acc += in * RC_P2;
+    return RC_ROTL(acc, 31) * RC_P1;
+}
+
+static void rc_hash_init(rc_hash* x) {
+    int k;
+
+    memset(x, 0, sizeof(rc_hash));
+    for (k = 0; k < 2; k++) {
+        x->v[k][0] = k + RC_P1 + RC_P2;
+        x->v[k][1] = k + RC_P2;
+        x->v[k][2] = k;
+        x->v[k][3] = k - RC_P1;
+    }
+}
+
+static void rc_stripe(rc_hash* x, const unsigned char* p) {
+    unsigned long long in;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        in = rc_read64(p + 8 * i);
+        x->v[0][i] = rc_round(x->v[0][i], in);
+        x->v[1][i] = rc_round(x->v[1][i], in);
+    }
+}
+
+static void rc_hash_add(rc_hash* x, const void* data, unsigned long long n) {
+    const unsigned char* p = (const unsigned char*)data;
+    unsigned long take;
+
+    x->len += n;
+    if (x->fill > 0) {
+        take = (unsigned long)(n < 32 - x->fill ? n : 32 - x->fill);
+        memcpy(x->buf + x->fill, p, take);
+        x->fill += take;
+        p += take;
+        n -= take;
+        if (x->fill < 32)
+            return;
+        rc_stripe(x, x->buf);
+        x->fill = 0;
+    }
+    for (; n >= 32; n -= 32, p += 32)
+        rc_stripe(x, p);
+    memcpy(x->buf, p, (size_t)n);
+    x->fill = (unsigned long)n;
+}
+
+static void rc_hash_end(rc_hash* x, rc_key* key) {
+    const unsigned char* p;
+    unsigned long long h;
+    unsigned long n;
+    unsigned int w;
+    int i, k;
+
+    for (k = 0; k < 2; k++) {
+        if (x->len >= 32) {
+            h = RC_ROTL(x->v[k][0], 1) + RC_ROTL(x->v[k][1], 7) + RC_ROTL(x->v[k][2], 12) + RC_ROTL(x->v[k][3], 18);
+            for (i = 0; i < 4; i++)
+                h = (h ^ rc_round(0, x->v[k][i])) * RC_P1 + RC_P4;
+        }
+        else
+            h = k + RC_P5;
+        h += x->len;
+
+        for (p = x->buf, n = x->fill; n >= 8; n -= 8, p += 8) {
+            h ^= rc_round(0, rc_read64(p));
+            h = RC_ROTL(h, 27) * RC_P1 + RC_P4;
+        }
+        if (n >= 4) {
+            memcpy(&w, p, 4);
+            h ^= w * RC_P1;
+            h = RC_ROTL(h, 23) * RC_P2 + RC_P3;
+            p += 4;
+            n -= 4;
+        }
+        for (; n > 0; n--, p++) {
+            h ^= *p * RC_P5;
+            h = RC_ROTL(h, 11) * RC_P1;
+        }
+
+        h ^= h >> 33;
+        h *= RC_P2;
+        h ^= h >> 29;
+        h *= RC_P3;
+        h ^= h >> 32;
+        key->h[k] = h;
+    }
+}
+
+/* Key of a text, and of a key followed by a text */
+static void rc_key_of(rc_key* key, const rc_key* prefix, const char* text) {
+    rc_hash x;
+
+    rc_hash_init(&x);
+    if (prefix != NULL)
+        rc_hash_add(&x, prefix->h, sizeof(prefix->h));
+    rc_hash_add(&x, text, strlen(text));
+    rc_hash_end(&x, key);
+}
+
+/* Entry of `key', in one of 256 subdirectories; `ext' tells its kind */
+static void rc_path(char* path, const rc_key* key, const char* ext) {
+    sprintf(path, "%s/%02x/%014llx%016llx%s", rc_dir, (unsigned int)(key->h[0] >> 56),
+            key->h[0] & 0xFFFFFFFFFFFFFFull, key->h[1], ext);
+}
+
+/* FNV-1a of an entry up to its checksum */
+static unsigned long long rc_sum(const unsigned char* b, long n) {
+    unsigned long long h = 0xcbf29ce484222325ull;
+    long i;
+
+    for (i = 0; i < n; i++)
+        h = (h ^ b[i]) * 0x100000001b3ull;
+    return h;
+}
+
+/* An entry: magic, key, `n' bytes of data, checksum */
+#define RC_ENTRY(n) (8 + sizeof(rc_key) + (n) + 8)
+
+static int rc_get(const char* path, const char* magic, const rc_key* key, void* data, long n) {
+    unsigned char b[RC_ENTRY(SVP56_STATE_BYTES)];
+    long size = (long)RC_ENTRY(n);
+    FILE* f;
+    int ok;
+
+    if ((f = fopen(path, "rb")) == NULL)
+        return -1;
+    ok = (long)fread(b, 1, size, f) == size && fgetc(f) == EOF;
+    fclose(f);
+    if (!ok || memcmp(b, magic, 8) != 0 || memcmp(b + 8, key->h, sizeof(key->h)) != 0 ||
+        rc_read64(b + size - 8) != rc_sum(b, size - 8))
+        return -1;
+    memcpy(data, b + 8 + sizeof(rc_key), n);
+    return 0;
+}
+
+static void rc_put(const char* path, const char* magic, const rc_key* key, const void* data, long n) {
+    unsigned char b[RC_ENTRY(SVP56_STATE_BYTES)];
+    char tmp[FILENAME_MAX + 128], dir[FILENAME_MAX + 64];
+    long size = (long)RC_ENTRY(n);
+    unsigned long long sum;
+    FILE* f;
+    int ok;
+
+    memcpy(b, magic, 8);
+    memcpy(b + 8, key->h, sizeof(key->h));
+    memcpy(b + 8 + sizeof(rc_key), data, n);
+    sum = rc_sum(b, size - 8);
+    memcpy(b + size - 8, &sum, 8);
+
+    /* A name no other writer has: the process, and the stack of this
+       thread */
+    sprintf(tmp, "%s.%d.%lx.tmp", path, (int)RC_PID(), (unsigned long)(size_t)tmp);
+    if ((f = fopen(tmp, "wb")) == NULL) {
+        strcpy(dir, path);
+        *strrchr(dir, '/') = 0;
+        RC_MKDIR(dir);
+        if ((f = fopen(tmp, "wb")) == NULL)
+            return;
+    }
+    ok = (long)fwrite(b, 1, size, f) == size;
+    ok = (fclose(f) == 0) && ok;
+
+    /* Where the entry is there already (rename() fails on Win32), it is
+       the same */
+    if (!ok || rename(tmp, path) != 0)
+        remove(tmp);
+}
+
+/* The samples of a file, hashed as actlevel_mono() reads them, and
+   the format of the file, for the key of its result */
+typedef struct {
+    rc_hash x;
+    double rate;
+    int format, bits;
+} rc_tap;
+
+static void rc_tap_add(void* arg, WAV_file* wf, const void* data, long frames) {
+    rc_tap* t = (rc_tap*)arg;
+
+    t->rate = wav_rate(wf, 16000);
+    t->format = wf->format;
+    t->bits = wf->bits;
+    rc_hash_add(&t->x, data, (unsigned long long)frames * wf->block_align);
+}
+
+/* Key of the result: hash of the samples, then of the parameters of
+   the measurement */
+static void rc_tap_key(rc_tap* t, rc_key* key) {
+    rc_key data;
+    char text[256];
+
+    rc_hash_end(&t->x, &data);
+    sprintf(text, "rate %.17g format %d bits %d block %d voltmeter %d state %d actlevel %d",
+            t->rate, t->format, t->bits, DEF_BLK_LEN,
+            SPEECH_VOLTMETER_defined, SVP56_STATE_VERSION, RC_VERSION);
+    rc_key_of(key, &data, text);
+}
+
+/* Key of what stat() tells of a file */
+static void rc_key_stat(char* FileIn, struct stat* st, rc_key* key) {
+    char text[FILENAME_MAX + 160];
+
+    sprintf(text, "%.*s\n%llu %lld %lld %llu %llu %d %d", FILENAME_MAX, FileIn,
+            (unsigned long long)st->st_size, (long long)st->st_mtime, (long long)st->st_ctime,
+            (unsigned long long)st->st_ino, (unsigned long long)st->st_dev,
+            DEF_BLK_LEN, RC_VERSION);
+    rc_key_of(key, NULL, text);
+}
+
+static int actlevel_cached(char* FileIn, SVP56_state* sv_state, SVP56_state* volt)
+{
+    char path[FILENAME_MAX + 64];
+    unsigned char blob[SVP56_STATE_BYTES];
+    struct stat st, st2;
+    rc_key skey, rkey;
+    rc_tap tap;
+    SVP56_state state;
+    unsigned long long pos;
+    double Overflow, ActiveLeveldB;
+    FILE* out;
+    int err, hit = 0, known = 0;
+
+    /* Streams aren't cached */
+    if (strcmp(FileIn, "-") == 0 || stat(FileIn, &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG)
+        return actlevel_mono(FileIn, sv_state, volt, NULL, NULL);
+
+    /* A file seen before, unchanged, has the key of its result */
+    rc_key_stat(FileIn, &st, &skey);
+    rc_path(path, &skey, ".s");
+    if (rc_get(path, RC_STAT_MAGIC, &skey, &rkey, sizeof(rkey)) == 0) {
+        known = 1;
+        rc_path(path, &rkey, ".r");
+        hit = rc_get(path, RC_MAGIC, &rkey, blob, SVP56_STATE_BYTES) == 0 &&
+              speech_voltmeter_restore(&state, &pos, blob, SVP56_STATE_BYTES) == 0;
+    }
+    SV_COUNT(hit ? SV_COUNT_CACHE_HITS : SV_COUNT_CACHE_MISSES, 1);
+
+    if (!hit) {
+        /* Measured, the samples being hashed in the same pass when the
+           key is not known, and kept unless the file changed meanwhile */
+        rc_hash_init(&tap.x);
+        if ((err = actlevel_mono(FileIn, sv_state, &state, known ? NULL : rc_tap_add, &tap)) != 0)
+            return err;
+        if (volt != NULL)
+            *volt = state;
+        if (stat(FileIn, &st2) != 0 || st2.st_size != st.st_size || st2.st_mtime != st.st_mtime)
+            return 0;
+        if (!known) {
+            rc_tap_key(&tap, &rkey);
+            rc_path(path, &rkey, ".r");
+        }
+        speech_voltmeter_save(&state, 0, blob, SVP56_STATE_BYTES);
+        rc_put(path, RC_MAGIC, &rkey, blob, SVP56_STATE_BYTES);
+    }
+    if (!known && time(NULL) - st.st_mtime > RC_RACY) {
+        rc_path(path, &skey, ".s");
+        rc_put(path, RC_STAT_MAGIC, &skey, &rkey, sizeof(rkey));
+    }
+    if (!hit)
+        return 0;
+
+    /* Reported as actlevel_mono() does */
+    ActiveLeveldB = active_speech_level(&state);
+    Overflow = pow((double)2.0, (double)(16 - 1));
+    if ((out = fopen("log.txt", "at")) != NULL) {
+        print_act_short_summary(out, FileIn, state, ActiveLeveldB, Overflow, 0);
+        fclose(out);
+    }
+    report_state(sv_state, &state, ActiveLeveldB, Overflow, 0);
+    if (volt != NULL)
+        *volt = state;
+    return 0;
+}
+
+
+/*
+  ============================================================================
+
+       int actlevel_cache (char *CacheDir);
+       ~~~~~~~~~~~~~~~~~~
+
+       Keep the results of actlevel() in `CacheDir', and look them up
+       there first, from then on; the directory may be shared by any
+       number of processes at once. There is one small file (380
+       bytes) per content measured, and one (48 bytes) per name and
+       version of a file; nothing is removed, but the directory may be
+       emptied at any time. A file is read at most once: entries that
+       are damaged or cut short are ignored, and written again.
+
+       Parameter:
+       ~~~~~~~~~~
+       CacheDir ... directory, created if need be; NULL or "" to stop
+                    caching
+
+       Returns
+       ~~~~~~~
+       0 on success, or -1 when the directory can't be used.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.1	Samples hashed in the same pass as the measurement.
+
+  ============================================================================
+*/
+int actlevel_cache(char* CacheDir)
+{
+    struct stat st;
+
+    rc_dir[0] = 0;
+    if (CacheDir == NULL || CacheDir[0] == 0)
+        return 0;
+    if (strlen(CacheDir) > FILENAME_MAX - 64)
+        return -1;
+    RC_MKDIR(CacheDir);
+    if (stat(CacheDir, &st) != 0 || (st.st_mode & S_IFMT) != S_IFDIR)
+        return -1;
+    strcpy(rc_dir, CacheDir);
+    return 0;
+}
+
+#undef RC_MAGIC
+#undef RC_STAT_MAGIC
+#undef RC_VERSION
+#undef RC_RACY
+#undef RC_ENTRY
+#undef RC_MKDIR
+#undef RC_PID
+#undef RC_P1
+#undef RC_P2
+#undef RC_P3
+#undef RC_P4
+#undef RC_P5
+#undef RC_ROTL
+/* ....................... End of result cache ....................... */
@@ -290,6 +290,7 @@ Appendix :
 #include <math.h>
 
 #include "sv56.h"
+#include "svstats.h"
 
 #ifdef REAL_IS_FLOAT
 typedef float REAL;
@@ -351,6 +352,8 @@ void rdft(int n, int isgn, REAL *a, int *ip, REAL *w)
     int nw, nc;
     REAL xi;
     
+    SV_STAGE_ENTER(SV_STAGE_FFT);
+    SV_COUNT(SV_COUNT_FFT_CALLS, 1);
     nw = ip[0];
     if (n > (nw << 2)) {
         nw = n >> 2;
@@ -381,6 +384,7 @@ void rdft(int n, int isgn, REAL *a, int *ip, REAL *w)
             cftbsub(n, a, ip + 2, nw, w);
         }
     }
+    SV_STAGE_LEAVE();
 }
 
 
@@ -1,4 +1,5 @@
 #define _CRT_SECURE_NO_WARNINGS
+#define _FILE_OFFSET_BITS 64
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,9 +10,12 @@
 #include <iconv.h>
 #include <wchar.h>
 #include <locale.h>
+#if defined(_WIN32)
 #include <atlstr.h>
+#endif
 
 #include "sv56.h"
+#include "svstats.h"
 
 #define VERSION "1.30"
 
@@ -328,12 +332,14 @@ int do_shaping(double s, double *peak, int dtype, int ch)
             double d = (double)s / shaper_clipmin;
             *peak = *peak < d ? d : *peak;
             s = shaper_clipmin;
+            SV_COUNT(SV_COUNT_CLIPS, 1);
         }
         if (s > shaper_clipmax)
         {
             double d = (double)s / shaper_clipmax;
             *peak = *peak < d ? d : *peak;
             s = shaper_clipmax;
+            SV_COUNT(SV_COUNT_CLIPS, 1);
         }
 
         return RINT(s);
@@ -354,6 +360,7 @@ int do_shaping(double s, double *peak, int dtype, int ch)
         double d = (double)s / shaper_clipmin;
         *peak = *peak < d ? d : *peak;
         s = shaper_clipmin;
+        SV_COUNT(SV_COUNT_CLIPS, 1);
         shapebuf[ch][0] = s - u;
 
         if (shapebuf[ch][0] > 1)
@@ -366,6 +373,7 @@ int do_shaping(double s, double *peak, int dtype, int ch)
         double d = (double)s / shaper_clipmax;
         *peak = *peak < d ? d : *peak;
         s = shaper_clipmax;
+        SV_COUNT(SV_COUNT_CLIPS, 1);
         shapebuf[ch][0] = s - u;
 
         if (shapebuf[ch][0] > 1)
@@ -446,6 +454,7 @@ void usage(void)
     printf("          --tmpfile <file name>      specify temporal file\n");
     printf("          --twopass                  two pass processing to avoid clipping\n");
     printf("          --normalize                normalize the wave file\n");
+    printf("          --mix <avg|channel>        average all channels, or keep only one\n");
     printf("          --quiet                    nothing displayed except error\n");
     printf("          --dither [<type>]          dithering\n");
     printf("                                       0 : no dither\n");
@@ -519,7 +528,216 @@ int gcd(int x, int y)
     return x;
 }
 
-double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int dfrq, double gain, unsigned int chanklen, int twopass, int dither)
+REAL decode_sample(unsigned char *p, int bps, int fmt)
+{
+    if (fmt == WAV_FORMAT_FLOAT)
+    {
+        float f;
+
+        memcpy(&f, p, sizeof(float));
+        return f;
+    }
+
+    switch (bps)
+    {
+    case 1:
+        return (1 / (REAL)0x7f) * ((REAL)p[0] - 128);
+    case 2:
+#ifndef BIGENDIAN
+        return (1 / (REAL)0x7fff) * (REAL)(*(short *)p);
+#else
+        return (1 / (REAL)0x7fff) * (((int)p[0]) | (((int)((char *)p)[1]) << 8));
+#endif
+    case 3:
+        return (1 / (REAL)0x7fffff) *
+               ((((int)p[0]) << 0) |
+                (((int)p[1]) << 8) |
+                (((int)((char *)p)[2]) << 16));
+    case 4:
+        return (1 / (REAL)0x7fffffff) *
+               ((((int)p[0]) << 0) |
+                (((int)p[1]) << 8) |
+                (((int)p[2]) << 16) |
+                (((int)((char *)p)[3]) << 24));
+    }
+    return 0;
+}
+
+// Decode nsmpl frames of snch interleaved source channels into nch interleaved
+// channels of out. Without a mixing matrix the channels pass straight through
+// (snch == nch); otherwise out = mixm * in, mixm being a row-major nch x snch
+// matrix, and source channels with a zero weight are never decoded. fmt is
+// WAV_FORMAT_FLOAT for 32-bit float samples, which are taken as they are.
+void decode_block(unsigned char *rawinbuf, REAL *out, int nsmpl, int snch, int nch, int bps, int fmt, const REAL *mixm)
+{
+    int i, ch, sch;
+
+    if (mixm == NULL)
+    {
+        if (fmt == WAV_FORMAT_FLOAT)
+        {
+            for (i = 0; i < nsmpl * nch; i++)
+                out[i] = decode_sample(rawinbuf + i * bps, bps, fmt);
+            return;
+        }
+
+        switch (bps)
+        {
+        case 1:
+            for (i = 0; i < nsmpl * nch; i++)
+                out[i] = (1 / (REAL)0x7f) * ((REAL)((unsigned char *)rawinbuf)[i] - 128);
+            break;
+
+#ifndef BIGENDIAN
+        case 2:
+            for (i = 0; i < nsmpl * nch; i++)
+                out[i] = (1 / (REAL)0x7fff) * (REAL)((short *)rawinbuf)[i];
+            break;
+#endif
+
+        default:
+            for (i = 0; i < nsmpl * nch; i++)
+                out[i] = decode_sample(rawinbuf + i * bps, bps, fmt);
+            break;
+        }
+        return;
+    }
+
+    for (i = 0; i < nsmpl; i++)
+    {
+        unsigned char *ip = rawinbuf + i * snch * bps;
+
+        for (ch = 0; ch < nch; ch++)
+        {
+            const REAL *w = &mixm[ch * snch];
+            REAL f = 0;
+
+            for (sch = 0; sch < snch; sch++)
+                if (w[sch] != 0)
+                    f += w[sch] * decode_sample(ip + sch * bps, bps, fmt);
+            out[i * nch + ch] = f;
+        }
+    }
+}
+
+// Build the nch x snch mixing matrix for decode_block() in *mixm, NULL when
+// the source channels are kept as they are. The number of channels that are
+// filtered and written is returned in *nch. Returns -1, with *mixm NULL, for
+// a channel or a matrix that doesn't fit the source, or an unknown type.
+int make_mix_matrix(const ssrc_mix *mix, int snch, int *nch, REAL **mixm)
+{
+    int i;
+
+    *nch = snch;
+    *mixm = NULL;
+    if (mix == NULL || mix->type == SSRC_MIX_NONE)
+        return 0;
+
+    switch (mix->type)
+    {
+    case SSRC_MIX_AVERAGE:
+        *nch = 1;
+        *mixm = (REAL *)calloc(snch, sizeof(REAL));
+        for (i = 0; i < snch; i++)
+            (*mixm)[i] = 1 / (REAL)snch;
+        break;
+
+    case SSRC_MIX_SELECT:
+        if (mix->channel < 0 || mix->channel >= snch)
+        {
+            fprintf(stderr, "Error: channel %d selected, but the source has %d channels.\n", mix->channel, snch);
+            return -1;
+        }
+        *nch = 1;
+        *mixm = (REAL *)calloc(snch, sizeof(REAL));
+        (*mixm)[mix->channel] = 1;
+        break;
+
+    case SSRC_MIX_MATRIX:
+        if (mix->in_channels != snch || mix->out_channels < 1 || mix->weights == NULL)
+        {
+            fprintf(stderr, "Error: %dx%d mixing matrix given for a %d channel source.\n", mix->out_channels, mix->in_channels, snch);
+            return -1;
+        }
+        *nch = mix->out_channels;
+        *mixm = (REAL *)calloc(*nch * snch, sizeof(REAL));
+        for (i = 0; i < *nch * snch; i++)
+            (*mixm)[i] = mix->weights[i];
+        break;
+
+    default:
+        fprintf(stderr, "Error: unknown mixing type %d.\n", mix->type);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Designed filters, kept from one conversion to the next between the same
+// rates: a process converting many files (a batch, the pysv daemon) designs
+// each pair of filters once. An entry is not changed once in the list, and
+// its FFT tables are complete, so that rdft() only reads them.
+
+#define SSRC_FILTERS 16 /* rate pairs kept at most */
+
+typedef struct ssrc_filter
+{
+    int up, sfrq, dfrq;     // direction and rates,
+    double aa, df;          // and design parameters: the key
+    int firlen;
+    int osf, fs1, fs2;
+    int n1, n2, nx, ny, nb; // n1x, n1y, n2b up; n2x, n2y, n1b down
+    REAL **poly;            // polyphase filter, stage 1 up and 2 down
+    REAL *fft;              // FFT filter, stage 2 up and 1 down
+    int *order, *inc;       // phases of poly (inc down only: up, it depends on nch)
+    int *fft_ip;
+    REAL *fft_w;
+    struct ssrc_filter *next;
+} ssrc_filter;
+
+static ssrc_filter *volatile filters = NULL;
+static volatile long nfilters = 0;
+
+#if defined(_WIN32)
+#define SSRC_CAS(p, old, new) (InterlockedCompareExchangePointer((PVOID volatile *)(p), (new), (old)) == (old))
+#define SSRC_INC(p) InterlockedIncrement(p)
+#else
+#define SSRC_CAS(p, old, new) __sync_bool_compare_and_swap((p), (old), (new))
+#define SSRC_INC(p) __sync_add_and_fetch((p), 1)
+#endif
+
+static const ssrc_filter *filter_find(int up, int sfrq, int dfrq)
+{
+    const ssrc_filter *f;
+
+    for (f = filters; f != NULL; f = f->next)
+        if (f->up == up && f->sfrq == sfrq && f->dfrq == dfrq &&
+            f->aa == AA && f->df == DF && f->firlen == FFTFIRLEN)
+            return f;
+    return NULL;
+}
+
+// Adds a copy of *f to the list. Returns 0 when the list is full, the
+// caller then freeing the filters itself.
+static int filter_keep(const ssrc_filter *f)
+{
+    ssrc_filter *k, *head;
+
+    if (SSRC_INC(&nfilters) > SSRC_FILTERS || (k = (ssrc_filter *)malloc(sizeof(ssrc_filter))) == NULL)
+        return 0;
+    *k = *f;
+    k->aa = AA;
+    k->df = DF;
+    k->firlen = FFTFIRLEN;
+    do
+    {
+        head = filters;
+        k->next = head;
+    } while (!SSRC_CAS(&filters, head, k));
+    return 1;
+}
+
+double upsample(WAV_file *wfi, WAV_out *fpo, int nch, int snch, const REAL *mixm, int bps, int dbps, int sfrq, int dfrq, double gain, unsigned long long chanklen, int twopass, int dither)
 {
     int frqgcd, osf, fs1, fs2;
     REAL **stage1, *stage2;
@@ -528,7 +746,10 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
     int *f1order, *f1inc;
     int *fft_ip = NULL;
     REAL *fft_w = NULL;
-    unsigned char *rawinbuf, *rawoutbuf;
+    const ssrc_filter *kept;
+    ssrc_filter flt;
+    const void *rawin;
+    unsigned char *rawoutbuf;
     REAL *inbuf, *outbuf;
     REAL **buf1, **buf2;
     double peak = 0;
@@ -537,8 +758,29 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
 
     filter2len = FFTFIRLEN; /* stage 2 filter length */
 
-    /* Make stage 1 filter */
+    /* Make stage 1 filter, unless kept from a former call */
+
+    SV_STAGE_ENTER(SV_STAGE_FILTER_DESIGN);
 
+    kept = filter_find(1, sfrq, dfrq);
+    if (kept != NULL)
+    {
+        frqgcd = gcd(sfrq, dfrq);
+        osf = kept->osf;
+        fs1 = kept->fs1;
+        fs2 = kept->fs2;
+        n1 = kept->n1;
+        n2 = kept->n2;
+        n1x = kept->nx;
+        n1y = kept->ny;
+        n2b = kept->nb;
+        stage1 = kept->poly;
+        stage2 = kept->fft;
+        f1order = kept->order;
+        fft_ip = kept->fft_ip;
+        fft_w = kept->fft_w;
+    }
+    else
     {
         double aa = AA; /* stop band attenuation(dB) */
         double lpf, delta, d, df, alp, iza;
@@ -589,14 +831,6 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                 f1order[i] = 0;
         }
 
-        f1inc = (int *)calloc(n1y * osf, sizeof(int));
-        for (i = 0; i < n1y * osf; i++)
-        {
-            f1inc[i] = f1order[i] < fs1 / (dfrq * osf) ? nch : 0;
-            if (f1order[i] == fs1 / sfrq)
-                f1order[i] = 0;
-        }
-
         stage1 = (REAL **)malloc(n1y * sizeof(REAL *));
         stage1[0] = (REAL *)calloc(n1x * n1y, sizeof(REAL));
 
@@ -615,6 +849,7 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
 
     /* Make stage 2 filter */
 
+    if (kept == NULL)
     {
         double aa = AA; /* stop band attenuation(dB) */
         double lpf, delta, d, df, alp, iza;
@@ -664,8 +899,36 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
         fft_w = (REAL *)calloc(wsize, sizeof(REAL));
 
         rdft(n2b, 1, stage2, fft_ip, fft_w);
+
+        flt.up = 1;
+        flt.sfrq = sfrq;
+        flt.dfrq = dfrq;
+        flt.osf = osf;
+        flt.fs1 = fs1;
+        flt.fs2 = fs2;
+        flt.n1 = n1;
+        flt.n2 = n2;
+        flt.nx = n1x;
+        flt.ny = n1y;
+        flt.nb = n2b;
+        flt.poly = stage1;
+        flt.fft = stage2;
+        flt.order = f1order;
+        flt.inc = NULL;
+        flt.fft_ip = fft_ip;
+        flt.fft_w = fft_w;
+        if (filter_keep(&flt))
+            kept = &flt;
     }
 
+    /* Input step of each phase of the stage 1 filter */
+
+    f1inc = (int *)calloc(n1y * osf, sizeof(int));
+    for (i = 0; i < n1y * osf; i++)
+        f1inc[i] = f1order[i] < fs1 / (dfrq * osf) ? nch : 0;
+
+    SV_STAGE_LEAVE();
+
     /* Apply filters */
 
     setstarttime();
@@ -680,7 +943,7 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                        // stage2 filterϤ륵ץ
         int s1p;       // stage1 filterϤ줿ץοn1y*osfǳä;
         int init, ending;
-        unsigned int sumread, sumwrite;
+        unsigned long long sumread, sumwrite;
         int osc;
         REAL *ip, *ip_backup;
         int s1p_backup, osc_backup;
@@ -700,7 +963,6 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
         for (i = 0; i < nch; i++)
             buf2[i] = (REAL *)calloc(n2b, sizeof(REAL));
 
-        rawinbuf = (unsigned char *)calloc(nch * (n2b2 + n1x), bps);
         rawoutbuf = (unsigned char *)calloc(nch * (n2b2 / osf + 1), dbps);
 
         inbuf = (REAL *)calloc(nch * (n2b2 + n1x), sizeof(REAL));
@@ -725,55 +987,13 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
             toberead2 = toberead = floor((double)n2b2 * sfrq / (dfrq * osf)) + 1 + n1x - inbuflen;
             if (toberead + sumread > chanklen)
             {
-                toberead = chanklen - sumread;
+                toberead = (int)(chanklen - sumread);
             }
 
-            nsmplread = fread(rawinbuf, 1, bps * nch * toberead, fpi);
-            nsmplread /= bps * nch;
+            nsmplread = wav_read(wfi, toberead, &rawin);
 
-            switch (bps)
-            {
-            case 1:
-                for (i = 0; i < nsmplread * nch; i++)
-                    inbuf[nch * inbuflen + i] =
-                        (1 / (REAL)0x7f) * ((REAL)((unsigned char *)rawinbuf)[i] - 128);
-                break;
-
-            case 2:
-#ifndef BIGENDIAN
-                for (i = 0; i < nsmplread * nch; i++)
-                    inbuf[nch * inbuflen + i] = (1 / (REAL)0x7fff) * (REAL)((short *)rawinbuf)[i];
-#else
-                for (i = 0; i < nsmplread * nch; i++)
-                {
-                    inbuf[nch * inbuflen + i] = (1 / (REAL)0x7fff) *
-                                                (((int)rawinbuf[i * 2]) |
-                                                 (((int)((char *)rawinbuf)[i * 2 + 1]) << 8));
-                }
-#endif
-                break;
-
-            case 3:
-                for (i = 0; i < nsmplread * nch; i++)
-                {
-                    inbuf[nch * inbuflen + i] = (1 / (REAL)0x7fffff) *
-                                                ((((int)rawinbuf[i * 3]) << 0) |
-                                                 (((int)rawinbuf[i * 3 + 1]) << 8) |
-                                                 (((int)((char *)rawinbuf)[i * 3 + 2]) << 16));
-                }
-                break;
-
-            case 4:
-                for (i = 0; i < nsmplread * nch; i++)
-                {
-                    inbuf[nch * inbuflen + i] = (1 / (REAL)0x7fffffff) *
-                                                ((((int)rawinbuf[i * 4]) << 0) |
-                                                 (((int)rawinbuf[i * 4 + 1]) << 8) |
-                                                 (((int)rawinbuf[i * 4 + 2]) << 16) |
-                                                 (((int)((char *)rawinbuf)[i * 4 + 3]) << 24));
-                }
-                break;
-            }
+            decode_block((unsigned char *)rawin, &inbuf[nch * inbuflen], nsmplread, snch, nch, bps, wfi->format, mixm);
+            i = nsmplread * nch;
 
             for (; i < nch * toberead2; i++)
                 inbuf[nch * inbuflen + i] = 0;
@@ -782,7 +1002,7 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
 
             sumread += nsmplread;
 
-            ending = feof(fpi) || sumread >= chanklen;
+            ending = nsmplread < toberead || sumread >= chanklen;
 
             //nsmplwrt1 = ((rp-1)*sfrq/fs1+inbuflen-n1x)*dfrq*osf/sfrq;
             //if (nsmplwrt1 > n2b2) nsmplwrt1 = n2b2;
@@ -804,6 +1024,7 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                 s1p = s1p_backup;
                 ip = ip_backup + ch;
 
+                SV_STAGE_ENTER(SV_STAGE_FIR);
                 switch (n1x)
                 {
                 case 7:
@@ -876,6 +1097,8 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                     break;
                 }
 
+                SV_STAGE_LEAVE();
+
                 osc = osc_backup;
 
                 // apply stage 2 filter
@@ -932,6 +1155,7 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
             }
             else
             {
+                SV_STAGE_ENTER(SV_STAGE_DITHER);
                 switch (dbps)
                 {
                 case 1:
@@ -956,12 +1180,14 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                                 double d = (double)s / -0x80;
                                 peak = peak < d ? d : peak;
                                 s = -0x80;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                             if (0x7f < s)
                             {
                                 double d = (double)s / 0x7f;
                                 peak = peak < d ? d : peak;
                                 s = 0x7f;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                         }
 
@@ -996,12 +1222,14 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                                 double d = (double)s / -0x8000;
                                 peak = peak < d ? d : peak;
                                 s = -0x8000;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                             if (0x7fff < s)
                             {
                                 double d = (double)s / 0x7fff;
                                 peak = peak < d ? d : peak;
                                 s = 0x7fff;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                         }
 
@@ -1041,12 +1269,14 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                                 double d = (double)s / -0x800000;
                                 peak = peak < d ? d : peak;
                                 s = -0x800000;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                             if (0x7fffff < s)
                             {
                                 double d = (double)s / 0x7fffff;
                                 peak = peak < d ? d : peak;
                                 s = 0x7fffff;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                         }
 
@@ -1063,46 +1293,13 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                 }
                 break;
 
-#if 0
                 case 4:
-                {
-                    REAL gain2 = gain * (REAL)0x7fffffff;
-                    ch = 0;
-
+                    // 32-bit float: no dither, no clipping
                     for (i = 0; i < nsmplwrt2 * nch; i++)
-                    {
-                        int s;
-
-                        if (dither) {
-                            s = do_shaping(outbuf[i] * gain2, &peak, dither, ch);
-                        }
-                        else {
-                            s = RINT(outbuf[i] * gain2);
-
-                            if (s < -0x80000000) {
-                                double d = (double)s / -0x80000000;
-                                peak = peak < d ? d : peak;
-                                s = -0x80000000;
-                            }
-                            if (0x7fffffff < s) {
-                                double d = (double)s / 0x7fffffff;
-                                peak = peak < d ? d : peak;
-                                s = 0x7fffffff;
-                            }
-                        }
-
-                        ((char*)rawoutbuf)[i * 4] = s & 255; s >>= 8;
-                        ((char*)rawoutbuf)[i * 4 + 1] = s & 255; s >>= 8;
-                        ((char*)rawoutbuf)[i * 4 + 2] = s & 255; s >>= 8;
-                        ((char*)rawoutbuf)[i * 4 + 3] = s & 255;
-
-                        ch++;
-                        if (ch == nch) ch = 0;
-                    }
-                }
-                break;
-#endif
+                        ((float *)rawoutbuf)[i] = outbuf[i] * gain;
+                    break;
                 }
+                SV_STAGE_LEAVE();
             }
 
             if (!init)
@@ -1111,7 +1308,7 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                 {
                     if ((double)sumread * dfrq / sfrq + 2 > sumwrite + nsmplwrt2)
                     {
-                        if (dbps * nch * nsmplwrt2 != fwrite(rawoutbuf, 1, dbps * nch * nsmplwrt2, fpo))
+                        if (dbps * nch * nsmplwrt2 != wav_out_write(rawoutbuf, 1, dbps * nch * nsmplwrt2, fpo))
                         {
                             fprintf(stderr, "fwrite error(1).\n");
                             abort();
@@ -1121,7 +1318,7 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                     else
                     {
                         if (dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite) !=
-                            fwrite(rawoutbuf, 1, dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite), fpo))
+                            wav_out_write(rawoutbuf, 1, dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite), fpo))
                         {
                             fprintf(stderr, "fwrite error(2).\n");
                             abort();
@@ -1131,7 +1328,7 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                 }
                 else
                 {
-                    if (dbps * nch * nsmplwrt2 != fwrite(rawoutbuf, 1, dbps * nch * nsmplwrt2, fpo))
+                    if (dbps * nch * nsmplwrt2 != wav_out_write(rawoutbuf, 1, dbps * nch * nsmplwrt2, fpo))
                     {
                         fprintf(stderr, "fwrite error(3).\n");
                         abort();
@@ -1151,17 +1348,18 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                     {
                         if ((double)sumread * dfrq / sfrq + 2 > sumwrite + nsmplwrt2 - delay)
                         {
-                            if (dbps * nch * (nsmplwrt2 - delay) != fwrite(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (nsmplwrt2 - delay), fpo))
+                            if (dbps * nch * (nsmplwrt2 - delay) != wav_out_write(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (nsmplwrt2 - delay), fpo))
                             {
                                 fprintf(stderr, "fwrite error(4).\n");
                                 abort();
                             }
                             sumwrite += nsmplwrt2 - delay;
+                            init = 0;
                         }
                         else
                         {
-                            if (dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite - delay) !=
-                                fwrite(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite - delay), fpo))
+                            if (dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite) !=
+                                wav_out_write(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite), fpo))
                             {
                                 fprintf(stderr, "fwrite error(5).\n");
                                 abort();
@@ -1171,7 +1369,7 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
                     }
                     else
                     {
-                        if (dbps * nch * (nsmplwrt2 - delay) != fwrite(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (nsmplwrt2 - delay), fpo))
+                        if (dbps * nch * (nsmplwrt2 - delay) != wav_out_write(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (nsmplwrt2 - delay), fpo))
                         {
                             fprintf(stderr, "fwrite error(6).\n");
                             abort();
@@ -1199,13 +1397,16 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
 
     showprogress(1);
 
-    free(f1order);
     free(f1inc);
-    free(stage1[0]);
-    free(stage1);
-    free(stage2);
-    free(fft_ip);
-    free(fft_w);
+    if (kept == NULL)
+    {
+        free(f1order);
+        free(stage1[0]);
+        free(stage1);
+        free(stage2);
+        free(fft_ip);
+        free(fft_w);
+    }
     for (i = 0; i < nch; i++)
         free(buf1[i]);
     free(buf1);
@@ -1214,13 +1415,12 @@ double upsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int
     free(buf2);
     free(inbuf);
     free(outbuf);
-    free(rawinbuf);
     free(rawoutbuf);
 
     return peak;
 }
 
-double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, int dfrq, double gain, unsigned int chanklen, int twopass, int dither)
+double downsample(WAV_file *wfi, WAV_out *fpo, int nch, int snch, const REAL *mixm, int bps, int dbps, int sfrq, int dfrq, double gain, unsigned long long chanklen, int twopass, int dither)
 {
     int frqgcd, osf, fs1, fs2;
     REAL *stage1, **stage2;
@@ -1229,7 +1429,10 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
     int *f2order, *f2inc;
     int *fft_ip = NULL;
     REAL *fft_w = NULL;
-    unsigned char *rawinbuf, *rawoutbuf;
+    const ssrc_filter *kept;
+    ssrc_filter flt;
+    const void *rawin;
+    unsigned char *rawoutbuf;
     REAL *inbuf, *outbuf;
     REAL **buf1, **buf2;
     int i, j;
@@ -1238,8 +1441,30 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
 
     filter1len = FFTFIRLEN; /* stage 1 filter length */
 
-    /* Make stage 1 filter */
+    /* Make stage 1 filter, unless kept from a former call */
+
+    SV_STAGE_ENTER(SV_STAGE_FILTER_DESIGN);
 
+    kept = filter_find(0, sfrq, dfrq);
+    if (kept != NULL)
+    {
+        frqgcd = gcd(sfrq, dfrq);
+        osf = kept->osf;
+        fs1 = kept->fs1;
+        fs2 = kept->fs2;
+        n1 = kept->n1;
+        n2 = kept->n2;
+        n2x = kept->nx;
+        n2y = kept->ny;
+        n1b = kept->nb;
+        stage1 = kept->fft;
+        stage2 = kept->poly;
+        f2order = kept->order;
+        f2inc = kept->inc;
+        fft_ip = kept->fft_ip;
+        fft_w = kept->fft_w;
+    }
+    else
     {
         double aa = AA; /* stop band attenuation(dB) */
         double lpf, delta, d, df, alp, iza;
@@ -1309,7 +1534,7 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
 
     /* Make stage 2 filter */
 
-    if (osf == 1)
+    if (kept == NULL && osf == 1)
     {
         fs2 = sfrq / frqgcd * dfrq;
         n2 = 1;
@@ -1322,7 +1547,7 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
         stage2[0] = (REAL *)calloc(n2x * n2y, sizeof(REAL));
         stage2[0][0] = 1;
     }
-    else
+    else if (kept == NULL)
     {
         double aa = AA; /* stop band attenuation(dB) */
         double lpf, delta, d, df, alp, iza;
@@ -1381,6 +1606,31 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
         }
     }
 
+    if (kept == NULL)
+    {
+        flt.up = 0;
+        flt.sfrq = sfrq;
+        flt.dfrq = dfrq;
+        flt.osf = osf;
+        flt.fs1 = fs1;
+        flt.fs2 = fs2;
+        flt.n1 = n1;
+        flt.n2 = n2;
+        flt.nx = n2x;
+        flt.ny = n2y;
+        flt.nb = n1b;
+        flt.poly = stage2;
+        flt.fft = stage1;
+        flt.order = f2order;
+        flt.inc = f2inc;
+        flt.fft_ip = fft_ip;
+        flt.fft_w = fft_w;
+        if (filter_keep(&flt))
+            kept = &flt;
+    }
+
+    SV_STAGE_LEAVE();
+
     /* Apply filters */
 
     setstarttime();
@@ -1400,7 +1650,7 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
         int rps_backup, s2p_backup;
         int k, ch, p;
         int inbuflen = 0;
-        unsigned int sumread, sumwrite;
+        unsigned long long sumread, sumwrite;
         int delay = 0;
         REAL *op;
 
@@ -1427,7 +1677,6 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
                 buf2[i][j] = 0;
         }
 
-        rawinbuf = (unsigned char *)calloc(nch * (n1b2 / osf + osf + 1), bps);
         rawoutbuf = (unsigned char *)calloc(((double)n1b2 * sfrq / dfrq + 1), dbps * nch);
         inbuf = (REAL *)calloc(nch * (n1b2 / osf + osf + 1), sizeof(REAL));
         outbuf = (REAL *)calloc(nch * ((double)n1b2 * sfrq / dfrq + 1), sizeof(REAL));
@@ -1450,67 +1699,27 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
         for (;;)
         {
             int nsmplread;
-            int toberead;
+            int toberead, toberead2;
 
-            toberead = (n1b2 - rps - 1) / osf + 1;
+            toberead2 = toberead = (n1b2 - rps - 1) / osf + 1;
             if (toberead + sumread > chanklen)
             {
-                toberead = chanklen - sumread;
+                toberead = (int)(chanklen - sumread);
             }
 
-            nsmplread = fread(rawinbuf, 1, bps * nch * toberead, fpi);
-            nsmplread /= bps * nch;
-
-            switch (bps)
-            {
-            case 1:
-                for (i = 0; i < nsmplread * nch; i++)
-                    inbuf[nch * inbuflen + i] =
-                        (1 / (REAL)0x7f) * ((REAL)((unsigned char *)rawinbuf)[i] - 128);
-                break;
-
-            case 2:
-#ifndef BIGENDIAN
-                for (i = 0; i < nsmplread * nch; i++)
-                    inbuf[nch * inbuflen + i] = (1 / (REAL)0x7fff) * (REAL)((short *)rawinbuf)[i];
-#else
-                for (i = 0; i < nsmplread * nch; i++)
-                {
-                    inbuf[nch * inbuflen + i] = (1 / (REAL)0x7fff) *
-                                                (((int)rawinbuf[i * 2]) |
-                                                 (((int)((char *)rawinbuf)[i * 2 + 1]) << 8));
-                }
-#endif
-                break;
-
-            case 3:
-                for (i = 0; i < nsmplread * nch; i++)
-                {
-                    inbuf[nch * inbuflen + i] = (1 / (REAL)0x7fffff) *
-                                                ((((int)rawinbuf[i * 3]) << 0) |
-                                                 (((int)rawinbuf[i * 3 + 1]) << 8) |
-                                                 (((int)((char *)rawinbuf)[i * 3 + 2]) << 16));
-                }
-                break;
+            nsmplread = wav_read(wfi, toberead, &rawin);
 
-            case 4:
-                for (i = 0; i < nsmplread * nch; i++)
-                {
-                    inbuf[nch * inbuflen + i] = (1 / (REAL)0x7fffffff) *
-                                                ((((int)rawinbuf[i * 4]) << 0) |
-                                                 (((int)rawinbuf[i * 4 + 1]) << 8) |
-                                                 (((int)rawinbuf[i * 4 + 2]) << 16) |
-                                                 (((int)((char *)rawinbuf)[i * 4 + 3]) << 24));
-                }
-                break;
-            }
+            decode_block((unsigned char *)rawin, &inbuf[nch * inbuflen], nsmplread, snch, nch, bps, wfi->format, mixm);
+            i = nsmplread * nch;
 
-            for (; i < nch * toberead; i++)
+            // zeros past the end of the input, up to the whole block as
+            // in upsample(), not the samples of the block before
+            for (; i < nch * toberead2; i++)
                 inbuf[i] = 0;
 
             sumread += nsmplread;
 
-            ending = feof(fpi) || sumread >= chanklen;
+            ending = nsmplread < toberead || sumread >= chanklen;
 
             rps_backup = rps;
             s2p_backup = s2p;
@@ -1573,6 +1782,7 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
 
                 s2p = s2p_backup;
 
+                SV_STAGE_ENTER(SV_STAGE_FIR);
                 for (p = 0; bp - buf2[ch] < n1b2 + 1; p++)
                 {
                     REAL tmp = 0;
@@ -1594,6 +1804,7 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
 
                     op[p * nch + ch] = tmp;
                 }
+                SV_STAGE_LEAVE();
 
                 nsmplwrt2 = p;
             }
@@ -1611,6 +1822,7 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
             }
             else
             {
+                SV_STAGE_ENTER(SV_STAGE_DITHER);
                 switch (dbps)
                 {
                 case 1:
@@ -1635,12 +1847,14 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
                                 double d = (double)s / -0x80;
                                 peak = peak < d ? d : peak;
                                 s = -0x80;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                             if (0x7f < s)
                             {
                                 double d = (double)s / 0x7f;
                                 peak = peak < d ? d : peak;
                                 s = 0x7f;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                         }
 
@@ -1675,12 +1889,14 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
                                 double d = (double)s / -0x8000;
                                 peak = peak < d ? d : peak;
                                 s = -0x8000;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                             if (0x7fff < s)
                             {
                                 double d = (double)s / 0x7fff;
                                 peak = peak < d ? d : peak;
                                 s = 0x7fff;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                         }
 
@@ -1721,12 +1937,14 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
                                 double d = (double)s / -0x800000;
                                 peak = peak < d ? d : peak;
                                 s = -0x800000;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                             if (0x7fffff < s)
                             {
                                 double d = (double)s / 0x7fffff;
                                 peak = peak < d ? d : peak;
                                 s = 0x7fffff;
+                                SV_COUNT(SV_COUNT_CLIPS, 1);
                             }
                         }
 
@@ -1743,46 +1961,13 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
                 }
                 break;
 
-#if 0
                 case 4:
-                {
-                    REAL gain2 = gain * (REAL)0x7fffffff;
-                    ch = 0;
-
+                    // 32-bit float: no dither, no clipping
                     for (i = 0; i < nsmplwrt2 * nch; i++)
-                    {
-                        double s;
-
-                        if (dither) {
-                            s = do_shaping(outbuf[i] * gain2, &peak, dither, ch);
-                        }
-                        else {
-                            s = RINT(outbuf[i] * gain2);
-
-                            if (s < -0x80000000) {
-                                double d = (double)s / -0x80000000;
-                                peak = peak < d ? d : peak;
-                                s = -0x80000000;
-                            }
-                            if (0x7fffffff < s) {
-                                double d = (double)s / 0x7fffffff;
-                                peak = peak < d ? d : peak;
-                                s = 0x7fffffff;
-                            }
-                        }
-
-                        ((char*)rawoutbuf)[i * 4] = s & 255; s >>= 8;
-                        ((char*)rawoutbuf)[i * 4 + 1] = s & 255; s >>= 8;
-                        ((char*)rawoutbuf)[i * 4 + 2] = s & 255; s >>= 8;
-                        ((char*)rawoutbuf)[i * 4 + 3] = s & 255;
-
-                        ch++;
-                        if (ch == nch) ch = 0;
-                    }
-                }
-                break;
-#endif
+                        ((float *)rawoutbuf)[i] = outbuf[i] * gain;
+                    break;
                 }
+                SV_STAGE_LEAVE();
             }
 
             if (!init)
@@ -1791,20 +1976,20 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
                 {
                     if ((double)sumread * dfrq / sfrq + 2 > sumwrite + nsmplwrt2)
                     {
-                        if (dbps * nch * nsmplwrt2 != fwrite(rawoutbuf, 1, dbps * nch * nsmplwrt2, fpo))
+                        if (dbps * nch * nsmplwrt2 != wav_out_write(rawoutbuf, 1, dbps * nch * nsmplwrt2, fpo))
                         {
                         }
                         sumwrite += nsmplwrt2;
                     }
                     else
                     {
-                        fwrite(rawoutbuf, 1, dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite), fpo);
+                        wav_out_write(rawoutbuf, 1, dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite), fpo);
                         break;
                     }
                 }
                 else
                 {
-                    fwrite(rawoutbuf, 1, dbps * nch * nsmplwrt2, fpo);
+                    wav_out_write(rawoutbuf, 1, dbps * nch * nsmplwrt2, fpo);
                     sumwrite += nsmplwrt2;
                 }
             }
@@ -1820,18 +2005,19 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
                     {
                         if ((double)sumread * dfrq / sfrq + 2 > sumwrite + nsmplwrt2 - delay)
                         {
-                            fwrite(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (nsmplwrt2 - delay), fpo);
+                            wav_out_write(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (nsmplwrt2 - delay), fpo);
                             sumwrite += nsmplwrt2 - delay;
+                            init = 0;
                         }
                         else
                         {
-                            fwrite(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite - delay), fpo);
+                            wav_out_write(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (floor((double)sumread * dfrq / sfrq) + 2 - sumwrite), fpo);
                             break;
                         }
                     }
                     else
                     {
-                        fwrite(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (nsmplwrt2 - delay), fpo);
+                        wav_out_write(rawoutbuf + dbps * nch * delay, 1, dbps * nch * (nsmplwrt2 - delay), fpo);
                         sumwrite += nsmplwrt2 - delay;
                         init = 0;
                     }
@@ -1860,13 +2046,16 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
 
     showprogress(1);
 
-    free(stage1);
-    free(fft_ip);
-    free(fft_w);
-    free(f2order);
-    free(f2inc);
-    free(stage2[0]);
-    free(stage2);
+    if (kept == NULL)
+    {
+        free(stage1);
+        free(fft_ip);
+        free(fft_w);
+        free(f2order);
+        free(f2inc);
+        free(stage2[0]);
+        free(stage2);
+    }
     for (i = 0; i < nch; i++)
         free(buf1[i]);
     free(buf1);
@@ -1875,16 +2064,20 @@ double downsample(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, int sfrq, in
     free(buf2);
     free(inbuf);
     free(outbuf);
-    free(rawinbuf);
     free(rawoutbuf);
 
     return peak;
 }
 
-double no_src(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, double gain, int chanklen, int twopass, int dither)
+double no_src(WAV_file *wfi, WAV_out *fpo, int nch, int snch, const REAL *mixm, int bps, int dbps, double gain, unsigned long long chanklen, int twopass, int dither)
 {
     double peak = 0;
-    int ch = 0, sumread = 0;
+    int ch = 0;
+    unsigned long long sumread = 0;
+    const void *rawframe;
+    REAL *frame;
+
+    frame = (REAL *)calloc(nch, sizeof(REAL));
 
     setstarttime();
 
@@ -1894,39 +2087,14 @@ double no_src(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, double gain, int
         int s;
         unsigned char buf[3];
 
-        switch (bps)
+        if (ch == 0)
         {
-        case 1:
-            fread(buf, 1, 1, fpi);
-            f = (1 / (REAL)0x7f) * ((REAL)((unsigned char *)buf)[0] - 128);
-            break;
-        case 2:
-            fread(buf, 2, 1, fpi);
-#ifndef BIGENDIAN
-            f = (1 / (REAL)0x7fff) * ((REAL)((short *)buf)[0]);
-#else
-            f = (1 / (REAL)0x7fff) * (((int)buf[0]) | (((int)(((char *)buf)[1])) << 8));
-#endif
-            break;
-        case 3:
-            fread(buf, 3, 1, fpi);
-            f = (1 / (REAL)0x7fffff) *
-                ((((int)buf[0]) << 0) |
-                 (((int)buf[1]) << 8) |
-                 (((int)((char *)buf)[2]) << 16));
-            break;
-        case 4:
-            fread(buf, 4, 1, fpi);
-            f = (1 / (REAL)0x7fffffff) *
-                ((((int)buf[0]) << 0) |
-                 (((int)buf[1]) << 8) |
-                 (((int)buf[2]) << 16) |
-                 (((int)((char *)buf)[3]) << 24));
-            break;
-        };
+            if (wav_read(wfi, 1, &rawframe) != 1)
+                break;
+            decode_block((unsigned char *)rawframe, frame, 1, snch, nch, bps, wfi->format, mixm);
+        }
 
-        if (feof(fpi))
-            break;
+        f = frame[ch];
         f *= gain;
 
         if (!twopass)
@@ -1937,7 +2105,7 @@ double no_src(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, double gain, int
                 f *= 0x7f;
                 s = dither ? do_shaping(f, &peak, dither, ch) : RINT(f);
                 buf[0] = s + 128;
-                fwrite(buf, sizeof(char), 1, fpo);
+                wav_out_write(buf, sizeof(char), 1, fpo);
                 break;
             case 2:
                 f *= 0x7fff;
@@ -1945,7 +2113,7 @@ double no_src(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, double gain, int
                 buf[0] = s & 255;
                 s >>= 8;
                 buf[1] = s & 255;
-                fwrite(buf, sizeof(char), 2, fpo);
+                wav_out_write(buf, sizeof(char), 2, fpo);
                 break;
             case 3:
                 f *= 0x7fffff;
@@ -1955,26 +2123,21 @@ double no_src(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, double gain, int
                 buf[1] = s & 255;
                 s >>= 8;
                 buf[2] = s & 255;
-                fwrite(buf, sizeof(char), 3, fpo);
+                wav_out_write(buf, sizeof(char), 3, fpo);
                 break;
-#if 0
             case 4:
-                f *= 0x7fffffff;
-                s = dither ? do_shaping(f, &peak, dither, ch) : RINT(f);
-                buf[0] = s & 255; s >>= 8;
-                buf[1] = s & 255; s >>= 8;
-                buf[2] = s & 255; s >>= 8;
-                buf[3] = s & 255;
-                fwrite(buf, sizeof(char), 4, fpo);
+                {
+                    float g = f;
+                    wav_out_write(&g, sizeof(float), 1, fpo);
+                }
                 break;
-#endif
             };
         }
         else
         {
             REAL p = f > 0 ? f : -f;
             peak = peak < p ? p : peak;
-            fwrite(&f, sizeof(REAL), 1, fpo);
+            wav_out_write(&f, sizeof(REAL), 1, fpo);
         }
 
         ch++;
@@ -1988,6 +2151,8 @@ double no_src(FILE *fpi, FILE *fpo, int nch, int bps, int dbps, double gain, int
 
     showprogress(1);
 
+    free(frame);
+
     return peak;
 }
 
@@ -2143,6 +2308,7 @@ int main(int argc, char **argv)
     int twopass, normalize, dither, pdf;
     int dfrq, dbps;
     double att, noiseamp;
+    ssrc_mix mix = {SSRC_MIX_NONE, 0, 0, 0, NULL};
     int i;
 
     // parse command line options
@@ -2249,6 +2415,32 @@ int main(int argc, char **argv)
             continue;
         }
 
+        if (strcmp(argv[i], "--mix") == 0)
+        {
+            char *endptr;
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "--mix needs a channel number or avg\n");
+                exit(-1);
+            }
+            mix.channel = strtol(argv[i + 1], &endptr, 10);
+            if (*endptr == '\0')
+            {
+                mix.type = SSRC_MIX_SELECT;
+            }
+            else if (strcmp(argv[i + 1], "avg") == 0)
+            {
+                mix.type = SSRC_MIX_AVERAGE;
+            }
+            else
+            {
+                fprintf(stderr, "unrecognized mix : %s\n", argv[i + 1]);
+                exit(-1);
+            }
+            i++;
+            continue;
+        }
+
         if (strcmp(argv[i], "--quiet") == 0)
         {
             quiet = 1;
@@ -2303,12 +2495,15 @@ int main(int argc, char **argv)
     sfn = argv[i];
     dfn = argv[i + 1];
 
-    ssrc(sfn, dfn, dfrq);
+    return ssrc_mixed(sfn, dfn, dfrq, &mix) < 0 ? 1 : 0;
 }
 #endif // SSRC
 
+/* File names come as UTF-8: Windows opens them in the ANSI code page,
+   elsewhere they are taken as they are */
 char *UTF8ToANSI(const char *pszCode)
 {
+#if defined(_WIN32)
     BSTR bstrWide;
     char *pszAnsi;
     int nLength;
@@ -2324,16 +2519,42 @@ char *UTF8ToANSI(const char *pszCode)
     SysFreeString(bstrWide);
 
     return pszAnsi;
+#else
+    char *pszAnsi = new char[strlen(pszCode) + 1];
+
+    return strcpy(pszAnsi, pszCode);
+#endif
 }
 
 int ssrc(char *sfn, char *dfn, int dfrq)
+{
+    return ssrc_mixed(sfn, dfn, dfrq, NULL);
+}
+
+int ssrc_mixed(char *sfn, char *dfn, int dfrq, const ssrc_mix *mix)
+{
+    return ssrc_stream(sfn, dfn, dfrq, mix, NULL, SSRC_OUT_AUTO);
+}
+
+/*
+ * sfn and dfn may be "-" for stdin/stdout, or pipes: the input is then
+ * read once, front to back, and the output is written out without
+ * coming back to patch its header, which keeps "unknown" sizes.
+ * raw gives the format of a headerless input, NULL for a wave file.
+ * Returns 0, or -1 when mix doesn't fit the channels of the input, in
+ * which case no output is created.
+ */
+int ssrc_stream(char *sfn, char *dfn, int dfrq, const ssrc_mix *mix, const ssrc_pcm *raw, int out)
 {
     char *tmpfn = NULL;
     char *infile, *outfile;
-    FILE *fpi, *fpo, *fpt = NULL;
-    int twopass, normalize, dither, pdf, samp;
-    int nch, bps;
-    unsigned int length;
+    WAV_file wfi;
+    FILE *fpo, *fpt = NULL;
+    WAV_out wo;
+    int twopass, normalize, dither, pdf, samp, streamed;
+    int nch, snch, bps;
+    REAL *mixm;
+    unsigned long long length;
     int sfrq, dbps;
     double att, peak, noiseamp;
 
@@ -2349,9 +2570,12 @@ int ssrc(char *sfn, char *dfn, int dfrq)
     noiseamp = 0.18;
     quiet = 1; // suppress verbose
 
+    SV_TRACE_BEGIN("ssrc", sfn);
+
     /* check file type */
     int name_len;
     int wav_flag = 0;
+    int container = WAV_RIFF;
 
     infile = UTF8ToANSI(sfn);
     outfile = UTF8ToANSI(dfn);
@@ -2363,107 +2587,84 @@ int ssrc(char *sfn, char *dfn, int dfrq)
     {
         if ((strcmp(outfile + name_len - 4, ".wav") == 0) || (strcmp(outfile + name_len - 4, ".WAV") == 0))
             wav_flag = 1;
+        else if ((strcmp(outfile + name_len - 4, ".w64") == 0) || (strcmp(outfile + name_len - 4, ".W64") == 0))
+        {
+            wav_flag = 1;
+            container = WAV_W64;
+        }
         else if ((strcmp(outfile + name_len - 4, ".raw") == 0) || (strcmp(outfile + name_len - 4, ".pcm") == 0))
             wav_flag = 0;
         else
             printf("diffent file\n");
     }
-
-    // fpi = fopen(sfn, "rb");
-    fpi = fopen(infile, "rb");
-    delete infile;
-
-    if (!fpi)
+    if (out != SSRC_OUT_AUTO && (out & SSRC_OUT_FLOAT))
+        dbps = 4;
+    if (out != SSRC_OUT_AUTO && out != SSRC_OUT_FLOAT)
+        wav_flag = out & SSRC_OUT_WAV;
+    else if (strcmp(outfile, "-") == 0)
+        wav_flag = 1;
+
+    /* open and map the input, parsing its wav header */
+    if (wav_open(infile, raw != NULL, &wfi) < 0)
     {
         fprintf(stderr, "cannot open input file.\n");
         exit(-1);
     }
+    delete infile;
 
-    /* read wav header */
+    /* headerless input: the format is the caller's */
+    if (raw != NULL)
     {
-        unsigned char ibuf[576 * 2 * 2];
-        int dword;
-
-        if (getc(fpi) != 'R')
-            fmterr(1);
-        if (getc(fpi) != 'I')
-            fmterr(1);
-        if (getc(fpi) != 'F')
-            fmterr(1);
-        if (getc(fpi) != 'F')
-            fmterr(1);
-
-        dword = fread_int(fpi);
-
-        if (getc(fpi) != 'W')
-            fmterr(2);
-        if (getc(fpi) != 'A')
-            fmterr(2);
-        if (getc(fpi) != 'V')
-            fmterr(2);
-        if (getc(fpi) != 'E')
-            fmterr(2);
-        if (getc(fpi) != 'f')
-            fmterr(2);
-        if (getc(fpi) != 'm')
-            fmterr(2);
-        if (getc(fpi) != 't')
-            fmterr(2);
-        if (getc(fpi) != ' ')
-            fmterr(2);
-
-        dword = fread_int(fpi);
-        fread(ibuf, dword, 1, fpi);
-
-        if (extract_short(&ibuf[0]) != 1)
-        {
-            fprintf(stderr, "Error: Only PCM is supported.\n");
-            exit(-1);
-        }
-        nch = extract_short(&ibuf[2]);
-        sfrq = extract_int(&ibuf[4]);
-        bps = extract_int(&ibuf[8]);
-        if ((int)bps % sfrq * nch != 0)
+        if (raw->channels < 1 || raw->sample_rate < 1 || (raw->bits != 8 && raw->bits != 16 && raw->bits != 24 && raw->bits != 32))
+            fmterr(4);
+        if (raw->format == WAV_FORMAT_FLOAT && raw->bits != 32)
             fmterr(4);
+        wfi.format = raw->format == WAV_FORMAT_FLOAT ? WAV_FORMAT_FLOAT : WAV_FORMAT_PCM;
+        wfi.channels = raw->channels;
+        wfi.sample_rate = raw->sample_rate;
+        wfi.bits = raw->bits;
+        wfi.block_align = raw->channels * (raw->bits / 8);
+        wfi.byte_rate = raw->sample_rate * wfi.block_align;
+        wfi.data_bytes -= wfi.data_bytes % wfi.block_align;
+    }
 
-        bps /= sfrq * nch;
+    nch = wfi.channels;
+    sfrq = wfi.sample_rate;
+    bps = wfi.byte_rate;
+    if ((int)bps % sfrq * nch != 0)
+        fmterr(4);
 
-        for (;;)
-        {
-            char buf[4];
-            buf[0] = getc(fpi);
-            buf[1] = getc(fpi);
-            buf[2] = getc(fpi);
-            buf[3] = getc(fpi);
-            length = fread_uint(fpi);
-            if (buf[0] == 'd' && buf[1] == 'a' && buf[2] == 't' && buf[3] == 'a')
-                break;
-            if (feof(fpi))
-                break;
-            fseek(fpi, length, SEEK_CUR);
-        }
-        if (feof(fpi))
-        {
-            fprintf(stderr, "Couldn't find data chank\n");
-            exit(-1);
-        }
-    }
+    bps /= sfrq * nch;
+    length = wfi.data_bytes;
 
-    if (bps != 1 && bps != 2 && bps != 3 && bps != 4)
+    if ((bps != 1 && bps != 2 && bps != 3 && bps != 4) || (wfi.format == WAV_FORMAT_FLOAT && bps != 4))
     {
-        fprintf(stderr, "Error : Only 8bit, 16bit, 24bit and 32bit PCM are supported.\n");
+        fprintf(stderr, "Error : Only 8bit, 16bit, 24bit and 32bit PCM, and 32bit float are supported.\n");
         exit(-1);
     }
 
+    /* downmix or select channels before any filtering */
+    snch = nch;
+    if (make_mix_matrix(mix, snch, &nch, &mixm) < 0)
+    {
+        wav_close(&wfi);
+        delete outfile;
+        SV_TRACE_END();
+        return -1;
+    }
+
     if (dbps == -1)
     {
         if (bps != 1)
             dbps = bps;
         else
             dbps = 2;
-        if (dbps == 4)
+        /* 32-bit integers go to 24 bits, floats stay floats */
+        if (dbps == 4 && wfi.format != WAV_FORMAT_FLOAT)
             dbps = 3;
     }
+    if (dbps == 4)
+        dither = 0;
 
     if (dfrq == -1)
         dfrq = sfrq;
@@ -2492,8 +2693,8 @@ int ssrc(char *sfn, char *dfn, int dfrq)
         printf("frequency : %d -> %d\n", sfrq, dfrq);
         printf("attenuation : %gdB\n", att);
         printf("bits per sample : %d -> %d\n", bps * 8, dbps * 8);
-        printf("nchannels : %d\n", nch);
-        printf("length : %d bytes, %g secs\n", length, (double)length / bps / nch / sfrq);
+        printf("nchannels : %d -> %d\n", snch, nch);
+        printf("length : %llu bytes, %g secs\n", length, (double)length / bps / snch / sfrq);
         if (dither == 0)
         {
             printf("dither type : none\n");
@@ -2523,43 +2724,31 @@ int ssrc(char *sfn, char *dfn, int dfrq)
     }
 
     // fpo = fopen(dfn, "wb");
-    fpo = fopen(outfile, "wb");
+    fpo = wav_create(outfile);
     delete outfile;
     if (!fpo)
     {
         fprintf(stderr, "cannot open output file.\n");
         exit(-1);
     }
+    streamed = !wav_seekable(fpo);
 
-    /* generate wav header */
+    /*
+     * generate wav header; RF64 when the samples won't fit a RIFF file,
+     * and sizes left unknown when they can't be patched at the end
+     */
     if (wav_flag != 0)
     {
-        short word;
-        int dword;
-
-        fwrite("RIFF", 4, 1, fpo);
-        dword = 0;
-        fwrite_int(fpo, dword);
-
-        fwrite("WAVEfmt ", 8, 1, fpo);
-        dword = 16;
-        fwrite_int(fpo, dword);
-        word = 1;
-        fwrite_short(fpo, word); /* format category, PCM */
-        word = nch;
-        fwrite_short(fpo, word); /* channels */
-        dword = dfrq;
-        fwrite_int(fpo, dword); /* sampling rate */
-        dword = dfrq * nch * dbps;
-        fwrite_int(fpo, dword); /* bytes per sec */
-        word = dbps * nch;
-        fwrite_short(fpo, word); /* block alignment */
-        word = dbps * 8;
-        fwrite_short(fpo, word); /* bits per sample */
-
-        fwrite("data", 4, 1, fpo);
-        dword = 0;
-        fwrite_int(fpo, dword);
+        if (container == WAV_RIFF && !wfi.stream && (double)length / bps / snch * dfrq / sfrq * nch * dbps >= 4294967295.0 - 1048576)
+            container = WAV_RF64;
+        if (streamed)
+            container |= WAV_STREAMED;
+
+        if (wav_write_header(fpo, container, dbps == 4 ? WAV_FORMAT_FLOAT : WAV_FORMAT_PCM, nch, dfrq, dbps * 8) < 0)
+        {
+            fprintf(stderr, "cannot write output file.\n");
+            exit(-1);
+        }
     }
 
 #if 0
@@ -2601,32 +2790,43 @@ int ssrc(char *sfn, char *dfn, int dfrq)
         samp = init_shaper(dfrq, nch, min, max, dither, pdf, noiseamp);
     }
 
+    /* Reads and writes overlap with the filters, each in an I/O thread */
+    wav_prefetch(&wfi, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+
     if (twopass)
     {
         REAL gain;
         int ch = 0;
-        unsigned int fptlen, sumread;
+        unsigned long long fptlen, sumread;
 
         if (!quiet)
             printf("Pass 1\n");
 
+        wav_out_open(&wo, fpt, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+
         if (normalize)
         {
             if (sfrq < dfrq)
-                peak = upsample(fpi, fpt, nch, bps, sizeof(REAL), sfrq, dfrq, 1, length / bps / nch, twopass, dither);
+                peak = upsample(&wfi, &wo, nch, snch, mixm, bps, sizeof(REAL), sfrq, dfrq, 1, length / bps / snch, twopass, dither);
             else if (sfrq > dfrq)
-                peak = downsample(fpi, fpt, nch, bps, sizeof(REAL), sfrq, dfrq, 1, length / bps / nch, twopass, dither);
+                peak = downsample(&wfi, &wo, nch, snch, mixm, bps, sizeof(REAL), sfrq, dfrq, 1, length / bps / snch, twopass, dither);
             else
-                peak = no_src(fpi, fpt, nch, bps, sizeof(REAL), 1, length / bps / nch, twopass, dither);
+                peak = no_src(&wfi, &wo, nch, snch, mixm, bps, sizeof(REAL), 1, length / bps / snch, twopass, dither);
         }
         else
         {
             if (sfrq < dfrq)
-                peak = upsample(fpi, fpt, nch, bps, sizeof(REAL), sfrq, dfrq, pow(10, -att / 20), length / bps / nch, twopass, dither);
+                peak = upsample(&wfi, &wo, nch, snch, mixm, bps, sizeof(REAL), sfrq, dfrq, pow(10, -att / 20), length / bps / snch, twopass, dither);
             else if (sfrq > dfrq)
-                peak = downsample(fpi, fpt, nch, bps, sizeof(REAL), sfrq, dfrq, pow(10, -att / 20), length / bps / nch, twopass, dither);
+                peak = downsample(&wfi, &wo, nch, snch, mixm, bps, sizeof(REAL), sfrq, dfrq, pow(10, -att / 20), length / bps / snch, twopass, dither);
             else
-                peak = no_src(fpi, fpt, nch, bps, sizeof(REAL), pow(10, -att / 20), length / bps / nch, twopass, dither);
+                peak = no_src(&wfi, &wo, nch, snch, mixm, bps, sizeof(REAL), pow(10, -att / 20), length / bps / snch, twopass, dither);
+        }
+
+        if (wav_out_close(&wo) < 0)
+        {
+            fprintf(stderr, "fwrite error(temporary file).\n");
+            exit(-1);
         }
 
         if (!quiet)
@@ -2658,11 +2858,9 @@ int ssrc(char *sfn, char *dfn, int dfrq)
             case 3:
                 gain = (normalize || peak >= (0x7fffff - samp) / (double)0x7fffff) ? 1 / peak * (0x7fffff - samp) : 1 / peak * 0x7fffff;
                 break;
-#if 0
             case 4:
-                gain = (normalize || peak >= (0x7fffffff - samp) / (double)0x7fffffff) ? 1 / peak * (0x7fffffff - samp) : 1 / peak * 0x7fffffff;
+                gain = 1 / peak;
                 break;
-#endif
             }
         }
         else
@@ -2678,21 +2876,20 @@ int ssrc(char *sfn, char *dfn, int dfrq)
             case 3:
                 gain = 1 / peak * 0x7fffff;
                 break;
-#if 0
             case 4:
-                gain = 1 / peak * 0x7fffffff;
+                gain = 1 / peak;
                 break;
-#endif
             }
         }
         randptr = 0;
 
         setstarttime();
 
-        fptlen = ftell(fpt) / sizeof(REAL);
+        fptlen = WAV_FTELL(fpt) / sizeof(REAL);
         sumread = 0;
 
         fseek(fpt, 0, SEEK_SET);
+        wav_out_open(&wo, fpo, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
         for (;;)
         {
             REAL f;
@@ -2712,7 +2909,7 @@ int ssrc(char *sfn, char *dfn, int dfrq)
 
                 buf[0] = s + 128;
 
-                fwrite(buf, sizeof(char), 1, fpo);
+                wav_out_write(buf, sizeof(char), 1, &wo);
             }
             break;
             case 2:
@@ -2724,7 +2921,7 @@ int ssrc(char *sfn, char *dfn, int dfrq)
                 s >>= 8;
                 buf[1] = s & 255;
 
-                fwrite(buf, sizeof(char), 2, fpo);
+                wav_out_write(buf, sizeof(char), 2, &wo);
             }
             break;
             case 3:
@@ -2738,24 +2935,16 @@ int ssrc(char *sfn, char *dfn, int dfrq)
                 s >>= 8;
                 buf[2] = s & 255;
 
-                fwrite(buf, sizeof(char), 3, fpo);
+                wav_out_write(buf, sizeof(char), 3, &wo);
             }
             break;
-#if 0
             case 4:
             {
-                char buf[4];
-                s = dither ? do_shaping(f, &peak, dither, ch) : RINT(f);
+                float g = f;
 
-                buf[0] = s & 255; s >>= 8;
-                buf[1] = s & 255; s >>= 8;
-                buf[2] = s & 255; s >>= 8;
-                buf[3] = s & 255;
-
-                fwrite(buf, sizeof(char), 4, fpo);
+                wav_out_write(&g, sizeof(float), 1, &wo);
             }
             break;
-#endif
             }
 
             ch++;
@@ -2765,6 +2954,7 @@ int ssrc(char *sfn, char *dfn, int dfrq)
             if ((sumread & 0x3ffff) == 0)
                 showprogress((double)sumread / fptlen);
         }
+        wav_out_close(&wo);
         showprogress(1);
         if (!quiet)
             printf("\n");
@@ -2777,12 +2967,14 @@ int ssrc(char *sfn, char *dfn, int dfrq)
     }
     else
     {
+        wav_out_open(&wo, fpo, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
         if (sfrq < dfrq)
-            peak = upsample(fpi, fpo, nch, bps, dbps, sfrq, dfrq, pow(10, -att / 20), length / bps / nch, twopass, dither);
+            peak = upsample(&wfi, &wo, nch, snch, mixm, bps, dbps, sfrq, dfrq, pow(10, -att / 20), length / bps / snch, twopass, dither);
         else if (sfrq > dfrq)
-            peak = downsample(fpi, fpo, nch, bps, dbps, sfrq, dfrq, pow(10, -att / 20), length / bps / nch, twopass, dither);
+            peak = downsample(&wfi, &wo, nch, snch, mixm, bps, dbps, sfrq, dfrq, pow(10, -att / 20), length / bps / snch, twopass, dither);
         else
-            peak = no_src(fpi, fpo, nch, bps, dbps, pow(10, -att / 20), length / bps / nch, twopass, dither);
+            peak = no_src(&wfi, &wo, nch, snch, mixm, bps, dbps, pow(10, -att / 20), length / bps / snch, twopass, dither);
+        wav_out_close(&wo);
         if (!quiet)
             printf("\n");
     }
@@ -2798,28 +2990,16 @@ int ssrc(char *sfn, char *dfn, int dfrq)
             printf("clipping detected : %gdB\n", 20 * log10(peak));
     }
 
-    {
-        int dword;
-        int len;
-
-        if (wav_flag != 0)
-        {
-
-            fseek(fpo, 0, SEEK_END);
-            len = ftell(fpo);
-
-            fseek(fpo, 4, SEEK_SET);
-            dword = len - 8;
-            fwrite_int(fpo, dword);
+    if (wav_flag != 0 && !streamed)
+        wav_write_sizes(fpo, container, dbps * nch);
 
-            fseek(fpo, 40, SEEK_SET);
-            dword = len - 44;
-            fwrite_int(fpo, dword);
-        }
-    }
-
-    fclose(fpi);
-    fclose(fpo);
+    wav_close(&wfi);
+    if (fpo != stdout)
+        fclose(fpo);
+    else
+        fflush(fpo);
+    free(mixm);
 
+    SV_TRACE_END();
     return 0;
 }
@@ -1,4 +1,4 @@
-/*                                                             v2.3 19.MAY.05
+/*                                                            v2.11 19.OCT.26
 =============================================================================
 
                           U    U   GGG    SSSS  TTTTT
@@ -25,9 +25,9 @@ MODULE:         SV-P56.C, FUNCTIONS RELATED TO ACTIVE LEVEL CALCULATIONS
 ORIGINAL BY:
    Simao Ferraz de Campos Neto   CPqD/Telebras Brazil
 
-DATE:           19/May/2005
+DATE:           19/Oct/2026
 
-RELEASE:        2.00
+RELEASE:        2.11
 
 PROTOTYPES:     see sv-p56.h.
 
@@ -40,6 +40,25 @@ speech_voltmeter .............. measurement of the active speech level of
                                 data in a buffer according to P.56. Other
                 relevant statistics are also available.
 
+active_speech_level ........... statistics (active level, activity factor,
+                                rms and DC levels) of an accumulated state.
+
+speech_voltmeter_thresholds ... activity and hangover counts for a run of
+                                envelope values.
+
+speech_voltmeter_int .......... speech_voltmeter() for 16, 24 or 32-bit
+                                integer samples, without conversion to
+                                float.
+
+speech_voltmeter_timeline ..... the voltmeter, with a timeline of per-frame
+                                envelope, rms, peak and activity; see also
+                                init_speech_timeline() and
+                                speech_timeline_end().
+
+speech_voltmeter_save ......... checkpoint of a state, as a portable blob;
+                                see also speech_voltmeter_restore() and
+                                speech_voltmeter_merge().
+
 HISTORY:
 
    07.Oct.91 v1.0 Release of 1st version to UGST.
@@ -57,6 +76,26 @@ HISTORY:
                   suggested by Mr Kabal.
                   Upper and lower bounds are updated during the interpolation.
                         <Cyril Guillaume & Stephane Ragot -- stephane.ragot@francetelecom.com>
+   19.Oct.26 v2.4 Statistics split into active_speech_level(); added
+                  speech_voltmeter_int() for integer input, with exact
+                  integer sums, and speech_voltmeter_thresholds(), whose
+                  cost per sample does not depend on the number of
+                  thresholds.
+   19.Oct.26 v2.5 Runs of equal samples (digital silence, DC) advanced
+                  in closed form by envelope_run().
+   19.Oct.26 v2.6 Sample and activity counts made 64-bit (SVP56_count),
+                  for multi-hour recordings where long is 32 bits.
+   19.Oct.26 v2.7 Per-frame timeline: init_speech_timeline(),
+                  speech_voltmeter_timeline(), speech_timeline_end().
+   19.Oct.26 v2.8 Checkpoints: speech_voltmeter_save(),
+                  speech_voltmeter_restore(), speech_voltmeter_merge().
+   19.Oct.26 v2.9 Coefficient of smoothing and hangover of 8, 16, 32,
+                  44.1 and 48 kHz from a table (sv_rates), instead of
+                  exp() and floor() on every call.
+   19.Oct.26 v2.10 Voltmeter time and samples counted (svstats.h).
+   19.Oct.26 v2.11 speech_voltmeter_merge() takes parts metered from a
+                  fresh voltmeter only, and refuses a part of another
+                  sampling rate.
 
 =============================================================================
 */
@@ -67,10 +106,13 @@ HISTORY:
 
  /* System includes ... */
 #include <math.h>
+#include <stddef.h>
+#include <string.h>
 
 /* Specific includes ... */
 #ifndef SPEECH_VOLTMETER_defined
 #include "sv-p56.h"
+#include "svstats.h"
 #endif
 
 /*
@@ -260,6 +302,151 @@ void init_speech_voltmeter(SVP56_state* state, double sampl_freq) {
 /* .................. End of init_speech_voltmeter() ..................... */
 
 
+/*
+ * Coefficient of smoothing and hangover of the common sampling rates,
+ * as exp() and floor() give them, so that they are not computed again
+ * on every call; other rates are computed by sv_constants().
+ */
+static const struct {
+    float f;                      /* sampling frequency, in Hz */
+    double g;                     /* exp(-1 / (f T)) */
+    long I;                       /* floor(H f + 0.5) */
+} sv_rates[] = {
+    { 8000.f, 0.99584200184510996, 1600 },
+    { 16000.f, 0.99791883529929926, 3200 },
+    { 32000.f, 0.99895887567972452, 6400 },
+    { 44100.f, 0.99924442768990718, 8820 },
+    { 48000.f, 0.99930579662629215, 9600 }
+};
+
+#define T        0.03           /* in [s] */
+#define H        0.20           /* in [s] */
+
+static void sv_constants(float f, double* g, long* I) {
+    int i;
+
+    for (i = 0; i < (int) (sizeof(sv_rates) / sizeof(sv_rates[0])); i++) {
+        if (sv_rates[i].f == f) {
+            *g = sv_rates[i].g;
+            *I = sv_rates[i].I;
+            return;
+        }
+    }
+    *I = (long) floor(H * f + 0.5);
+    *g = exp(-1.0 / (f * T));
+}
+
+#undef H
+#undef T
+
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        static void envelope_run (SVP56_state *state, double x, long L,
+        ~~~~~~~~~~~~~~~~~~~~~~~~  long I, double g);
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Advances Process 2 of P.56 and the threshold counts over a run
+        of `L' samples that are all equal to `x'; peaks and sums are
+        left to the caller. With d = |x|, the envelopes after k samples
+        of the run are
+
+          p[k] = d + g^k (p[0] - d)
+          q[k] = d + g^k (q[0] - d + k (1-g) (p[0] - d))
+
+        and q[k] stays between the smallest and the largest of p[0],
+        q[0] and d. The run is processed sample by sample while a
+        threshold lies within that range; from then on, every threshold
+        is either reached at all samples or at none, so the counts and
+        the envelopes are advanced for the rest of the run at once.
+
+        Variables:
+        ~~~~~~~~~~
+        Name:         Type:   Use:
+        state          I/O       state variable
+        x               I        value of all samples in the run
+        L               I        length of the run
+        I               I        hangover, in samples
+        g               I        coefficient of smoothing
+
+        Value returned:
+        ~~~~~~~~~~~~~~~
+        None.
+
+        Log of changes:
+        ~~~~~~~~~~~~~~~
+        19.Oct.26     1.0       Created.
+        19.Oct.26     1.1       Merge of fresh parts only, of one rate.
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+#define THRES_NO 15             /* number of thresholds in the speech voltmeter */
+
+static void envelope_run(SVP56_state* state, double x, long L, long I, double g) {
+    long j, Klo = 0, Khi;
+    SVP56_count held;
+    double d, lo, hi, gL, P, Q;
+
+    d = (x > 0) ? x : -x;
+
+    while (L > 0) {
+        /* Range of the envelope over the rest of the run */
+        lo = (state->p < state->q) ? state->p : state->q;
+        lo = (d < lo) ? d : lo;
+        hi = (state->p > state->q) ? state->p : state->q;
+        hi = (d > hi) ? d : hi;
+        for (Klo = 0; Klo < THRES_NO && lo >= state->c[Klo]; Klo++);
+        for (Khi = Klo; Khi < THRES_NO && hi >= state->c[Khi]; Khi++);
+        if (Klo == Khi)
+            break;
+
+        /* A threshold may still be crossed: one sample as in speech_voltmeter() */
+        state->p = g * (state->p) + (1 - g) * d;
+        state->q = g * (state->q) + (1 - g) * (state->p);
+        for (j = 0; j < THRES_NO; j++) {
+            if ((state->q) >= state->c[j]) {
+                state->a[j]++;
+                state->hang[j] = 0;
+            }
+            if (((state->q) < state->c[j]) && (state->hang[j] < (SVP56_count) I)) {
+                state->a[j]++;
+                state->hang[j] += 1;
+            }
+        }
+        L--;
+    }
+
+    if (L == 0)
+        return;
+
+    /* Thresholds below the envelope are reached all along the run */
+    for (j = 0; j < Klo; j++) {
+        state->a[j] += L;
+        state->hang[j] = 0;
+    }
+
+    /* The others are counted while their hangover lasts */
+    for (j = Klo; j < THRES_NO; j++) {
+        held = (SVP56_count) I - state->hang[j];
+        held = (held < (SVP56_count) L) ? held : (SVP56_count) L;
+        state->a[j] += held;
+        state->hang[j] += held;
+    }
+
+    gL = pow(g, (double) L);
+    P = state->p - d;
+    Q = state->q - d;
+    state->p = d + gL * P;
+    state->q = d + gL * (Q + L * (1 - g) * P);
+}
+
+#undef THRES_NO
+/* ....................... End of envelope_run() ......................... */
+
+
 /*
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
@@ -337,30 +524,54 @@ void init_speech_voltmeter(SVP56_state* state, double sampl_freq) {
                 DEC Alpha VMS workstation and extended
                                 to ther platforms as well. Exceptions are
                                 VMS and gcc on PC. <simao@ctd.comsat.com>
+        19.Oct.26     2.3       Runs of SV_RUN_MIN or more equal samples are
+                                advanced at once by envelope_run().
+        19.Oct.26     2.4       Accumulation split into voltmeter_float(),
+                                shared with speech_voltmeter_timeline().
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 */
 #define T        0.03           /* in [s] */
 #define H        0.20           /* in [s] */
 #define M        15.9           /* in [dB] */
 #define THRES_NO 15             /* number of thresholds in the speech voltmeter */
+#define SV_RUN_MIN 64           /* shortest run of equal samples taken at once */
 
 /* Hooked to eliminate sigularity with log(0.0) (happens w/all-0 data blocks */
 #define MIN_LOG_OFFSET 1.0e-20
 
-double speech_voltmeter(float* buffer, long smpno, SVP56_state* state) {
-    int I, j;
-    long k;
-    double g, x, AdB, CdB, AmdB, CmdB, ActiveSpeechLevel;
-    double LongTermLevel, Delta[15];
+/* Process 1 and 2 of P.56 over the buffer; the statistics are left to the caller */
+static void voltmeter_float(float* buffer, long smpno, SVP56_state* state) {
+    int j;
+    long I, k, L;
+    double g, x;
 
 
     /* Some initializations */
-    I = (int) floor(H * state->f + 0.5);
-    g = exp(-1.0 / (state->f * T));
+    sv_constants(state->f, &g, &I);
 
     /* Calculates statistics for all given data points */
     for (k = 0; k < smpno; k++) {
         x = (double)buffer[k];
+
+        /* Long runs of one value (e.g. digital silence) are advanced at once */
+        if (k + SV_RUN_MIN <= smpno && buffer[k + SV_RUN_MIN - 1] == buffer[k]) {
+            for (L = 1; k + L < smpno && buffer[k + L] == buffer[k]; L++);
+            if (L >= SV_RUN_MIN) {
+                if (fabs(x) > state->max)
+                    state->max = fabs(x);
+                if (x > state->maxP)
+                    state->maxP = x;
+                if (x < state->maxN)
+                    state->maxN = x;
+                (state->sq) += L * (x * x);
+                (state->s) += L * x;
+                (state->n) += L;
+                envelope_run(state, x, L, I, g);
+                k += L - 1;
+                continue;
+            }
+        }
+
         /* Compares the sample with the max. already found for the file */
         if (fabs(x) > state->max)
             state->max = fabs(x);
@@ -386,15 +597,79 @@ double speech_voltmeter(float* buffer, long smpno, SVP56_state* state) {
                 state->a[j]++;
                 state->hang[j] = 0;
             }
-            if (((state->q) < state->c[j]) && (state->hang[j] < I)) {
+            if (((state->q) < state->c[j]) && (state->hang[j] < (SVP56_count) I)) {
                 state->a[j]++;
                 state->hang[j] += 1;
             }
             /* if (((state->q)<state->c[j])&&(state->hang[j]=I)), do nothing */
         }                           /* [j] */
     }                             /* [k] */
+}
+
+double speech_voltmeter(float* buffer, long smpno, SVP56_state* state) {
+    SV_STAGE_ENTER(SV_STAGE_VOLTMETER);
+    voltmeter_float(buffer, smpno, state);
+    SV_COUNT(SV_COUNT_SAMPLES, smpno);
+    SV_STAGE_LEAVE();
 
     /* Computes the statistics */
+    return active_speech_level(state);
+}
+
+#undef MIN_LOG_OFFSET
+#undef SV_RUN_MIN
+#undef M
+#undef H
+#undef T
+#undef THRES_NO
+/* .................... End of speech_voltmeter() ........................ */
+
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        double active_speech_level (SVP56_state *state);
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Computes the statistics (DC level, rms level, activity factor
+        and active speech level) from the counts and sums accumulated
+        in `state' by speech_voltmeter() or by any of the other
+        voltmeter front-ends that fill a SVP56_state.
+
+        Variables:
+        ~~~~~~~~~~
+        Name:         Type:   Use:
+        state          I/O       state variable with the accumulations
+
+        Value returned:
+        ~~~~~~~~~~~~~~~
+        Returns the active speech level, in dBov, as a double.
+
+        Prototype:   in sv-p56.h
+        ~~~~~~~~~~
+
+        Log of changes:
+        ~~~~~~~~~~~~~~~
+        19.Oct.26     1.0       Split from speech_voltmeter(), so that the
+                                statistics can also be computed for states
+                                accumulated by other voltmeter front-ends.
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+#define M        15.9           /* in [dB] */
+#define THRES_NO 15             /* number of thresholds in the speech voltmeter */
+
+/* Hooked to eliminate sigularity with log(0.0) (happens w/all-0 data blocks */
+#define MIN_LOG_OFFSET 1.0e-20
+
+double active_speech_level(SVP56_state* state) {
+    int j;
+    double AdB, CdB, AmdB, CmdB, ActiveSpeechLevel;
+    double LongTermLevel, Delta[15];
+
     state->DClevel = (state->s) / (state->n);
     LongTermLevel = 10 * log10((state->sq) / (state->n) + MIN_LOG_OFFSET);
     state->rmsdB = LongTermLevel - state->refdB;
@@ -438,7 +713,721 @@ double speech_voltmeter(float* buffer, long smpno, SVP56_state* state) {
 
 #undef MIN_LOG_OFFSET
 #undef M
+#undef THRES_NO
+/* ...................... End of active_speech_level() ...................... */
+
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        void speech_voltmeter_thresholds (SVP56_count *a,
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  SVP56_count *hang, long stride,
+                                          double *c, long I, double *q,
+                                          long qstride, long nq);
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Applies the 15 thresholds of the speech voltmeter to `nq'
+        consecutive values of the envelope q, updating the activity and
+        hangover counts exactly as the threshold loop of
+        speech_voltmeter() does, sample by sample.
+
+        The thresholds are nested powers of two, so those reached by q
+        are always c[0..K-1] and, as a threshold is reset whenever a
+        higher one is, those still within their hangover are c[0..M-1],
+        M being the largest K of the last I+1 samples. M is kept with a
+        monotonic queue of (K, time) pairs, at most one per level, and
+        the activity counts follow from a histogram of M: the cost per
+        sample does not grow with the number of thresholds.
+
+        Variables:
+        ~~~~~~~~~~
+        Name:         Type:   Use:
+        a              I/O       activity count of threshold 0; that of
+                                 threshold j is a[j * stride]
+        hang           I/O       hangover counts, laid out as `a'
+        stride          I        distance between the counts of
+                                 consecutive thresholds (1 in SVP56_state)
+        c               I        the 15 thresholds, ascending
+        I               I        hangover, in samples
+        q               I        envelope; sample k is q[k * qstride]
+        qstride         I        distance between consecutive samples
+        nq              I        number of envelope values
+
+        Value returned:
+        ~~~~~~~~~~~~~~~
+        None.
+
+        Prototype:   in sv-p56.h
+        ~~~~~~~~~~
+
+        Log of changes:
+        ~~~~~~~~~~~~~~~
+        19.Oct.26     1.0       Created, from the batch voltmeter of
+                                sv-p56m.c.
+        19.Oct.26     1.1       64-bit counts.
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+#define THRES_NO 15             /* number of thresholds in the speech voltmeter */
+
+void speech_voltmeter_thresholds(SVP56_count* a, SVP56_count* hang, long stride,
+                                 double* c, long I, double* q, long qstride, long nq) {
+    long lev[THRES_NO], tim[THRES_NO];
+    unsigned long cnt[THRES_NO + 1], acc;
+    double cs[THRES_NO + 1], x;
+    long n = 0, i, j, k, K, M;
+
+    /* Thresholds, with one that is never reached to end the search */
+    for (j = 0; j < THRES_NO; j++)
+        cs[j] = c[j];
+    cs[THRES_NO] = HUGE_VAL;
+
+    /* Rebuilds the queue from the hangover counts; the last sample seen is -1 */
+    for (j = THRES_NO - 1; j >= 0; j--) {
+        if (hang[j * stride] < (SVP56_count) I) {
+            k = -1 - (long) hang[j * stride];
+            if (n == 0 || k > tim[n - 1]) {
+                lev[n] = j + 1;
+                tim[n] = k;
+                n++;
+            }
+        }
+    }
+
+    for (j = 0; j <= THRES_NO; j++)
+        cnt[j] = 0;
+
+    for (k = 0; k < nq; k++, q += qstride) {
+        /* Number of thresholds reached, by a branch-free binary search */
+        x = *q;
+        K = (x >= cs[7]) ? 8 : 0;
+        K += (x >= cs[K + 3]) ? 4 : 0;
+        K += (x >= cs[K + 1]) ? 2 : 0;
+        K += (x >= cs[K]) ? 1 : 0;
+
+        /* Pushes (K, k) over the pairs it covers, then expires the oldest */
+        if (K > 0) {
+            while (n > 0 && lev[n - 1] <= K)
+                n--;
+            lev[n] = K;
+            tim[n] = k;
+            n++;
+        }
+        if (n > 0 && tim[0] < k - I) {
+            for (i = 1; i < n; i++) {
+                lev[i - 1] = lev[i];
+                tim[i - 1] = tim[i];
+            }
+            n--;
+        }
+
+        M = (n > 0) ? lev[0] : 0;
+        cnt[M]++;
+    }
+
+    /* Threshold j was counted in the samples where M > j */
+    for (acc = 0, j = THRES_NO - 1; j >= 0; j--) {
+        acc += cnt[j + 1];
+        a[j * stride] += acc;
+    }
+
+    /* The newest pair above a threshold tells when it was last reached */
+    for (j = 0; j < THRES_NO; j++)
+        hang[j * stride] = (SVP56_count) I;
+    for (i = 0; i < n; i++)
+        for (j = 0; j < lev[i]; j++)
+            hang[j * stride] = (SVP56_count) (nq - 1 - tim[i]);
+}
+
+#undef THRES_NO
+/* .................. End of speech_voltmeter_thresholds() .................. */
+
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        double speech_voltmeter_int (void *buffer, long smpno, int bits,
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~~  SVP56_state *state);
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Same as speech_voltmeter(), for integer samples: 16-bit (short),
+        24-bit (3 bytes, little-endian, as in wave files) or 32-bit
+        (int). Samples are taken in the normalized range, i.e. divided
+        by 2^(bits-1), which for 16 and 24 bits is exactly what sh2fl()
+        and speech_voltmeter() compute, so that the counts are the same.
+
+        The sum and the squared sum are accumulated exactly in 64-bit
+        integers (the squares of 24 and 32-bit samples split in 16-bit
+        halves) and added to the state once per call, and the peaks are
+        found on the integers; only the envelope is computed in floating
+        point. Runs of SV_RUN_MIN or more equal samples are advanced by
+        envelope_run(), as in speech_voltmeter().
+
+        Variables:
+        ~~~~~~~~~~
+        Name:         Type:   Use:
+        buffer          I        integer samples
+        smpno           I        number of samples in `buffer'
+        bits            I        16, 24 or 32
+        state          I/O       state variable associated with the input
+
+        Value returned:
+        ~~~~~~~~~~~~~~~
+        Returns the active speech level, in dBov, as a double.
+
+        Prototype:   in sv-p56.h
+        ~~~~~~~~~~
+
+        Log of changes:
+        ~~~~~~~~~~~~~~~
+        19.Oct.26     1.0       Created.
+        19.Oct.26     1.1       Constant chunks in closed form.
+        19.Oct.26     1.2       Accumulation split into voltmeter_int(),
+                                shared with speech_voltmeter_timeline().
+        19.Oct.26     1.3       Runs found anywhere in the buffer, as in
+                                speech_voltmeter(), instead of whole
+                                constant chunks only.
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+#define T        0.03           /* in [s] */
+#define H        0.20           /* in [s] */
+#define SV_INT_CHUNK 256        /* samples decoded at a time */
+#define SV_RUN_MIN 64           /* shortest run of equal samples taken at once */
+
+/* Sample k of an integer buffer, as a 32-bit integer */
+static int sample_int(void* buffer, int bits, long k) {
+    unsigned char* b;
+
+    if (bits == 16)
+        return ((short*)buffer)[k];
+    if (bits == 24) {
+        b = (unsigned char*)buffer + 3 * k;
+        return (int)(((unsigned)b[0] << 8) | ((unsigned)b[1] << 16) | ((unsigned)b[2] << 24)) >> 8;
+    }
+    return ((int*)buffer)[k];
+}
+
+/* Same as voltmeter_float(), for integer samples */
+static void voltmeter_int(void* buffer, long smpno, int bits, SVP56_state* state) {
+    long I, k, k0, nk, st, L;
+    int xi[SV_INT_CHUNK], x0, xmax, xmin, hi, lo;
+    unsigned char* b;
+    long long is = 0, sqi = 0, shh = 0, shl = 0;
+    unsigned long long sll = 0;
+    double g, scale, ax, p, q, qs[SV_INT_CHUNK];
+
+    /* Some initializations */
+    sv_constants(state->f, &g, &I);
+    scale = ldexp(1.0, 1 - bits);
+    xmax = -2147483647 - 1;
+    xmin = 2147483647;
+    p = state->p;
+    q = state->q;
+
+    for (k0 = 0; k0 < smpno; k0 += nk) {
+        /* Long runs of one value (e.g. digital silence) are advanced at
+           once, the same runs as in voltmeter_float() */
+        x0 = sample_int(buffer, bits, k0);
+        if (k0 + SV_RUN_MIN <= smpno && sample_int(buffer, bits, k0 + SV_RUN_MIN - 1) == x0) {
+            for (L = 1; k0 + L < smpno && sample_int(buffer, bits, k0 + L) == x0; L++);
+            if (L >= SV_RUN_MIN) {
+                xmax = (x0 > xmax) ? x0 : xmax;
+                xmin = (x0 < xmin) ? x0 : xmin;
+                is += (long long)L * x0;
+                if (bits == 16)
+                    sqi += (long long)L * (x0 * x0);
+                else {
+                    hi = x0 >> 16;
+                    lo = x0 & 0xFFFF;
+                    shh += (long long)L * hi * hi;
+                    shl += (long long)L * hi * lo;
+                    sll += (unsigned long long)L * ((unsigned)lo * (unsigned)lo);
+                }
+                state->p = p;
+                state->q = q;
+                envelope_run(state, (double)x0 * scale, L, I, g);
+                p = state->p;
+                q = state->q;
+                nk = L;
+                continue;
+            }
+        }
+
+        nk = (smpno - k0 < SV_INT_CHUNK) ? smpno - k0 : SV_INT_CHUNK;
+
+        /* Brings the samples to 32-bit integers */
+        if (bits == 16) {
+            for (k = 0; k < nk; k++)
+                xi[k] = ((short*)buffer)[k0 + k];
+        }
+        else if (bits == 24) {
+            b = (unsigned char*)buffer + 3 * k0;
+            for (k = 0; k < nk; k++, b += 3)
+                xi[k] = (int)(((unsigned)b[0] << 8) | ((unsigned)b[1] << 16) | ((unsigned)b[2] << 24)) >> 8;
+        }
+        else {
+            for (k = 0; k < nk; k++)
+                xi[k] = ((int*)buffer)[k0 + k];
+        }
+
+        /* The chunk ends where the next run starts, maybe past its end */
+        for (st = 0, L = 1, k = 1; k < nk && L < SV_RUN_MIN; k++) {
+            st = (xi[k] == xi[k - 1]) ? st : k;
+            L = k - st + 1;
+        }
+        if (st > 0)
+            for (; L < SV_RUN_MIN && k0 + st + L < smpno && sample_int(buffer, bits, k0 + st + L) == xi[st]; L++);
+        if (L >= SV_RUN_MIN && st > 0)
+            nk = st;
+
+        /* Peaks and Process 1 of P.56, exactly */
+        for (k = 0; k < nk; k++) {
+            xmax = (xi[k] > xmax) ? xi[k] : xmax;
+            xmin = (xi[k] < xmin) ? xi[k] : xmin;
+            is += xi[k];
+        }
+        if (bits == 16) {
+            for (k = 0; k < nk; k++)
+                sqi += xi[k] * xi[k];
+        }
+        else {
+            for (k = 0; k < nk; k++) {
+                hi = xi[k] >> 16;
+                lo = xi[k] & 0xFFFF;
+                shh += (long long)hi * hi;
+                shl += (long long)hi * lo;
+                sll += (unsigned long long)((unsigned)lo * (unsigned)lo);
+            }
+        }
+
+        /* Process 2 of P.56, sample by sample */
+        for (k = 0; k < nk; k++) {
+            ax = fabs((double)xi[k]) * scale;
+            p = g * p + (1 - g) * ax;
+            q = g * q + (1 - g) * p;
+            qs[k] = q;
+        }
+
+        /* Applies the thresholds to the envelope */
+        speech_voltmeter_thresholds(state->a, state->hang, 1, state->c, I, qs, 1, nk);
+    }
+
+    /* Adds the block to the state */
+    if (smpno > 0) {
+        if ((double)xmax * scale > state->maxP)
+            state->maxP = (double)xmax * scale;
+        if ((double)xmin * scale < state->maxN)
+            state->maxN = (double)xmin * scale;
+        if (fabs((double)xmax) * scale > state->max)
+            state->max = fabs((double)xmax) * scale;
+        if (fabs((double)xmin) * scale > state->max)
+            state->max = fabs((double)xmin) * scale;
+    }
+    state->s += (double)is * scale;
+    if (bits == 16)
+        state->sq += (double)sqi * scale * scale;
+    else
+        state->sq += ((double)shh * 4294967296.0 + (double)shl * 131072.0 + (double)sll) * scale * scale;
+    state->n += smpno;
+    state->p = p;
+    state->q = q;
+}
+
+double speech_voltmeter_int(void* buffer, long smpno, int bits, SVP56_state* state) {
+    SV_STAGE_ENTER(SV_STAGE_VOLTMETER);
+    voltmeter_int(buffer, smpno, bits, state);
+    SV_COUNT(SV_COUNT_SAMPLES, smpno);
+    SV_STAGE_LEAVE();
+
+    /* Computes the statistics */
+    return active_speech_level(state);
+}
+
+#undef SV_RUN_MIN
+#undef SV_INT_CHUNK
 #undef H
 #undef T
+/* ..................... End of speech_voltmeter_int() ...................... */
+
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        void init_speech_timeline (SVP56_timeline *tl, SVP56_state *state,
+        ~~~~~~~~~~~~~~~~~~~~~~~~~  long len, SVP56_frame *frame, long max);
+
+        double speech_voltmeter_timeline (void *buffer, long smpno,
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  int bits, SVP56_state *state,
+                                          SVP56_timeline *tl);
+
+        long speech_timeline_end (SVP56_timeline *tl, SVP56_state *state);
+        ~~~~~~~~~~~~~~~~~~~~~~~~
+
+        Description:
+        ~~~~~~~~~~~~
+
+        The speech voltmeter, with a timeline of frames of `len'
+        samples (e.g. 10 ms) kept along the way in the caller's buffer
+        `frame': the envelope at the end of each frame, its rms level
+        and peak, in dBov, and its activity. speech_voltmeter_timeline()
+        meters the samples as speech_voltmeter() (bits = 0, float) or
+        speech_voltmeter_int() (bits = 16, 24 or 32) do, one frame at a
+        time. As the threshold of P.56 is only known once the whole
+        signal has been seen, the activity counts of each frame are
+        kept at all 15 thresholds, and speech_timeline_end() finally
+        interpolates them, in dB, at the active level less the margin:
+        `active' is then the fraction of the frame counted as active by
+        the final threshold, and a frame with active >= 0.5 is an active
+        frame. Frames beyond `max' are counted but not stored.
+
+        Variables:
+        ~~~~~~~~~~
+        Name:         Type:   Use:
+        tl             I/O       timeline state
+        state          I/O       voltmeter state, as for speech_voltmeter()
+        len             I        samples per frame, up to 65535
+        frame           O        timeline, `max' frames
+        buffer          I        samples
+        smpno           I        number of samples in `buffer'
+        bits            I        0 for float samples, or 16, 24 or 32
+
+        Value returned:
+        ~~~~~~~~~~~~~~~
+        speech_voltmeter_timeline() returns the active speech level, in
+        dBov; speech_timeline_end() the number of frames, stored or not.
+
+        Prototype:   in sv-p56.h
+        ~~~~~~~~~~
+
+        Log of changes:
+        ~~~~~~~~~~~~~~~
+        19.Oct.26     1.0       Created.
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+#define M        15.9           /* in [dB] */
+#define THRES_NO 15             /* number of thresholds in the speech voltmeter */
+
+/* Hooked to eliminate sigularity with log(0.0) (happens w/all-0 data blocks */
+#define MIN_LOG_OFFSET 1.0e-20
+
+void init_speech_timeline(SVP56_timeline* tl, SVP56_state* state, long len, SVP56_frame* frame, long max) {
+    int j;
+
+    tl->frame = frame;
+    tl->max = (frame != NULL) ? max : 0;
+    tl->count = 0;
+    tl->len = (len < 1) ? 1 : (len > 65535) ? 65535 : len;
+    tl->fill = 0;
+    tl->sq = state->sq;
+    tl->peak = 0;
+    for (j = 0; j < THRES_NO; j++)
+        tl->a[j] = state->a[j];
+}
+
+/* Stores the current frame, if any, and starts the next one */
+static void timeline_close(SVP56_timeline* tl, SVP56_state* state) {
+    SVP56_frame* fr;
+    double sq;
+    int j;
+
+    if (tl->fill == 0)
+        return;
+    if (tl->count < tl->max) {
+        fr = &tl->frame[tl->count];
+        sq = state->sq - tl->sq;
+        sq = (sq > 0) ? sq : 0;
+        fr->envdB = (float) (20 * log10(state->q + MIN_LOG_OFFSET) - state->refdB);
+        fr->rmsdB = (float) (10 * log10(sq / tl->fill + MIN_LOG_OFFSET) - state->refdB);
+        fr->peakdB = (float) (20 * log10(tl->peak + MIN_LOG_OFFSET) - state->refdB);
+        fr->active = 0;
+        fr->n = (unsigned short) tl->fill;
+        for (j = 0; j < THRES_NO; j++)
+            fr->a[j] = (unsigned short) (state->a[j] - tl->a[j]);
+    }
+    tl->count++;
+    tl->fill = 0;
+    tl->sq = state->sq;
+    tl->peak = 0;
+    for (j = 0; j < THRES_NO; j++)
+        tl->a[j] = state->a[j];
+}
+
+double speech_voltmeter_timeline(void* buffer, long smpno, int bits, SVP56_state* state, SVP56_timeline* tl) {
+    long k, l, size;
+    double max;
+
+    size = (bits == 0) ? (long) sizeof(float) : (bits == 16) ? 2 : (bits == 24) ? 3 : 4;
+    SV_STAGE_ENTER(SV_STAGE_VOLTMETER);
+
+    /* One frame, or what is left of it, at a time */
+    for (k = 0; k < smpno; k += l) {
+        l = tl->len - tl->fill;
+        l = (smpno - k < l) ? smpno - k : l;
+
+        /* The peak of the piece is taken apart, then merged back */
+        max = state->max;
+        state->max = 0;
+        if (bits == 0)
+            voltmeter_float((float*)buffer + k, l, state);
+        else
+            voltmeter_int((unsigned char*)buffer + k * size, l, bits, state);
+        tl->peak = (state->max > tl->peak) ? state->max : tl->peak;
+        state->max = (max > state->max) ? max : state->max;
+
+        if ((tl->fill += l) == tl->len)
+            timeline_close(tl, state);
+    }
+    SV_COUNT(SV_COUNT_SAMPLES, smpno);
+    SV_STAGE_LEAVE();
+
+    /* Computes the statistics */
+    return active_speech_level(state);
+}
+
+long speech_timeline_end(SVP56_timeline* tl, SVP56_state* state) {
+    double thr, w, CdB[THRES_NO];
+    long i, lo, hi;
+    SVP56_frame* fr;
+
+    timeline_close(tl, state);
+
+    /* Final threshold: the active level, less the margin */
+    thr = active_speech_level(state) + state->refdB - M;
+    for (hi = 0; hi < THRES_NO; hi++)
+        CdB[hi] = 20 * log10(state->c[hi]);
+    for (hi = 0; hi < THRES_NO && CdB[hi] <= thr; hi++);
+    if (hi == 0 || hi == THRES_NO) {
+        lo = hi = (hi == 0) ? 0 : THRES_NO - 1;
+        w = 0;
+    }
+    else {
+        lo = hi - 1;
+        w = (thr - CdB[lo]) / (CdB[hi] - CdB[lo]);
+    }
+
+    /* Activity of each frame there; none at all in silence */
+    for (i = 0; i < tl->count && i < tl->max; i++) {
+        fr = &tl->frame[i];
+        if (state->ActivityFactor > 0)
+            fr->active = (float) (((1 - w) * fr->a[lo] + w * fr->a[hi]) / fr->n);
+    }
+
+    return tl->count;
+}
+
+#undef MIN_LOG_OFFSET
 #undef THRES_NO
-/* .................... End of speech_voltmeter() ........................ */
+#undef M
+/* .................. End of speech_voltmeter_timeline() .................. */
+
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        long speech_voltmeter_save (SVP56_state *state,
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~  unsigned long long pos,
+                                    unsigned char *blob, long size);
+
+        int speech_voltmeter_restore (SVP56_state *state,
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~~~  unsigned long long *pos,
+                                      const unsigned char *blob, long size);
+
+        int speech_voltmeter_merge (SVP56_state *to, SVP56_state *from);
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Checkpoints of the voltmeter. speech_voltmeter_save() writes all
+        that the voltmeter accumulates (sums, peaks, envelope, activity
+        and hangover counts), with the position `pos' of the caller in
+        its input, to a blob of SVP56_STATE_BYTES bytes: little-endian,
+        doubles as their IEEE bits, versioned and closed by a checksum,
+        so that it can be kept in a file or sent to another machine.
+        speech_voltmeter_restore() brings such a blob back into a state,
+        from which metering goes on exactly as if it had never stopped.
+
+        speech_voltmeter_merge() adds the state `from', of the samples
+        that follow those of `to', to `to'. `from' must have been metered
+        from a fresh voltmeter (init_speech_voltmeter(), at the sampling
+        rate of `to'): all it holds is added, so that a part that went
+        on from a checkpoint of `to' would count the samples of `to'
+        twice; such a part is the whole signal already, and needs no
+        merge. Process 1 of P.56 (count, sum and squared sum) and the
+        peaks merge exactly, in any order. Each part starts with a
+        silent envelope, so that up to a hangover (0.2 s) and a rise
+        time of speech at its start may be counted apart from what a
+        single pass would have. The envelope and hangovers of the merge
+        are those of `from'. active_speech_level() then gives the
+        statistics of the merge.
+
+        Variables:
+        ~~~~~~~~~~
+        Name:         Type:   Use:
+        state          I/O       voltmeter state
+        pos            I/O       position of the caller in its input
+        blob           I/O       checkpoint
+        size            I        bytes in `blob'
+        to             I/O       state of the first samples
+        from            I        state of the samples that follow
+
+        Value returned:
+        ~~~~~~~~~~~~~~~
+        speech_voltmeter_save() returns SVP56_STATE_BYTES, or 0 when
+        `size' is less; speech_voltmeter_restore() returns 0, or -1 when
+        the blob is not a good checkpoint (and then leaves `state' as is);
+        speech_voltmeter_merge() returns 0, or -1 when the sampling rates
+        of `to' and `from' differ (and then leaves `to' as is).
+
+        Prototype:   in sv-p56.h
+        ~~~~~~~~~~
+
+        Log of changes:
+        ~~~~~~~~~~~~~~~
+        19.Oct.26     1.0       Created.
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+#define THRES_NO 15             /* number of thresholds in the speech voltmeter */
+#define SV_MAGIC "SV56"         /* first bytes of a checkpoint */
+
+/* 64-bit fields, little-endian */
+static void sv_put(unsigned char* b, unsigned long long v) {
+    int i;
+
+    for (i = 0; i < 8; i++, v >>= 8)
+        b[i] = (unsigned char) v;
+}
+
+static unsigned long long sv_get(const unsigned char* b) {
+    unsigned long long v = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--)
+        v = (v << 8) | b[i];
+    return v;
+}
+
+static void sv_put_double(unsigned char* b, double x) {
+    unsigned long long v;
+
+    memcpy(&v, &x, 8);
+    sv_put(b, v);
+}
+
+static double sv_get_double(const unsigned char* b) {
+    unsigned long long v = sv_get(b);
+    double x;
+
+    memcpy(&x, &v, 8);
+    return x;
+}
+
+/* FNV-1a of the blob up to its checksum */
+static unsigned long long sv_sum(const unsigned char* b) {
+    unsigned long long h = 0xcbf29ce484222325ull;
+    long i;
+
+    for (i = 0; i < SVP56_STATE_BYTES - 8; i++)
+        h = (h ^ b[i]) * 0x100000001b3ull;
+    return h;
+}
+
+long speech_voltmeter_save(SVP56_state* state, unsigned long long pos, unsigned char* blob, long size) {
+    unsigned char* b = blob;
+    int j;
+
+    if (size < SVP56_STATE_BYTES)
+        return 0;
+
+    /* Magic, version and size, then the caller's position */
+    memcpy(b, SV_MAGIC, 4);
+    sv_put(b + 4, ((unsigned long long) SVP56_STATE_BYTES << 32) | SVP56_STATE_VERSION);
+    sv_put(b + 12, pos);
+    b += 20;
+
+    /* Process 1, peaks and Process 2 */
+    sv_put_double(b, state->f);
+    sv_put(b + 8, state->n);
+    sv_put_double(b + 16, state->s);
+    sv_put_double(b + 24, state->sq);
+    sv_put_double(b + 32, state->max);
+    sv_put_double(b + 40, state->maxP);
+    sv_put_double(b + 48, state->maxN);
+    sv_put_double(b + 56, state->refdB);
+    sv_put_double(b + 64, state->p);
+    sv_put_double(b + 72, state->q);
+    b += 80;
+    for (j = 0; j < THRES_NO; j++, b += 16) {
+        sv_put(b, state->a[j]);
+        sv_put(b + 8, state->hang[j]);
+    }
+
+    sv_put(b, sv_sum(blob));
+    return SVP56_STATE_BYTES;
+}
+
+int speech_voltmeter_restore(SVP56_state* state, unsigned long long* pos, const unsigned char* blob, long size) {
+    const unsigned char* b = blob;
+    int j;
+
+    if (size < SVP56_STATE_BYTES || memcmp(b, SV_MAGIC, 4) != 0 ||
+        sv_get(b + 4) != (((unsigned long long) SVP56_STATE_BYTES << 32) | SVP56_STATE_VERSION) ||
+        sv_get(b + SVP56_STATE_BYTES - 8) != sv_sum(blob) || !(sv_get_double(b + 20) > 0))
+        return -1;
+    *pos = sv_get(b + 12);
+    b += 20;
+
+    /* Thresholds and the rest as at initialization, then the accumulations */
+    init_speech_voltmeter(state, sv_get_double(b));
+    state->n = sv_get(b + 8);
+    state->s = sv_get_double(b + 16);
+    state->sq = sv_get_double(b + 24);
+    state->max = sv_get_double(b + 32);
+    state->maxP = sv_get_double(b + 40);
+    state->maxN = sv_get_double(b + 48);
+    state->refdB = sv_get_double(b + 56);
+    state->p = sv_get_double(b + 64);
+    state->q = sv_get_double(b + 72);
+    b += 80;
+    for (j = 0; j < THRES_NO; j++, b += 16) {
+        state->a[j] = sv_get(b);
+        state->hang[j] = sv_get(b + 8);
+    }
+    return 0;
+}
+
+int speech_voltmeter_merge(SVP56_state* to, SVP56_state* from) {
+    int j;
+
+    /* The thresholds and the envelope are those of one rate */
+    if (to->f != from->f)
+        return -1;
+
+    /* Process 1 and the peaks */
+    to->n += from->n;
+    to->s += from->s;
+    to->sq += from->sq;
+    to->max = (from->max > to->max) ? from->max : to->max;
+    to->maxP = (from->maxP > to->maxP) ? from->maxP : to->maxP;
+    to->maxN = (from->maxN < to->maxN) ? from->maxN : to->maxN;
+
+    /* Process 2: the counts add up, the envelope goes on from `from' */
+    for (j = 0; j < THRES_NO; j++) {
+        to->a[j] += from->a[j];
+        to->hang[j] = from->hang[j];
+    }
+    to->p = from->p;
+    to->q = from->q;
+    return 0;
+}
+
+#undef SV_MAGIC
+#undef THRES_NO
+/* ................... End of speech_voltmeter_save() ................... */
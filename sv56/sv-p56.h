@@ -1,6 +1,6 @@
 /*
   ============================================================================
-   File: SV-P56.H                                             01.SEP.1995 v2.2
+   File: SV-P56.H                                            19.OCT.2026 v2.11
   ============================================================================
 
                       UGST/ITU-T SPEECH VOLTMETER MODULE
@@ -23,6 +23,13 @@
                         <tdsimao@venus.cpqd.ansp.br>
    01.Sep.95    v2.2    Updated version number to match sv-p56.c and added
                         smart prototypes <simao@ctd.comsat.com>
+  19.Oct.26    v2.4    Prototypes of active_speech_level(),
+                       speech_voltmeter_thresholds() and
+                       speech_voltmeter_int().
+  19.Oct.26    v2.6    64-bit sample and activity counts (SVP56_count).
+  19.Oct.26    v2.7    Per-frame timeline (SVP56_frame, SVP56_timeline).
+  19.Oct.26    v2.8    Checkpoints of the state (SVP56_STATE_BYTES).
+  19.Oct.26    v2.11   speech_voltmeter_merge() returns an error code.
 
   ============================================================================
 */
@@ -38,13 +45,17 @@
 #endif
 #endif
 
+/* Sample and activity counts: 64 bits, so that hours of audio at high
+   sampling rates don't wrap where long is 32 bits */
+typedef unsigned long long SVP56_count;
+
 /* State for speech voltmeter function */
 typedef struct {
     float f;                      /* sampling frequency, in Hz */
-    unsigned long a[15];          /* activity count */
+    SVP56_count a[15];            /* activity count */
     double c[15];                 /* threshold level; 15 is the no.of thres. */
-    unsigned long hang[15];       /* hangover count */
-    unsigned long n;              /* number of samples read since last reset */
+    SVP56_count hang[15];         /* hangover count */
+    SVP56_count n;                /* number of samples read since last reset */
     double s;                     /* sum of all samples since last reset */
     double sq;                    /* squared sum of samples since last reset */
     double p;                     /* intermediate quantities */
@@ -61,10 +72,46 @@ typedef struct {
     double Gain;                  /* equalization factor to be used in the output file */
 } SVP56_state;
 
+/* Checkpoint of a state, by speech_voltmeter_save() */
+#define SVP56_STATE_VERSION 1
+#define SVP56_STATE_BYTES   348
+
+/* One frame of the timeline of speech_voltmeter_timeline() */
+typedef struct {
+    float envdB;                  /* envelope q at the end of the frame, in dBov */
+    float rmsdB;                  /* rms level of the frame, in dBov */
+    float peakdB;                 /* largest absolute sample of the frame, in dBov */
+    float active;                 /* fraction active at the final threshold, by
+                                   * speech_timeline_end(); >= 0.5: active frame */
+    unsigned short n;             /* samples in the frame */
+    unsigned short a[15];         /* active samples at each threshold */
+} SVP56_frame;
+
+/* State of a timeline, frames stored in the caller's buffer */
+typedef struct {
+    SVP56_frame* frame;           /* caller's buffer */
+    long max;                     /* frames in the buffer */
+    long count;                   /* frames so far, stored or not */
+    long len;                     /* samples per frame */
+    long fill;                    /* samples in the current frame */
+    double sq;                    /* squared sum at the start of the frame */
+    double peak;                  /* peak of the current frame */
+    SVP56_count a[15];            /* activity counts at the start of the frame */
+} SVP56_timeline;
+
 /* Speech voltmeter prototypes */
 double bin_interp ARGS((double upcount, double lwcount, double upthr, double lwthr, double Margin, double tol));
 void init_speech_voltmeter ARGS((SVP56_state* state, double sampl_freq));
 double speech_voltmeter ARGS((float* buffer, long smpno, SVP56_state* state));
+double active_speech_level ARGS((SVP56_state* state));
+void speech_voltmeter_thresholds ARGS((SVP56_count* a, SVP56_count* hang, long stride, double* c, long I, double* q, long qstride, long nq));
+double speech_voltmeter_int ARGS((void* buffer, long smpno, int bits, SVP56_state* state));
+void init_speech_timeline ARGS((SVP56_timeline* tl, SVP56_state* state, long len, SVP56_frame* frame, long max));
+double speech_voltmeter_timeline ARGS((void* buffer, long smpno, int bits, SVP56_state* state, SVP56_timeline* tl));
+long speech_timeline_end ARGS((SVP56_timeline* tl, SVP56_state* state));
+long speech_voltmeter_save ARGS((SVP56_state* state, unsigned long long pos, unsigned char* blob, long size));
+int speech_voltmeter_restore ARGS((SVP56_state* state, unsigned long long* pos, const unsigned char* blob, long size));
+int speech_voltmeter_merge ARGS((SVP56_state* to, SVP56_state* from));
 
 
 /* Definitions for getting statistics from a `SVP56_state' variable */
@@ -0,0 +1,504 @@
+/*                                                             v1.4 19.OCT.26
+=============================================================================
+
+                          U    U   GGG    SSSS  TTTTT
+                          U    U  G       S       T
+                          U    U  G  GG   SSSS    T
+                          U    U  G   G       S   T
+                           UUU     GG     SSS     T
+
+                   ========================================
+                    ITU-T - USER'S GROUP ON SOFTWARE TOOLS
+                   ========================================
+
+       =============================================================
+       COPYRIGHT NOTE: This source code, and all of its derivations,
+       is subject to the "ITU-T General Public License". Please have
+       it  read  in    the  distribution  disk,   or  in  the  ITU-T
+       Recommendation G.191 on "SOFTWARE TOOLS FOR SPEECH AND  AUDIO
+       CODING STANDARDS".
+       =============================================================
+
+
+MODULE:         SV-P56M.C, MULTI-CHANNEL ACTIVE LEVEL CALCULATIONS
+
+DATE:           19/Oct/2026
+
+RELEASE:        1.40
+
+PROTOTYPES:     see sv-p56m.h.
+
+FUNCTIONS:
+
+init_speech_voltmeter_multi ... allocation and initialization of the state
+                                variables of a SVP56_multi_state.
+
+free_speech_voltmeter_multi ... release of the memory of a SVP56_multi_state.
+
+speech_voltmeter_multi ........ P.56 measurement of interleaved data of
+                                several channels, in a single pass.
+
+speech_voltmeter_batch ........ P.56 measurement of many independent
+                                streams, one block per stream and call.
+
+speech_voltmeter_lane ......... per-channel (or mix) statistics, returned in
+                                a SVP56_state.
+
+HISTORY:
+
+   19.Oct.26 v1.0 Release of 1st version. The arithmetic of each lane is
+                  the same as speech_voltmeter()'s, so that every channel
+                  gives the very same counts as a separate mono
+                  measurement, but the state is kept as a structure of
+                  arrays and all channels are advanced by branch-free
+                  loops over contiguous memory, which the compiler
+                  vectorizes across channels.
+   19.Oct.26 v1.1 Added speech_voltmeter_batch() for many independent
+                  streams: envelopes of 8 streams at a time (SSE2 where
+                  available), and thresholds applied through the
+                  running maximum of the number of thresholds reached,
+                  instead of 15 counters per sample.
+   19.Oct.26 v1.2 Threshold pass moved to sv-p56.c as
+                  speech_voltmeter_thresholds(), shared with
+                  speech_voltmeter_int(). Lane loops of
+                  speech_voltmeter_multi() split so that they vectorize.
+   19.Oct.26 v1.3 Counts are SVP56_count, 64-bit like those of
+                  SVP56_state.
+   19.Oct.26 v1.4 Voltmeter time and samples counted (svstats.h).
+
+=============================================================================
+*/
+
+/*
+ * .................... INCLUDES ....................
+ */
+#include <stdlib.h>
+#include <math.h>
+
+#include "sv-p56m.h"
+#include "svstats.h"
+
+/* SSE2 is part of every x86-64 target; other targets use plain C */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SV_BATCH_SSE2
+#endif
+
+/*
+ * .................... FUNCTIONS ....................
+ */
+
+#define T        0.03           /* in [s] */
+#define H        0.20           /* in [s] */
+#define THRES_NO 15             /* number of thresholds in the speech voltmeter */
+#define SV_BATCH_TILE 8         /* streams advanced together by the batch voltmeter */
+#define SV_BATCH_SPAN 256       /* samples of envelope kept per batch pass */
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        int init_speech_voltmeter_multi (SVP56_multi_state *state,
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  double sampl_freq, long nch, int mix);
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Allocates and initializes the state variables of a structure
+        of type SVP56_multi_state, for use by speech_voltmeter_multi().
+        When `mix' is non-zero, one extra lane measures the average of
+        all channels.
+
+        Variables:
+        ~~~~~~~~~~
+        Name:         Type:   Use:
+        state          I/O       state to be initialized
+        sampl_freq      I        input signal's sampling frequency
+        nch             I        number of interleaved channels
+        mix             I        also measure the average of the channels
+
+        Value returned:
+        ~~~~~~~~~~~~~~~
+        0 on success, -1 if the memory could not be allocated.
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+int init_speech_voltmeter_multi(SVP56_multi_state* state, double sampl_freq, long nch, int mix) {
+    double x;
+    long j, l, lanes;
+
+    lanes = nch + (mix ? 1 : 0);
+    state->nch = nch;
+    state->lanes = lanes;
+
+    /* First initializations, as in init_speech_voltmeter() */
+    state->f = (float) sampl_freq;
+    state->I = (long) floor(H * state->f + 0.5);
+    state->g = exp(-1.0 / (state->f * T));
+
+    for (x = 0.5, j = 1; j <= THRES_NO; j++, x /= 2.0)
+        state->c[THRES_NO - j] = x;
+
+    /* One block for the threshold-major counts, one for the per-lane values */
+    state->a = (SVP56_count*) calloc(2 * THRES_NO * lanes, sizeof(SVP56_count));
+    state->s = (double*) calloc(8 * lanes, sizeof(double));
+    if (state->a == NULL || state->s == NULL) {
+        free(state->a);
+        free(state->s);
+        state->a = NULL;
+        state->s = NULL;
+        return -1;
+    }
+    state->hang = state->a + THRES_NO * lanes;
+    state->sq = state->s + lanes;
+    state->p = state->s + 2 * lanes;
+    state->q = state->s + 3 * lanes;
+    state->max = state->s + 4 * lanes;
+    state->maxP = state->s + 5 * lanes;
+    state->maxN = state->s + 6 * lanes;
+    state->x = state->s + 7 * lanes;
+
+    for (j = 0; j < THRES_NO * lanes; j++)
+        state->hang[j] = state->I;
+
+    for (l = 0; l < lanes; l++) {
+        state->maxP[l] = -32768.;
+        state->maxN[l] = 32767.;
+    }
+    state->n = 0;
+
+    return 0;
+}
+
+/* ............... End of init_speech_voltmeter_multi() ................. */
+
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        void free_speech_voltmeter_multi (SVP56_multi_state *state);
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Releases the memory allocated by init_speech_voltmeter_multi().
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+void free_speech_voltmeter_multi(SVP56_multi_state* state) {
+    free(state->a);
+    free(state->s);
+    state->a = state->hang = NULL;
+    state->s = state->sq = state->p = state->q = NULL;
+    state->max = state->maxP = state->maxN = state->x = NULL;
+}
+
+/* ............... End of free_speech_voltmeter_multi() ................. */
+
+
+/*
+  Advances lanes `lo'..`hi'-1 by the sample period held in state->x:
+  peaks, Process 1 and Process 2 of P.56 and the activity counts.
+*/
+static void advance_lanes(SVP56_multi_state* state, long lo, long hi) {
+    long l, j;
+    long lanes = state->lanes;
+    SVP56_count I = (SVP56_count) state->I;
+    double g = state->g, x, ax;
+    double* xs = state->x;
+    double* s = state->s, * sq = state->sq, * p = state->p, * q = state->q;
+    double* mx = state->max, * maxP = state->maxP, * maxN = state->maxN;
+
+    /*
+     * One loop per group of arrays: the compiler has to check every
+     * pair of them for overlap before vectorizing, and gives up when
+     * a single loop touches all of them.
+     */
+    for (l = lo; l < hi; l++) {
+        x = xs[l];
+        ax = (x > 0) ? x : -x;
+        mx[l] = (ax > mx[l]) ? ax : mx[l];
+        maxP[l] = (x > maxP[l]) ? x : maxP[l];
+        maxN[l] = (x < maxN[l]) ? x : maxN[l];
+    }
+
+    for (l = lo; l < hi; l++) {
+        x = xs[l];
+        sq[l] += x * x;
+        s[l] += x;
+    }
+
+    for (l = lo; l < hi; l++) {
+        x = xs[l];
+        ax = (x > 0) ? x : -x;
+        p[l] = g * p[l] + (1 - g) * ax;
+        q[l] = g * q[l] + (1 - g) * p[l];
+    }
+
+    /* Applies the thresholds to the envelopes, without branches */
+    for (j = 0; j < THRES_NO; j++) {
+        SVP56_count* aj = state->a + j * lanes;
+        SVP56_count* hj = state->hang + j * lanes;
+        double cj = state->c[j];
+
+        for (l = lo; l < hi; l++) {
+            SVP56_count active = q[l] >= cj;
+            SVP56_count held = hj[l] < I;
+
+            aj[l] += active | held;
+            hj[l] = active ? 0 : hj[l] + held;
+        }
+    }
+}
+
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        void speech_voltmeter_multi (float *buffer, long nframes,
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~~  SVP56_multi_state *state);
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Runs Process 1 and Process 2 of P.56 over `nframes' sample
+        periods of `state->nch' interleaved channels in `buffer', in the
+        normalized range -1.0 .. 1.0. The statistics of each lane are
+        obtained afterwards with speech_voltmeter_lane().
+
+        Variables:
+        ~~~~~~~~~~
+        Name:         Type:   Use:
+        buffer          I        interleaved input samples
+        nframes         I        number of sample periods in `buffer'
+        state          I/O       state variable associated with `buffer'
+
+        Value returned:
+        ~~~~~~~~~~~~~~~
+        None.
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+void speech_voltmeter_multi(float* buffer, long nframes, SVP56_multi_state* state) {
+    long k, l;
+    long nch = state->nch, lanes = state->lanes;
+    double mix;
+    double* xs = state->x;
+
+    SV_STAGE_ENTER(SV_STAGE_VOLTMETER);
+    for (k = 0; k < nframes; k++, buffer += nch) {
+        /* Gathers one sample period; the extra lane is the channel average */
+        for (l = 0; l < nch; l++)
+            xs[l] = (double)buffer[l];
+        if (lanes > nch) {
+            for (mix = 0, l = 0; l < nch; l++)
+                mix += xs[l];
+            xs[nch] = mix / nch;
+        }
+
+        advance_lanes(state, 0, lanes);
+    }
+
+    state->n += nframes;
+    SV_COUNT(SV_COUNT_SAMPLES, nframes * nch);
+    SV_STAGE_LEAVE();
+}
+
+/* .................. End of speech_voltmeter_multi() .................... */
+
+
+/*
+  Envelope pass of the batch voltmeter: peaks, sums, Process 1 and
+  Process 2 of P.56 for one tile of streams over `nk' samples, keeping
+  q of every sample in `qs' for the threshold pass. `v' holds, tile by
+  tile, x, p, q, s, sq, max, maxP and maxN.
+*/
+static void batch_envelope(double v[8][SV_BATCH_TILE], double qs[][SV_BATCH_TILE],
+                           float** buffers, long k0, long nk, long nl, double g) {
+    long k, l;
+#ifdef SV_BATCH_SSE2
+    __m128d x, ax, p, q, s, sq, mx, maxP, maxN;
+    __m128d vg = _mm_set1_pd(g), vh = _mm_set1_pd(1 - g), sign = _mm_set1_pd(-0.0);
+#else
+    double x, ax;
+#endif
+
+    for (k = 0; k < nk; k++) {
+        for (l = 0; l < nl; l++)
+            v[0][l] = (double)buffers[l][k0 + k];
+
+#ifdef SV_BATCH_SSE2
+        for (l = 0; l < SV_BATCH_TILE; l += 2) {
+            x = _mm_loadu_pd(&v[0][l]);
+            ax = _mm_andnot_pd(sign, x);
+            mx = _mm_max_pd(ax, _mm_loadu_pd(&v[5][l]));
+            maxP = _mm_max_pd(x, _mm_loadu_pd(&v[6][l]));
+            maxN = _mm_min_pd(x, _mm_loadu_pd(&v[7][l]));
+
+            sq = _mm_add_pd(_mm_loadu_pd(&v[4][l]), _mm_mul_pd(x, x));
+            s = _mm_add_pd(_mm_loadu_pd(&v[3][l]), x);
+
+            p = _mm_add_pd(_mm_mul_pd(vg, _mm_loadu_pd(&v[1][l])), _mm_mul_pd(vh, ax));
+            q = _mm_add_pd(_mm_mul_pd(vg, _mm_loadu_pd(&v[2][l])), _mm_mul_pd(vh, p));
+
+            _mm_storeu_pd(&v[1][l], p);
+            _mm_storeu_pd(&v[2][l], q);
+            _mm_storeu_pd(&v[3][l], s);
+            _mm_storeu_pd(&v[4][l], sq);
+            _mm_storeu_pd(&v[5][l], mx);
+            _mm_storeu_pd(&v[6][l], maxP);
+            _mm_storeu_pd(&v[7][l], maxN);
+            _mm_storeu_pd(&qs[k][l], q);
+        }
+#else
+        for (l = 0; l < SV_BATCH_TILE; l++) {
+            x = v[0][l];
+            ax = (x > 0) ? x : -x;
+            v[5][l] = (ax > v[5][l]) ? ax : v[5][l];
+            v[6][l] = (x > v[6][l]) ? x : v[6][l];
+            v[7][l] = (x < v[7][l]) ? x : v[7][l];
+
+            v[4][l] += x * x;
+            v[3][l] += x;
+
+            v[1][l] = g * v[1][l] + (1 - g) * ax;
+            v[2][l] = g * v[2][l] + (1 - g) * v[1][l];
+            qs[k][l] = v[2][l];
+        }
+#endif
+    }
+}
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        void speech_voltmeter_batch (float **buffers, long smpno,
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~~  SVP56_multi_state *state);
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Advances `state->lanes' independent streams (e.g. call legs) by
+        one block of `smpno' samples each, stream `l' being read from
+        `buffers[l]'. The state must have been initialized with
+        init_speech_voltmeter_multi() with `mix' = 0 and one channel per
+        stream. Streams are processed in tiles of SV_BATCH_TILE: the
+        envelopes of a tile are computed together (with SSE2 where
+        available) over up to SV_BATCH_SPAN samples, then the
+        thresholds are applied to each stream over that span.
+
+        Variables:
+        ~~~~~~~~~~
+        Name:         Type:   Use:
+        buffers         I        one block of normalized samples per stream
+        smpno           I        number of samples in every block
+        state          I/O       state variable of all streams
+
+        Value returned:
+        ~~~~~~~~~~~~~~~
+        None.
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+void speech_voltmeter_batch(float** buffers, long smpno, SVP56_multi_state* state) {
+    long k0, nk, l, lo, nl, i;
+    long lanes = state->lanes;
+    double v[8][SV_BATCH_TILE];
+    double qs[SV_BATCH_SPAN][SV_BATCH_TILE];
+    double* lane[8];
+
+    lane[0] = state->x;
+    lane[1] = state->p;
+    lane[2] = state->q;
+    lane[3] = state->s;
+    lane[4] = state->sq;
+    lane[5] = state->max;
+    lane[6] = state->maxP;
+    lane[7] = state->maxN;
+
+    SV_STAGE_ENTER(SV_STAGE_VOLTMETER);
+    for (lo = 0; lo < lanes; lo += SV_BATCH_TILE) {
+        nl = (lanes - lo < SV_BATCH_TILE) ? lanes - lo : SV_BATCH_TILE;
+
+        /* Loads the tile; lanes past the last stream run on silence */
+        for (i = 0; i < 8; i++)
+            for (l = 0; l < SV_BATCH_TILE; l++)
+                v[i][l] = (l < nl) ? lane[i][lo + l] : 0;
+
+        for (k0 = 0; k0 < smpno; k0 += SV_BATCH_SPAN) {
+            nk = (smpno - k0 < SV_BATCH_SPAN) ? smpno - k0 : SV_BATCH_SPAN;
+
+            batch_envelope(v, qs, buffers + lo, k0, nk, nl, state->g);
+
+            for (l = 0; l < nl; l++)
+                speech_voltmeter_thresholds(state->a + lo + l, state->hang + lo + l, lanes,
+                                            state->c, state->I, &qs[0][l], SV_BATCH_TILE, nk);
+        }
+
+        for (i = 0; i < 8; i++)
+            for (l = 0; l < nl; l++)
+                lane[i][lo + l] = v[i][l];
+    }
+
+    state->n += smpno;
+    SV_COUNT(SV_COUNT_SAMPLES, smpno * lanes);
+    SV_STAGE_LEAVE();
+}
+
+/* .................. End of speech_voltmeter_batch() .................... */
+
+
+/*
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+        double speech_voltmeter_lane (SVP56_multi_state *state, long lane,
+        ~~~~~~~~~~~~~~~~~~~~~~~~~~~~  SVP56_state *lane_state);
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Copies the accumulations of one lane (channel, or the mix at
+        lane `state->nch') into a SVP56_state and computes its
+        statistics with active_speech_level().
+
+        Variables:
+        ~~~~~~~~~~
+        Name:         Type:   Use:
+        state           I        multi-channel state
+        lane            I        lane whose statistics are wanted
+        lane_state      O        single-channel state for that lane
+
+        Value returned:
+        ~~~~~~~~~~~~~~~
+        Returns the active speech level of the lane, in dBov.
+
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+*/
+double speech_voltmeter_lane(SVP56_multi_state* state, long lane, SVP56_state* lane_state) {
+    long j;
+
+    lane_state->f = state->f;
+    for (j = 0; j < THRES_NO; j++) {
+        lane_state->a[j] = state->a[j * state->lanes + lane];
+        lane_state->hang[j] = state->hang[j * state->lanes + lane];
+        lane_state->c[j] = state->c[j];
+    }
+    lane_state->n = state->n;
+    lane_state->s = state->s[lane];
+    lane_state->sq = state->sq[lane];
+    lane_state->p = state->p[lane];
+    lane_state->q = state->q[lane];
+    lane_state->max = state->max[lane];
+    lane_state->maxP = state->maxP[lane];
+    lane_state->maxN = state->maxN[lane];
+    lane_state->refdB = 0 /* dBov */;
+
+    return active_speech_level(lane_state);
+}
+
+#undef SV_BATCH_SPAN
+#undef SV_BATCH_TILE
+#undef THRES_NO
+#undef H
+#undef T
+/* ................... End of speech_voltmeter_lane() ..................... */
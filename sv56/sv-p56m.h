@@ -0,0 +1,66 @@
+/*
+  ============================================================================
+   File: SV-P56M.H                                            19.Oct.26 v1.3
+  ============================================================================
+
+                  UGST/ITU-T MULTI-CHANNEL SPEECH VOLTMETER MODULE
+
+                          GLOBAL FUNCTION PROTOTYPES
+
+   History:
+   19.Oct.26    v1.0    First version, structure-of-arrays state for
+                        measuring interleaved channels in a single pass.
+   19.Oct.26    v1.1    Batch voltmeter for many independent streams.
+   19.Oct.26    v1.3    64-bit counts, as in SVP56_state.
+
+  ============================================================================
+*/
+#ifndef SPEECH_VOLTMETER_MULTI_defined
+#define SPEECH_VOLTMETER_MULTI_defined 100
+
+#include "sv-p56.h"
+
+/*
+ * State for the multi-channel speech voltmeter. Every per-channel
+ * quantity is kept in its own array indexed by lane, so that one
+ * sample period of all lanes is updated by loops over contiguous
+ * memory. The activity and hangover counts are threshold-major:
+ * a[j * lanes + l] is the count of threshold j for lane l.
+ */
+typedef struct {
+    float f;                      /* sampling frequency, in Hz */
+    long nch;                     /* number of input channels, or of streams */
+    long lanes;                   /* nch, plus one if the mix is measured */
+    long I;                       /* hangover, in samples */
+    double g;                     /* coefficient of smoothing */
+    double c[15];                 /* threshold level; 15 is the no.of thres. */
+    SVP56_count n;                /* number of frames read since last reset */
+    SVP56_count* a;               /* activity count [15 * lanes] */
+    SVP56_count* hang;            /* hangover count [15 * lanes] */
+    double* s;                    /* sum of all samples [lanes] */
+    double* sq;                   /* squared sum of samples [lanes] */
+    double* p;                    /* intermediate quantities [lanes] */
+    double* q;                    /* envelope [lanes] */
+    double* max;                  /* max absolute value [lanes] */
+    double* maxP;                 /* maximum positive value [lanes] */
+    double* maxN;                 /* maximum negative value [lanes] */
+    double* x;                    /* current sample of every lane [lanes] */
+} SVP56_multi_state;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Multi-channel speech voltmeter prototypes */
+int init_speech_voltmeter_multi ARGS((SVP56_multi_state* state, double sampl_freq, long nch, int mix));
+void free_speech_voltmeter_multi ARGS((SVP56_multi_state* state));
+void speech_voltmeter_multi ARGS((float* buffer, long nframes, SVP56_multi_state* state));
+void speech_voltmeter_batch ARGS((float** buffers, long smpno, SVP56_multi_state* state));
+double speech_voltmeter_lane ARGS((SVP56_multi_state* state, long lane, SVP56_state* lane_state));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPEECH_VOLTMETER_MULTI_defined */
+/* ........................ End of SV-P56M.H .......................... */
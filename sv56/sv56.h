@@ -2,12 +2,13 @@
 #define __SV56_H__
 
 #include "sv-p56.h"
+#include "wavfile.h"
 #include <stdio.h>
 
 typedef struct wav_header {
     // RIFF Header
     unsigned char riff_header[4];   // Contains "RIFF"
-    int wav_size;                   // Size of the wav portion of the file, which follows the first 8 bytes. File size - 8
+    long long wav_size;             // Size of the wav portion of the file, which follows the first 8 bytes. File size - 8
     unsigned char wave_header[4];   // Contains "WAVE"
 
     // Format Header
@@ -21,21 +22,66 @@ typedef struct wav_header {
     short bit_depth;                // Number of bits per sample
     // Data
     unsigned char data_header[4];   // Contains "data"
-    int data_bytes;                 // Number of bytes in data. Number of samples * num_channels * sample byte size
+    long long data_bytes;           // Number of bytes in data. Number of samples * num_channels * sample byte size
     // uint8_t bytes[];             // Remainder of wave file is bytes
 } wav_header;
 
 typedef float REAL;
 
+/* Channel mixing applied by ssrc() while decoding the input, ahead of the filters */
+#define SSRC_MIX_NONE       0   /* keep and resample every source channel */
+#define SSRC_MIX_AVERAGE    1   /* average all source channels into one */
+#define SSRC_MIX_SELECT     2   /* keep only source channel `channel' */
+#define SSRC_MIX_MATRIX     3   /* out_channels x source channels weighted matrix */
+
+typedef struct ssrc_mix {
+    int type;                       // one of SSRC_MIX_*
+    int channel;                    // source channel (0-based) for SSRC_MIX_SELECT
+    int out_channels;               // number of output channels for SSRC_MIX_MATRIX
+    int in_channels;                // number of source channels the matrix was built for
+    const double* weights;          // row-major out_channels x in_channels gains for SSRC_MIX_MATRIX
+} ssrc_mix;
+
+/* Format of a headerless input to ssrc_stream() */
+typedef struct ssrc_pcm {
+    int sample_rate;                // in Hz
+    int channels;                   // number of interleaved channels
+    int bits;                       // 8 (unsigned), 16, 24 or 32 (signed, little-endian)
+    int format;                     // WAV_FORMAT_PCM, or WAV_FORMAT_FLOAT with 32 bits
+} ssrc_pcm;
+
+/* Output of ssrc_stream() */
+#define SSRC_OUT_AUTO      -1   /* by the extension of dfn; a wave file for "-" */
+#define SSRC_OUT_RAW        0   /* headerless PCM */
+#define SSRC_OUT_WAV        1   /* wave file, with unknown sizes when dfn can't seek */
+#define SSRC_OUT_FLOAT      2   /* or'ed to the above: 32-bit float samples, without
+                                 * dither; alone, the container is chosen as for AUTO */
+
+/* Offset of the samples, or one of the WAV_HEADER_* codes of wavfile.h */
 int wav_header_read(char* FileIn, wav_header* header);
+int wav_header_check(WAV_file* wf, wav_header* header);
 int ssrc(char* sfn, char* dfn, int dfrq);
+int ssrc_mixed(char* sfn, char* dfn, int dfrq, const ssrc_mix* mix);
+int ssrc_stream(char* sfn, char* dfn, int dfrq, const ssrc_mix* mix, const ssrc_pcm* raw, int out);
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
     int actlevel(char* FileIn, SVP56_state* sv_state);
+    int actlevel_volt(char* FileIn, SVP56_state* sv_state, SVP56_state* volt);
+    int actlevel_multi(char* FileIn, SVP56_state* sv_state, long max_ch, SVP56_state* mixed);
+    int actlevel_index(char* FileIn, long block);
+    int actlevel_range(char* FileIn, unsigned long long start, unsigned long long count, SVP56_state* sv_state);
+    int actlevel_segments(char* FileIn, unsigned long long* start, unsigned long long* end, long nseg, SVP56_state* sv_state);
+    long actlevel_timeline(char* FileIn, double frame_ms, SVP56_frame* frame, long max_frames, SVP56_state* sv_state);
+    int actlevel_resume(char* FileIn, char* FileState, unsigned long long every, SVP56_state* sv_state);
+    int actlevel_merge(char** FileState, long nstate, SVP56_state* sv_state);
+    int actlevel_cache(char* CacheDir);
     int sv56demo(char* FileIn, char* FileOut, double targetdB);
+    int sv56demo_inplace(char* File, double targetdB);
+    int sv56demo_corpus(char** FileIn, char** FileOut, long nfile, double targetdB, int threads,
+                        SVP56_state* sv_state, SVP56_state* corpus);
     double dbesi0(double x);
     void rdft(int, int, REAL *, int *, REAL *);
 #ifdef __cplusplus
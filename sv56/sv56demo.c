@@ -155,6 +155,46 @@
                            a multiple of the block size <simao>.
   02.Feb.10     3.5        Modified maximum string length to avoid
                            buffer overruns (y.hiwasaki)
+  19.Oct.26     3.6        Non-mono and bad wave headers are rejected; the
+                           level is measured with speech_voltmeter_int()
+                           directly on the 16-bit samples.
+  19.Oct.26     3.7        Input read through the memory-mapped reader of
+                           wavfile.c, opened once for both passes.
+  19.Oct.26     3.8        RF64/Wave64 input; sample counts are 64-bit.
+  19.Oct.26     3.9        Input prefetched and output written behind by
+                           I/O threads, see wav_set_pipeline().
+  19.Oct.26     3.10       Streams (stdin, pipes) are refused up front:
+                           equalization reads the input twice.
+  19.Oct.26     3.11       32-bit float wave files are measured and
+                           equalized in float, and written back as float
+                           with no clipping nor truncation.
+  19.Oct.26     3.12       sv56demo_inplace(): equalization in place,
+                           rewriting only the samples, with a journal for
+                           crash safety; sv56demo() goes there when FileOut
+                           is FileIn (or NULL).
+  19.Oct.26     3.13       Equalization of 16-bit samples by sh2sh_scale(),
+                           in one pass, in blocks of 4096 samples.
+  19.Oct.26     3.14       Voltmeter at the sampling rate of the wave
+                           header (16 kHz for *.pcm files).
+  19.Oct.26     3.15       sv56demo() and sv56demo_inplace() traced as
+                           spans, with the file name (svstats.h).
+  19.Oct.26     3.16       sv56demo_corpus(): many files equalized by one
+                           gain, from the active level of all of them,
+                           measured and equalized by worker threads.
+  19.Oct.26     3.17       sv56demo() and sv56demo_inplace() return their
+                           errors (empty input, files that can't be
+                           created or written) instead of calling exit(),
+                           closing the files and removing a partial
+                           output.
+  19.Oct.26     3.18       sv56demo_corpus() refuses files of different
+                           sampling rates.
+  19.Oct.26     3.19       sv56demo_corpus() returns its errors instead of
+                           calling exit(), and leaves no output unless all
+                           the files could be equalized.
+  19.Oct.26     3.20       sv56demo_corpus() refuses an output named as
+                           any input, or as another output, before
+                           reading any file: the outputs removed on an
+                           error could otherwise be inputs.
 
   ============================================================================
 */
@@ -166,6 +206,7 @@
 /* ... Includes in general ... */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>             /* for offsetof() */
 #include <string.h>             /* for strstr() */
 #include <math.h>
 
@@ -182,6 +223,17 @@
 #endif /* MSDOS */
 #endif /* !VMS */
 
+/* ... Includes for the corpus workers ... */
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define CORPUS_THREADS_WIN32
+#elif defined(unix) || defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#include <pthread.h>
+#include <unistd.h>
+#define CORPUS_THREADS_POSIX
+#endif
+
 /* ... Include of speech-voltmeter-related routines ... */
 #include "sv-p56.h"
 
@@ -190,6 +242,9 @@
 
 #include "sv56.h"
 
+/* ... Include of stage timers, counters and trace ... */
+#include "svstats.h"
+
 /* Local definitions */
 #define MIN_LOG_OFFSET 1.0e-20  /* To avoid sigularity with log(0.0) */
 
@@ -397,7 +452,7 @@ void print_p56_long_summary(FILE* out, char* file, SVP56_state state, double al_
 */
 void print_p56_short_summary(FILE* out, char* file, SVP56_state state, double al_dB, double ratio, double gain) {
     /* Report number of samples */
-    fprintf(out, "Samples: %5ld, ", state.n);
+    fprintf(out, "Samples: %5llu, ", state.n);
 
     /* Skip if filesize is zero */
     if (state.n == 0) {
@@ -468,7 +523,7 @@ int main(int argc, char* argv[])
 
     actlevel(FileOut, &sv_state);
     fprintf(stderr, "FIle: \t%s\n", FileOut);
-    fprintf(stderr, "Samples: %5ld\n", sv_state.n);
+    fprintf(stderr, "Samples: %5llu\n", sv_state.n);
     fprintf(stderr, "Min: %5.0f\n", sv_state.maxN);
     fprintf(stderr, "Max: %5.0f\n", sv_state.maxP);
     fprintf(stderr, "DC: %7.2f\n", sv_state.DClevel);
@@ -482,222 +537,870 @@ int main(int argc, char* argv[])
 }
 #endif
 
-int sv56demo(char* FileIn, char* FileOut, double targetdB)
+/* Measures the open input, unless `gain' > 0 gives the factor, and
+   writes the equalized samples to Fo; 0, or -1 after a message */
+static int sv56demo_equalize(WAV_file* wf, FILE* Fo, FILE* out, char* FileIn, char* FileOut,
+                             double targetdB, double gain, long* NrSat)
 {
-    /* DECLARATIONS */
-
     /* Parameters for operation */
     double Overflow;              /* Max.positive value for AD_resolution bits */
-    long N = 256, N1 = 1, N2 = 0, i, l;
+    long N = 256, l;
 
     /* Intermediate storage variables for speech voltmeter */
     SVP56_state state;
 
-    /* File-related variables */
-    FILE* Fi, * Fo;                /* input/output file pointers */
-    FILE* out = stdout;           /* where to print the statistical results */
-#ifdef VMS
-    char mrs[15];
-#endif
-
     /* Other variables */
-    char quiet = 0, use_active_level = 1, long_summary = 1;
+    char use_active_level = 1;
+    WAV_out wo;                   /* output samples, written behind */
+    const void* samples;          /* input samples, in place in the mapping */
     short buffer[4096];
     float Buf[4096];
-    long NrSat = 0, bitno = 16;
-    double sf = 16000, factor;
-    double ActiveLeveldB, DesiredSpeechLeveldB;
-    static char funny[5] = { '/', '-', '\\', '|', '-' };
+    long bitno = 16;
+    double sf = 16000, factor;    /* sf: for *.pcm files */
+    double ActiveLeveldB = -100.0, DesiredSpeechLeveldB;
     static unsigned mask[5] = { 0xFFFF, 0xFFFE, 0xFFFB, 0xFFF8, 0xFFF0 };
+    int err = 0;
+
+    /* Overflow (saturation) point */
+    Overflow = pow((double)2.0, (double)(bitno - 1));
+
+    /* reset variables for speech level measurements, at the rate of the file */
+    init_speech_voltmeter(&state, wav_rate(wf, sf));
+
+    /* ... MEASUREMENT OF ACTIVE SPEECH LEVEL ACCORDING P.56 ... */
+    if (wav_frames_left(wf) == 0) {
+        fprintf(stderr, "%s: no samples\n", FileIn);
+        return -1;
+    }
+
+    /* Reads overlap with the metering and the equalization */
+    wav_prefetch(wf, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+
+    if (gain > 0)
+        factor = gain;
+    else {
+        /* Get the active level, straight from the 16-bit or float samples */
+        while ((l = wav_read(wf, N, &samples)) > 0) {
+            if (wf->format == WAV_FORMAT_FLOAT)
+                ActiveLeveldB = speech_voltmeter((float*)memcpy(Buf, samples, l * sizeof(float)), l, &state);
+            else
+                ActiveLeveldB = speech_voltmeter_int((void*)samples, l, 16, &state);
+        }
+
+        /* ... COMPUTE EQUALIZATION FACTOR ... */
+
+        /* Computes the equalization factor to be used in the output file */
+        DesiredSpeechLeveldB = (double)targetdB;
+        if (use_active_level)
+            factor = pow(10.0, (DesiredSpeechLeveldB - ActiveLeveldB) / 20.0);
+        else
+            factor = pow(10.0, (DesiredSpeechLeveldB - SVP56_get_rms_dB(state)) / 20.0);
+
+        /* ... PRINT-OUT OF RESULTS ... */
+        print_p56_short_summary(out, FileIn, state, ActiveLeveldB, Overflow, factor);
+
+        /* Back to the 1st sample */
+        if (wav_rewind(wf) < 0) {
+            perror(FileIn);
+            return -1;
+        }
+    }
+
+    /* EQUALIZATION: hard clipping (with truncation) */
+
+    /* Samples written behind by an I/O thread */
+    wav_out_open(&wo, Fo, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+
+    /* Get data of interest, equalize and de-normalize */
+    while (err == 0 && (l = wav_read(wf, sizeof(buffer) / sizeof(short), &samples)) > 0) {
+        /* float samples are equalized and written as they are */
+        if (wf->format == WAV_FORMAT_FLOAT) {
+            scale((float*)memcpy(Buf, samples, l * sizeof(float)), (long)l, (double)factor);
+            if ((long)wav_out_write(Buf, sizeof(float), l, &wo) != l)
+                err = -1;
+            continue;
+        }
+
+        /* equalize, with hard clip and truncation, in one pass */
+        *NrSat += sh2sh_scale((long)l, (short*)samples, buffer, (double)factor, bitno, mask[16 - bitno]);
 
+        /* write equalized, de-normalized and hard-clipped samples to file */
+        if ((long)wav_out_write(buffer, sizeof(short), l, &wo) != l)
+            err = -1;
+    }
+    if (wav_out_close(&wo) < 0 || err < 0) {
+        perror(FileOut);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * sv56demo(), or, with `gain' > 0, the equalization alone by `gain'
+ * (the input was measured before); the clipped samples go to `clips'.
+ * Errors are returned, never exit(): the files are closed, and an
+ * output that was begun is removed.
+ */
+static int sv56demo_file(char* FileIn, char* FileOut, double targetdB, double gain, long* clips)
+{
+    /* File-related variables */
+    WAV_file wf;                  /* input file, mapped */
+    FILE* Fo;                     /* output file pointer */
+    FILE* out = stdout;           /* where to print the statistical results */
+
+    /* Other variables */
+    long NrSat = 0;
     wav_header header;
     int header_offset = 0;
-    int name_len = 0;
+    int name_len = 0, raw = 0, err;
 
     char FileLog[256] = "log.txt";
 
+    /* Writing over the input is done in place, not through a new file */
+    if (FileOut == NULL || strcmp(FileIn, FileOut) == 0)
+        return sv56demo_inplace(FileIn, targetdB);
+
     if ((out = fopen(FileLog, "at")) == NULL) {
         fprintf(stderr, "log file open error.\n");
         return -1;
     }
 
-    /* ......... SOME INITIALIZATIONS ......... */
+    /* check file extension: *.pcm files have no header */
+    name_len = strlen(FileIn);
+    if (name_len > 4)
+        raw = (strcmp(FileIn + name_len - 4, ".PCM") == 0) || (strcmp(FileIn + name_len - 4, ".pcm") == 0);
 
-    /* Check if is to process the whole file */
-    //if (N2 == 0) {
-    //    struct stat st;
+    /*
+     * ......... FILE PREPARATION .........
+     */
 
-    //    /* ... find the input file size ... */
-    //    stat(FileIn, &st);
-    //    N2 = ceil((st.st_size - start_byte) / (double)(N * sizeof(short)));
-    //}
+    /* Opening input file and reading its wave header, at once */
+    header_offset = wav_open(FileIn, raw, &wf);
+    if (header_offset == 0) {
+        if (raw)
+            header.num_channels = 1;
+        else if ((header_offset = wav_header_check(&wf, &header)) < 0)
+            wav_close(&wf);
+    }
 
-    /* Overflow (saturation) point */
-    Overflow = pow((double)2.0, (double)(bitno - 1));
+    /* Bad header, or an interleaved file: only mono is equalized */
+    if (header_offset < 0) {
+        fclose(out);
+        return header_offset;
+    }
+    if (header.num_channels != 1) {
+        fprintf(stderr, "not MONO channel\n");
+        wav_close(&wf);
+        fclose(out);
+        return WAV_HEADER_NOT_MONO;
+    }
+    if (wf.stream) {
+        fprintf(stderr, "%s: can't read a stream twice\n", FileIn);
+        wav_close(&wf);
+        fclose(out);
+        return WAV_HEADER_NOK;
+    }
 
-    /* reset variables for speech level measurements */
-    init_speech_voltmeter(&state, sf);
+    /* Creates output file, with the same header as the input, then
+       measures and equalizes; chunks after the samples are copied as
+       they are */
+    if ((Fo = fopen(FileOut, WB)) == NULL) {
+        perror(FileOut);
+        err = -1;
+    }
+    else if (header_offset > 0 && wav_copy(&wf, 0, wf.data_offset, Fo) != header_offset) {
+        fprintf(stderr, "%s: error in writing wave header\n", FileOut);
+        err = -1;
+    }
+    else if ((err = sv56demo_equalize(&wf, Fo, out, FileIn, FileOut, targetdB, gain, &NrSat)) == 0 && header_offset > 0)
+        wav_copy(&wf, wf.data_offset + wf.data_bytes, wf.file_size, Fo);
 
-    /* check file extension */
-    /* Read wave header and offset */
-    name_len = strlen(FileIn);
-    if (name_len > 4)
-    {
-        if ((strcmp(FileIn + name_len - 4, ".wav") == 0) || (strcmp(FileIn + name_len - 4, ".WAV") == 0))
-            header_offset = wav_header_read(FileIn, &header);
-        if ((strcmp(FileIn + name_len - 4, ".PCM") == 0) || (strcmp(FileIn + name_len - 4, ".pcm") == 0))
-        {
-            header_offset = 0;
-            struct stat st;
-            stat(FileIn, &st);
-            header.data_bytes = st.st_size;
+    /* Log number of clipped samples */
+    if (NrSat != 0)
+        fprintf(out, "\n  Number of clippings: .......... %7ld []\n", NrSat);
+    if (clips != NULL)
+        *clips = NrSat;
+
+    /* Close files, and remove a partial output */
+    wav_close(&wf);
+    if (Fo != NULL && fclose(Fo) != 0 && err == 0) {
+        perror(FileOut);
+        err = -1;
+    }
+    if (Fo != NULL && err < 0)
+        remove(FileOut);
+    if (out != stdout)
+        fclose(out);
+    return err;
+}
+
+int sv56demo(char* FileIn, char* FileOut, double targetdB)
+{
+    int err;
+
+    SV_TRACE_BEGIN("sv56demo", FileIn);
+    err = sv56demo_file(FileIn, FileOut, targetdB, 0, NULL);
+    SV_TRACE_END();
+    return err;
+}
+
+
+/*
+ * .................... IN-PLACE EQUALIZATION ....................
+ *
+ * The samples are rewritten where they are, one window of INPL_BLOCK
+ * bytes at a time; the header and the chunks after the samples are not
+ * touched. Before a window is changed, its original bytes are saved to
+ * a journal next to the file ("<file>.jnl") and flushed to the disk.
+ * The journal has two slots, written in turn, so that a crash while
+ * writing one leaves the other intact. After a crash, the next run
+ * finds the latest good record, puts its window back as it was, and
+ * goes on from there with the same gain: windows before it are already
+ * equalized, those after it are still original.
+ */
+#define INPL_BLOCK (1L << 20)
+#define INPL_MAGIC "SV56JNL1"
+
+/* A journal record, followed by the `len' original bytes of the window */
+typedef struct {
+    char magic[8];                /* INPL_MAGIC */
+    unsigned long long seq;       /* record number; the highest one wins */
+    unsigned long long file_size; /* of the file being equalized */
+    unsigned long long data_offset, data_bytes; /* of its samples */
+    unsigned long long offset;    /* first byte of the saved window */
+    unsigned long len;            /* bytes saved */
+    int format;                   /* WAV_FORMAT_PCM or WAV_FORMAT_FLOAT */
+    double factor;                /* gain being applied */
+    unsigned long long sum;       /* checksum of the record and the bytes */
+} inpl_record;
+
+/* FNV-1a over the record (without its checksum) and the saved bytes */
+static unsigned long long inpl_sum(const inpl_record* r, const unsigned char* bytes) {
+    unsigned long long h = 0xcbf29ce484222325ull;
+    const unsigned char* p = (const unsigned char*)r;
+    unsigned long i;
+
+    for (i = 0; i < offsetof(inpl_record, sum); i++)
+        h = (h ^ p[i]) * 0x100000001b3ull;
+    for (i = 0; i < r->len; i++)
+        h = (h ^ bytes[i]) * 0x100000001b3ull;
+    return h;
+}
+
+/* Write a record to its slot and wait until it is on the disk */
+static int inpl_write(FILE* fj, inpl_record* r, const unsigned char* bytes) {
+    memcpy(r->magic, INPL_MAGIC, 8);
+    r->sum = inpl_sum(r, bytes);
+    if (fseek(fj, (long)((r->seq & 1) * (sizeof(inpl_record) + INPL_BLOCK)), SEEK_SET) != 0 ||
+        fwrite(r, sizeof(inpl_record), 1, fj) != 1 || fwrite(bytes, 1, r->len, fj) != r->len)
+        return -1;
+    return wav_flush(fj);
+}
+
+/* Latest good record of a journal, into r and bytes; 0 if there is none */
+static int inpl_read(FILE* fj, inpl_record* r, unsigned char* bytes) {
+    inpl_record t;
+    unsigned char* b = (unsigned char*)malloc(INPL_BLOCK);
+    int slot, found = 0;
+
+    for (slot = 0; b != NULL && slot < 2; slot++) {
+        if (fseek(fj, (long)(slot * (sizeof(inpl_record) + INPL_BLOCK)), SEEK_SET) != 0 ||
+            fread(&t, sizeof(inpl_record), 1, fj) != 1 ||
+            memcmp(t.magic, INPL_MAGIC, 8) != 0 || t.len > INPL_BLOCK ||
+            fread(b, 1, t.len, fj) != t.len || inpl_sum(&t, b) != t.sum)
+            continue;
+        if (!found || t.seq > r->seq) {
+            *r = t;
+            memcpy(bytes, b, t.len);
+            found = 1;
         }
     }
+    free(b);
+    return found;
+}
 
-    /*
-     * ......... FILE PREPARATION .........
-     */
 
-     /* Opening input file; abort if there's any problem */
-#ifdef VMS
-    sprintf(mrs, "mrs=%d", 2 * N);
-#endif
-    if ((Fi = fopen(FileIn, RB)) == NULL)
-        KILL(FileIn, 2);
-
-    /* Creates output file */
-    if ((Fo = fopen(FileOut, WB)) == NULL)
-        KILL(FileOut, 3);
-    if (header_offset > 0) {
-        if ((l = fread(buffer, sizeof(char), header_offset, Fi)) != header_offset) {
-            fprintf(out, "Error in reading wave header.\n");
-            return -1;
+/*
+  ============================================================================
+
+       int sv56demo_inplace (char *File, double targetdB);
+       ~~~~~~~~~~~~~~~~~~~~
+
+       Equalize a file to `targetdB' dBov like sv56demo(), but in place:
+       only the samples of the data chunk are rewritten, through a
+       writable mapping, so that no second copy of the file is made.
+       The headers and the chunks after the samples are left untouched.
+
+       The run is crash-safe: each window is saved to "<File>.jnl"
+       before it is changed, and a run that finds such a journal
+       completes the interrupted one, with its gain, instead of
+       measuring the half-equalized file again. The journal is removed
+       once all samples are on the disk.
+
+       Parameter:
+       ~~~~~~~~~~
+       File ..... wave (or headerless *.pcm) file, 16-bit or float mono
+       targetdB . active speech level wanted, in dBov
+
+       Returns
+       ~~~~~~~
+       0 on success, or a WAV_HEADER_* error code, or -1 when the file
+       has no samples or can't be rewritten; the journal is then kept,
+       for the next run to finish the equalization.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.1	Traced.
+       19.Oct.26	v1.2	Errors returned instead of exit().
+
+  ============================================================================
+*/
+/* Rewrites the samples from the window of `rec' on, with its gain,
+   putting `saved' back first when resuming; 0, or -1 after a message,
+   with the journal kept for the next run to finish this one */
+static int inpl_rewrite(char* File, char* FileJnl, inpl_record* rec, unsigned char* saved, int resume,
+                        int size, long* NrSat)
+{
+    WAV_rw rw;                    /* the file, rewritten in place */
+    FILE* fj;                     /* journal */
+    unsigned char* p;
+    float Buf[4096];
+    long bitno = 16, i, n, k;
+    static unsigned mask[5] = { 0xFFFF, 0xFFFE, 0xFFFB, 0xFFF8, 0xFFF0 };
+    unsigned long long off, end;
+    int err = 0;
+
+    if (wav_rw_open(&rw, File) < 0) {
+        perror(File);
+        return -1;
+    }
+    if ((fj = fopen(FileJnl, resume ? "r+b" : "w+b")) == NULL) {
+        perror(FileJnl);
+        wav_rw_close(&rw);
+        return -1;
+    }
+
+    /* Put the window being rewritten at the crash back as it was */
+    if (resume) {
+        if ((p = wav_rw_map(&rw, rec->offset, rec->len)) == NULL)
+            err = -1;
+        else {
+            memcpy(p, saved, rec->len);
+            err = wav_rw_sync(&rw) < 0 ? -1 : 0;
         }
-        if ((l = fwrite(buffer, sizeof(char), header_offset, Fo)) != header_offset) {
-            fprintf(out, "Error in writing wave header.\n");
-            return -1;
+        if (err < 0)
+            perror(File);
+    }
+
+    end = rec->data_offset + rec->data_bytes;
+    for (off = rec->offset; err == 0 && off < end; off += n * size) {
+        n = (long)((end - off < INPL_BLOCK ? end - off : INPL_BLOCK) / size);
+        if (n == 0)
+            break;
+        if ((p = wav_rw_map(&rw, off, n * size)) == NULL) {
+            perror(File);
+            err = -1;
+            break;
+        }
+
+        /* Journal first, then the samples */
+        rec->seq++;
+        rec->offset = off;
+        rec->len = n * size;
+        if (inpl_write(fj, rec, p) < 0) {
+            perror(FileJnl);
+            err = -1;
+            break;
+        }
+
+        if (size == sizeof(float)) {
+            for (i = 0; i < n; i += k) {
+                k = n - i < 4096 ? n - i : 4096;
+                memcpy(Buf, p + i * size, k * size);
+                scale(Buf, k, rec->factor);
+                memcpy(p + i * size, Buf, k * size);
+            }
+        }
+        else
+            *NrSat += sh2sh_scale(n, (short*)p, (short*)p, rec->factor, bitno, mask[16 - bitno]);
+        if (wav_rw_sync(&rw) < 0) {
+            perror(File);
+            err = -1;
         }
     }
 
-    /* Initialize number of blocks to all samples */
-    N2 = (long) ceil(header.data_bytes / (double)(N * sizeof(short)));
+    /* All samples are on the disk, or none was changed: the journal is
+       no longer needed */
+    wav_rw_close(&rw);
+    fclose(fj);
+    if (err == 0 || rec->seq == 0)
+        remove(FileJnl);
+    return err;
+}
 
-    /* Move pointer to 1st block of interest */
-    //if (fseek(Fi, start_byte, 0) < 0l)
-    //    KILL(FileIn, 4);
+static int inpl_run(char* File, double targetdB)
+{
+    long N = 256, l;
+    SVP56_state state;
+    WAV_file wf;                  /* input file, mapped read-only to meter */
+    FILE* fj;                     /* journal */
+    FILE* out;                    /* log */
+    inpl_record rec;
+    const void* samples;
+    unsigned char* saved;
+    char* FileJnl;
+    float Buf[4096];
+    long NrSat = 0, bitno = 16;
+    double sf = 16000, factor, Overflow; /* sf: for *.pcm files */
+    double ActiveLeveldB = -100.0;
+    wav_header header;
+    int header_offset, name_len, raw = 0, resume = 0, size, err = 0;
+
+    if ((out = fopen("log.txt", "at")) == NULL) {
+        fprintf(stderr, "log file open error.\n");
+        return -1;
+    }
 
+    Overflow = pow((double)2.0, (double)(bitno - 1));
 
-    /* ... MEASUREMENT OF ACTIVE SPEECH LEVEL ACCORDING P.56 ... */
-    int total_samples = header.data_bytes / 2;
-    int no_samples = 0;
-
-    /* Process selected blocks */
-    for (i = 0; i < (N2 - 1); i++) {
-        /* Read samples ... */
-        if ((l = fread(buffer, sizeof(short), N, Fi)) > 0) {
-            /* ... Convert samples to float */
-            sh2fl((long)l, buffer, Buf, bitno, 1);
-
-            /* ... Get the active level */
-            ActiveLeveldB = speech_voltmeter(Buf, (long)l, &state);
-            //total_samples -= l;
-            no_samples += l;
+    /* *.pcm files have no header */
+    name_len = strlen(File);
+    if (name_len > 4)
+        raw = (strcmp(File + name_len - 4, ".PCM") == 0) || (strcmp(File + name_len - 4, ".pcm") == 0);
+
+    /* Same checks as sv56demo(): mono, 16-bit or float, not a stream */
+    header_offset = wav_open(File, raw, &wf);
+    if (header_offset == 0) {
+        if (raw)
+            header.num_channels = 1;
+        else if ((header_offset = wav_header_check(&wf, &header)) < 0)
+            wav_close(&wf);
+    }
+    if (header_offset < 0) {
+        fclose(out);
+        return header_offset;
+    }
+    if (header.num_channels != 1 || wf.stream) {
+        fprintf(stderr, wf.stream ? "%s: can't rewrite a stream\n" : "%s: not MONO channel\n", File);
+        wav_close(&wf);
+        fclose(out);
+        return wf.stream ? WAV_HEADER_NOK : WAV_HEADER_NOT_MONO;
+    }
+    init_speech_voltmeter(&state, wav_rate(&wf, sf));
+    size = wf.format == WAV_FORMAT_FLOAT ? sizeof(float) : sizeof(short);
+
+    /* An interrupted run of the same file is completed with its gain */
+    FileJnl = (char*)malloc(name_len + 5);
+    saved = (unsigned char*)malloc(INPL_BLOCK);
+    if (FileJnl == NULL || saved == NULL) {
+        fprintf(stderr, "Can't allocate memory for the journal\n");
+        err = -1;
+    }
+    else {
+        sprintf(FileJnl, "%s.jnl", File);
+        if ((fj = fopen(FileJnl, "rb")) != NULL) {
+            resume = inpl_read(fj, &rec, saved);
+            fclose(fj);
+            if (resume && (rec.file_size != wf.file_size || rec.data_offset != wf.data_offset ||
+                           rec.data_bytes != wf.data_bytes || rec.format != wf.format)) {
+                fprintf(stderr, "%s: journal of another file, ignored\n", FileJnl);
+                resume = 0;
+            }
         }
-        else {
-            KILL(FileIn, 5);
+    }
+
+    if (err == 0 && resume) {
+        factor = rec.factor;
+        fprintf(out, "\n  Resuming %s at byte %llu, gain %f\n", File, rec.offset, factor);
+    }
+    else if (err == 0 && wav_frames_left(&wf) == 0) {
+        fprintf(stderr, "%s: no samples\n", File);
+        err = -1;
+    }
+    else if (err == 0) {
+        /* ... MEASUREMENT OF ACTIVE SPEECH LEVEL ACCORDING P.56 ... */
+        wav_prefetch(&wf, WAV_PIPE_DEFAULT, WAV_PIPE_DEFAULT);
+        while ((l = wav_read(&wf, N, &samples)) > 0) {
+            if (wf.format == WAV_FORMAT_FLOAT)
+                ActiveLeveldB = speech_voltmeter((float*)memcpy(Buf, samples, l * sizeof(float)), l, &state);
+            else
+                ActiveLeveldB = speech_voltmeter_int((void*)samples, l, 16, &state);
         }
+        factor = pow(10.0, (targetdB - ActiveLeveldB) / 20.0);
+        print_p56_short_summary(out, File, state, ActiveLeveldB, Overflow, factor);
+
+        memset(&rec, 0, sizeof(rec));
+        rec.file_size = wf.file_size;
+        rec.data_offset = wf.data_offset;
+        rec.data_bytes = wf.data_bytes;
+        rec.offset = wf.data_offset;
+        rec.format = wf.format;
+        rec.factor = factor;
     }
-    // for the last block samples, no < N
-    if ((l = fread(buffer, sizeof(short), (total_samples - no_samples), Fi)) > 0) {
-        /* ... Convert samples to float */
-        sh2fl((long)l, buffer, Buf, bitno, 1);
+    wav_close(&wf);
+
+    /* ... EQUALIZATION, IN PLACE ... */
+    if (err == 0)
+        err = inpl_rewrite(File, FileJnl, &rec, saved, resume, size, &NrSat);
+
+    if (NrSat != 0)
+        fprintf(out, "\n  Number of clippings: .......... %7ld []\n", NrSat);
+
+    free(saved);
+    free(FileJnl);
+    fclose(out);
+    return err;
+}
+
+int sv56demo_inplace(char* File, double targetdB)
+{
+    int err;
+
+    SV_TRACE_BEGIN("sv56demo_inplace", File);
+    err = inpl_run(File, targetdB);
+    SV_TRACE_END();
+    return err;
+}
+/* .................... End of sv56demo_inplace() .................... */
+
+#undef INPL_MAGIC
+#undef INPL_BLOCK
+
+
+/*
+ * .................... CORPUS EQUALIZATION ....................
+ *
+ * The files of a corpus are brought together to one active speech
+ * level, by the same gain, so that their levels relative to each other
+ * are kept. In a first sweep, worker threads measure the files with
+ * actlevel_volt(), each taking the next file in the list when done
+ * with one; the voltmeters are then merged, in the order of the list,
+ * into that of the corpus (Process 1 sums and Process 2 activity
+ * counts add up: the active level of the corpus is that of all its
+ * active samples). A second sweep equalizes the files by the gain
+ * found, again in parallel. Each file is read once per sweep, and not
+ * at all in the first one when the result cache has it; the
+ * statistics of the outputs are those of the inputs, moved by the
+ * gain, and not measured again.
+ */
+#define CORPUS_MAX_THREADS 64
+
+/* One sweep over the files */
+typedef struct {
+    char** FileIn;
+    char** FileOut;
+    long nfile;
+    double gain;                  /* 0: measure; else equalize by it */
+    SVP56_state* sv_state;        /* statistics of each input */
+    SVP56_state* volt;            /* voltmeter of each input */
+    long* clips;                  /* clipped samples of each output */
+    int* err;                     /* of each file */
+    volatile long next;           /* next file to be taken */
+} corpus_job;
+
+/* Index of the next file, for any number of threads at once */
+static long corpus_take(corpus_job* job) {
+#if defined(CORPUS_THREADS_WIN32)
+    return InterlockedIncrement((LONG volatile*)&job->next) - 1;
+#elif defined(CORPUS_THREADS_POSIX)
+    return __sync_fetch_and_add(&job->next, 1);
+#else
+    return job->next++;
+#endif
+}
+
+static void corpus_work(corpus_job* job) {
+    long i;
 
-        /* ... Get the active level */
-        ActiveLeveldB = speech_voltmeter(Buf, (long)l, &state);
-        //total_samples -= l;
-        no_samples += l;
+    while ((i = corpus_take(job)) < job->nfile) {
+        if (job->gain > 0) {
+            SV_TRACE_BEGIN("sv56demo", job->FileIn[i]);
+            job->err[i] = sv56demo_file(job->FileIn[i], job->FileOut[i], 0, job->gain, &job->clips[i]);
+            SV_TRACE_END();
+        }
+        else
+            job->err[i] = actlevel_volt(job->FileIn[i], &job->sv_state[i], &job->volt[i]);
     }
-    else {
-        KILL(FileIn, 5);
+}
+
+#if defined(CORPUS_THREADS_WIN32)
+static DWORD WINAPI corpus_entry(LPVOID arg) {
+    SV_TRACE_THREAD("corpus worker");
+    corpus_work((corpus_job*)arg);
+    return 0;
+}
+#elif defined(CORPUS_THREADS_POSIX)
+static void* corpus_entry(void* arg) {
+    SV_TRACE_THREAD("corpus worker");
+    corpus_work((corpus_job*)arg);
+    return NULL;
+}
+#endif
+
+/* A sweep on `threads' threads, the caller being one of them; with
+   fewer threads if some can't be started */
+static void corpus_sweep(corpus_job* job, int threads) {
+#if defined(CORPUS_THREADS_WIN32)
+    HANDLE t[CORPUS_MAX_THREADS];
+#elif defined(CORPUS_THREADS_POSIX)
+    pthread_t t[CORPUS_MAX_THREADS];
+#endif
+    int k, started = 0;
+
+    job->next = 0;
+#if defined(CORPUS_THREADS_WIN32)
+    for (k = 1; k < threads; k++)
+        if ((t[started] = CreateThread(NULL, 0, corpus_entry, job, 0, NULL)) != NULL)
+            started++;
+#elif defined(CORPUS_THREADS_POSIX)
+    for (k = 1; k < threads; k++)
+        if (pthread_create(&t[started], NULL, corpus_entry, job) == 0)
+            started++;
+#endif
+    corpus_work(job);
+    for (k = 0; k < started; k++) {
+#if defined(CORPUS_THREADS_WIN32)
+        WaitForSingleObject(t[k], INFINITE);
+        CloseHandle(t[k]);
+#elif defined(CORPUS_THREADS_POSIX)
+        pthread_join(t[k], NULL);
+#endif
     }
+}
 
-    /* ... COMPUTE EQUALIZATION FACTOR ... */
+/* Worker threads for `nfile' files: `threads', or one per processor */
+static int corpus_threads(int threads, long nfile) {
+#if defined(CORPUS_THREADS_WIN32)
+    SYSTEM_INFO si;
 
-    /* Computes the equalization factor to be used in the output file */
-    DesiredSpeechLeveldB = (double)targetdB;
-    if (use_active_level)
-        factor = pow(10.0, (DesiredSpeechLeveldB - ActiveLeveldB) / 20.0);
-    else
-        factor = pow(10.0, (DesiredSpeechLeveldB - SVP56_get_rms_dB(state)) / 20.0);
+    if (threads <= 0) {
+        GetSystemInfo(&si);
+        threads = (int)si.dwNumberOfProcessors;
+    }
+#elif defined(CORPUS_THREADS_POSIX)
+    if (threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    threads = 1;
+#endif
+    if (threads > CORPUS_MAX_THREADS)
+        threads = CORPUS_MAX_THREADS;
+    if (threads > nfile)
+        threads = (int)nfile;
+    return threads < 1 ? 1 : threads;
+}
 
-    /* ... PRINT-OUT OF RESULTS ... */
-    print_p56_short_summary(out, FileIn, state, ActiveLeveldB, Overflow, factor);
+/* Statistics after equalization by `gain', from the voltmeter `volt' of
+   the input: the sums, peaks, envelope and thresholds are scaled, so
+   that the activity counts hold as they are and all levels move by
+   20 log10(gain); peaks are held at the clipping points when samples
+   were clipped (the levels then being a little above those of the
+   output). Reported in the input sample range, as by actlevel(). */
+static void corpus_scale(SVP56_state* sv_state, const SVP56_state* volt, double gain, long clips, double ratio) {
+    SVP56_state state = *volt;
+    double al_dB, abs_max_dB;
+    int j;
+
+    state.s *= gain;
+    state.sq *= gain * gain;
+    state.p *= gain;
+    state.q *= gain;
+    state.max *= gain;
+    state.maxP *= gain;
+    state.maxN *= gain;
+    for (j = 0; j < (int)(sizeof(state.c) / sizeof(state.c[0])); j++)
+        state.c[j] *= gain;
+    if (clips > 0) {
+        if (state.maxP > (ratio - 1) / ratio)
+            state.maxP = (ratio - 1) / ratio;
+        if (state.maxN < -1)
+            state.maxN = -1;
+        state.max = (state.maxP > -state.maxN) ? state.maxP : -state.maxN;
+    }
+    al_dB = active_speech_level(&state);
+    abs_max_dB = 20 * log10(SVP56_get_abs_max(state) + MIN_LOG_OFFSET);
+
+    *sv_state = state;
+    sv_state->maxN = ratio * state.maxN;
+    sv_state->maxP = ratio * state.maxP;
+    sv_state->DClevel = ratio * state.DClevel;
+    sv_state->ActiveSpeechLevel = al_dB;
+    sv_state->ActivityFactor = state.ActivityFactor * 100;
+    sv_state->rmsPkF = abs_max_dB - state.rmsdB;
+    sv_state->ActPkF = abs_max_dB - al_dB;
+    sv_state->Gain = gain;
+}
 
-    /* EQUALIZATION: hard clipping (with truncation) */
 
-    /* Move pointer to 1st desired block */
-    if (fseek(Fi, header_offset, 0) < 0l)
-        KILL(FileIn, 4);
-    no_samples = 0;
-    /* Get data of interest, equalize and de-normalize */
-    for (i = 0; i < (N2 - 1); i++) {
-        if ((l = fread(buffer, sizeof(short), N, Fi)) > 0) {
-            /* convert samples to float */
-            sh2fl((long)l, buffer, Buf, bitno, 1);
+/*
+  ============================================================================
+
+       int sv56demo_corpus (char **FileIn, char **FileOut, long nfile,
+       ~~~~~~~~~~~~~~~~~~~  double targetdB, int threads,
+                            SVP56_state *sv_state, SVP56_state *corpus);
+
+       Equalize `nfile' files together: the active speech level of all
+       of them, as one signal, is brought to `targetdB' dBov by one
+       gain, applied to every file, so that the levels of the files
+       relative to each other are kept. The files are measured in
+       parallel, then equalized in parallel, each being read twice.
+       Nothing is written unless all of them could be measured, at one
+       sampling rate, and no output is left unless all of them could
+       be written; errors are returned, never exit().
+
+       The statistics returned are those of the outputs, found from
+       the gain and the measurement of the inputs rather than by
+       reading the outputs: they are what actlevel() would give of
+       them, up to the rounding of the 16-bit samples, unless samples
+       were clipped (see the log).
 
-            /* equalizes vector */
-            scale(Buf, (long)l, (double)factor);
+       Parameter:
+       ~~~~~~~~~~
+       FileIn ..... wave (or headerless *.pcm) files, 16-bit or float
+                    mono
+       FileOut .... equalized files, one per input, none of them named
+                    as an input or as another output
+       nfile ...... number of files
+       targetdB ... active speech level wanted for the corpus, in dBov
+       threads .... worker threads; 0 for one per processor
+       sv_state ... statistics of each output, or NULL
+       corpus ..... statistics of all outputs as one signal, the gain in
+                    `Gain', or NULL
 
-            /* Convert from float to short with hard clip and truncation */
-            NrSat += fl2sh((long)l, Buf, buffer, (double)0.0, mask[16 - bitno]);
+       Returns
+       ~~~~~~~
+       0 on success, or the error of the first file that failed (a
+       WAV_HEADER_* error code, or -1).
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.1	Files of another sampling rate refused.
+       19.Oct.26	v1.2	Errors returned, not exit(); all or no outputs.
+       19.Oct.26	v1.3	Outputs named as an input or twice refused.
 
-            /* write equalized, de-normalized and hard-clipped samples to file */
-            if ((l = fwrite(buffer, sizeof(short), l, Fo)) < 0)
-                KILL(FileOut, 6);
-            no_samples += l;
+  ============================================================================
+*/
+static int corpus_run(char** FileIn, char** FileOut, long nfile, double targetdB, int threads,
+                      SVP56_state* sv_state, SVP56_state* corpus)
+{
+    corpus_job job;
+    SVP56_state merged;
+    FILE* out;
+    double Overflow, ActiveLeveldB, factor;
+    long bitno = 16, i, j, clips = 0;
+    int err = 0;
+
+    if (nfile <= 0)
+        return -1;
+
+    /* Each file is read twice, and written apart from the inputs */
+    for (i = 0; i < nfile; i++) {
+        if (strcmp(FileIn[i], "-") == 0) {
+            fprintf(stderr, "%s: can't read a stream twice\n", FileIn[i]);
+            return WAV_HEADER_NOK;
         }
-        else {
-            KILL(FileIn, 5);
+        if (FileOut[i] == NULL) {
+            fprintf(stderr, "%s: the corpus is equalized into new files\n", FileIn[i]);
+            return -1;
         }
     }
-    // for the last block samples, no < N
-    if ((l = fread(buffer, sizeof(short), (total_samples - no_samples), Fi)) > 0) {
-        /* convert samples to float */
-        sh2fl((long)l, buffer, Buf, bitno, 1);
 
-        /* equalizes vector */
-        scale(Buf, (long)l, (double)factor);
-
-        /* Convert from float to short with hard clip and truncation */
-        NrSat += fl2sh((long)l, Buf, buffer, (double)0.0, mask[16 - bitno]);
+    /* ... and no output is an input, of its own or of another file,
+       or another output: the outputs are removed on an error, and
+       written while the other workers read ... */
+    for (i = 0; i < nfile; i++)
+        for (j = 0; j < nfile; j++) {
+            if (strcmp(FileOut[i], FileIn[j]) == 0) {
+                fprintf(stderr, "%s: the corpus is equalized into new files\n", FileIn[j]);
+                return -1;
+            }
+            if (j < i && strcmp(FileOut[i], FileOut[j]) == 0) {
+                fprintf(stderr, "%s: output of %s and of %s\n", FileOut[i], FileIn[j], FileIn[i]);
+                return -1;
+            }
+        }
 
-        /* write equalized, de-normalized and hard-clipped samples to file */
-        if ((l = fwrite(buffer, sizeof(short), l, Fo)) < 0)
-            KILL(FileOut, 6);
+    memset(&job, 0, sizeof(job));
+    job.FileIn = FileIn;
+    job.FileOut = FileOut;
+    job.nfile = nfile;
+    job.sv_state = (SVP56_state*)malloc(nfile * sizeof(SVP56_state));
+    job.volt = (SVP56_state*)malloc(nfile * sizeof(SVP56_state));
+    job.clips = (long*)calloc(nfile, sizeof(long));
+    job.err = (int*)calloc(nfile, sizeof(int));
+    if (job.sv_state == NULL || job.volt == NULL || job.clips == NULL || job.err == NULL) {
+        fprintf(stderr, "Can't allocate memory for the corpus\n");
+        err = -1;
     }
     else {
-        KILL(FileIn, 5);
+        /* ... 1st sweep: the voltmeter of each file ... */
+        threads = corpus_threads(threads, nfile);
+        corpus_sweep(&job, threads);
+        for (i = 0; i < nfile && err == 0; i++)
+            err = job.err[i];
     }
-    if (header_offset > 0) {
-        while (1) {
-            if ((l = fread(buffer, sizeof(char), N, Fi)) > 0) {
-                fwrite(buffer, sizeof(char), l, Fo);
+
+    if (err == 0) {
+        /* ... the voltmeter of the corpus, of files of one rate ... */
+        merged = job.volt[0];
+        for (i = 1; i < nfile && err == 0; i++)
+            if (speech_voltmeter_merge(&merged, &job.volt[i]) != 0) {
+                fprintf(stderr, "%s: sampling rate %g Hz, not %g Hz as %s\n", FileIn[i], job.volt[i].f, merged.f, FileIn[0]);
+                err = -1;
             }
-            else
-                break;
+    }
+
+    if (err == 0) {
+        /* ... and the gain to the target ... */
+        ActiveLeveldB = active_speech_level(&merged);
+        factor = pow(10.0, (targetdB - ActiveLeveldB) / 20.0);
+        Overflow = pow((double)2.0, (double)(bitno - 1));
+        if ((out = fopen("log.txt", "at")) != NULL) {
+            fprintf(out, "\n  Corpus of %ld files, equalized to %.3f dBov:\n", nfile, targetdB);
+            print_p56_short_summary(out, "(corpus)", merged, ActiveLeveldB, Overflow, factor);
+            fclose(out);
+        }
+
+        /* ... 2nd sweep: every file equalized by that gain ... */
+        job.gain = factor;
+        corpus_sweep(&job, threads);
+        for (i = 0; i < nfile; i++) {
+            if (err == 0)
+                err = job.err[i];
+            clips += job.clips[i];
+            if (sv_state != NULL)
+                corpus_scale(&sv_state[i], &job.volt[i], factor, job.clips[i], Overflow);
         }
+        if (corpus != NULL)
+            corpus_scale(corpus, &merged, factor, clips, Overflow);
+
+        /* ... all the files equalized, or none: the outputs written
+           are removed when another could not be ... */
+        if (err != 0)
+            for (i = 0; i < nfile; i++)
+                if (job.err[i] == 0)
+                    remove(FileOut[i]);
     }
 
-    /* Log number of clipped samples */
-    if (NrSat != 0)
-        fprintf(out, "\n  Number of clippings: .......... %7ld []\n", NrSat);
+    free(job.sv_state);
+    free(job.volt);
+    free(job.clips);
+    free(job.err);
+    return err;
+}
 
-    /* Close files ... */
-    fclose(Fi);
-    fclose(Fo);
-    if (out != stdout)
-        fclose(out);
-#if !defined(VMS)
-    return (0);
-#endif
+int sv56demo_corpus(char** FileIn, char** FileOut, long nfile, double targetdB, int threads,
+                    SVP56_state* sv_state, SVP56_state* corpus)
+{
+    int err;
+
+    SV_TRACE_BEGIN("sv56demo_corpus", nfile > 0 ? FileIn[0] : NULL);
+    err = corpus_run(FileIn, FileOut, nfile, targetdB, threads, sv_state, corpus);
+    SV_TRACE_END();
+    return err;
 }
+/* .................... End of sv56demo_corpus() .................... */
+
+#undef CORPUS_MAX_THREADS
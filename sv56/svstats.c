@@ -0,0 +1,592 @@
+/*                                                             v1.2 19.OCT.26
+=============================================================================
+
+                          U    U   GGG    SSSS  TTTTT
+                          U    U  G       S       T
+                          U    U  G  GG   SSSS    T
+                          U    U  G   G       S   T
+                           UUU     GG     SSS     T
+
+                   ========================================
+                    ITU-T - USER'S GROUP ON SOFTWARE TOOLS
+                   ========================================
+
+       =============================================================
+       COPYRIGHT NOTE: This source code, and all of its derivations,
+       is subject to the "ITU-T General Public License". Please have
+       it  read  in    the  distribution  disk,   or  in  the  ITU-T
+       Recommendation G.191 on "SOFTWARE TOOLS FOR SPEECH AND  AUDIO
+       CODING STANDARDS".
+       =============================================================
+
+
+MODULE:         SVSTATS.C, STAGE TIMERS AND COUNTERS
+
+DATE:           19/Oct/2026
+
+RELEASE:        1.20
+
+PROTOTYPES:     see svstats.h.
+
+FUNCTIONS:
+
+sv_stats_begin ........ starts a new call: its timers and counters are
+                        zeroed, those of the process go on.
+
+sv_stats_get .......... timers and counters of the call and of the process.
+
+sv_stats_reset ........ zeroes both.
+
+sv_stats_stage_name ... name of a stage, e.g. "voltmeter".
+
+sv_stats_counter_name . name of a counter, e.g. "bytes_read".
+
+sv_stage_enter ........ the calling code enters a stage (SV_STAGE_ENTER()).
+
+sv_stage_leave ........ and leaves it (SV_STAGE_LEAVE()).
+
+sv_count .............. adds to a counter (SV_COUNT()).
+
+sv_trace_start ........ starts recording a trace, to be written to a file.
+
+sv_trace_stop ......... stops it and writes the file.
+
+sv_trace_begin ........ the calling thread starts a span (SV_TRACE_BEGIN()).
+
+sv_trace_end .......... and ends it (SV_TRACE_END()).
+
+sv_trace_thread ....... names the calling thread in the trace.
+
+HISTORY:
+
+   19.Oct.26 v1.0 Release of 1st version. The stages are timed with the
+                  monotonic clock, one reading when a stage is entered
+                  and one when it is left; stages run inside another
+                  are kept on a small stack, and the time of the inner
+                  stage is taken off the outer one.
+   19.Oct.26 v1.1 Trace: while sv_trace_start() is in effect, stages and
+                  spans are recorded as begin and end events, each thread
+                  filling chunks of its own (found through thread-local
+                  storage and put on a shared list by compare-and-swap,
+                  so that no lock is taken); sv_trace_stop(), or the end
+                  of the process, writes them out as Chrome Trace Event
+                  JSON (chrome://tracing, Perfetto).
+   19.Oct.26 v1.2 Stages may be entered by several threads at once (the
+                  parallel sweeps of sv56demo_corpus()): each thread
+                  keeps its own stack of stages, and the calls and
+                  counters are added atomically.
+
+=============================================================================
+*/
+
+/*
+ * .................... INCLUDES ....................
+ */
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "svstats.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define SV_PID() ((long)GetCurrentProcessId())
+#else
+#include <time.h>
+#include <unistd.h>
+#define SV_PID() ((long)getpid())
+#endif
+
+/* Thread-local storage, and the atomic operations of the trace */
+#if defined(_MSC_VER)
+#define SV_TLS __declspec(thread)
+#define SV_CAS(p, old, new) (InterlockedCompareExchangePointer((PVOID volatile*)(p), (new), (old)) == (old))
+#define SV_INC(p) InterlockedIncrement(p)
+#define SV_ADD(p, n) InterlockedExchangeAdd64((LONGLONG volatile*)(p), (LONGLONG)(n))
+#else
+#define SV_TLS __thread
+#define SV_CAS(p, old, new) __sync_bool_compare_and_swap((p), (old), (new))
+#define SV_INC(p) __sync_add_and_fetch((p), 1)
+#define SV_ADD(p, n) __sync_fetch_and_add((p), (n))
+#endif
+
+/* Stages entered one inside another, deepest kept */
+#define SV_DEPTH 16
+
+/* Events per chunk of the trace */
+#define SV_CHUNK 4096
+
+/*
+ * The timers and counters are those of the process, not of a thread:
+ * the drivers do their timing in the calling thread (the I/O threads
+ * are seen through the waits in wav_read() and wav_out_write()), and
+ * one call is measured at a time. A call may run its work on several
+ * threads: each has its stack of stages, and their times add up (to
+ * more than `wall'); the seconds are added without a lock, and the
+ * odd update lost to a race is not worth one.
+ */
+static sv_stats sv_call, sv_total;
+static double sv_call_start = -1, sv_total_start = -1;
+static SV_TLS int sv_stack[SV_DEPTH];
+static SV_TLS int sv_depth;
+static SV_TLS double sv_t0;
+
+static const char* sv_stage_names[SV_STAGES] = {
+    "header", "read", "convert", "voltmeter", "scale",
+    "filter_design", "fir", "fft", "dither", "write"
+};
+static const char* sv_counter_names[SV_COUNTERS] = {
+    "bytes_read", "bytes_written", "samples", "clips",
+    "fft_calls", "cache_hits", "cache_misses"
+};
+
+/* An event of the trace: 'B'egin or 'E'nd of a span */
+typedef struct {
+    const char* name;             /* static string, or NULL for 'E' */
+    char* file;                   /* copy of the file name, or NULL */
+    double ts;                    /* seconds since sv_trace_start() */
+    char ph;
+} sv_event;
+
+/* Events of one thread; a thread fills one chunk after the other */
+typedef struct sv_chunk {
+    struct sv_chunk* next;        /* on the list of all chunks */
+    const char* thread;           /* name of the thread, or NULL */
+    long tid;
+    long n;
+    sv_event ev[SV_CHUNK];
+} sv_chunk;
+
+int sv_tracing;
+static char* sv_trace_file;
+static sv_chunk* volatile sv_chunks;
+static volatile long sv_trace_tids;
+static unsigned sv_trace_gen;
+static double sv_trace_t0;
+static int sv_trace_atexit;
+
+/* Chunk being filled by the calling thread, valid for trace sv_mine_gen */
+static SV_TLS sv_chunk* sv_mine;
+static SV_TLS unsigned sv_mine_gen;
+static SV_TLS long sv_mine_tid;
+static SV_TLS const char* sv_mine_name;
+
+
+/*
+ * .................... LOCAL FUNCTIONS ....................
+ */
+
+/* Monotonic clock, in seconds */
+static double sv_clock(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER f, c;
+
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (double)c.QuadPart / (double)f.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+#endif
+}
+
+/* Record an event of the calling thread; no lock, only its own chunk */
+static void sv_trace_put(const char* name, const char* file, char ph, double t) {
+    sv_chunk* c = sv_mine_gen == sv_trace_gen ? sv_mine : NULL;
+    sv_event* e;
+
+    if (c == NULL || c->n == SV_CHUNK) {
+        if (c == NULL)
+            sv_mine_tid = SV_INC(&sv_trace_tids);
+        if ((c = (sv_chunk*)malloc(sizeof(sv_chunk))) == NULL)
+            return;
+        c->thread = sv_mine_name;
+        c->tid = sv_mine_tid;
+        c->n = 0;
+        do
+            c->next = sv_chunks;
+        while (!SV_CAS(&sv_chunks, c->next, c));
+        sv_mine = c;
+        sv_mine_gen = sv_trace_gen;
+    }
+    e = &c->ev[c->n];
+    e->name = name;
+    e->file = NULL;
+    if (file != NULL && (e->file = (char*)malloc(strlen(file) + 1)) != NULL)
+        strcpy(e->file, file);
+    e->ts = t - sv_trace_t0;
+    e->ph = ph;
+    c->n++;
+}
+
+/* A JSON string */
+static void sv_json(FILE* fp, const char* s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(fp, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(fp, "\\u%04x", (unsigned char)*s);
+        else
+            fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+static void sv_trace_exit(void) {
+    sv_trace_stop();
+}
+
+/* Time since the last reading charged to the innermost stage */
+static double sv_charge(void) {
+    double t = sv_clock();
+    int s;
+
+    if (sv_depth > 0) {
+        s = sv_stack[(sv_depth < SV_DEPTH ? sv_depth : SV_DEPTH) - 1];
+        sv_call.seconds[s] += t - sv_t0;
+        sv_total.seconds[s] += t - sv_t0;
+    }
+    sv_t0 = t;
+    return t;
+}
+
+
+/*
+ * .................... FUNCTIONS ....................
+ */
+
+/*
+  ============================================================================
+
+       void sv_stats_begin (void);
+       ~~~~~~~~~~~~~~~~~~~
+
+       void sv_stats_get (sv_stats *call, sv_stats *total);
+       ~~~~~~~~~~~~~~~~~
+
+       void sv_stats_reset (void);
+       ~~~~~~~~~~~~~~~~~~~
+
+       Timers and counters of a call, i.e. of all that was done since
+       sv_stats_begin(), and of the process since it started (or since
+       sv_stats_reset()). `wall' is the time elapsed since then; the
+       time outside of any stage is `wall' less the sum of `seconds'.
+       Either of `call' and `total' may be NULL.
+
+       Parameter:
+       ~~~~~~~~~~
+       call ..... timers and counters of the call
+       total .... those of the process
+
+       Returns
+       ~~~~~~~
+       None.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+void sv_stats_begin(void) {
+    memset(&sv_call, 0, sizeof(sv_call));
+    sv_call_start = sv_clock();
+    if (sv_total_start < 0)
+        sv_total_start = sv_call_start;
+}
+
+void sv_stats_get(sv_stats* call, sv_stats* total) {
+    double t = sv_clock();
+
+    if (sv_total_start < 0)
+        sv_total_start = t;
+    if (sv_call_start < 0)
+        sv_call_start = sv_total_start;
+    if (call != NULL) {
+        *call = sv_call;
+        call->wall = t - sv_call_start;
+    }
+    if (total != NULL) {
+        *total = sv_total;
+        total->wall = t - sv_total_start;
+    }
+}
+
+void sv_stats_reset(void) {
+    memset(&sv_total, 0, sizeof(sv_total));
+    sv_total_start = -1;
+    sv_depth = 0;
+    sv_stats_begin();
+}
+/* ....................... End of sv_stats_get() ....................... */
+
+
+/*
+  ============================================================================
+
+       const char *sv_stats_stage_name (int stage);
+       ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+       const char *sv_stats_counter_name (int counter);
+       ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+       Names of the stages and counters, as the keys of pysv.stats().
+
+       Returns
+       ~~~~~~~
+       The name, or NULL past the last one.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+const char* sv_stats_stage_name(int stage) {
+    return (stage >= 0 && stage < SV_STAGES) ? sv_stage_names[stage] : NULL;
+}
+
+const char* sv_stats_counter_name(int counter) {
+    return (counter >= 0 && counter < SV_COUNTERS) ? sv_counter_names[counter] : NULL;
+}
+/* ..................... End of sv_stats_stage_name() ..................... */
+
+
+/*
+  ============================================================================
+
+       void sv_stage_enter (int stage);
+       ~~~~~~~~~~~~~~~~~~~
+
+       void sv_stage_leave (void);
+       ~~~~~~~~~~~~~~~~~~~
+
+       void sv_count (int counter, unsigned long long n);
+       ~~~~~~~~~~~~~
+
+       The instrumentation itself, through the macros SV_STAGE_ENTER(),
+       SV_STAGE_LEAVE() and SV_COUNT() of svstats.h. Every enter is
+       matched by a leave on all paths; the time until then goes to the
+       stage, less that of the stages entered inside it.
+
+       Parameter:
+       ~~~~~~~~~~
+       stage .... SV_STAGE_*
+       counter .. SV_COUNT_*
+       n ........ added to the counter
+
+       Returns
+       ~~~~~~~
+       None.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+void sv_stage_enter(int stage) {
+    double t = sv_charge();
+
+    if (sv_tracing)
+        sv_trace_put(sv_stage_names[stage], NULL, 'B', t);
+    if (sv_depth < SV_DEPTH)
+        sv_stack[sv_depth] = stage;
+    sv_depth++;
+    SV_ADD(&sv_call.calls[stage], 1);
+    SV_ADD(&sv_total.calls[stage], 1);
+}
+
+void sv_stage_leave(void) {
+    double t = sv_charge();
+
+    if (sv_tracing)
+        sv_trace_put(NULL, NULL, 'E', t);
+    if (sv_depth > 0)
+        sv_depth--;
+}
+
+void sv_count(int counter, unsigned long long n) {
+    SV_ADD(&sv_call.count[counter], n);
+    SV_ADD(&sv_total.count[counter], n);
+}
+/* ....................... End of sv_stage_enter() ....................... */
+
+
+/*
+  ============================================================================
+
+       int sv_trace_start (const char *file);
+       ~~~~~~~~~~~~~~~~~~
+
+       int sv_trace_stop (void);
+       ~~~~~~~~~~~~~~~~~
+
+       Record a trace of the stages, and of the spans marked with
+       SV_TRACE_BEGIN() and SV_TRACE_END(), of all threads, from
+       sv_trace_start() on. sv_trace_stop() writes it to `file' in the
+       Chrome Trace Event format, one begin and one end event per span,
+       with timestamps in microseconds from the start; it is called at
+       the end of the process if not before. It must not be called
+       while some thread is still recording, i.e. while a driver runs.
+
+       Parameter:
+       ~~~~~~~~~~
+       file ..... JSON file to be written
+
+       Returns
+       ~~~~~~~
+       0 on success; -1 if a trace is already (or, for sv_trace_stop(),
+       not) being taken, or if `file' can't be written.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int sv_trace_start(const char* file) {
+    if (sv_tracing || file == NULL)
+        return -1;
+    if ((sv_trace_file = (char*)malloc(strlen(file) + 1)) == NULL)
+        return -1;
+    strcpy(sv_trace_file, file);
+    if (!sv_trace_atexit)
+        sv_trace_atexit = atexit(sv_trace_exit) == 0;
+    sv_chunks = NULL;
+    sv_trace_tids = 0;
+    sv_trace_gen++;
+    sv_trace_t0 = sv_clock();
+    sv_trace_thread("main");
+    sv_tracing = 1;
+    return 0;
+}
+
+int sv_trace_stop(void) {
+    sv_chunk *c, *next;
+    long i, pid = SV_PID();
+    int first = 1, err = 0;
+    FILE* fp;
+
+    if (!sv_tracing)
+        return -1;
+    sv_tracing = 0;
+
+    /* Chunks in the order they were started */
+    for (c = sv_chunks, sv_chunks = NULL; c != NULL; c = next) {
+        next = c->next;
+        c->next = sv_chunks;
+        sv_chunks = c;
+    }
+
+    if ((fp = fopen(sv_trace_file, "w")) == NULL)
+        err = -1;
+    else
+        fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (c = sv_chunks; c != NULL; c = next) {
+        next = c->next;
+        if (fp != NULL && c->thread != NULL) {
+            fprintf(fp, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %ld, \"tid\": %ld, \"args\": {\"name\": ",
+                    first ? "" : ",", pid, c->tid);
+            sv_json(fp, c->thread);
+            fprintf(fp, "}}");
+            first = 0;
+        }
+        for (i = 0; i < c->n; i++) {
+            if (fp != NULL) {
+                fprintf(fp, "%s\n{", first ? "" : ",");
+                if (c->ev[i].name != NULL) {
+                    fprintf(fp, "\"name\": ");
+                    sv_json(fp, c->ev[i].name);
+                    fprintf(fp, ", ");
+                }
+                fprintf(fp, "\"ph\": \"%c\", \"ts\": %.3f, \"pid\": %ld, \"tid\": %ld",
+                        c->ev[i].ph, 1e6 * c->ev[i].ts, pid, c->tid);
+                if (c->ev[i].file != NULL) {
+                    fprintf(fp, ", \"args\": {\"file\": ");
+                    sv_json(fp, c->ev[i].file);
+                    fprintf(fp, "}");
+                }
+                fprintf(fp, "}");
+                first = 0;
+            }
+            free(c->ev[i].file);
+        }
+        free(c);
+    }
+    sv_chunks = NULL;
+    if (fp != NULL) {
+        fprintf(fp, "\n]}\n");
+        if (fclose(fp) != 0)
+            err = -1;
+    }
+    free(sv_trace_file);
+    sv_trace_file = NULL;
+    return err;
+}
+/* ....................... End of sv_trace_start() ....................... */
+
+
+/*
+  ============================================================================
+
+       void sv_trace_begin (const char *name, const char *file);
+       ~~~~~~~~~~~~~~~~~~~
+
+       void sv_trace_end (void);
+       ~~~~~~~~~~~~~~~~~
+
+       void sv_trace_thread (const char *name);
+       ~~~~~~~~~~~~~~~~~~~~
+
+       A span of the calling thread, e.g. a whole driver call or a
+       block written by an I/O thread, and the name the thread goes by
+       in the trace. Through the macros SV_TRACE_BEGIN(), SV_TRACE_END()
+       and SV_TRACE_THREAD() of svstats.h, which do nothing unless a
+       trace is being taken.
+
+       Parameter:
+       ~~~~~~~~~~
+       name ..... name of the span or of the thread; a string that stays
+                  (a literal)
+       file ..... file the span works on, shown with it, or NULL
+
+       Returns
+       ~~~~~~~
+       None.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+void sv_trace_begin(const char* name, const char* file) {
+    sv_trace_put(name, file, 'B', sv_clock());
+}
+
+void sv_trace_end(void) {
+    sv_trace_put(NULL, NULL, 'E', sv_clock());
+}
+
+void sv_trace_thread(const char* name) {
+    sv_mine_name = name;
+    if (sv_mine_gen == sv_trace_gen && sv_mine != NULL)
+        sv_mine->thread = name;
+}
+/* ....................... End of sv_trace_begin() ....................... */
+
+#undef SV_CHUNK
+#undef SV_INC
+#undef SV_CAS
+#undef SV_TLS
+#undef SV_PID
+#undef SV_DEPTH
+/* ......................... End of SVSTATS.C ........................... */
@@ -0,0 +1,115 @@
+/*
+  ============================================================================
+   File: SVSTATS.H                                            19.Oct.26 v1.2
+  ============================================================================
+
+                      UGST/ITU-T STAGE TIMERS AND COUNTERS
+
+                          GLOBAL FUNCTION PROTOTYPES
+
+   History:
+   19.Oct.26    v1.0    First version: time spent in each stage of the
+                        voltmeter, equalizer and rate converter, and
+                        counts of bytes, samples, clips, FFTs and cache
+                        hits, per call and per process.
+   19.Oct.26    v1.1    Trace of the stages and of the I/O threads, as
+                        Chrome Trace Event JSON.
+   19.Oct.26    v1.2    Stages timed from several threads at once.
+
+  ============================================================================
+*/
+#ifndef SVSTATS_defined
+#define SVSTATS_defined 120
+
+/* macros for smart prototypes */
+#ifndef ARGS
+#if (defined(__STDC__) || defined(VMS) || defined(__DECC)  || defined(MSDOS) || defined(__MSDOS__)) || defined (__CYGWIN__) || defined (_MSC_VER)
+#define ARGS(s) s
+#else
+#define ARGS(s) ()
+#endif
+#endif
+
+/* Stages, timed apart: the time of a stage run inside another is not
+   counted again in the outer one */
+#define SV_STAGE_HEADER         0   /* wav_open(): header parsing */
+#define SV_STAGE_READ           1   /* wav_read(): disk reads, or waits on the I/O thread */
+#define SV_STAGE_CONVERT        2   /* sh2fl(), fl2sh() and the like */
+#define SV_STAGE_VOLTMETER      3   /* speech voltmeter, P.56 */
+#define SV_STAGE_SCALE          4   /* equalization of the samples */
+#define SV_STAGE_FILTER_DESIGN  5   /* rate converter filters: dbesi0(), win(), hn_lpf() */
+#define SV_STAGE_FIR            6   /* rate converter, polyphase FIR (stage 1 up, 2 down) */
+#define SV_STAGE_FFT            7   /* rdft() */
+#define SV_STAGE_DITHER         8   /* requantization, with or without dither */
+#define SV_STAGE_WRITE          9   /* wav_out_write(): writes, or waits on the I/O thread */
+#define SV_STAGES               10
+
+/* Counters */
+#define SV_COUNT_BYTES_READ     0
+#define SV_COUNT_BYTES_WRITTEN  1
+#define SV_COUNT_SAMPLES        2   /* samples through the voltmeter */
+#define SV_COUNT_CLIPS          3   /* output samples saturated */
+#define SV_COUNT_FFT_CALLS      4
+#define SV_COUNT_CACHE_HITS     5   /* level index and result cache */
+#define SV_COUNT_CACHE_MISSES   6
+#define SV_COUNTERS             7
+
+/* Timers and counters, of a call or of the whole process */
+typedef struct {
+    double wall;                  /* seconds since sv_stats_begin(), or in total */
+    double seconds[SV_STAGES];    /* time in each stage */
+    unsigned long long calls[SV_STAGES]; /* times each stage was entered */
+    unsigned long long count[SV_COUNTERS];
+} sv_stats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Stage timer and counter prototypes */
+void sv_stats_begin ARGS((void));
+void sv_stats_get ARGS((sv_stats* call, sv_stats* total));
+void sv_stats_reset ARGS((void));
+const char* sv_stats_stage_name ARGS((int stage));
+const char* sv_stats_counter_name ARGS((int counter));
+void sv_stage_enter ARGS((int stage));
+void sv_stage_leave ARGS((void));
+void sv_count ARGS((int counter, unsigned long long n));
+
+/* Trace prototypes */
+int sv_trace_start ARGS((const char* file));
+int sv_trace_stop ARGS((void));
+void sv_trace_begin ARGS((const char* name, const char* file));
+void sv_trace_end ARGS((void));
+void sv_trace_thread ARGS((const char* name));
+
+/* Non-zero between sv_trace_start() and sv_trace_stop() */
+extern int sv_tracing;
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * The instrumentation, in the code of the stages: SV_NO_STATS defined at
+ * compile time takes it all out, sv_stats_get() then giving zeros. While
+ * no trace is taken, SV_TRACE_*() cost a test of sv_tracing.
+ */
+#ifndef SV_NO_STATS
+#define SV_STAGE_ENTER(stage)   sv_stage_enter(stage)
+#define SV_STAGE_LEAVE()        sv_stage_leave()
+#define SV_COUNT(counter, n)    sv_count((counter), (unsigned long long)(n))
+#define SV_TRACE_BEGIN(name, file) do { if (sv_tracing) sv_trace_begin((name), (file)); } while (0)
+#define SV_TRACE_END()          do { if (sv_tracing) sv_trace_end(); } while (0)
+#define SV_TRACE_THREAD(name)   do { if (sv_tracing) sv_trace_thread(name); } while (0)
+#else
+#define SV_STAGE_ENTER(stage)   ((void)0)
+#define SV_STAGE_LEAVE()        ((void)0)
+#define SV_COUNT(counter, n)    ((void)0)
+#define SV_TRACE_BEGIN(name, file) ((void)0)
+#define SV_TRACE_END()          ((void)0)
+#define SV_TRACE_THREAD(name)   ((void)0)
+#endif
+
+#endif /* SVSTATS_defined */
+/* ......................... End of SVSTATS.H ........................... */
@@ -1,4 +1,4 @@
-/*                                                            v3.0  06.Mar.96
+/*                                                            v3.5  19.Oct.26
 =============================================================================
 
                           U    U   GGG    SSSS  TTTTT
@@ -46,6 +46,10 @@ FUNCTIONS:
     sh2fl_12bit: .... conversion of an array from 12 bit to float (*)
     sh2fl: .......... generic function for conversion from short to float
 
+    sh2sh_scale: .... sh2fl(), scale() and fl2sh() fused, on 16-bit data
+
+    utl_simd: ....... caps the SIMD kernels of the functions above
+
     serialize_left_justified ....... serialization for left-justified data
     serialize_right_justified ...... serialization for right-justified data
     parallelize_left_justified ..... parallelization for left-justified data
@@ -89,6 +93,22 @@ HISTORY:
   06.Mar.96 v3.0 Created new parallelize_...() and serialize_...() functions
                  which comply to the bitstream definition given in Annex B
                  of G.192. <simao@ctd.comsat.com>
+  19.Oct.26 v3.1 Added sh2sh_scale(), the int16 -> gain -> int16 loop of
+                 the level equalization in one pass, vectorized with
+                 SSE2/AVX2 (AVX2 chosen at run time).
+  19.Oct.26 v3.2 scale(), sh2fl(), sh2fl_alt() and fl2sh() run whole
+                 vectors of samples through SSE2/AVX2 kernels, with the
+                 results and overflow counts of the scalar loops, which
+                 are kept for the tails and for other processors.
+  19.Oct.26 v3.3 serialize_...() and parallelize_...() make or read all
+                 the softbits of a sample at once with SSE2/AVX2, the
+                 scalar loops handling frame boundaries and tails.
+  19.Oct.26 v3.4 Conversions and scaling timed, and clippings counted
+                 (svstats.h).
+  19.Oct.26 v3.5 The SIMD level is found once and kept with atomic loads
+                 and stores, every call choosing its kernel from it, so
+                 that threads may convert at the same time; utl_simd()
+                 caps it, down to the scalar loops.
 =============================================================================
 */
 
@@ -98,12 +118,385 @@ HISTORY:
  */
 #include <string.h>             /* For memset() */
 #include "ugst-utl.h"           /* Module Function prototypes */
+#include "svstats.h"            /* Stage timers and counters */
+
+/* SSE2 is part of every x86-64 target; AVX2 is used only where the
+   processor reports it, the functions for it being compiled apart */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTL_SSE2
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#define UTL_AVX2
+#define UTL_TARGET_AVX2
+#elif defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#include <immintrin.h>
+#define UTL_AVX2
+#define UTL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+/* Atomic loads and stores of the SIMD levels below */
+#if defined(_MSC_VER)
+#define UTL_LOAD(p) _InterlockedCompareExchange((long volatile*)(p), 0, 0)
+#define UTL_STORE(p, v) _InterlockedExchange((long volatile*)(p), (v))
+#else
+#define UTL_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define UTL_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+/* The widest SIMD level of the processor (-1 until found), and the cap
+   set by utl_simd() */
+static long utl_cpu = -1;
+static long utl_cap = UTL_SIMD_AVX2;
+
+/* The SIMD level the processor, and the OS saving its registers, run.
+   Threads finding it at the same time all store the same value */
+static long utl_cpu_level(void) {
+    long level = UTL_LOAD(&utl_cpu);
+
+    if (level < 0) {
+        level = UTL_SIMD_NONE;
+#ifdef UTL_SSE2
+        level = UTL_SIMD_SSE2;
+#endif
+#ifdef UTL_AVX2
+#if defined(_MSC_VER)
+        {
+            int r[4];
+
+            __cpuid(r, 1);
+            if ((r[2] & (1 << 27)) != 0 && (r[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6) {
+                __cpuidex(r, 7, 0);
+                if ((r[1] & (1 << 5)) != 0)
+                    level = UTL_SIMD_AVX2;
+            }
+        }
+#else
+        /* libgcc finds the features before any constructor runs, so
+           this only reads them */
+        if (__builtin_cpu_supports("avx2"))
+            level = UTL_SIMD_AVX2;
+#endif
+#endif
+        UTL_STORE(&utl_cpu, level);
+    }
+    return level;
+}
+
+/* The level the kernels run at: that of the processor, within the cap */
+static long utl_level(void) {
+    long cpu = utl_cpu_level(), cap = UTL_LOAD(&utl_cap);
+
+    return cap < cpu ? cap : cpu;
+}
+
+/*
+ * .................... VECTOR KERNELS ....................
+ *
+ * The bulk of scale(), sh2fl(), sh2fl_alt() and fl2sh(): each kernel
+ * handles a whole number of vectors from the start of the arrays and
+ * returns how many samples that was, the caller's own loop finishing
+ * the tail from there. The arithmetic is that of the scalar loops
+ * (single precision products, double precision for the rounding of
+ * fl2sh()), so the results are the same bit for bit.
+ */
+#ifdef UTL_SSE2
+static long scale_sse2(float* buffer, long n, float f) {
+    __m128 vf = _mm_set1_ps(f);
+    long k;
+
+    for (k = 0; k + 8 <= n; k += 8) {
+        _mm_storeu_ps(buffer + k, _mm_mul_ps(_mm_loadu_ps(buffer + k), vf));
+        _mm_storeu_ps(buffer + k + 4, _mm_mul_ps(_mm_loadu_ps(buffer + k + 4), vf));
+    }
+    return k;
+}
+
+/* shift > 0 shifts ix in place first; norm != 0 multiplies by inv */
+static long sh2fl_sse2(long n, short* ix, float* y, int shift, short mask, int norm, float inv) {
+    __m128i v, vm = _mm_set1_epi16(mask), cnt = _mm_cvtsi32_si128(shift);
+    __m128 vinv = _mm_set1_ps(inv), a, b;
+    long k;
+
+    for (k = 0; k + 8 <= n; k += 8) {
+        v = _mm_loadu_si128((const __m128i*)(ix + k));
+        if (shift > 0) {
+            v = _mm_sra_epi16(v, cnt);
+            _mm_storeu_si128((__m128i*)(ix + k), v);
+        }
+        v = _mm_and_si128(v, vm);
+        a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+        if (norm) {
+            a = _mm_mul_ps(a, vinv);
+            b = _mm_mul_ps(b, vinv);
+        }
+        _mm_storeu_ps(y + k, a);
+        _mm_storeu_ps(y + k + 4, b);
+    }
+    return k;
+}
+
+/* fl2sh() with truncation; clips are added to *ovf */
+static long fl2sh_trunc_sse2(long n, float* x, short* iy, short mask, long* ovf) {
+    __m128 vs = _mm_set1_ps(32768.0f), vmax = _mm_set1_ps(32767.0f), vmin = _mm_set1_ps(-32768.0f), a, b;
+    __m128i vm = _mm_set1_epi16(mask), cnt = _mm_setzero_si128();
+    long k;
+
+    for (k = 0; k + 8 <= n; k += 8) {
+        /* x * 32768 is exact in single precision, as in double */
+        a = _mm_mul_ps(_mm_loadu_ps(x + k), vs);
+        b = _mm_mul_ps(_mm_loadu_ps(x + k + 4), vs);
+        cnt = _mm_sub_epi32(cnt, _mm_castps_si128(_mm_or_ps(_mm_cmpgt_ps(a, vmax), _mm_cmplt_ps(a, vmin))));
+        cnt = _mm_sub_epi32(cnt, _mm_castps_si128(_mm_or_ps(_mm_cmpgt_ps(b, vmax), _mm_cmplt_ps(b, vmin))));
+        a = _mm_min_ps(_mm_max_ps(a, vmin), vmax);
+        b = _mm_min_ps(_mm_max_ps(b, vmin), vmax);
+        _mm_storeu_si128((__m128i*)(iy + k), _mm_and_si128(_mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)), vm));
+    }
+    cnt = _mm_add_epi32(cnt, _mm_shuffle_epi32(cnt, 0x4E));
+    cnt = _mm_add_epi32(cnt, _mm_shuffle_epi32(cnt, 0xB1));
+    *ovf += _mm_cvtsi128_si32(cnt);
+    return k;
+}
+
+/* 2 samples of fl2sh() with rounding, in double: clipped, truncated */
+static __m128i fl2sh_round2_sse2(__m128d y, __m128d h, __m128i* cnt) {
+    __m128d vmax = _mm_set1_pd(32767.0), vmin = _mm_set1_pd(-32768.0);
+
+    /* y + half_lsb, or y - half_lsb below 0 */
+    y = _mm_add_pd(y, _mm_or_pd(h, _mm_and_pd(_mm_cmplt_pd(y, _mm_setzero_pd()), _mm_set1_pd(-0.0))));
+    *cnt = _mm_sub_epi64(*cnt, _mm_castpd_si128(_mm_or_pd(_mm_cmpgt_pd(y, vmax), _mm_cmplt_pd(y, vmin))));
+    return _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(y, vmin), vmax));
+}
+
+/* Masking of the magnitude, as fl2sh() does below 0: -(|t| & mask).
+   The sign of the truncated t stands for that of y: they differ only
+   where t is 0, which gives 0 either way */
+static __m128i fl2sh_mask_sse2(__m128i t, __m128i vm) {
+    __m128i s = _mm_srai_epi32(t, 31);
+
+    t = _mm_sub_epi32(_mm_xor_si128(t, s), s);
+    return _mm_sub_epi32(_mm_xor_si128(_mm_and_si128(t, vm), s), s);
+}
+
+static long fl2sh_round_sse2(long n, float* x, short* iy, double half_lsb, short mask, long* ovf) {
+    __m128d h = _mm_set1_pd(half_lsb), vs = _mm_set1_pd(32768.0);
+    __m128i vm = _mm_set1_epi32(mask), cnt = _mm_setzero_si128(), t0, t1;
+    __m128 a, b;
+    long k;
+
+    for (k = 0; k + 8 <= n; k += 8) {
+        a = _mm_loadu_ps(x + k);
+        b = _mm_loadu_ps(x + k + 4);
+        t0 = _mm_unpacklo_epi64(fl2sh_round2_sse2(_mm_mul_pd(_mm_cvtps_pd(a), vs), h, &cnt),
+                                fl2sh_round2_sse2(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(a, a)), vs), h, &cnt));
+        t1 = _mm_unpacklo_epi64(fl2sh_round2_sse2(_mm_mul_pd(_mm_cvtps_pd(b), vs), h, &cnt),
+                                fl2sh_round2_sse2(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(b, b)), vs), h, &cnt));
+        _mm_storeu_si128((__m128i*)(iy + k), _mm_packs_epi32(fl2sh_mask_sse2(t0, vm), fl2sh_mask_sse2(t1, vm)));
+    }
+    *ovf += (long)(_mm_cvtsi128_si32(cnt) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(cnt, cnt)));
+    return k;
+}
+#endif
+
+#ifdef UTL_AVX2
+UTL_TARGET_AVX2
+static long scale_avx2(float* buffer, long n, float f) {
+    __m256 vf = _mm256_set1_ps(f);
+    long k;
+
+    for (k = 0; k + 16 <= n; k += 16) {
+        _mm256_storeu_ps(buffer + k, _mm256_mul_ps(_mm256_loadu_ps(buffer + k), vf));
+        _mm256_storeu_ps(buffer + k + 8, _mm256_mul_ps(_mm256_loadu_ps(buffer + k + 8), vf));
+    }
+    return k;
+}
+
+UTL_TARGET_AVX2
+static long sh2fl_avx2(long n, short* ix, float* y, int shift, short mask, int norm, float inv) {
+    __m256i v, vm = _mm256_set1_epi16(mask);
+    __m128i cnt = _mm_cvtsi32_si128(shift);
+    __m256 vinv = _mm256_set1_ps(inv), a, b;
+    long k;
+
+    for (k = 0; k + 16 <= n; k += 16) {
+        v = _mm256_loadu_si256((const __m256i*)(ix + k));
+        if (shift > 0) {
+            v = _mm256_sra_epi16(v, cnt);
+            _mm256_storeu_si256((__m256i*)(ix + k), v);
+        }
+        v = _mm256_and_si256(v, vm);
+        a = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+        b = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+        if (norm) {
+            a = _mm256_mul_ps(a, vinv);
+            b = _mm256_mul_ps(b, vinv);
+        }
+        _mm256_storeu_ps(y + k, a);
+        _mm256_storeu_ps(y + k + 8, b);
+    }
+    return k;
+}
+
+UTL_TARGET_AVX2
+static long fl2sh_trunc_avx2(long n, float* x, short* iy, short mask, long* ovf) {
+    __m256 vs = _mm256_set1_ps(32768.0f), vmax = _mm256_set1_ps(32767.0f), vmin = _mm256_set1_ps(-32768.0f), a, b;
+    __m256i vm = _mm256_set1_epi16(mask), cnt = _mm256_setzero_si256(), v;
+    __m128i c;
+    long k;
+
+    for (k = 0; k + 16 <= n; k += 16) {
+        a = _mm256_mul_ps(_mm256_loadu_ps(x + k), vs);
+        b = _mm256_mul_ps(_mm256_loadu_ps(x + k + 8), vs);
+        cnt = _mm256_sub_epi32(cnt, _mm256_castps_si256(_mm256_or_ps(_mm256_cmp_ps(a, vmax, _CMP_GT_OQ), _mm256_cmp_ps(a, vmin, _CMP_LT_OQ))));
+        cnt = _mm256_sub_epi32(cnt, _mm256_castps_si256(_mm256_or_ps(_mm256_cmp_ps(b, vmax, _CMP_GT_OQ), _mm256_cmp_ps(b, vmin, _CMP_LT_OQ))));
+        a = _mm256_min_ps(_mm256_max_ps(a, vmin), vmax);
+        b = _mm256_min_ps(_mm256_max_ps(b, vmin), vmax);
+
+        /* packs works within 128-bit lanes: put the quadwords back in order */
+        v = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+        v = _mm256_permute4x64_epi64(v, 0xD8);
+        _mm256_storeu_si256((__m256i*)(iy + k), _mm256_and_si256(v, vm));
+    }
+    c = _mm_add_epi32(_mm256_castsi256_si128(cnt), _mm256_extracti128_si256(cnt, 1));
+    c = _mm_add_epi32(c, _mm_shuffle_epi32(c, 0x4E));
+    c = _mm_add_epi32(c, _mm_shuffle_epi32(c, 0xB1));
+    *ovf += _mm_cvtsi128_si32(c);
+    return k;
+}
+
+UTL_TARGET_AVX2
+static __m128i fl2sh_round4_avx2(__m128 x, __m256d h, __m128i vm, __m256i* cnt) {
+    __m256d vmax = _mm256_set1_pd(32767.0), vmin = _mm256_set1_pd(-32768.0), y;
+    __m128i t, s;
+
+    y = _mm256_mul_pd(_mm256_cvtps_pd(x), _mm256_set1_pd(32768.0));
+    y = _mm256_add_pd(y, _mm256_or_pd(h, _mm256_and_pd(_mm256_cmp_pd(y, _mm256_setzero_pd(), _CMP_LT_OQ), _mm256_set1_pd(-0.0))));
+    *cnt = _mm256_sub_epi64(*cnt, _mm256_castpd_si256(_mm256_or_pd(_mm256_cmp_pd(y, vmax, _CMP_GT_OQ), _mm256_cmp_pd(y, vmin, _CMP_LT_OQ))));
+    t = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(y, vmin), vmax));
+
+    /* -(|t| & mask) below 0, as fl2sh_mask_sse2() */
+    s = _mm_srai_epi32(t, 31);
+    t = _mm_sub_epi32(_mm_xor_si128(t, s), s);
+    return _mm_sub_epi32(_mm_xor_si128(_mm_and_si128(t, vm), s), s);
+}
+
+UTL_TARGET_AVX2
+static long fl2sh_round_avx2(long n, float* x, short* iy, double half_lsb, short mask, long* ovf) {
+    __m256d h = _mm256_set1_pd(half_lsb);
+    __m256i cnt = _mm256_setzero_si256();
+    __m128i vm = _mm_set1_epi32(mask), t0, t1;
+    long k;
+
+    for (k = 0; k + 8 <= n; k += 8) {
+        t0 = fl2sh_round4_avx2(_mm_loadu_ps(x + k), h, vm, &cnt);
+        t1 = fl2sh_round4_avx2(_mm_loadu_ps(x + k + 4), h, vm, &cnt);
+        _mm_storeu_si128((__m128i*)(iy + k), _mm_packs_epi32(t0, t1));
+    }
+    t0 = _mm_add_epi64(_mm256_castsi256_si128(cnt), _mm256_extracti128_si256(cnt, 1));
+    *ovf += (long)(_mm_cvtsi128_si32(t0) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(t0, t0)));
+    return k;
+}
+#endif
+
+/* Dispatch: AVX2 where the processor has it, else SSE2, else none,
+   within the cap of utl_simd() */
+static long utl_scale(float* buffer, long n, float f) {
+    long level = utl_level();
+
+#ifdef UTL_AVX2
+    if (level >= UTL_SIMD_AVX2)
+        return scale_avx2(buffer, n, f);
+#endif
+#ifdef UTL_SSE2
+    if (level >= UTL_SIMD_SSE2)
+        return scale_sse2(buffer, n, f);
+#endif
+    return 0;
+}
+
+static long utl_sh2fl(long n, short* ix, float* y, int shift, short mask, int norm, float inv) {
+    long level = utl_level();
+
+#ifdef UTL_AVX2
+    if (level >= UTL_SIMD_AVX2)
+        return sh2fl_avx2(n, ix, y, shift, mask, norm, inv);
+#endif
+#ifdef UTL_SSE2
+    if (level >= UTL_SIMD_SSE2)
+        return sh2fl_sse2(n, ix, y, shift, mask, norm, inv);
+#endif
+    return 0;
+}
+
+static long utl_fl2sh(long n, float* x, short* iy, double half_lsb, short mask, long* ovf) {
+    long level = utl_level();
+
+#ifdef UTL_AVX2
+    if (level >= UTL_SIMD_AVX2)
+        return half_lsb == 0.0 ? fl2sh_trunc_avx2(n, x, iy, mask, ovf) : fl2sh_round_avx2(n, x, iy, half_lsb, mask, ovf);
+#endif
+#ifdef UTL_SSE2
+    if (level >= UTL_SIMD_SSE2)
+        return half_lsb == 0.0 ? fl2sh_trunc_sse2(n, x, iy, mask, ovf) : fl2sh_round_sse2(n, x, iy, half_lsb, mask, ovf);
+#endif
+    return 0;
+}
 
 
  /*
   * .................... FUNCTIONS ....................
   */
 
+/*
+  --------------------------------------------------------------------------
+
+        int utl_simd (int max);
+        ~~~~~~~~~~~~
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Caps the SIMD kernels of scale(), sh2fl(), sh2fl_alt(), fl2sh(),
+        sh2sh_scale(), serialize_...() and parallelize_...() at `max':
+        UTL_SIMD_NONE runs the scalar loops only, UTL_SIMD_SSE2 up to
+        SSE2, UTL_SIMD_AVX2 (the default) whatever the processor has.
+        The results are the same bit for bit at every level, which is
+        what the cap is for: checking the kernels against the loops.
+        A negative `max' leaves the cap as it is.
+
+        The level of the processor is found at the first call of any of
+        these functions, and kept with an atomic store; the cap too is
+        read and written atomically, so that it may be changed while
+        other threads convert (each call runs at one level throughout).
+
+        Parameters:
+        ~~~~~~~~~~~
+        max ......... the widest level to run, or -1.
+
+        Returns value:
+        ~~~~~~~~~~~~~~
+        Returns the level the functions now run at: the cap, or less
+        where the processor or the compiler do not have it.
+
+        Prototype:  in ugst-utl.h
+        ~~~~~~~~~~
+
+        History:
+        ~~~~~~~~
+        19.Oct.26 v1.0 Release of 1st version.
+
+  --------------------------------------------------------------------------
+*/
+int utl_simd(int max) {
+    if (max >= 0)
+        UTL_STORE(&utl_cap, (long)(max < UTL_SIMD_AVX2 ? max : UTL_SIMD_AVX2));
+    return (int)utl_level();
+}                               /* ....... end of utl_simd() ....... */
+
+
   /*
   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
@@ -155,6 +548,7 @@ HISTORY:
           ~~~~~~~~~~~~~~~
           Dates        Version        Description
           11.Oct.91      1.0        First release in C.
+          19.Oct.26      1.1        SSE2/AVX2 kernel for whole vectors.
 
   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
   */
@@ -162,9 +556,11 @@ long scale(float* buffer, long smpno, double factor) {
     register long j;
     register float f;
 
-    /* scales all of the samples */
-    for (f = (float)factor, j = 0; j < smpno; j++)
+    /* scales all of the samples, whole vectors first */
+    SV_STAGE_ENTER(SV_STAGE_SCALE);
+    for (f = (float)factor, j = utl_scale(buffer, smpno, f); j < smpno; j++)
         buffer[j] *= f;
+    SV_STAGE_LEAVE();
 
     /* and return the number of scaled samples */
     return (j);
@@ -250,16 +646,26 @@ long scale(float* buffer, long smpno, double factor) {
                        in the integer range (-32768.0 .. 32767.0).
         27.Nov.92 v1.4 fl2sh() corrected for negative values
                        <hf@pkinbg.uucp>
+        19.Oct.26 v1.5 SSE2/AVX2 kernels for whole vectors, for both
+                       truncation and rounding, with the same results.
+                       -y goes to short through long, for -32768.0 to
+                       give 0x8000 as meant, not whatever a saturating
+                       (vectorized) conversion makes of it.
 
   --------------------------------------------------------------------------
 */
 
 long fl2sh(long n, float* x, short* iy, double half_lsb, short mask) {
-    register long iOvrFlw, k;
+    register long k;
     register double y;
+    long iOvrFlw, k0;
 
     /* Reset overflow counter */
     iOvrFlw = 0;
+    SV_STAGE_ENTER(SV_STAGE_CONVERT);
+
+    /* Whole vectors first, by the same rules; the loops do the rest */
+    k0 = utl_fl2sh(n, x, iy, half_lsb, mask, &iOvrFlw);
 
     /* Loop over all input samples: assume result left justified in array */
 
@@ -267,7 +673,7 @@ long fl2sh(long n, float* x, short* iy, double half_lsb, short mask) {
     /* Perform 2's complement truncation if "no rounding" is selected */
     /* ------------------------------------------------------------------------ */
     if (half_lsb == 0.0) {
-        for (k = 0; k < n; k++) {
+        for (k = k0; k < n; k++) {
             /* Convert input data from normalized to 16-bit range (still float) */
             y = x[k] * 32768;
 
@@ -290,7 +696,7 @@ long fl2sh(long n, float* x, short* iy, double half_lsb, short mask) {
     /* Perform Magnitude Rounding */
     /* ---------------------------------------------------------------------- */
     else {
-        for (k = 0; k < n; k++) {
+        for (k = k0; k < n; k++) {
             /* Convert input data from normalized to 16-bit range (still float) */
             y = x[k] * 32768;
             if (y >= 0.0)
@@ -317,7 +723,7 @@ long fl2sh(long n, float* x, short* iy, double half_lsb, short mask) {
             }
             else {
                 /* if (y < 0.0) */
-                iy[k] = (short)(-y);   /* iy will be 0x8000 even if y = -32768.0 */
+                iy[k] = (short)(long)(-y);   /* iy will be 0x8000 even if y = -32768.0 */
                 iy[k] &= mask;
                 iy[k] = -iy[k];
             }
@@ -325,6 +731,8 @@ long fl2sh(long n, float* x, short* iy, double half_lsb, short mask) {
     }
 
     /* Return number of overflows */
+    SV_COUNT(SV_COUNT_CLIPS, iOvrFlw);
+    SV_STAGE_LEAVE();
     return iOvrFlw;
 }                               /* ......... end of fl2sh() ......... */
 
@@ -376,6 +784,7 @@ long fl2sh(long n, float* x, short* iy, double half_lsb, short mask) {
                samples are always normalised to -1.0 ... +1.0.
                The input vector is not changed.
                <bloecher@pkinbg.uucp>
+        19.Oct.26 v1.1 SSE2/AVX2 kernel for whole vectors.
 
   --------------------------------------------------------------------------
 */
@@ -385,8 +794,15 @@ void sh2fl_alt(long n, short* ix, float* y, short mask) {
     register float factor;
 
 
-    for (k = 0, factor = (1. / 32768.); k < n; k++)
+    /* Whole vectors first */
+    SV_STAGE_ENTER(SV_STAGE_CONVERT);
+    k = utl_sh2fl(n, ix, y, 0, mask, 1, (float)(1. / 32768.));
+    ix += k;
+    y += k;
+
+    for (factor = (1. / 32768.); k < n; k++)
         *y++ = factor * ((*ix++) & mask);
+    SV_STAGE_LEAVE();
 
 }                               /* ......... end of sh2fl_alt() ......... */
 
@@ -439,39 +855,329 @@ void sh2fl_alt(long n, short* ix, float* y, short mask) {
                        <tdsimao@venus.cpqd.ansp.br>
         27.Nov.92 v1.2 Corrected bug when left-adjusting to the
                        desired resolution <bloecher@pkinbg.uucp>
+        19.Oct.26 v1.3 SSE2/AVX2 kernel for whole vectors.
 
   --------------------------------------------------------------------------
 */
 
 void sh2fl(long n, short* ix, float* y, long resolution, char norm) {
     register long k;
-    float factor;
+    float factor = 1;
+    long k0 = 0;
+
+    /* Factor for normalization */
+    SV_STAGE_ENTER(SV_STAGE_CONVERT);
+    if (norm)
+        for (factor = 32768.0, k = 16 - resolution; k > 0; k--)
+            factor /= 2;
+
+    /* Whole vectors first: shifted, converted and normalized (by the
+       power of 2 1/factor, which is exact) in one go */
+    if (resolution >= 1 && resolution <= 16)
+        k0 = utl_sh2fl(n, ix, y, (int)(16 - resolution), (short)0xFFFF, norm, 1 / factor);
 
     /* Shift of left-adjusted samples to the desired resolution */
     if (resolution != 16) {       /* Block been correct as per suggestion from <bloecher@pkinbg.uucp> */
         register long tmp;
         tmp = 16 - resolution;
-        for (k = 0; k < n; k++)
+        for (k = k0; k < n; k++)
             ix[k] >>= tmp;
     }
 
-    /* Factor for normalization */
-    if (norm)
-        for (factor = 32768.0, k = 16 - resolution; k > 0; k--)
-            factor /= 2;
-
     /* Convert all samples */
-    for (k = 0; k < n; k++)
+    for (k = k0; k < n; k++)
         y[k] = (float)ix[k];
 
     /* Normalize samples, fi requested, to the range -1..+1 */
     if (norm)
-        for (k = 0; k < n; k++)
+        for (k = k0; k < n; k++)
             y[k] /= factor;
+    SV_STAGE_LEAVE();
 
 }                               /* ......... end of sh2fl() ......... */
 
 
+/*
+  --------------------------------------------------------------------------
+
+        long sh2sh_scale (long n, short *ix, short *iy, double factor,
+        ~~~~~~~~~~~~~~~~  long resolution, short mask);
+
+        Description:
+        ~~~~~~~~~~~~
+
+        Gain/loss insertion on 16-bit data, fused: does in one pass over
+        the samples what
+
+            sh2fl(n, ix, y, resolution, 1);
+            scale(y, n, factor);
+            fl2sh(n, y, iy, 0.0, mask);
+
+        does in three, with the same results bit for bit: the samples
+        are scaled in single precision, hard clipped (clips counted) and
+        truncated, then masked. Unlike sh2fl(), ix is left unchanged;
+        ix and iy may be the same array.
+
+        The work is done 8 samples at a time with SSE2, or with AVX2
+        where the processor has it (found once, see utl_simd()), and
+        in plain C elsewhere.
+
+        Parameters:
+        ~~~~~~~~~~~
+        n ........... is the number of samples in ix[];
+        ix .......... is input short array's pointer;
+        iy .......... is output short array's pointer;
+        factor ...... is the scaling factor;
+        resolution .. is the resolution (number of bits) of the input
+                      data, as for sh2fl();
+        mask ........ unsigned masking of the lower (right) bits of the
+                      output, as for fl2sh().
+
+        Returns value:
+        ~~~~~~~~~~~~~~
+        Returns the number of overflows that happened.
+
+        Prototype:  in ugst-utl.h
+        ~~~~~~~~~~
+
+        History:
+        ~~~~~~~~
+        19.Oct.26 v1.0 Release of 1st version.
+        19.Oct.26 v1.1 Kernel chosen at every call, with no state shared
+                       between threads.
+
+  --------------------------------------------------------------------------
+*/
+
+/* Plain C; also the tail of the vector versions */
+static long sh2sh_scale_c(long n, short* ix, short* iy, float f, short in_mask, short mask) {
+    register long k, iOvrFlw = 0;
+    register float y;
+
+    for (k = 0; k < n; k++) {
+        y = (float)(short)(ix[k] & in_mask) * f;
+        if (y > 32767.0f) {
+            y = 32767.0f;
+            iOvrFlw++;
+        }
+        else if (y < -32768.0f) {
+            y = -32768.0f;
+            iOvrFlw++;
+        }
+        iy[k] = (short)y & mask;
+    }
+    return iOvrFlw;
+}
+
+#ifdef UTL_SSE2
+static long sh2sh_scale_sse2(long n, short* ix, short* iy, float f, short in_mask, short mask) {
+    __m128 vf = _mm_set1_ps(f), vmax = _mm_set1_ps(32767.0f), vmin = _mm_set1_ps(-32768.0f);
+    __m128i vin = _mm_set1_epi16(in_mask), vout = _mm_set1_epi16(mask), cnt = _mm_setzero_si128();
+    __m128i v, lo, hi;
+    __m128 a, b;
+    long k, c[4];
+
+    for (k = 0; k + 8 <= n; k += 8) {
+        /* 8 samples, sign-extended to 32 bits, as floats */
+        v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(ix + k)), vin);
+        lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        a = _mm_mul_ps(_mm_cvtepi32_ps(lo), vf);
+        b = _mm_mul_ps(_mm_cvtepi32_ps(hi), vf);
+
+        /* Clips are counted lane by lane: a true compare is -1 */
+        cnt = _mm_sub_epi32(cnt, _mm_castps_si128(_mm_or_ps(_mm_cmpgt_ps(a, vmax), _mm_cmplt_ps(a, vmin))));
+        cnt = _mm_sub_epi32(cnt, _mm_castps_si128(_mm_or_ps(_mm_cmpgt_ps(b, vmax), _mm_cmplt_ps(b, vmin))));
+        a = _mm_min_ps(_mm_max_ps(a, vmin), vmax);
+        b = _mm_min_ps(_mm_max_ps(b, vmin), vmax);
+
+        /* Truncation, back to 16 bits, then the mask */
+        v = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+        _mm_storeu_si128((__m128i*)(iy + k), _mm_and_si128(v, vout));
+    }
+    c[0] = _mm_cvtsi128_si32(cnt);
+    c[1] = _mm_cvtsi128_si32(_mm_shuffle_epi32(cnt, 0x55));
+    c[2] = _mm_cvtsi128_si32(_mm_shuffle_epi32(cnt, 0xAA));
+    c[3] = _mm_cvtsi128_si32(_mm_shuffle_epi32(cnt, 0xFF));
+    return c[0] + c[1] + c[2] + c[3] + sh2sh_scale_c(n - k, ix + k, iy + k, f, in_mask, mask);
+}
+#endif
+
+#ifdef UTL_AVX2
+UTL_TARGET_AVX2
+static long sh2sh_scale_avx2(long n, short* ix, short* iy, float f, short in_mask, short mask) {
+    __m256 vf = _mm256_set1_ps(f), vmax = _mm256_set1_ps(32767.0f), vmin = _mm256_set1_ps(-32768.0f);
+    __m256i vin = _mm256_set1_epi16(in_mask), vout = _mm256_set1_epi16(mask), cnt = _mm256_setzero_si256();
+    __m256i v, lo, hi;
+    __m256 a, b;
+    __m128i c;
+    long k;
+
+    for (k = 0; k + 16 <= n; k += 16) {
+        v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(ix + k)), vin);
+        lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+        hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+        a = _mm256_mul_ps(_mm256_cvtepi32_ps(lo), vf);
+        b = _mm256_mul_ps(_mm256_cvtepi32_ps(hi), vf);
+
+        cnt = _mm256_sub_epi32(cnt, _mm256_castps_si256(_mm256_or_ps(_mm256_cmp_ps(a, vmax, _CMP_GT_OQ), _mm256_cmp_ps(a, vmin, _CMP_LT_OQ))));
+        cnt = _mm256_sub_epi32(cnt, _mm256_castps_si256(_mm256_or_ps(_mm256_cmp_ps(b, vmax, _CMP_GT_OQ), _mm256_cmp_ps(b, vmin, _CMP_LT_OQ))));
+        a = _mm256_min_ps(_mm256_max_ps(a, vmin), vmax);
+        b = _mm256_min_ps(_mm256_max_ps(b, vmin), vmax);
+
+        /* packs works within 128-bit lanes: put the quadwords back in order */
+        v = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+        v = _mm256_permute4x64_epi64(v, 0xD8);
+        _mm256_storeu_si256((__m256i*)(iy + k), _mm256_and_si256(v, vout));
+    }
+    c = _mm_add_epi32(_mm256_castsi256_si128(cnt), _mm256_extracti128_si256(cnt, 1));
+    c = _mm_add_epi32(c, _mm_shuffle_epi32(c, 0x4E));
+    c = _mm_add_epi32(c, _mm_shuffle_epi32(c, 0xB1));
+    return _mm_cvtsi128_si32(c) + sh2sh_scale_c(n - k, ix + k, iy + k, f, in_mask, mask);
+}
+#endif
+
+long sh2sh_scale(long n, short* ix, short* iy, double factor, long resolution, short mask) {
+    long (*kernel)(long, short*, short*, float, short, short) = sh2sh_scale_c;
+    long level = utl_level();
+    short in_mask;
+    long ovf;
+
+    /* The widest version the processor runs, within the cap */
+#ifdef UTL_SSE2
+    if (level >= UTL_SIMD_SSE2)
+        kernel = sh2sh_scale_sse2;
+#endif
+#ifdef UTL_AVX2
+    if (level >= UTL_SIMD_AVX2)
+        kernel = sh2sh_scale_avx2;
+#endif
+
+    /* Shifting right by 16 - resolution then normalizing by 32768 >>
+       (16 - resolution), as sh2fl() does, is clearing the low bits */
+    in_mask = (short)(0xFFFF << (16 - resolution));
+    SV_STAGE_ENTER(SV_STAGE_SCALE);
+    ovf = kernel(n, ix, iy, (float)factor, in_mask, mask);
+    SV_COUNT(SV_COUNT_CLIPS, ovf);
+    SV_STAGE_LEAVE();
+    return ovf;
+}                               /* ....... end of sh2sh_scale() ....... */
+
+
+/*
+ * .................... BITSTREAM KERNELS ....................
+ *
+ * The bulk of the serialize_...() and parallelize_...() functions. A
+ * sample's softbits, at most 16 words, are made (or read) in one go:
+ * the sample is broadcast to all lanes, each lane tests its own bit
+ * and picks EID_ONE or EID_ZERO; the other way, the words are compared
+ * with EID_ONE and the lanes gathered into one bit each. A sample's
+ * vector may reach past its resol words, over the next sample's (which
+ * are then written over, or read again), so the kernels stop while
+ * there is still a whole vector left before `end'. The parallelizing
+ * kernel also stops where a sample starts with a sync word or a bad
+ * frame flag, that the caller's loop deals with before starting it
+ * again after them. One-bit samples are left to the scalar loops, which
+ * are as fast for them.
+ */
+#define EID_ZERO  0x007F
+#define EID_ONE   0x0081
+#define SYNC_WORD 0x6B21
+#define BAD_FRAME 0x6B20
+
+#ifdef UTL_SSE2
+/* Softbits of (par[j] >> shift), lowest bit first, for j up to n */
+static long ser_sse2(short* par, unsigned short* bs, unsigned short* end, long n, long resol, int shift) {
+    __m128i b0 = _mm_setr_epi16(0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080);
+    __m128i b1 = _mm_slli_epi16(b0, 8);
+    __m128i zero = _mm_set1_epi16(EID_ZERO), flip = _mm_set1_epi16(EID_ONE ^ EID_ZERO);
+    __m128i v;
+    long j, width = resol > 8 ? 16 : 8;
+
+    for (j = 0; j < n && bs + width <= end; j++, bs += resol) {
+        v = _mm_set1_epi16((short)(par[j] >> shift));
+        _mm_storeu_si128((__m128i*)bs, _mm_xor_si128(zero, _mm_and_si128(flip, _mm_cmpeq_epi16(_mm_and_si128(v, b0), b0))));
+        if (width > 8)
+            _mm_storeu_si128((__m128i*)(bs + 8), _mm_xor_si128(zero, _mm_and_si128(flip, _mm_cmpeq_epi16(_mm_and_si128(v, b1), b1))));
+    }
+    return j;
+}
+
+/* Samples of resol softbits, sign extended if sign != 0, for j up to n */
+static long par_sse2(unsigned short* bs, unsigned short* end, short* par, long n, long resol, int sign) {
+    __m128i one = _mm_set1_epi16(EID_ONE), hi = _mm_setzero_si128();
+    unsigned long bits, mask = (1UL << resol) - 1;
+    long j, width = resol > 8 ? 16 : 8;
+
+    for (j = 0; j < n && bs + width <= end; j++, bs += resol) {
+        if (*bs == SYNC_WORD || *bs == BAD_FRAME)
+            break;
+        if (width > 8)
+            hi = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(bs + 8)), one);
+        bits = (unsigned long)_mm_movemask_epi8(_mm_packs_epi16(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)bs), one), hi)) & mask;
+        if (sign && (bits >> (resol - 1)) != 0)
+            bits |= ~mask;
+        par[j] = (short)(unsigned short)bits;
+    }
+    return j;
+}
+#endif
+
+#ifdef UTL_AVX2
+UTL_TARGET_AVX2
+static long ser_avx2(short* par, unsigned short* bs, unsigned short* end, long n, long resol, int shift) {
+    __m256i b = _mm256_setr_epi16(0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+        0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, (short)0x8000);
+    __m256i zero = _mm256_set1_epi16(EID_ZERO), flip = _mm256_set1_epi16(EID_ONE ^ EID_ZERO);
+    __m256i v;
+    long j;
+
+    for (j = 0; j < n && bs + 16 <= end; j++, bs += resol) {
+        v = _mm256_set1_epi16((short)(par[j] >> shift));
+        _mm256_storeu_si256((__m256i*)bs, _mm256_xor_si256(zero, _mm256_and_si256(flip, _mm256_cmpeq_epi16(_mm256_and_si256(v, b), b))));
+    }
+    return j;
+}
+#endif
+
+/* Dispatch: AVX2 where the processor has it, else SSE2, else none,
+   within the cap of utl_simd(). The gathering of at most 16 softbits
+   fits SSE2 registers: parallelizing has no AVX2 version */
+static long utl_serialize(short* par, unsigned short* bs, unsigned short* end, long n, long resol, int shift) {
+    long level = utl_level();
+
+    if (resol < 2 || resol > 16)
+        return 0;
+#ifdef UTL_AVX2
+    if (level >= UTL_SIMD_AVX2 && resol > 8)
+        return ser_avx2(par, bs, end, n, resol, shift);
+#endif
+#ifdef UTL_SSE2
+    if (level >= UTL_SIMD_SSE2)
+        return ser_sse2(par, bs, end, n, resol, shift);
+#endif
+    return 0;
+}
+
+static long utl_parallelize(unsigned short* bs, unsigned short* end, short* par, long n, long resol, int sign) {
+    long level = utl_level();
+
+    if (resol < 2 || resol > 16)
+        return 0;
+#ifdef UTL_SSE2
+    if (level >= UTL_SIMD_SSE2)
+        return par_sse2(bs, end, par, n, resol, sign);
+#endif
+    return 0;
+}
+
+#undef BAD_FRAME
+#undef EID_ONE
+#undef EID_ZERO
+#undef SYNC_WORD
+/* .................... End of bitstream kernels .................... */
+
+
 
 /*
  ============================================================================
@@ -570,6 +1276,7 @@ void sh2fl(long n, short* ix, float* y, long resolution, char norm) {
         06.Jun.95 v2.0 Exchanged definition of softbits '1' and '0' for
                        compatibitilty with EID module, HW, and Rec.G.192
                        <simao@ctd.comsat.com>
+        19.Oct.26 v2.1 SSE2/AVX2 kernel for whole samples.
  ============================================================================
 */
 #define EID_ZERO  0x007F
@@ -602,7 +1309,10 @@ long serialize_right_justifiedstl92(short* par_buf, short* bit_stm, long n, long
         *bs++ = SYNC_WORD;
 
     /* Convert every sample in parallel buffer into a bitstream, including a sync word if requested */
-    for (j = 0; j < n; j++) {
+    /* Whole samples through the vector kernel, the rest bit by bit below */
+    j = utl_serialize(par_buf, bs, bs + n * resol, n, resol, 0);
+    bs += j * resol;
+    for (; j < n; j++) {
         /* Convert input word to unsigned */
         tmp = (unsigned short)par_buf[j];
 
@@ -729,6 +1439,7 @@ long serialize_right_justifiedstl92(short* par_buf, short* bit_stm, long n, long
         06.Jun.95 v2.0 Exchanged definition of softbits '1' and '0' for
                        compatibitilty with EID module, HW, and Rec.G.192
                        <simao@ctd.comsat.com>
+        19.Oct.26 v2.1 SSE2/AVX2 kernel for whole samples.
 
  ============================================================================
 */
@@ -757,6 +1468,12 @@ long parallelize_right_justifiedstl92(short* bit_stm, short* par_buf, long bs_le
 
     /* Convert every sample in parallel buffer into a bitstream, including a sync word if requested */
     for (j = 0; j < n; j++) {
+        /* Samples up to the next frame boundary through the vector kernel */
+        k = utl_parallelize(bs, (unsigned short*)bit_stm + bs_len, par_buf + j, n - j, resol, 0);
+        bs += k * resol;
+        if ((j += k) >= n)
+            break;
+
         /* Skip sync word if present */
         if (*bs == SYNC_WORD)
             bs++;
@@ -866,6 +1583,7 @@ long parallelize_right_justifiedstl92(short* bit_stm, short* par_buf, long bs_le
         06.Jun.95 v2.0 Exchanged definition of softbits '1' and '0' for
                        compatibitilty with EID module, HW, and Rec.G.192
                        <simao@ctd.comsat.com>
+        19.Oct.26 v2.1 SSE2/AVX2 kernel for whole samples.
 
  ============================================================================
 */
@@ -902,7 +1620,10 @@ long serialize_left_justifiedstl92(short* par_buf, short* bit_stm, long n, long
     l = 16 - resol;
 
     /* Convert every sample in parallel buffer into a bitstream, including a sync word if requested */
-    for (j = 0; j < n; j++) {
+    /* Whole samples through the vector kernel, the rest bit by bit below */
+    j = utl_serialize(par_buf, bs, bs + n * resol, n, resol, l);
+    bs += j * resol;
+    for (; j < n; j++) {
         /* Convert input word to unsigned */
         tmp = (unsigned short)(par_buf[j] >> l);
 
@@ -1012,6 +1733,7 @@ long serialize_left_justifiedstl92(short* par_buf, short* bit_stm, long n, long
         06.Jun.95 v2.0 Exchanged definition of softbits '1' and '0' for
                        compatibitilty with EID module, HW, and Rec.G.192
                        <simao@ctd.comsat.com>
+        19.Oct.26 v2.1 SSE2/AVX2 kernel for whole samples.
 
  ============================================================================
 */
@@ -1040,6 +1762,12 @@ long parallelize_left_justifiedstl92(short* bit_stm, short* par_buf, long bs_len
 
     /* Convert every sample in parallel buffer into a bitstream, including a sync word if requested */
     for (j = 0; j < n; j++) {
+        /* Samples up to the next frame boundary through the vector kernel */
+        k = utl_parallelize(bs, (unsigned short*)bit_stm + bs_len, par_buf + j, n - j, resol, 1);
+        bs += k * resol;
+        if ((j += k) >= n)
+            break;
+
         /* Skip sync word if present */
         if (*bs == SYNC_WORD)
             bs++;
@@ -1202,6 +1930,7 @@ long parallelize_left_justifiedstl92(short* bit_stm, short* par_buf, long bs_len
         06.Mar.96 v1.0 Created based on the STL92 version, however using
                        the bitstream definition in Annex B of G.192.
                        <simao@ctd.comsat.com>
+        19.Oct.26 v1.1 SSE2/AVX2 kernel for whole samples.
  ============================================================================
 */
 #define EID_ZERO  0x007F
@@ -1237,7 +1966,10 @@ long serialize_right_justifiedstl96(short* par_buf, short* bit_stm, long n, long
     }
 
     /* Convert every sample in parallel buffer into a bitstream, including a sync word if requested */
-    for (j = 0; j < n; j++) {
+    /* Whole samples through the vector kernel, the rest bit by bit below */
+    j = utl_serialize(par_buf, bs, bs + n * resol, n, resol, 0);
+    bs += j * resol;
+    for (; j < n; j++) {
         /* Convert input right-justified word to unsigned */
         tmp = (unsigned short)par_buf[j];
 
@@ -1390,6 +2122,7 @@ long serialize_right_justifiedstl96(short* par_buf, short* bit_stm, long n, long
         06.Mar.96 v1.0 Created based on the STL92 version, however using
                        the bitstream definition in Annex B of G.192.
                        <simao@ctd.comsat.com>
+        19.Oct.26 v1.1 SSE2/AVX2 kernel for whole samples.
 
  ============================================================================
 */
@@ -1435,6 +2168,12 @@ long parallelize_right_justifiedstl96(short* bit_stm, short* par_buf, long bs_le
 
       /* Convert every softbit in serial buffer to a parallel sample format */
     for (j = 0; j < n; j++) {
+        /* Samples up to the next frame boundary through the vector kernel */
+        k = utl_parallelize(bs, (unsigned short*)bit_stm + bs_len, par_buf + j, n - j, resol, 0);
+        bs += k * resol;
+        if ((j += k) >= n)
+            break;
+
         /* If bad frame indicator present, no valid samples are returned. The output buffer will contain just zero samples */
         if (*bs == BAD_FRAME)
             return (0l);
@@ -1554,6 +2293,7 @@ long parallelize_right_justifiedstl96(short* bit_stm, short* par_buf, long bs_le
         06.Mar.96 v1.0 Created based on the STL92 version, however using
                        the bitstream definition in Annex B of G.192.
                        <simao@ctd.comsat.com>
+        19.Oct.26 v1.1 SSE2/AVX2 kernel for whole samples.
 
  ============================================================================
 */
@@ -1593,7 +2333,10 @@ long serialize_left_justifiedstl96(short* par_buf, short* bit_stm, long n, long
     l = 16 - resol;
 
     /* Convert every sample in parallel buffer into a bitstream, including a sync word if requested */
-    for (j = 0; j < n; j++) {
+    /* Whole samples through the vector kernel, the rest bit by bit below */
+    j = utl_serialize(par_buf, bs, bs + n * resol, n, resol, l);
+    bs += j * resol;
+    for (; j < n; j++) {
         /* Convert input word to unsigned */
         tmp = (unsigned short)(par_buf[j] >> l);
 
@@ -1725,6 +2468,7 @@ long serialize_left_justifiedstl96(short* par_buf, short* bit_stm, long n, long
         06.Mar.96 v1.0 Created based on the STL92 version, however using
                        the bitstream definition in Annex B of G.192.
                        <simao@ctd.comsat.com>
+        19.Oct.26 v1.1 SSE2/AVX2 kernel for whole samples.
 
  ============================================================================
 */
@@ -1769,6 +2513,12 @@ long parallelize_left_justifiedstl96(short* bit_stm, short* par_buf, long bs_len
 
       /* Convert every sample in parallel buffer into a bitstream, including a sync word if requested */
     for (j = 0; j < n; j++) {
+        /* Samples up to the next frame boundary through the vector kernel */
+        k = utl_parallelize(bs, (unsigned short*)bit_stm + bs_len, par_buf + j, n - j, resol, 1);
+        bs += k * resol;
+        if ((j += k) >= n)
+            break;
+
         /* If bad frame indicator present, no valid samples are returned. The output buffer will contain just zero samples */
         if (*bs == BAD_FRAME)
             return (0l);
@@ -1828,4 +2578,14 @@ long parallelize_left_justifiedstl96(short* bit_stm, short* par_buf, long bs_len
 #undef SYNC_WORD
 /* ............... End of parallelize_left_justifiedstl96() ............... */
 
+#ifdef UTL_AVX2
+#undef UTL_TARGET_AVX2
+#undef UTL_AVX2
+#endif
+#ifdef UTL_SSE2
+#undef UTL_SSE2
+#endif
+#undef UTL_LOAD
+#undef UTL_STORE
+
 /* ......................... END OF UGST-UTL.C .......................... */
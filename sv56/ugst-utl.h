@@ -21,10 +21,14 @@
                         the G.192-compliant functions is made by the
                         the definition of the symbol STL92 at compile
                         time <simao@ctd.comsat.com>
+   19.Oct.26    v3.1    Added sh2sh_scale(), sh2fl()/scale()/fl2sh() fused.
+   19.Oct.26    v3.2    SSE2/AVX2 scale(), sh2fl(), sh2fl_alt(), fl2sh().
+   19.Oct.26    v3.3    SSE2/AVX2 serialize_...() and parallelize_...().
+   19.Oct.26    v3.5    utl_simd() and its UTL_SIMD_... levels.
   ============================================================================
 */
 #ifndef UGST_UTILITIES_defined
-#define UGST_UTILITIES_defined 300
+#define UGST_UTILITIES_defined 350
 
 /* macros for smart prototypes */
 #ifndef ARGS
@@ -86,10 +90,17 @@ long scale ARGS((float* buffer, long smpno, double factor));
 long fl2sh ARGS((long n, float* x, short* iy, double half_lsb, short mask));
 void sh2fl_alt ARGS((long n, short* ix, float* y, short mask));
 void sh2fl ARGS((long n, short* ix, float* y, long resolution, char norm));
+long sh2sh_scale ARGS((long n, short* ix, short* iy, double factor, long resolution, short mask));
 long serialize_right_justified ARGS((short* par_buf, short* bit_stm, long n, long resol, char sync));
 long parallelize_right_justified ARGS((short* bit_stm, short* par_buf, long bs_len, long resol, char sync));
 long serialize_left_justified ARGS((short* par_buf, short* bit_stm, long n, long resol, char sync));
 long parallelize_left_justified ARGS((short* bit_stm, short* par_buf, long bs_len, long resol, char sync));
+int utl_simd ARGS((int max));
+
+/* SIMD levels, for utl_simd() */
+#define UTL_SIMD_NONE 0
+#define UTL_SIMD_SSE2 1
+#define UTL_SIMD_AVX2 2
 
 #define IS_SERIAL -1
 #define IS_PARALLEL 1
@@ -0,0 +1,1975 @@
+/*                                                             v1.7 19.OCT.26
+=============================================================================
+
+                          U    U   GGG    SSSS  TTTTT
+                          U    U  G       S       T
+                          U    U  G  GG   SSSS    T
+                          U    U  G   G       S   T
+                           UUU     GG     SSS     T
+
+                   ========================================
+                    ITU-T - USER'S GROUP ON SOFTWARE TOOLS
+                   ========================================
+
+       =============================================================
+       COPYRIGHT NOTE: This source code, and all of its derivations,
+       is subject to the "ITU-T General Public License". Please have
+       it  read  in    the  distribution  disk,   or  in  the  ITU-T
+       Recommendation G.191 on "SOFTWARE TOOLS FOR SPEECH AND  AUDIO
+       CODING STANDARDS".
+       =============================================================
+
+
+MODULE:         WAVFILE.C, WAVE FILE READER AND WRITER
+
+DATE:           19/Oct/2026
+
+RELEASE:        1.70
+
+PROTOTYPES:     see wavfile.h.
+
+FUNCTIONS:
+
+wav_open ...... opens a wave (or headerless 16-bit) file, parses its RIFF
+                chunks and maps it into memory.
+
+wav_read ...... pointer to the next frames of the sample region.
+
+wav_rewind .... moves back to the first frame.
+
+wav_seek ...... moves to any frame of the sample region.
+
+wav_copy ...... copies a byte range of the file to a stream.
+
+wav_close ..... unmaps and closes the file.
+
+wav_write_header  writes the header of a RIFF, RF64 or Wave64 file with
+                  the sizes left blank.
+
+wav_write_sizes . fills in the sizes once all samples are written.
+
+wav_create .... opens an output file, "-" being stdout.
+
+wav_seekable .. tells whether a stream can be positioned.
+
+wav_set_pipeline  sets the queue depth and block size of the I/O threads.
+
+wav_prefetch .. starts an I/O thread reading ahead of wav_read().
+
+wav_out_open .. sets up a writer with an I/O thread writing behind.
+
+wav_out_write . queues samples for writing.
+
+wav_out_close . flushes the queue and stops the writer's thread.
+
+wav_rw_open ... opens a file for rewriting parts of it in place.
+
+wav_rw_map .... maps a window of the file for update.
+
+wav_rw_sync ... writes the window back to the disk.
+
+wav_rw_close .. releases the window and closes the file.
+
+wav_flush ..... flushes a stream through to the disk.
+
+HISTORY:
+
+   19.Oct.26 v1.0 Release of 1st version. The header is parsed once, by
+                  walking the RIFF chunks (so that "LIST", "fact" and
+                  other chunks ahead of "data" are skipped), and the
+                  samples are read in place from a read-only mapping of
+                  the file, with no copy nor system call per block.
+                  Files that can't be mapped are read through stdio.
+   19.Oct.26 v1.1 RF64 ("ds64" chunk) and Sony Wave64 input and output,
+                  and 64-bit sizes and positions throughout, for
+                  recordings beyond 4 GB. Pages of the mapping already
+                  read are released every WAV_DROP bytes, so that long
+                  files stream through in constant memory.
+   19.Oct.26 v1.2 I/O pipeline: wav_prefetch() and wav_out_open() run
+                  the reads and writes in their own thread, through a
+                  queue of WAV_ALIGN-aligned blocks, so that a slow or
+                  cold disk overlaps with the filtering and metering
+                  instead of stalling them. Win32 or POSIX threads.
+   19.Oct.26 v1.3 Streams: "-" reads stdin and writes stdout, and pipes
+                  are read front to back, skipping chunks by reading;
+                  a data chunk of unknown size (0 or 0xFFFFFFFF) runs
+                  to the end of the stream. WAV_STREAMED headers carry
+                  "unknown" sizes, for outputs that can't be patched.
+   19.Oct.26 v1.4 32-bit IEEE float samples (format 3), and the PCM and
+                  float subformats of WAVE_FORMAT_EXTENSIBLE, which are
+                  reported as plain PCM and float.
+   19.Oct.26 v1.5 In-place rewriting: wav_rw_map() maps windows of a
+                  file shared and writable, so that the samples can be
+                  changed where they are, and wav_rw_sync() and
+                  wav_flush() make changes and journals durable.
+   19.Oct.26 v1.6 wav_seek(), for reading parts of a file out of order.
+   19.Oct.26 v1.7 Header parsing, reads and writes timed and counted
+                  (svstats.h); blocks of the I/O threads traced.
+
+=============================================================================
+*/
+
+/*
+ * .................... INCLUDES ....................
+ */
+#define _CRT_SECURE_NO_WARNINGS
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "wavfile.h"
+#include "svstats.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#define WAV_MMAP_WIN32
+#define WAV_THREADS_WIN32
+#define WAV_THREADS
+#elif defined(unix) || defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#define WAV_MMAP_POSIX
+#define WAV_THREADS_POSIX
+#define WAV_THREADS
+#endif
+
+/* Bytes read from the mapping before the pages behind are released */
+#define WAV_DROP (64ul << 20)
+
+/* Alignment of the pipeline blocks, and page size assumed when touching */
+#define WAV_ALIGN 4096
+#define WAV_PAGE 4096
+
+/* Reads and writes smaller than this are counted but not timed: two
+   clock readings would cost more than a sample or two moved */
+#define WAV_TIMED 4096
+
+/* Largest RIFF file; beyond it, the sizes don't fit the 32-bit fields */
+#define WAV_RIFF_MAX 0xFFFFFFFFull
+
+/* Wave64 chunk ids: the first 4 bytes spell the RIFF id */
+static const unsigned char w64_riff[16] = { 'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+static const unsigned char w64_wave[16] = { 'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+static const unsigned char w64_fmt[16] = { 'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+static const unsigned char w64_data[16] = { 'd', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+
+
+/*
+ * .................... LOCAL FUNCTIONS ....................
+ */
+
+/* Little-endian fields of the RIFF headers */
+static unsigned long wav_u32(const unsigned char* p) {
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+static unsigned long long wav_u64(const unsigned char* p) {
+    return wav_u32(p) | ((unsigned long long)wav_u32(p + 4) << 32);
+}
+
+static int wav_u16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static void wav_put(unsigned char* p, unsigned long long x, int n) {
+    for (; n > 0; n--, x >>= 8)
+        *p++ = (unsigned char)(x & 0xFF);
+}
+
+/*
+ * Copy `n' bytes at offset `off' of the file; 0 if past its end. A
+ * stream can't go back: its first bytes are kept in wf->lead, and
+ * beyond them it is only read forward, skipping by reading.
+ */
+static int wav_fetch(WAV_file* wf, unsigned long long off, unsigned char* dst, unsigned long n) {
+    unsigned char skip[4096];
+    unsigned long long k;
+
+    if (off > wf->file_size || n > wf->file_size - off)
+        return 0;
+    if (wf->map != NULL) {
+        memcpy(dst, wf->map + off, n);
+        return 1;
+    }
+    if (wf->stream) {
+        for (; n > 0 && off < wf->lead_len; n--)
+            *dst++ = wf->lead[off++];
+        if (n == 0)
+            return 1;
+        if (off < wf->stream_pos)
+            return 0;
+        for (; wf->stream_pos < off; wf->stream_pos += k) {
+            k = off - wf->stream_pos < sizeof(skip) ? off - wf->stream_pos : sizeof(skip);
+            if (fread(skip, 1, (size_t)k, wf->fp) != k)
+                return 0;
+        }
+        if (fread(dst, 1, n, wf->fp) != n)
+            return 0;
+        wf->stream_pos += n;
+        return 1;
+    }
+    if (WAV_FSEEK(wf->fp, off, SEEK_SET) != 0)
+        return 0;
+    return fread(dst, 1, n, wf->fp) == n;
+}
+
+/*
+ * Format fields of a "fmt " chunk body of `len' bytes (16 at least). An
+ * extensible format is replaced by the one of its SubFormat GUID, whose
+ * first 2 bytes hold the format code; the GUID is at 24 in a body of 40.
+ */
+static void wav_fmt(WAV_file* wf, const unsigned char* b, unsigned long long len) {
+    wf->format = wav_u16(b);
+    wf->channels = wav_u16(b + 2);
+    wf->sample_rate = (long)wav_u32(b + 4);
+    wf->byte_rate = (long)wav_u32(b + 8);
+    wf->block_align = wav_u16(b + 12);
+    wf->bits = wav_u16(b + 14);
+    if (wf->format == WAV_FORMAT_EXTENSIBLE && len >= 40)
+        wf->format = wav_u16(b + 24);
+}
+
+/*
+ * Walk the chunks of a RIFF or RF64 file up to "data"; chunks are
+ * padded to even sizes. In RF64 files the real size of the data chunk
+ * is in the "ds64" chunk, and its 32-bit field holds 0xFFFFFFFF.
+ */
+static int wav_parse_riff(WAV_file* wf) {
+    unsigned char b[40];
+    unsigned long long off, len, ds64_data = 0;
+    int have_fmt = 0;
+
+    for (off = 12;; off += 8 + len + (len & 1)) {
+        if (!wav_fetch(wf, off, b, 8))
+            return have_fmt ? 0 : -1;
+        len = wav_u32(b + 4);
+
+        if (memcmp(b, "ds64", 4) == 0) {
+            /* RIFF size, data size and sample count, 64 bits each */
+            if (len < 24 || !wav_fetch(wf, off + 8, b + 8, 16))
+                return -1;
+            ds64_data = wav_u64(b + 16);
+        }
+        else if (memcmp(b, "fmt ", 4) == 0) {
+            if (len < 16 || !wav_fetch(wf, off + 8, b, len < 40 ? 16 : 40))
+                return -1;
+            wav_fmt(wf, b, len);
+            have_fmt = 1;
+        }
+        else if (memcmp(b, "data", 4) == 0) {
+            if (!have_fmt)
+                return -1;
+            if (wf->container == WAV_RF64 && len == 0xFFFFFFFFul)
+                len = ds64_data;
+            wf->data_offset = off + 8;
+            wf->data_bytes = len;
+            return 1;
+        }
+        if (len > wf->file_size)
+            len = wf->file_size;
+    }
+}
+
+/*
+ * Walk the chunks of a Wave64 file up to "data": 16-byte ids, 64-bit
+ * sizes that count the 24-byte chunk header, and 8-byte alignment.
+ */
+static int wav_parse_w64(WAV_file* wf) {
+    unsigned char b[40];
+    unsigned long long off, len;
+    int have_fmt = 0;
+
+    for (off = 40;; off += (len + 7) & ~7ull) {
+        if (!wav_fetch(wf, off, b, 24))
+            return have_fmt ? 0 : -1;
+        len = wav_u64(b + 16);
+        if (len < 24)
+            return -1;
+
+        if (memcmp(b, w64_fmt, 16) == 0) {
+            if (len < 24 + 16 || !wav_fetch(wf, off + 24, b, len < 24 + 40 ? 16 : 40))
+                return -1;
+            wav_fmt(wf, b, len - 24);
+            have_fmt = 1;
+        }
+        else if (memcmp(b, w64_data, 16) == 0) {
+            if (!have_fmt)
+                return -1;
+            wf->data_offset = off + 24;
+            wf->data_bytes = len - 24;
+            return 1;
+        }
+        if (len > wf->file_size)
+            len = wf->file_size;
+    }
+}
+
+/* Map the whole file read-only; 0 leaves wf->map NULL */
+static int wav_map(WAV_file* wf, char* name) {
+#if defined(WAV_MMAP_WIN32)
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+    void* view;
+
+    file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (unsigned long long)(SIZE_T)size.QuadPart != (unsigned long long)size.QuadPart) {
+        CloseHandle(file);
+        return 0;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return 0;
+    view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        return 0;
+    }
+    wf->map = (const unsigned char*)view;
+    wf->handle = mapping;
+    wf->file_size = (unsigned long long)size.QuadPart;
+    return 1;
+#elif defined(WAV_MMAP_POSIX)
+    struct stat st;
+    void* view;
+    int fd;
+
+    /* Opening a FIFO would take its writer, so regular files only */
+    if (stat(name, &st) != 0 || !S_ISREG(st.st_mode) || (fd = open(name, O_RDONLY)) < 0)
+        return 0;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 || (unsigned long long)(size_t)st.st_size != (unsigned long long)st.st_size) {
+        close(fd);
+        return 0;
+    }
+    view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return 0;
+#if defined(MADV_SEQUENTIAL)
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+    wf->map = (const unsigned char*)view;
+    wf->file_size = (unsigned long long)st.st_size;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+static void wav_unmap(WAV_file* wf) {
+#if defined(WAV_MMAP_WIN32)
+    UnmapViewOfFile((void*)wf->map);
+    CloseHandle((HANDLE)wf->handle);
+#elif defined(WAV_MMAP_POSIX)
+    munmap((void*)wf->map, (size_t)wf->file_size);
+#endif
+    wf->map = NULL;
+}
+
+/*
+ * I/O pipeline. A wav_pipe is a queue of `depth' blocks of `block'
+ * bytes, aligned on WAV_ALIGN, between the caller and an I/O thread:
+ * - reading a stream, the thread fills the blocks ahead of wav_read(),
+ *   which hands them out (in place when a request fits in a block);
+ * - reading a mapping, there's no block to fill: the thread touches
+ *   the pages up to depth*block bytes ahead of wav_read(), so that
+ *   the page faults of a cold file are taken off the compute loop;
+ * - writing, wav_out_write() fills the blocks and the thread writes
+ *   them out.
+ * One lock guards head/count/len[] and the flags; the block being
+ * filled or consumed on either side is outside the queue meanwhile.
+ */
+struct wav_pipe {
+#if defined(WAV_THREADS_WIN32)
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+    HANDLE thread;
+#elif defined(WAV_THREADS_POSIX)
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+#endif
+    void (*run)(struct wav_pipe* p); /* body of the I/O thread */
+    int running;                  /* thread started and not yet joined */
+
+    int depth;                    /* number of blocks */
+    size_t block;                 /* bytes per block */
+    unsigned char* mem;           /* allocation holding the blocks */
+    unsigned char* blocks;        /* first block */
+    size_t* len;                  /* bytes held by each block */
+    int head;                     /* oldest block in the queue */
+    int count;                    /* blocks in the queue */
+    int fill;                     /* writer: block being filled */
+    size_t off;                   /* bytes of the head block consumed (reader)
+                                   * or of the block being filled (writer) */
+    int stop;                     /* asks the thread to return */
+    int eof;                      /* reader: no more blocks to come */
+    int error;                    /* writer: a block couldn't be written */
+
+    FILE* fp;                     /* stream read or written */
+    const unsigned char* map;     /* mapping read, or NULL */
+    unsigned long long next;      /* reader: next byte of the file to fetch */
+    unsigned long long end;       /* reader: end of the samples in the file */
+    unsigned long long want;      /* mapped reader: pages to touch up to here */
+    volatile unsigned sink;       /* mapped reader: keeps the touches */
+};
+
+#if defined(WAV_THREADS_WIN32)
+#define WAV_LOCK(p)   EnterCriticalSection(&(p)->lock)
+#define WAV_UNLOCK(p) LeaveCriticalSection(&(p)->lock)
+#define WAV_WAIT(p)   SleepConditionVariableCS(&(p)->cond, &(p)->lock, INFINITE)
+#define WAV_WAKE(p)   WakeAllConditionVariable(&(p)->cond)
+
+static DWORD WINAPI wav_pipe_entry(LPVOID arg) {
+    struct wav_pipe* p = (struct wav_pipe*)arg;
+    p->run(p);
+    return 0;
+}
+#elif defined(WAV_THREADS_POSIX)
+#define WAV_LOCK(p)   pthread_mutex_lock(&(p)->lock)
+#define WAV_UNLOCK(p) pthread_mutex_unlock(&(p)->lock)
+#define WAV_WAIT(p)   pthread_cond_wait(&(p)->cond, &(p)->lock)
+#define WAV_WAKE(p)   pthread_cond_broadcast(&(p)->cond)
+
+static void* wav_pipe_entry(void* arg) {
+    struct wav_pipe* p = (struct wav_pipe*)arg;
+    p->run(p);
+    return NULL;
+}
+#endif
+
+/* Queue depth and block size taken for WAV_PIPE_DEFAULT */
+static int wav_pipe_depth = WAV_QUEUE_DEPTH;
+static long wav_pipe_block = WAV_BLOCK_SIZE;
+
+#if defined(WAV_THREADS)
+/* Allocate a pipe of `depth' blocks, or none; NULL when out of memory */
+static struct wav_pipe* wav_pipe_new(int depth, size_t block, int alloc, void (*run)(struct wav_pipe*)) {
+    struct wav_pipe* p;
+
+    if ((p = (struct wav_pipe*)calloc(1, sizeof(struct wav_pipe))) == NULL)
+        return NULL;
+    p->depth = depth;
+    p->block = block;
+    p->run = run;
+    p->len = (size_t*)calloc((size_t)depth, sizeof(size_t));
+    if (alloc)
+        p->mem = (unsigned char*)malloc((size_t)depth * block + WAV_ALIGN);
+    if (p->len == NULL || (alloc && p->mem == NULL)) {
+        free(p->len);
+        free(p->mem);
+        free(p);
+        return NULL;
+    }
+    if (alloc)
+        p->blocks = p->mem + (WAV_ALIGN - (size_t)p->mem % WAV_ALIGN) % WAV_ALIGN;
+#if defined(WAV_THREADS_WIN32)
+    InitializeCriticalSection(&p->lock);
+    InitializeConditionVariable(&p->cond);
+#else
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+#endif
+    return p;
+}
+
+/* Start the I/O thread on an empty queue; 0 if it can't be started */
+static int wav_pipe_start(struct wav_pipe* p) {
+    p->head = p->count = p->fill = 0;
+    p->off = 0;
+    p->stop = p->eof = p->error = 0;
+#if defined(WAV_THREADS_WIN32)
+    p->thread = CreateThread(NULL, 0, wav_pipe_entry, p, 0, NULL);
+    p->running = p->thread != NULL;
+#else
+    p->running = pthread_create(&p->thread, NULL, wav_pipe_entry, p) == 0;
+#endif
+    return p->running;
+}
+
+/* Have the I/O thread return, and wait for it */
+static void wav_pipe_halt(struct wav_pipe* p) {
+    if (!p->running)
+        return;
+    WAV_LOCK(p);
+    p->stop = 1;
+    WAV_WAKE(p);
+    WAV_UNLOCK(p);
+#if defined(WAV_THREADS_WIN32)
+    WaitForSingleObject(p->thread, INFINITE);
+    CloseHandle(p->thread);
+#else
+    pthread_join(p->thread, NULL);
+#endif
+    p->running = 0;
+}
+
+static void wav_pipe_free(struct wav_pipe* p) {
+    wav_pipe_halt(p);
+#if defined(WAV_THREADS_WIN32)
+    DeleteCriticalSection(&p->lock);
+#else
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->cond);
+#endif
+    free(p->len);
+    free(p->mem);
+    free(p);
+}
+
+/* Reader thread on a stream: fill the free blocks, in file order */
+static void wav_pipe_fetch(struct wav_pipe* p) {
+    size_t n, got;
+    int slot;
+
+    SV_TRACE_THREAD("wav reader");
+    WAV_LOCK(p);
+    while (!p->eof) {
+        while (p->count == p->depth && !p->stop)
+            WAV_WAIT(p);
+        if (p->stop)
+            break;
+        slot = (p->head + p->count) % p->depth;
+        n = p->end - p->next < p->block ? (size_t)(p->end - p->next) : p->block;
+        WAV_UNLOCK(p);
+
+        SV_TRACE_BEGIN("fetch", NULL);
+        got = n > 0 ? fread(p->blocks + slot * p->block, 1, n, p->fp) : 0;
+        SV_TRACE_END();
+
+        WAV_LOCK(p);
+        p->len[slot] = got;
+        p->next += got;
+        if (got > 0)
+            p->count++;
+        if (got < n || p->next >= p->end)
+            p->eof = 1;
+        WAV_WAKE(p);
+    }
+    WAV_UNLOCK(p);
+}
+
+/* Reader thread on a mapping: touch the pages ahead of the reader */
+static void wav_pipe_touch(struct wav_pipe* p) {
+    unsigned long long from, to, q;
+    unsigned sum = 0;
+
+    SV_TRACE_THREAD("wav reader");
+    WAV_LOCK(p);
+    for (;;) {
+        while (!p->stop && (p->next >= p->end || p->next >= p->want))
+            WAV_WAIT(p);
+        if (p->stop)
+            break;
+        from = p->next;
+        to = from + p->block;
+        if (to > p->want)
+            to = p->want;
+        if (to > p->end)
+            to = p->end;
+        WAV_UNLOCK(p);
+
+        SV_TRACE_BEGIN("touch", NULL);
+        for (q = from - from % WAV_PAGE; q < to; q += WAV_PAGE)
+            sum += p->map[q];
+        SV_TRACE_END();
+
+        WAV_LOCK(p);
+        p->next = to;
+    }
+    WAV_UNLOCK(p);
+    p->sink = sum;
+}
+
+/* Writer thread: write the queued blocks out, in order */
+static void wav_pipe_drain(struct wav_pipe* p) {
+    size_t n;
+    int slot;
+
+    SV_TRACE_THREAD("wav writer");
+    WAV_LOCK(p);
+    for (;;) {
+        while (p->count == 0 && !p->stop)
+            WAV_WAIT(p);
+        if (p->count == 0)
+            break;
+        slot = p->head;
+        n = p->len[slot];
+        WAV_UNLOCK(p);
+
+        SV_TRACE_BEGIN("flush", NULL);
+        n = fwrite(p->blocks + slot * p->block, 1, n, p->fp) == n;
+        SV_TRACE_END();
+
+        WAV_LOCK(p);
+        if (!n)
+            p->error = 1;
+        p->head = (p->head + 1) % p->depth;
+        p->count--;
+        WAV_WAKE(p);
+    }
+    WAV_UNLOCK(p);
+}
+
+/* Queue the block being filled and wait for a free one; 0 on error */
+static int wav_pipe_push(struct wav_pipe* p) {
+    int ok;
+
+    WAV_LOCK(p);
+    p->len[p->fill] = p->off;
+    p->count++;
+    WAV_WAKE(p);
+    while (p->count == p->depth)
+        WAV_WAIT(p);
+    ok = !p->error;
+    WAV_UNLOCK(p);
+    p->fill = (p->fill + 1) % p->depth;
+    p->off = 0;
+    return ok;
+}
+
+/* (Re)start the reader at the current read position of `wf' */
+static void wav_pipe_resume(WAV_file* wf) {
+    struct wav_pipe* p = wf->pipe;
+
+    p->next = wf->data_offset + wf->pos;
+    p->end = wf->data_offset + wf->data_bytes;
+    p->want = p->next + (unsigned long long)p->depth * p->block;
+    if (p->map == NULL && !wf->stream)
+        WAV_FSEEK(p->fp, p->next, SEEK_SET);
+    wav_pipe_start(p);
+}
+
+/*
+ * wav_read() from the blocks of the reader thread: in place when the
+ * request lies within the head block, else gathered in wf->buf.
+ */
+static unsigned long long wav_pipe_take(WAV_file* wf, unsigned long long bytes, const void** data) {
+    struct wav_pipe* p = wf->pipe;
+    unsigned long long got = 0;
+    size_t k;
+
+    WAV_LOCK(p);
+    for (;;) {
+        /* Give the head block back once consumed */
+        if (p->count > 0 && p->off == p->len[p->head]) {
+            p->head = (p->head + 1) % p->depth;
+            p->count--;
+            p->off = 0;
+            WAV_WAKE(p);
+        }
+        if (got == bytes)
+            break;
+        while (p->count == 0 && !p->eof)
+            WAV_WAIT(p);
+        if (p->count == 0)
+            break;
+
+        k = p->len[p->head] - p->off;
+        if (got == 0 && k >= bytes) {
+            *data = p->blocks + p->head * p->block + p->off;
+            p->off += (size_t)bytes;
+            WAV_UNLOCK(p);
+            return bytes;
+        }
+        if (wf->buf_size < bytes) {
+            unsigned char* buf = (unsigned char*)realloc(wf->buf, (size_t)bytes);
+            if (buf == NULL)
+                break;
+            wf->buf = buf;
+            wf->buf_size = (unsigned long)bytes;
+        }
+        if (k > bytes - got)
+            k = (size_t)(bytes - got);
+        memcpy(wf->buf + got, p->blocks + p->head * p->block + p->off, k);
+        p->off += k;
+        got += k;
+    }
+    WAV_UNLOCK(p);
+
+    *data = wf->buf;
+    return got;
+}
+#endif /* WAV_THREADS */
+
+
+/*
+  ============================================================================
+
+       int wav_open (char *name, int raw, WAV_file *wf);
+       ~~~~~~~~~~~~
+
+       Open a file for reading and locate its samples. A RIFF, RF64 or
+       Wave64 file is parsed chunk by chunk up to the "data" chunk
+       (the container is told by the first bytes); with `raw' set,
+       the whole file is taken as 16-bit mono samples, with no header
+       (sample_rate is then left 0 for the caller to set).
+
+       Samples are integer PCM or 32-bit IEEE float, possibly under
+       WAVE_FORMAT_EXTENSIBLE; wf->format tells which. The name "-"
+       reads stdin. Stdin and pipes are streams: they are
+       read once, front to back (wf->stream is set), and their size is
+       unknown, so that a data chunk of size 0 or 0xFFFFFFFF, as
+       written by programs that can't seek their output, runs to the
+       end of the stream; so does a raw stream.
+
+       Parameter:
+       ~~~~~~~~~~
+       name ..... file name
+       raw ...... 1 for a headerless file, 0 for a wave file
+       wf ....... reader state to be initialized
+
+       Returns
+       ~~~~~~~
+       0 on success, WAV_HEADER_NOK or WAV_HEADER_NOT_PCM on error; the
+       file is closed on error.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.1	RF64 and Wave64.
+       19.Oct.26	v1.3	Streams.
+       19.Oct.26	v1.4	Float and extensible formats.
+       19.Oct.26	v1.7	Timed.
+
+  ============================================================================
+*/
+static int wav_open_parse(char* name, int raw, WAV_file* wf) {
+    unsigned char b[40];
+    int found;
+
+    memset(wf, 0, sizeof(WAV_file));
+
+    if (strcmp(name, "-") == 0) {
+#if defined(_WIN32)
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        wf->fp = stdin;
+        wf->stream = 2;
+    }
+    else if (!wav_map(wf, name)) {
+        long long size;
+        if ((wf->fp = fopen(name, "rb")) == NULL) {
+            fprintf(stderr, "can't open %s\n", name);
+            return WAV_HEADER_NOK;
+        }
+        if (!wav_seekable(wf->fp))
+            wf->stream = 1;
+        else if (WAV_FSEEK(wf->fp, 0, SEEK_END) == 0 && (size = WAV_FTELL(wf->fp)) > 0)
+            wf->file_size = (unsigned long long)size;
+    }
+
+    /* Unknown size; the header is read ahead, enough to tell the container */
+    if (wf->stream) {
+        wf->file_size = ~0ull;
+        if (!raw)
+            wf->lead_len = (unsigned long)fread(wf->lead, 1, sizeof(wf->lead), wf->fp);
+        wf->stream_pos = wf->lead_len;
+    }
+
+    if (raw) {
+        wf->format = WAV_FORMAT_PCM;
+        wf->channels = 1;
+        wf->bits = 16;
+        wf->block_align = 2;
+        wf->data_offset = 0;
+        wf->data_bytes = wf->file_size & ~1ull;
+        wav_rewind(wf);
+        return 0;
+    }
+
+    /* "RIFF"/"RF64", RIFF size, "WAVE"; or the Wave64 "riff" and "wave" ids */
+    if (wav_fetch(wf, 0, b, 40) && memcmp(b, w64_riff, 16) == 0 && memcmp(b + 24, w64_wave, 16) == 0) {
+        wf->container = WAV_W64;
+        found = wav_parse_w64(wf);
+    }
+    else {
+        if (!wav_fetch(wf, 0, b, 12) || (memcmp(b, "RIFF", 4) != 0 && memcmp(b, "RF64", 4) != 0)) {
+            fprintf(stderr, "not RIFF\n");
+            wav_close(wf);
+            return WAV_HEADER_NOK;
+        }
+        if (memcmp(b + 8, "WAVE", 4) != 0) {
+            fprintf(stderr, "not WAVE\n");
+            wav_close(wf);
+            return WAV_HEADER_NOK;
+        }
+        wf->container = (memcmp(b, "RF64", 4) == 0) ? WAV_RF64 : WAV_RIFF;
+        found = wav_parse_riff(wf);
+    }
+
+    if (found <= 0) {
+        fprintf(stderr, found < 0 ? "not fmt \n" : "not data\n");
+        wav_close(wf);
+        return WAV_HEADER_NOK;
+    }
+
+    /* A truncated file holds less than the chunk size tells */
+    if (wf->data_bytes > wf->file_size - wf->data_offset)
+        wf->data_bytes = wf->file_size - wf->data_offset;
+
+    /* A stream: up to the samples, and maybe to its end */
+    if (wf->stream) {
+        if (wf->data_offset < wf->lead_len || !wav_fetch(wf, wf->data_offset, b, 0)) {
+            fprintf(stderr, "not data\n");
+            wav_close(wf);
+            return WAV_HEADER_NOK;
+        }
+        if (wf->data_bytes == 0 || wf->data_bytes == 0xFFFFFFFFull)
+            wf->data_bytes = wf->file_size - wf->data_offset;
+    }
+
+    if (wf->format != WAV_FORMAT_PCM && (wf->format != WAV_FORMAT_FLOAT || wf->bits != 32)) {
+        fprintf(stderr, "not PCM\n");
+        wav_close(wf);
+        return WAV_HEADER_NOT_PCM;
+    }
+    if (wf->channels < 1 || wf->block_align < 1) {
+        fprintf(stderr, "no channel\n");
+        wav_close(wf);
+        return WAV_HEADER_NOK;
+    }
+
+    /* Whole frames only */
+    wf->data_bytes -= wf->data_bytes % wf->block_align;
+    wav_rewind(wf);
+    return 0;
+}
+
+int wav_open(char* name, int raw, WAV_file* wf) {
+    int err;
+
+    SV_STAGE_ENTER(SV_STAGE_HEADER);
+    err = wav_open_parse(name, raw, wf);
+    SV_STAGE_LEAVE();
+    return err;
+}
+/* ....................... End of wav_open() ....................... */
+
+
+/*
+  ============================================================================
+
+       long wav_read (WAV_file *wf, long nframes, const void **data);
+       ~~~~~~~~~~~~~
+
+       Get the next `nframes' frames of interleaved samples, or as many
+       as are left. For a mapped file, `*data' points into the mapping
+       and nothing is copied; otherwise the frames are read into a
+       buffer owned by `wf'. Either way, `*data' is valid until the
+       next call. Pages of the mapping more than WAV_DROP bytes behind
+       are given back to the system, so that memory use stays bounded
+       however long the file. After wav_prefetch(), the frames come
+       from the blocks of the I/O thread, which is woken as they are
+       consumed.
+
+       Parameter:
+       ~~~~~~~~~~
+       wf ....... reader state
+       nframes .. number of frames wanted
+       data ..... pointer to the frames read
+
+       Returns
+       ~~~~~~~
+       The number of frames read, 0 at the end of the samples.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.1	64-bit positions; release of pages read.
+       19.Oct.26	v1.2	Frames from the prefetching thread.
+       19.Oct.26	v1.3	Counted, and timed from WAV_TIMED bytes.
+
+  ============================================================================
+*/
+long wav_read(WAV_file* wf, long nframes, const void** data) {
+    unsigned long long bytes, left;
+    int timed;
+
+    timed = (unsigned long long)nframes * wf->block_align >= WAV_TIMED;
+    if (timed)
+        SV_STAGE_ENTER(SV_STAGE_READ);
+
+    left = wf->data_bytes - wf->pos;
+    bytes = (unsigned long long)nframes * wf->block_align;
+    if (bytes > left)
+        bytes = left;
+
+    if (wf->map != NULL) {
+        *data = wf->map + wf->data_offset + wf->pos;
+#if defined(WAV_MMAP_POSIX) && defined(MADV_DONTNEED)
+        /* Whole WAV_DROP blocks, which keeps the start page-aligned */
+        if (wf->data_offset + wf->pos >= wf->dropped + 2 * WAV_DROP) {
+            madvise((void*)(wf->map + wf->dropped), WAV_DROP, MADV_DONTNEED);
+            wf->dropped += WAV_DROP;
+        }
+#endif
+#if defined(WAV_THREADS)
+        /* Keep the thread touching depth blocks ahead */
+        if (wf->pipe != NULL) {
+            struct wav_pipe* p = wf->pipe;
+            unsigned long long want = wf->data_offset + wf->pos + bytes + (unsigned long long)p->depth * p->block;
+            if (want >= p->want + p->block) {
+                WAV_LOCK(p);
+                p->want = want;
+                WAV_WAKE(p);
+                WAV_UNLOCK(p);
+            }
+        }
+#endif
+    }
+#if defined(WAV_THREADS)
+    else if (wf->pipe != NULL) {
+        bytes = wav_pipe_take(wf, bytes, data);
+        bytes -= bytes % wf->block_align;
+    }
+#endif
+    else {
+        if (bytes > wf->buf_size) {
+            unsigned char* buf = (unsigned char*)realloc(wf->buf, (size_t)bytes);
+            if (buf == NULL) {
+                if (timed)
+                    SV_STAGE_LEAVE();
+                return 0;
+            }
+            wf->buf = buf;
+            wf->buf_size = (unsigned long)bytes;
+        }
+        bytes = fread(wf->buf, 1, (size_t)bytes, wf->fp);
+        bytes -= bytes % wf->block_align;
+        *data = wf->buf;
+    }
+
+    wf->pos += bytes;
+    SV_COUNT(SV_COUNT_BYTES_READ, bytes);
+    if (timed)
+        SV_STAGE_LEAVE();
+    return (long)(bytes / wf->block_align);
+}
+/* ....................... End of wav_read() ....................... */
+
+
+/*
+  ============================================================================
+
+       int wav_seek (WAV_file *wf, unsigned long long frame);
+       ~~~~~~~~~~~~
+
+       Move to frame `frame' of the samples, so that the next wav_read()
+       starts there. A stream can only be "moved" to where it is.
+
+       Parameter:
+       ~~~~~~~~~~
+       wf ....... reader state
+       frame .... frame to go to; the number of frames goes to the end
+
+       Returns
+       ~~~~~~~
+       0 on success, -1 for a frame beyond the end or a stream.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation, from wav_rewind().
+
+  ============================================================================
+*/
+int wav_seek(WAV_file* wf, unsigned long long frame) {
+    unsigned long long pos = frame * wf->block_align;
+
+    if (pos > wf->data_bytes)
+        return -1;
+    if (wf->stream)
+        return wf->pos == pos ? 0 : -1;
+#if defined(WAV_THREADS)
+    if (wf->pipe != NULL)
+        wav_pipe_halt(wf->pipe);
+#endif
+    wf->pos = pos;
+    /* Pages are released again from the WAV_DROP block of the new position */
+    wf->dropped = (wf->data_offset + pos) / WAV_DROP * WAV_DROP;
+    if (wf->map == NULL)
+        WAV_FSEEK(wf->fp, wf->data_offset + pos, SEEK_SET);
+#if defined(WAV_THREADS)
+    if (wf->pipe != NULL)
+        wav_pipe_resume(wf);
+#endif
+    return 0;
+}
+/* ....................... End of wav_seek() ....................... */
+
+
+/*
+  ============================================================================
+
+       int wav_rewind (WAV_file *wf);
+       ~~~~~~~~~~~~~~
+
+       Move back to the first frame of the samples. A stream can't be
+       rewound once read from.
+
+       Parameter:
+       ~~~~~~~~~~
+       wf ....... reader state
+
+       Returns
+       ~~~~~~~
+       0 on success, -1 for a stream already read from.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.2	Restarts the prefetching thread.
+       19.Oct.26	v1.3	Returns an error for streams.
+       19.Oct.26	v1.4	Through wav_seek().
+
+  ============================================================================
+*/
+int wav_rewind(WAV_file* wf) {
+    return wav_seek(wf, 0);
+}
+/* ...................... End of wav_rewind() ...................... */
+
+
+/*
+  ============================================================================
+
+       long long wav_copy (WAV_file *wf, unsigned long long from,
+       ~~~~~~~~~~~~~~~~~~  unsigned long long to, FILE *out);
+
+       Copy bytes `from' to `to' (excluded) of the file to `out', e.g.
+       the header and the chunks after the samples, when a processed
+       copy of the file is written. The read position is kept. Not
+       for streams.
+
+       Parameter:
+       ~~~~~~~~~~
+       wf ....... reader state
+       from ..... first byte to copy
+       to ....... end of the range; clipped to the file size
+       out ...... output stream
+
+       Returns
+       ~~~~~~~
+       The number of bytes copied, or -1 on error.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.1	64-bit offsets.
+       19.Oct.26	v1.2	Pauses the prefetching thread on streams.
+
+  ============================================================================
+*/
+long long wav_copy(WAV_file* wf, unsigned long long from, unsigned long long to, FILE* out) {
+    unsigned char chunk[4096];
+    unsigned long long n, done = 0;
+    int ok;
+
+    if (to > wf->file_size)
+        to = wf->file_size;
+    if (from >= to)
+        return 0;
+
+    if (wf->map != NULL)
+        return fwrite(wf->map + from, 1, (size_t)(to - from), out) == to - from ? (long long)(to - from) : -1;
+    if (wf->stream)
+        return -1;
+
+    /* The stream is the reader thread's meanwhile */
+#if defined(WAV_THREADS)
+    if (wf->pipe != NULL)
+        wav_pipe_halt(wf->pipe);
+#endif
+    ok = WAV_FSEEK(wf->fp, from, SEEK_SET) == 0;
+    while (ok && done < to - from) {
+        n = to - from - done;
+        if (n > sizeof(chunk))
+            n = sizeof(chunk);
+        if (fread(chunk, 1, (size_t)n, wf->fp) != n || fwrite(chunk, 1, (size_t)n, out) != n)
+            break;
+        done += n;
+    }
+    WAV_FSEEK(wf->fp, wf->data_offset + wf->pos, SEEK_SET);
+#if defined(WAV_THREADS)
+    if (wf->pipe != NULL)
+        wav_pipe_resume(wf);
+#endif
+    return ok && done == to - from ? (long long)done : -1;
+}
+/* ....................... End of wav_copy() ....................... */
+
+
+/*
+  ============================================================================
+
+       void wav_close (WAV_file *wf);
+       ~~~~~~~~~~~~~~
+
+       Stop the prefetching thread, if any, unmap or close the file and
+       release the read buffer.
+
+       Parameter:
+       ~~~~~~~~~~
+       wf ....... reader state
+
+       Returns
+       ~~~~~~~
+       None
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.2	Stops the prefetching thread.
+
+  ============================================================================
+*/
+void wav_close(WAV_file* wf) {
+#if defined(WAV_THREADS)
+    if (wf->pipe != NULL)
+        wav_pipe_free(wf->pipe);
+    wf->pipe = NULL;
+#endif
+    if (wf->map != NULL)
+        wav_unmap(wf);
+    if (wf->fp != NULL && wf->stream != 2)
+        fclose(wf->fp);
+    free(wf->buf);
+    wf->fp = NULL;
+    wf->buf = NULL;
+    wf->buf_size = 0;
+}
+/* ....................... End of wav_close() ...................... */
+
+
+/*
+  ============================================================================
+
+       long wav_write_header (FILE *fp, int container, int format,
+       ~~~~~~~~~~~~~~~~~~~~~  int channels, long rate, int bits);
+
+       Write the header of a wave file at the current position of `fp',
+       which should be the start of the file, with all sizes left 0
+       (0xFFFFFFFF in the 32-bit fields of RF64) for wav_write_sizes()
+       to fill in. The samples follow the header. With WAV_STREAMED
+       or'ed to the container, every size is all ones instead, read as
+       "up to the end of the file" (wav_open() does so), for outputs
+       that can't be sought back to, like pipes.
+
+       Parameter:
+       ~~~~~~~~~~
+       fp ....... output stream
+       container  WAV_RIFF, WAV_RF64 or WAV_W64, maybe | WAV_STREAMED
+       format ... WAV_FORMAT_PCM or WAV_FORMAT_FLOAT
+       channels . number of interleaved channels
+       rate ..... sampling rate, in Hz
+       bits ..... bits per sample, a multiple of 8
+
+       Returns
+       ~~~~~~~
+       The size of the header, in bytes, or -1 on error.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.3	WAV_STREAMED.
+
+  ============================================================================
+*/
+long wav_write_header(FILE* fp, int container, int format, int channels, long rate, int bits) {
+    unsigned char h[104], * f;
+    int streamed = (container & WAV_STREAMED) != 0;
+    long n;
+
+    memset(h, 0, sizeof(h));
+    switch (container & ~WAV_STREAMED) {
+    case WAV_RIFF:
+        /* "RIFF" size "WAVE" "fmt " 16 <fmt> "data" size */
+        memcpy(h, "RIFFxxxxWAVEfmt ", 16);
+        wav_put(h + 16, 16, 4);
+        f = h + 20;
+        memcpy(h + 36, "data", 4);
+        if (streamed) {
+            wav_put(h + 4, 0xFFFFFFFFul, 4);
+            wav_put(h + 40, 0xFFFFFFFFul, 4);
+        }
+        n = 44;
+        break;
+    case WAV_RF64:
+        /* "RF64" -1 "WAVE" "ds64" 28 <riff, data, frames, 0> "fmt " 16 <fmt> "data" -1 */
+        memcpy(h, "RF64xxxxWAVEds64", 16);
+        wav_put(h + 4, 0xFFFFFFFFul, 4);
+        wav_put(h + 16, 28, 4);
+        memcpy(h + 48, "fmt ", 4);
+        wav_put(h + 52, 16, 4);
+        f = h + 56;
+        memcpy(h + 72, "data", 4);
+        wav_put(h + 76, 0xFFFFFFFFul, 4);
+        if (streamed) {
+            wav_put(h + 20, ~0ull, 8);
+            wav_put(h + 28, ~0ull, 8);
+        }
+        n = 80;
+        break;
+    case WAV_W64:
+        /* riff size wave, fmt 40 <fmt>, data size */
+        memcpy(h, w64_riff, 16);
+        memcpy(h + 24, w64_wave, 16);
+        memcpy(h + 40, w64_fmt, 16);
+        wav_put(h + 56, 24 + 16, 8);
+        f = h + 64;
+        memcpy(h + 80, w64_data, 16);
+        if (streamed) {
+            wav_put(h + 16, ~0ull, 8);
+            wav_put(h + 96, ~0ull, 8);
+        }
+        n = 104;
+        break;
+    default:
+        return -1;
+    }
+
+    wav_put(f, format, 2);
+    wav_put(f + 2, channels, 2);
+    wav_put(f + 4, rate, 4);
+    wav_put(f + 8, rate * channels * (bits / 8), 4);
+    wav_put(f + 12, channels * (bits / 8), 2);
+    wav_put(f + 14, bits, 2);
+
+    return fwrite(h, 1, n, fp) == (size_t)n ? n : -1;
+}
+/* .................... End of wav_write_header() .................... */
+
+
+/*
+  ============================================================================
+
+       int wav_write_sizes (FILE *fp, int container, int block_align);
+       ~~~~~~~~~~~~~~~~~~~
+
+       Fill in the sizes of a header written by wav_write_header(),
+       once all samples have been written after it. A RIFF file whose
+       samples ended up beyond 4 GB gets 0xFFFFFFFF sizes, which most
+       readers (wav_open() among them) take as "up to the end of the
+       file"; RF64 or Wave64 should be chosen up front for such sizes.
+       The stream is left at its end.
+
+       Parameter:
+       ~~~~~~~~~~
+       fp ....... output stream, opened for update
+       container  container given to wav_write_header()
+       block_align bytes per frame, all channels
+
+       Returns
+       ~~~~~~~
+       0 on success, -1 on error.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int wav_write_sizes(FILE* fp, int container, int block_align) {
+    unsigned char b[24];
+    unsigned long long end, data;
+    long long pos;
+
+    if (WAV_FSEEK(fp, 0, SEEK_END) != 0 || (pos = WAV_FTELL(fp)) < 0)
+        return -1;
+    end = (unsigned long long)pos;
+
+    switch (container) {
+    case WAV_RIFF:
+        if (end < 44)
+            return -1;
+        data = end - 44;
+        if (end - 8 > WAV_RIFF_MAX) {
+            fprintf(stderr, "wave file beyond 4 GB, sizes left open\n");
+            wav_put(b, 0xFFFFFFFFul, 4);
+            wav_put(b + 4, 0xFFFFFFFFul, 4);
+        }
+        else {
+            wav_put(b, end - 8, 4);
+            wav_put(b + 4, data, 4);
+        }
+        if (WAV_FSEEK(fp, 4, SEEK_SET) != 0 || fwrite(b, 1, 4, fp) != 4)
+            return -1;
+        if (WAV_FSEEK(fp, 40, SEEK_SET) != 0 || fwrite(b + 4, 1, 4, fp) != 4)
+            return -1;
+        break;
+    case WAV_RF64:
+        if (end < 80)
+            return -1;
+        data = end - 80;
+        wav_put(b, end - 8, 8);
+        wav_put(b + 8, data, 8);
+        wav_put(b + 16, data / block_align, 8);
+        if (WAV_FSEEK(fp, 20, SEEK_SET) != 0 || fwrite(b, 1, 24, fp) != 24)
+            return -1;
+        break;
+    case WAV_W64:
+        if (end < 104)
+            return -1;
+        data = end - 104;
+        /* The file ends on an 8-byte boundary, like every chunk */
+        memset(b, 0, 8);
+        if ((end & 7) != 0 && fwrite(b, 1, (size_t)(8 - (end & 7)), fp) != 8 - (end & 7))
+            return -1;
+        end = (end + 7) & ~7ull;
+        wav_put(b, end, 8);
+        wav_put(b + 8, 24 + data, 8);
+        if (WAV_FSEEK(fp, 16, SEEK_SET) != 0 || fwrite(b, 1, 8, fp) != 8)
+            return -1;
+        if (WAV_FSEEK(fp, 96, SEEK_SET) != 0 || fwrite(b + 8, 1, 8, fp) != 8)
+            return -1;
+        break;
+    default:
+        return -1;
+    }
+
+    return WAV_FSEEK(fp, 0, SEEK_END) == 0 ? 0 : -1;
+}
+/* ..................... End of wav_write_sizes() .................... */
+
+
+/*
+  ============================================================================
+
+       FILE *wav_create (char *name);
+       ~~~~~~~~~~~~~~~~
+
+       Open an output file, in binary mode; "-" is stdout.
+
+       Parameter:
+       ~~~~~~~~~~
+       name ..... file name, or "-"
+
+       Returns
+       ~~~~~~~
+       The stream, or NULL if the file can't be created.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+FILE* wav_create(char* name) {
+    if (strcmp(name, "-") == 0) {
+#if defined(_WIN32)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        return stdout;
+    }
+    return fopen(name, "wb");
+}
+/* ....................... End of wav_create() ...................... */
+
+
+/*
+  ============================================================================
+
+       int wav_seekable (FILE *fp);
+       ~~~~~~~~~~~~~~~~
+
+       Tell whether a stream is a file that can be positioned, as
+       opposed to a pipe, a socket or a terminal, whose header can't
+       be parsed backwards nor patched.
+
+       Parameter:
+       ~~~~~~~~~~
+       fp ....... stream
+
+       Returns
+       ~~~~~~~
+       1 if `fp' can be positioned, 0 otherwise.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int wav_seekable(FILE* fp) {
+#if defined(_WIN32)
+    return GetFileType((HANDLE)_get_osfhandle(_fileno(fp))) == FILE_TYPE_DISK;
+#elif defined(WAV_MMAP_POSIX)
+    struct stat st;
+    return fstat(fileno(fp), &st) == 0 && (S_ISREG(st.st_mode) || S_ISBLK(st.st_mode));
+#else
+    return WAV_FSEEK(fp, 0, SEEK_CUR) == 0;
+#endif
+}
+/* ...................... End of wav_seekable() ..................... */
+
+
+/*
+  ============================================================================
+
+       void wav_set_pipeline (int depth, long block);
+       ~~~~~~~~~~~~~~~~~~~~~
+
+       Set the queue depth and block size that wav_prefetch() and
+       wav_out_open() take for WAV_PIPE_DEFAULT, i.e. those of the
+       readers and writers of actlevel(), sv56demo() and ssrc(). The
+       defaults are WAV_QUEUE_DEPTH blocks of WAV_BLOCK_SIZE bytes.
+
+       Parameter:
+       ~~~~~~~~~~
+       depth .... blocks in the queue; 0 does all I/O in the calling
+                  thread, as before the pipeline
+       block .... bytes per block; 0 or less for WAV_BLOCK_SIZE
+
+       Returns
+       ~~~~~~~
+       None
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+void wav_set_pipeline(int depth, long block) {
+    wav_pipe_depth = depth > 0 ? depth : 0;
+    wav_pipe_block = block > 0 ? block : WAV_BLOCK_SIZE;
+}
+/* .................... End of wav_set_pipeline() .................... */
+
+
+/*
+  ============================================================================
+
+       int wav_prefetch (WAV_file *wf, int depth, long block);
+       ~~~~~~~~~~~~~~~~
+
+       Start an I/O thread that reads the samples of an open file ahead
+       of wav_read(), up to `depth' blocks of `block' bytes, so that
+       the latency of the disk or network overlaps with the caller's
+       processing. A stream is read into the blocks; a mapped file has
+       its pages touched ahead instead, which keeps wav_read() copy-
+       free. wav_read(), wav_rewind(), wav_copy() and wav_close() are
+       used as before; the thread stops with wav_close().
+
+       Parameter:
+       ~~~~~~~~~~
+       wf ....... reader state, just opened
+       depth .... blocks read ahead, or WAV_PIPE_DEFAULT
+       block .... bytes per block, or WAV_PIPE_DEFAULT; rounded down
+                  to whole frames
+
+       Returns
+       ~~~~~~~
+       1 if the thread runs, 0 if the file is read in the calling
+       thread (depth 0, no thread support, or no memory).
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int wav_prefetch(WAV_file* wf, int depth, long block) {
+#if defined(WAV_THREADS)
+    size_t size;
+
+    if (depth == WAV_PIPE_DEFAULT)
+        depth = wav_pipe_depth;
+    if (block == WAV_PIPE_DEFAULT)
+        block = wav_pipe_block;
+    if (wf->pipe != NULL || depth <= 0 || block <= 0 || wf->pos >= wf->data_bytes)
+        return wf->pipe != NULL;
+
+    /* Mapped files have no blocks to fill, just pages to touch */
+    size = (size_t)block;
+    size -= size % wf->block_align;
+    if (size == 0)
+        size = wf->block_align;
+    if ((wf->pipe = wav_pipe_new(depth, size, wf->map == NULL, wf->map != NULL ? wav_pipe_touch : wav_pipe_fetch)) == NULL)
+        return 0;
+    wf->pipe->fp = wf->fp;
+    wf->pipe->map = wf->map;
+
+    wav_pipe_resume(wf);
+    if (!wf->pipe->running) {
+        wav_pipe_free(wf->pipe);
+        wf->pipe = NULL;
+        return 0;
+    }
+    return 1;
+#else
+    (void)wf;
+    (void)depth;
+    (void)block;
+    return 0;
+#endif
+}
+/* ...................... End of wav_prefetch() ...................... */
+
+
+/*
+  ============================================================================
+
+       int wav_out_open (WAV_out *wo, FILE *fp, int depth, long block);
+       ~~~~~~~~~~~~~~~~
+
+       Set up a writer over an open stream, with an I/O thread writing
+       behind the caller through a queue of `depth' blocks of `block'
+       bytes. Whatever precedes the samples (e.g. a header) should be
+       written to `fp' beforehand, and whatever follows them, or
+       patches them, after wav_out_close().
+
+       Parameter:
+       ~~~~~~~~~~
+       wo ....... writer state to be initialized
+       fp ....... output stream
+       depth .... blocks in the queue, or WAV_PIPE_DEFAULT
+       block .... bytes per block, or WAV_PIPE_DEFAULT
+
+       Returns
+       ~~~~~~~
+       1 if the thread runs, 0 if wav_out_write() will write in the
+       calling thread (depth 0, no thread support, or no memory).
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int wav_out_open(WAV_out* wo, FILE* fp, int depth, long block) {
+    wo->fp = fp;
+    wo->pipe = NULL;
+#if defined(WAV_THREADS)
+    if (depth == WAV_PIPE_DEFAULT)
+        depth = wav_pipe_depth;
+    if (block == WAV_PIPE_DEFAULT)
+        block = wav_pipe_block;
+    /* One block is being filled while the others are written */
+    if (depth <= 0 || block <= 0 || (wo->pipe = wav_pipe_new(depth + 1, (size_t)block, 1, wav_pipe_drain)) == NULL)
+        return 0;
+    wo->pipe->fp = fp;
+    if (!wav_pipe_start(wo->pipe)) {
+        wav_pipe_free(wo->pipe);
+        wo->pipe = NULL;
+    }
+#else
+    (void)depth;
+    (void)block;
+#endif
+    return wo->pipe != NULL;
+}
+/* ...................... End of wav_out_open() ...................... */
+
+
+/*
+  ============================================================================
+
+       size_t wav_out_write (const void *data, size_t size, size_t n,
+       ~~~~~~~~~~~~~~~~~~~~  WAV_out *wo);
+
+       Queue `n' items of `size' bytes for writing; same arguments and
+       return value as fwrite(). Write errors of the I/O thread show
+       up in a later call, or in wav_out_close().
+
+       Parameter:
+       ~~~~~~~~~~
+       data ..... items to be written
+       size ..... bytes per item
+       n ........ number of items
+       wo ....... writer state
+
+       Returns
+       ~~~~~~~
+       `n', or 0 after a write error.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+       19.Oct.26	v1.1	Counted, and timed from WAV_TIMED bytes.
+
+  ============================================================================
+*/
+static size_t wav_out_queue(const void* data, size_t size, size_t n, WAV_out* wo) {
+#if defined(WAV_THREADS)
+    struct wav_pipe* p = wo->pipe;
+    const unsigned char* src = (const unsigned char*)data;
+    size_t left = size * n, k;
+
+    if (p == NULL)
+        return fwrite(data, size, n, wo->fp);
+
+    while (left > 0) {
+        if (p->off == p->block && !wav_pipe_push(p))
+            return 0;
+        k = p->block - p->off;
+        if (k > left)
+            k = left;
+        memcpy(p->blocks + p->fill * p->block + p->off, src, k);
+        p->off += k;
+        src += k;
+        left -= k;
+    }
+    return n;
+#else
+    return fwrite(data, size, n, wo->fp);
+#endif
+}
+
+size_t wav_out_write(const void* data, size_t size, size_t n, WAV_out* wo) {
+    size_t done;
+    int timed = size * n >= WAV_TIMED;
+
+    if (timed)
+        SV_STAGE_ENTER(SV_STAGE_WRITE);
+    done = wav_out_queue(data, size, n, wo);
+    SV_COUNT(SV_COUNT_BYTES_WRITTEN, done * size);
+    if (timed)
+        SV_STAGE_LEAVE();
+    return done;
+}
+/* ..................... End of wav_out_write() ...................... */
+
+
+/*
+  ============================================================================
+
+       int wav_out_close (WAV_out *wo);
+       ~~~~~~~~~~~~~~~~~
+
+       Write out what is left in the queue and stop the I/O thread. The
+       stream itself is left open, positioned after the samples.
+
+       Parameter:
+       ~~~~~~~~~~
+       wo ....... writer state
+
+       Returns
+       ~~~~~~~
+       0 on success, -1 if some samples couldn't be written.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int wav_out_close(WAV_out* wo) {
+    int error = 0;
+
+#if defined(WAV_THREADS)
+    if (wo->pipe != NULL) {
+        if (wo->pipe->off > 0)
+            wav_pipe_push(wo->pipe);
+        wav_pipe_halt(wo->pipe);
+        error = wo->pipe->error;
+        wav_pipe_free(wo->pipe);
+        wo->pipe = NULL;
+    }
+#endif
+    return error || ferror(wo->fp) ? -1 : 0;
+}
+/* ...................... End of wav_out_close() ..................... */
+
+
+/*
+  ============================================================================
+
+       int wav_rw_open (WAV_rw *rw, char *name);
+       ~~~~~~~~~~~~~~~
+
+       Open a file for rewriting parts of it in place, e.g. the samples
+       of its data chunk, leaving the rest of the file as it is. Windows
+       of the file are then taken one at a time by wav_rw_map(), changed
+       in memory and written back by wav_rw_sync().
+
+       Parameter:
+       ~~~~~~~~~~
+       rw ....... in-place writer to set up
+       name ..... file name; a regular file, not a stream
+
+       Returns
+       ~~~~~~~
+       0 on success, -1 if the file can't be opened for update.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int wav_rw_open(WAV_rw* rw, char* name) {
+    memset(rw, 0, sizeof(*rw));
+    rw->fd = -1;
+
+#if defined(WAV_MMAP_WIN32)
+    {
+        HANDLE file;
+        LARGE_INTEGER size;
+
+        file = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return -1;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 ||
+            (rw->mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, 0, NULL)) == NULL) {
+            CloseHandle(file);
+            return -1;
+        }
+        rw->handle = file;
+        rw->file_size = (unsigned long long)size.QuadPart;
+        return 0;
+    }
+#elif defined(WAV_MMAP_POSIX)
+    {
+        struct stat st;
+
+        if (stat(name, &st) != 0 || !S_ISREG(st.st_mode) || (rw->fd = open(name, O_RDWR)) < 0)
+            return -1;
+        if (fstat(rw->fd, &st) != 0) {
+            close(rw->fd);
+            return -1;
+        }
+        rw->file_size = (unsigned long long)st.st_size;
+        return 0;
+    }
+#else
+    if ((rw->fp = fopen(name, "r+b")) == NULL)
+        return -1;
+    WAV_FSEEK(rw->fp, 0, SEEK_END);
+    rw->file_size = (unsigned long long)WAV_FTELL(rw->fp);
+    return 0;
+#endif
+}
+/* ....................... End of wav_rw_open() ...................... */
+
+
+/* Release the current window, written back or not */
+static void wav_rw_unmap(WAV_rw* rw) {
+    if (rw->view == NULL)
+        return;
+#if defined(WAV_MMAP_WIN32)
+    UnmapViewOfFile(rw->view);
+#elif defined(WAV_MMAP_POSIX)
+    munmap(rw->view, rw->view_len);
+#else
+    free(rw->view);
+#endif
+    rw->view = NULL;
+    rw->data = NULL;
+}
+
+
+/*
+  ============================================================================
+
+       unsigned char *wav_rw_map (WAV_rw *rw, unsigned long long offset,
+       ~~~~~~~~~~~~~~~~~~~~~~~~~  unsigned long len);
+
+       Take the window [offset, offset + len) of the file for update,
+       releasing the previous one: it is mapped shared, so that changes
+       reach the file, or, where the file can't be mapped, read into a
+       buffer which wav_rw_sync() writes back.
+
+       Parameter:
+       ~~~~~~~~~~
+       rw ....... in-place writer
+       offset ... first byte of the window in the file
+       len ...... size of the window, in bytes, within the file
+
+       Returns
+       ~~~~~~~
+       Pointer to the first byte of the window, or NULL on failure.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+unsigned char* wav_rw_map(WAV_rw* rw, unsigned long long offset, unsigned long len) {
+    unsigned long long base;
+
+    wav_rw_unmap(rw);
+    if (len == 0 || offset + len > rw->file_size)
+        return NULL;
+
+#if defined(WAV_MMAP_WIN32)
+    {
+        SYSTEM_INFO si;
+
+        /* Views start on the allocation granularity */
+        GetSystemInfo(&si);
+        base = offset - offset % si.dwAllocationGranularity;
+        rw->view_len = (unsigned long)(offset - base) + len;
+        rw->view = (unsigned char*)MapViewOfFile((HANDLE)rw->mapping, FILE_MAP_WRITE,
+                                                 (DWORD)(base >> 32), (DWORD)base, rw->view_len);
+        if (rw->view == NULL)
+            return NULL;
+    }
+#elif defined(WAV_MMAP_POSIX)
+    {
+        void* view;
+        long page = sysconf(_SC_PAGESIZE);
+
+        /* Mappings start on a page */
+        base = offset - offset % (unsigned long long)(page > 0 ? page : WAV_PAGE);
+        rw->view_len = (unsigned long)(offset - base) + len;
+        view = mmap(NULL, rw->view_len, PROT_READ | PROT_WRITE, MAP_SHARED, rw->fd, (off_t)base);
+        if (view == MAP_FAILED)
+            return NULL;
+        rw->view = (unsigned char*)view;
+    }
+#else
+    base = offset;
+    rw->view_len = len;
+    if ((rw->view = (unsigned char*)malloc(len)) == NULL)
+        return NULL;
+    if (WAV_FSEEK(rw->fp, offset, SEEK_SET) != 0 || fread(rw->view, 1, len, rw->fp) != len) {
+        wav_rw_unmap(rw);
+        return NULL;
+    }
+#endif
+    rw->offset = offset;
+    rw->len = len;
+    rw->data = rw->view + (offset - base);
+    return rw->data;
+}
+/* ....................... End of wav_rw_map() ....................... */
+
+
+/*
+  ============================================================================
+
+       int wav_rw_sync (WAV_rw *rw);
+       ~~~~~~~~~~~~~~~
+
+       Write the current window back and wait until it is on the disk,
+       so that a crash past this point can't lose the changes.
+
+       Parameter:
+       ~~~~~~~~~~
+       rw ....... in-place writer
+
+       Returns
+       ~~~~~~~
+       0 on success, -1 on a write error.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int wav_rw_sync(WAV_rw* rw) {
+    if (rw->view == NULL)
+        return 0;
+#if defined(WAV_MMAP_WIN32)
+    return FlushViewOfFile(rw->view, rw->view_len) && FlushFileBuffers((HANDLE)rw->handle) ? 0 : -1;
+#elif defined(WAV_MMAP_POSIX)
+    return msync(rw->view, rw->view_len, MS_SYNC);
+#else
+    if (WAV_FSEEK(rw->fp, rw->offset, SEEK_SET) != 0 || fwrite(rw->data, 1, rw->len, rw->fp) != rw->len)
+        return -1;
+    return wav_flush(rw->fp);
+#endif
+}
+/* ...................... End of wav_rw_sync() ....................... */
+
+
+/*
+  ============================================================================
+
+       void wav_rw_close (WAV_rw *rw);
+       ~~~~~~~~~~~~~~~~~
+
+       Release the window and close the file. A window not synced may
+       or may not have reached the file.
+
+       Parameter:
+       ~~~~~~~~~~
+       rw ....... in-place writer
+
+       Returns
+       ~~~~~~~
+       None
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+void wav_rw_close(WAV_rw* rw) {
+    wav_rw_unmap(rw);
+#if defined(WAV_MMAP_WIN32)
+    if (rw->mapping != NULL)
+        CloseHandle((HANDLE)rw->mapping);
+    if (rw->handle != NULL)
+        CloseHandle((HANDLE)rw->handle);
+#elif defined(WAV_MMAP_POSIX)
+    if (rw->fd >= 0)
+        close(rw->fd);
+#else
+    if (rw->fp != NULL)
+        fclose(rw->fp);
+#endif
+    memset(rw, 0, sizeof(*rw));
+    rw->fd = -1;
+}
+/* ...................... End of wav_rw_close() ...................... */
+
+
+/*
+  ============================================================================
+
+       int wav_flush (FILE *fp);
+       ~~~~~~~~~~~~~
+
+       Flush a stream and wait until its bytes are on the disk, e.g.
+       for a journal that must be complete before the file it guards
+       is changed.
+
+       Parameter:
+       ~~~~~~~~~~
+       fp ....... stream, opened for writing
+
+       Returns
+       ~~~~~~~
+       0 on success, -1 on a write error.
+
+       Log of changes
+       ~~~~~~~~~~~~~~
+       19.Oct.26	v1.0	Creation.
+
+  ============================================================================
+*/
+int wav_flush(FILE* fp) {
+    if (fflush(fp) != 0)
+        return -1;
+#if defined(_WIN32)
+    return _commit(_fileno(fp));
+#elif defined(WAV_MMAP_POSIX)
+    return fsync(fileno(fp));
+#else
+    return 0;
+#endif
+}
+/* ........................ End of wav_flush() ....................... */
+
+#undef WAV_RIFF_MAX
+#undef WAV_PAGE
+#undef WAV_ALIGN
+#undef WAV_DROP
+#undef WAV_TIMED
+/* ......................... End of WAVFILE.C ........................... */
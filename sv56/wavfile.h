@@ -0,0 +1,188 @@
+/*
+  ============================================================================
+   File: WAVFILE.H                                            19.Oct.26 v1.7
+  ============================================================================
+
+                       UGST/ITU-T WAVE FILE READER MODULE
+
+                          GLOBAL FUNCTION PROTOTYPES
+
+   History:
+   19.Oct.26    v1.0    First version, memory-mapped reader shared by
+                        actlevel(), sv56demo() and ssrc().
+   19.Oct.26    v1.1    RF64 and Wave64 containers, 64-bit sizes; header
+                        writer for ssrc().
+   19.Oct.26    v1.2    Prefetching reader and write-behind writer, run
+                        by I/O threads over queues of aligned blocks.
+   19.Oct.26    v1.3    Non-seekable input and output (pipes, stdin and
+                        stdout as "-"), with headers of unknown size.
+   19.Oct.26    v1.4    IEEE float and WAVE_FORMAT_EXTENSIBLE input.
+   19.Oct.26    v1.5    In-place rewriting of a file, through writable
+                        windows, and durable flushes.
+   19.Oct.26    v1.6    wav_seek().
+   19.Oct.26    v1.7    wav_rate().
+
+  ============================================================================
+*/
+#ifndef WAVFILE_defined
+#define WAVFILE_defined 170
+
+#include <stdio.h>
+
+/* macros for smart prototypes */
+#ifndef ARGS
+#if (defined(__STDC__) || defined(VMS) || defined(__DECC)  || defined(MSDOS) || defined(__MSDOS__)) || defined (__CYGWIN__) || defined (_MSC_VER)
+#define ARGS(s) s
+#else
+#define ARGS(s) ()
+#endif
+#endif
+
+/* Containers, in WAV_file.container and for wav_write_header() */
+#define WAV_RIFF                0   /* RIFF/WAVE, sizes below 4 GB */
+#define WAV_RF64                1   /* EBU Tech 3306 RF64, sizes in a "ds64" chunk */
+#define WAV_W64                 2   /* Sony Wave64, GUID chunk ids and 64-bit sizes */
+#define WAV_STREAMED            0x100 /* or'ed to the container: sizes written as
+                                       * unknown, for a stream that can't be patched */
+
+/* Sample formats, in WAV_file.format and for wav_write_header() */
+#define WAV_FORMAT_PCM          1   /* integer samples */
+#define WAV_FORMAT_FLOAT        3   /* IEEE float samples, full scale at 1.0 */
+#define WAV_FORMAT_EXTENSIBLE   0xFFFE /* the format is in the SubFormat GUID */
+
+/* I/O pipeline: blocks in the queue, and bytes per block */
+#define WAV_QUEUE_DEPTH         4
+#define WAV_BLOCK_SIZE          (1L << 20)
+#define WAV_PIPE_DEFAULT        -1  /* value set by wav_set_pipeline() */
+
+/* Error codes returned by wav_open(), and by wav_header_read() and
+   wav_header_check() of sv56.h, which includes this header */
+#define WAV_HEADER_NOK          -1
+#define WAV_HEADER_NOT_PCM      -2
+#define WAV_HEADER_NOT_MONO     -3
+#define WAV_HEADER_NOT_16BIT    -4
+
+/*
+ * An open wave (or headerless 16-bit) file. The RIFF chunks are parsed
+ * once by wav_open(); the samples are then read in place from a
+ * read-only mapping of the whole file, or, where the file can't be
+ * mapped, through a stdio stream and an internal buffer. Either way
+ * wav_read() hands out a pointer to the interleaved samples, valid
+ * until the next call.
+ */
+typedef struct {
+    int container;                /* WAV_RIFF, WAV_RF64 or WAV_W64 */
+    int stream;                   /* 0 for a file, 1 for a pipe, 2 for stdin */
+
+    /* Format, from the "fmt " chunk */
+    int format;                   /* WAV_FORMAT_PCM or WAV_FORMAT_FLOAT */
+    int channels;                 /* number of interleaved channels */
+    long sample_rate;             /* in Hz */
+    long byte_rate;               /* bytes per second */
+    int block_align;              /* bytes per frame, all channels */
+    int bits;                     /* bits per sample */
+
+    /* Sample region, from the "data" chunk */
+    unsigned long long data_offset; /* first byte of the samples in the file */
+    unsigned long long data_bytes;  /* size of the samples, in bytes */
+    unsigned long long pos;       /* bytes of samples read so far */
+    unsigned long long file_size; /* size of the whole file, in bytes */
+
+    /* Backing store */
+    const unsigned char* map;     /* whole file, or NULL when not mapped */
+    unsigned long long dropped;   /* bytes of the mapping released behind pos */
+    FILE* fp;                     /* stream, when not mapped */
+    unsigned char* buf;           /* read buffer, when not mapped */
+    unsigned long buf_size;       /* size of buf, in bytes */
+    void* handle;                 /* mapping handle (Win32) */
+    struct wav_pipe* pipe;        /* I/O thread, when prefetching */
+
+    /* Header of a stream, read forward only */
+    unsigned char lead[40];       /* first bytes of the stream */
+    unsigned long lead_len;       /* number of bytes in lead */
+    unsigned long long stream_pos; /* bytes read from the stream so far */
+} WAV_file;
+
+/*
+ * An output stream written behind by an I/O thread: wav_out_write()
+ * only copies the bytes into a queue of blocks, which the thread
+ * writes out while the caller goes on computing.
+ */
+typedef struct {
+    FILE* fp;                     /* output stream */
+    struct wav_pipe* pipe;        /* I/O thread, or NULL to write in place */
+} WAV_out;
+
+/*
+ * A file rewritten in place: one window of it at a time is mapped
+ * shared and writable (or, where the file can't be mapped, read into a
+ * buffer), changed by the caller, then written back by wav_rw_sync().
+ */
+typedef struct {
+    unsigned char* data;          /* the window, as asked for */
+    unsigned long len;            /* size of the window, in bytes */
+    unsigned long long offset;    /* of the window in the file */
+    unsigned long long file_size; /* size of the whole file, in bytes */
+    unsigned char* view;          /* mapping, from a page boundary */
+    unsigned long view_len;       /* size of the mapping, in bytes */
+    FILE* fp;                     /* stream, when not mapped */
+    void* handle;                 /* file handle (Win32) */
+    void* mapping;                /* mapping handle (Win32) */
+    int fd;                       /* file descriptor (POSIX) */
+} WAV_rw;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Wave file reader prototypes */
+int wav_open ARGS((char* name, int raw, WAV_file* wf));
+long wav_read ARGS((WAV_file* wf, long nframes, const void** data));
+int wav_rewind ARGS((WAV_file* wf));
+int wav_seek ARGS((WAV_file* wf, unsigned long long frame));
+long long wav_copy ARGS((WAV_file* wf, unsigned long long from, unsigned long long to, FILE* out));
+void wav_close ARGS((WAV_file* wf));
+long wav_write_header ARGS((FILE* fp, int container, int format, int channels, long rate, int bits));
+int wav_write_sizes ARGS((FILE* fp, int container, int block_align));
+FILE* wav_create ARGS((char* name));
+int wav_seekable ARGS((FILE* fp));
+
+/* I/O pipeline prototypes */
+void wav_set_pipeline ARGS((int depth, long block));
+int wav_prefetch ARGS((WAV_file* wf, int depth, long block));
+int wav_out_open ARGS((WAV_out* wo, FILE* fp, int depth, long block));
+size_t wav_out_write ARGS((const void* data, size_t size, size_t n, WAV_out* wo));
+int wav_out_close ARGS((WAV_out* wo));
+
+/* In-place rewriting prototypes */
+int wav_rw_open ARGS((WAV_rw* rw, char* name));
+unsigned char* wav_rw_map ARGS((WAV_rw* rw, unsigned long long offset, unsigned long len));
+int wav_rw_sync ARGS((WAV_rw* rw));
+void wav_rw_close ARGS((WAV_rw* rw));
+int wav_flush ARGS((FILE* fp));
+
+#ifdef __cplusplus
+}
+#endif
+
+/* 64-bit positioning of stdio streams */
+#if defined(_MSC_VER)
+#define WAV_FSEEK(fp, off, whence) _fseeki64((fp), (long long)(off), (whence))
+#define WAV_FTELL(fp) ((long long)_ftelli64(fp))
+#elif defined(unix) || defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#include <sys/types.h>
+#define WAV_FSEEK(fp, off, whence) fseeko((fp), (off_t)(off), (whence))
+#define WAV_FTELL(fp) ((long long)ftello(fp))
+#else
+#define WAV_FSEEK(fp, off, whence) fseek((fp), (long)(off), (whence))
+#define WAV_FTELL(fp) ((long long)ftell(fp))
+#endif
+
+/* Number of frames left to be read */
+#define wav_frames_left(wf) (((wf)->data_bytes - (wf)->pos) / (wf)->block_align)
+
+/* Sampling rate of the file, in Hz, or `sf' when it has no header */
+#define wav_rate(wf, sf) ((wf)->sample_rate > 0 ? (double)(wf)->sample_rate : (double)(sf))
+
+#endif /* WAVFILE_defined */
+/* ......................... End of WAVFILE.H ........................... */
@@ -0,0 +1,67 @@
+# The result cache: a file is read once on a miss and not at all on a
+# hit, and damaged or truncated entries are ignored and written again
+import glob
+import os
+import sys
+import tempfile
+import time
+
+import pysv
+import wavtool
+
+
+def measure(name):
+    # calculate() of in.wav, against the result without the cache, with
+    # whether it was a hit and the bytes it read
+    st = pysv.calculate('in.wav')
+    err = wavtool.same_state(st, ref)
+    assert err is None, '%s: %s' % (name, err)
+    call = pysv.stats()['call']
+    return call['cache_hits'] == 1, call['bytes_read']
+
+
+def entry(ext):
+    found = glob.glob(os.path.join('cache', '*', '*' + ext))
+    assert len(found) == 1, '%s entries: %d' % (ext, len(found))
+    with open(found[0], 'rb') as f:
+        return found[0], f.read()
+
+
+os.chdir(tempfile.mkdtemp())
+x = wavtool.to_int16(wavtool.speech(6))
+wavtool.write('in.wav', x)
+# Files changed in the last seconds are not keyed by stat()
+past = time.time() - 100
+os.utime('in.wav', (past, past))
+size = 2 * len(x)
+ref = pysv.calculate('in.wav')
+
+assert pysv.set_result_cache('cache') == 0, 'cache directory'
+assert measure('miss') == (False, size), 'a miss reads the file once'
+assert measure('hit') == (True, 0), 'a hit reads nothing'
+path, good = entry('.r')
+print('miss and hit: ok')
+
+# A result entry with a bit flipped, or cut short, is not used: the
+# file is measured again, and the entry written again
+for name, bad in (('bit flip', good[:100] + bytes([good[100] ^ 1]) + good[101:]),
+                  ('truncated', good[:len(good) // 2]),
+                  ('empty', b'')):
+    with open(path, 'wb') as f:
+        f.write(bad)
+    assert measure(name) == (False, size), '%s: entry used' % name
+    assert entry('.r') == (path, good), '%s: entry not written again' % name
+    assert measure(name + ', then') == (True, 0), '%s: no hit after' % name
+    print('%s result entry: ok' % name)
+
+# A damaged name entry: the file is measured, and hashed in the same pass
+spath, sgood = entry('.s')
+with open(spath, 'wb') as f:
+    f.write(sgood[:-1] + bytes([sgood[-1] ^ 0x80]))
+assert measure('name entry') == (False, size), 'name entry used'
+assert entry('.s') == (spath, sgood), 'name entry not written again'
+assert measure('name entry, then') == (True, 0), 'no hit after the name entry'
+print('damaged name entry: ok')
+
+pysv.set_result_cache('')
+sys.exit(0)
@@ -0,0 +1,43 @@
+# calculate_channels() against calculate() of each channel on its own
+import os
+import sys
+import tempfile
+
+import pysv
+import wavtool
+
+
+def check(nch, seconds):
+    chans = [wavtool.to_int16(wavtool.speech(seconds, seed=ch + 1, level=0.1 + 0.02 * (ch % 10)))
+             for ch in range(nch)]
+    wavtool.write('multi.wav', wavtool.interleave(chans), channels=nch)
+    states = pysv.calculate_channels('multi.wav')
+    assert len(states) == nch + 1, 'channels: %d, expected %d' % (len(states) - 1, nch)
+    # In one pass, however many channels
+    read = pysv.stats()['call']['bytes_read']
+    assert read == 2 * nch * len(chans[0]), 'read %d bytes' % read
+
+    for ch in range(nch):
+        wavtool.write('mono.wav', chans[ch])
+        err = wavtool.same_state(states[ch], pysv.calculate('mono.wav'))
+        assert err is None, 'channel %d: %s' % (ch, err)
+
+    # The last entry is the channel average, as a float mono file
+    mix = [sum(frame) / (nch * 32768.0) for frame in zip(*chans)]
+    wavtool.write('mix.wav', mix, fmt='float')
+    err = wavtool.same_state(states[nch], pysv.calculate('mix.wav'), tol=1e-5)
+    assert err is None, 'mix: %s' % err
+    assert len(pysv.calculate_channels('multi.wav', False)) == nch
+    print('%d channels: ok' % nch)
+
+
+os.chdir(tempfile.mkdtemp())
+check(1, 2)
+check(3, 4)
+check(300, 0.2)
+
+# A file without samples is an error, not a state of NaNs
+wavtool.write('empty.wav', [], channels=2)
+assert pysv.calculate_channels('empty.wav') == [], 'no samples'
+print('no samples: ok')
+sys.exit(0)
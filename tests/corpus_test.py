@@ -0,0 +1,73 @@
+# normalize_corpus(): one file as normalize() equalizes it, and all the
+# files or none on errors, which are returned and never exit()
+import os
+import sys
+import tempfile
+
+import pysv
+import wavtool
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+os.chdir(tempfile.mkdtemp())
+x = wavtool.to_int16(wavtool.speech(6))
+
+# A corpus of one file is that file, equalized alone
+for fmt, samples in (('pcm16', x), ('float', [v / 32768.0 for v in x])):
+    wavtool.write('one.wav', samples, fmt=fmt)
+    pysv.normalize('one.wav', 'single.wav', -26)
+    states = pysv.normalize_corpus(['one.wav'], ['corpus.wav'], -26)
+    assert len(states) == 2, '%s: %d states' % (fmt, len(states))
+    assert read('corpus.wav') == read('single.wav'), '%s: not the bytes of normalize()' % fmt
+    # The states are found from the gain, not measured: up to the
+    # truncation to 16 bits, which moves the thresholds of P.56 a little
+    out = pysv.calculate('corpus.wav')
+    for st in states:
+        assert st.n == out.n, '%s: n' % fmt
+        for k in ('rmsdB', 'ActiveSpeechLevel'):
+            assert abs(getattr(st, k) - getattr(out, k)) < 0.05, '%s: %s' % (fmt, k)
+    print('%s, one file as normalize(): ok' % fmt)
+
+# Three files, and then each of the errors: an empty list, and no
+# output left, not even of the files that could be equalized
+for k, level in enumerate((0.05, 0.2, 0.5)):
+    wavtool.write('in%d.wav' % k, wavtool.to_int16(wavtool.speech(3, seed=k + 2, level=level)))
+ins = ['in0.wav', 'in1.wav', 'in2.wav']
+outs = ['out0.wav', 'out1.wav', 'out2.wav']
+states = pysv.normalize_corpus(ins, outs, -26)
+assert len(states) == 4 and all(os.path.exists(o) for o in outs), 'three files'
+assert abs(states[3].ActiveSpeechLevel + 26) < 0.1, 'corpus level %g' % states[3].ActiveSpeechLevel
+for o in outs:
+    os.remove(o)
+print('three files: ok')
+
+wavtool.write('empty.wav', [])
+wavtool.write('rate8k.wav', x[:8000], rate=8000)
+cases = (('no samples', ['in0.wav', 'empty.wav', 'in2.wav'], outs),
+         ('missing input', ['in0.wav', 'in1.wav', 'none.wav'], outs),
+         ('two sampling rates', ['in0.wav', 'in1.wav', 'rate8k.wav'], outs),
+         ('output not writable', ins, ['out0.wav', os.path.join('no', 'dir.wav'), 'out2.wav']))
+for name, i, o in cases:
+    assert pysv.normalize_corpus(i, o, -26) == [], '%s: no error' % name
+    left = [p for p in o if os.path.exists(p)]
+    assert left == [], '%s: %s left' % (name, ', '.join(left))
+    print('%s: ok' % name)
+
+# Outputs named as an input, of their own file or of another, or twice:
+# refused before any file is read, the inputs as they were
+before = [read(p) for p in ins]
+cases = (('output named as its input', ['out0.wav', 'in1.wav', 'out2.wav']),
+         ('output named as another input', ['x.wav', 'in0.wav', os.path.join('no', 'dir.wav')]),
+         ('output named twice', ['x.wav', 'x.wav', 'out2.wav']))
+for name, o in cases:
+    for threads in (1, 3):
+        assert pysv.normalize_corpus(ins, o, -26, threads) == [], '%s: no error' % name
+        assert [read(p) for p in ins] == before, '%s: an input changed' % name
+        left = [p for p in o if p not in ins and os.path.exists(p)]
+        assert left == [], '%s: %s left' % (name, ', '.join(left))
+    print('%s: ok' % name)
+sys.exit(0)
@@ -0,0 +1,68 @@
+# The same samples in other sample formats must measure the same
+import os
+import sys
+import tempfile
+
+import pysv
+import wavtool
+
+
+def check(name, a, b, tol=0.0, fields=wavtool.STATE_FIELDS):
+    err = wavtool.same_state(a, b, tol, fields)
+    assert err is None, '%s: %s' % (name, err)
+    print('%s: ok' % name)
+
+
+os.chdir(tempfile.mkdtemp())
+x = wavtool.to_int16(wavtool.speech(6))
+wavtool.write('int16.wav', x)
+ref = pysv.calculate('int16.wav')
+
+# 16-bit samples go through the integer voltmeter, float samples
+# through the float one; k / 32768 is exact in float
+wavtool.write('float.wav', [v / 32768.0 for v in x], fmt='float')
+check('int16 and float voltmeters', ref, pysv.calculate('float.wav'))
+
+# RF64 and Wave64 containers hold the same samples as RIFF
+for c in ('rf64', 'w64'):
+    wavtool.write(c + '.wav', x, container=c)
+    check(c + ' input', ref, pysv.calculate(c + '.wav'))
+    assert wavtool.read(c + '.wav')[3] == x
+
+# The converter reads them alike, and writes Wave64 for *.w64 outputs
+pysv.samplerate_change('int16.wav', 'out.wav', 8000)
+out = wavtool.read('out.wav')
+for c in ('rf64', 'w64'):
+    pysv.samplerate_change(c + '.wav', c + '_out.wav', 8000)
+    assert wavtool.read(c + '_out.wav') == out, c + ' conversion'
+pysv.samplerate_change('int16.wav', 'out.w64', 8000)
+with open('out.w64', 'rb') as f:
+    assert f.read(16) == wavtool.W64_RIFF, 'not a Wave64 file'
+assert wavtool.read('out.w64') == out, 'Wave64 output'
+check('Wave64 output', pysv.calculate('out.wav'), pysv.calculate('out.w64'))
+print('rf64 and w64 conversions: ok')
+
+# Float output: the 16-bit output before rounding, to the precision of
+# floats. The converter takes 0x7fff as full scale, so that a float
+# input of x / 32767 converts as the 16-bit input x does
+pysv.samplerate_change('int16.wav', 'out_float.wav', 8000, float_out=True)
+rate, nch, fmt, y = wavtool.read('out_float.wav')
+assert (rate, nch, fmt) == (8000, 1, 'float'), 'float output format'
+assert max(abs(a - b * 32767) for a, b in zip(out[3], y)) <= 0.501, 'float output'
+wavtool.write('float7fff.wav', [v / 32767.0 for v in x], fmt='float')
+pysv.samplerate_change('float7fff.wav', 'out_float2.wav', 8000)
+assert wavtool.read('out_float2.wav')[2] == 'float', 'float input, float output'
+assert max(abs(a - b) for a, b in zip(y, wavtool.read('out_float2.wav')[3])) < 1e-6, 'float input'
+print('float conversions: ok')
+
+# Equalized float files stay float, scaled without rounding
+pysv.normalize('float.wav', 'norm_float.wav', -26)
+pysv.normalize('int16.wav', 'norm_int16.wav', -26)
+rate, nch, fmt, z = wavtool.read('norm_float.wav')
+assert fmt == 'float', 'float equalization output'
+gain = max(z) / max(v / 32768.0 for v in x)
+assert all(abs(a - gain * b / 32768.0) <= 1e-6 * abs(a) for a, b in zip(z, x)), 'float equalization'
+# Only the rounding to 16 bits sets the two apart
+check('float equalization', pysv.calculate('norm_int16.wav'), pysv.calculate('norm_float.wav'),
+      1e-3, ('rmsdB', 'ActiveSpeechLevel', 'ActivityFactor'))
+sys.exit(0)
@@ -0,0 +1,81 @@
+# normalize_inplace() killed while it rewrites the samples, then run
+# again, must leave the same bytes as a run that was not interrupted
+import os
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+import pysv
+import wavtool
+
+WINDOW = 1 << 20        # bytes rewritten per journal record
+
+
+def run(path):
+    # normalize_inplace() in a child process, which can be killed
+    code = 'import pysv; pysv.normalize_inplace(%r, -26)' % path
+    env = dict(os.environ, PYTHONPATH=os.pathsep.join(p for p in sys.path if p))
+    return subprocess.Popen([sys.executable, '-c', code], env=env)
+
+
+os.chdir(tempfile.mkdtemp())
+
+# 64 MB of samples, so that the rewrite takes many journal records
+x = wavtool.to_int16(wavtool.speech(10))
+wavtool.write('ref.wav', x * 200)
+with open('ref.wav', 'rb') as f:
+    original = f.read()
+with open('crash.wav', 'wb') as f:
+    f.write(original)
+
+# The reference, not interrupted
+pysv.normalize_inplace('ref.wav', -26)
+with open('ref.wav', 'rb') as f:
+    expected = f.read()
+assert expected != original and len(expected) == len(original)
+assert not os.path.exists('ref.wav.jnl'), 'journal left behind'
+
+# Killed as soon as the samples half way through change, which is after
+# their journal record is written; up to a few tries, as a run may end
+# before it can be caught
+middle = len(original) // 2
+for attempt in range(20):
+    with open('crash.wav', 'wb') as f:
+        f.write(original)
+    child = run('crash.wav')
+    with open('crash.wav', 'rb') as f:
+        while child.poll() is None:
+            f.seek(middle)
+            if f.read(4096) != original[middle:middle + 4096]:
+                child.send_signal(signal.SIGKILL)
+                break
+            time.sleep(0.0002)
+    child.wait()
+    if child.returncode == -signal.SIGKILL and os.path.exists('crash.wav.jnl'):
+        break
+else:
+    raise AssertionError('no run could be interrupted')
+with open('crash.wav', 'rb') as f:
+    half = f.read()
+assert half != original and half != expected, 'not interrupted half way'
+print('interrupted with %d of %d windows rewritten' %
+      (sum(half[i:i + WINDOW] != original[i:i + WINDOW] for i in range(0, len(half), WINDOW)),
+       (len(half) + WINDOW - 1) // WINDOW))
+
+# The next run finishes the interrupted one, with the same gain
+pysv.normalize_inplace('crash.wav', -26)
+with open('crash.wav', 'rb') as f:
+    assert f.read() == expected, 'resumed run differs from an uninterrupted one'
+assert not os.path.exists('crash.wav.jnl'), 'journal left behind'
+print('interrupted and resumed: ok')
+
+# Errors are returned, not exit(): n = 0, and no output is left
+wavtool.write('empty.wav', [])
+assert pysv.normalize_inplace('empty.wav', -26).n == 0
+assert pysv.normalize('empty.wav', 'empty_out.wav', -26).n == 0
+assert not os.path.exists('empty_out.wav') and not os.path.exists('empty.wav.jnl')
+assert pysv.normalize('ref.wav', os.path.join('no', 'such', 'dir.wav'), -26).n == 0
+print('errors: ok')
+sys.exit(0)
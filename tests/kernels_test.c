@@ -0,0 +1,285 @@
+/*
+  ============================================================================
+   File: KERNELS_TEST.C                                       19.Oct.26 v1.1
+  ============================================================================
+
+                    UGST/ITU-T SAMPLE CONVERSION KERNEL CHECKS
+
+   Description:
+   ~~~~~~~~~~~~
+   Checks the SSE2/AVX2 kernels of scale(), sh2fl(), sh2fl_alt(),
+   fl2sh() and sh2sh_scale() against the scalar loops, which utl_simd()
+   selects, on random input of lengths that are not whole vectors: the
+   outputs must be the same bit for bit, and so the overflow counts.
+   The same for the serialize_...() and parallelize_...() functions of
+   both families (STL92 and STL96), for every resolution and a range
+   of frame sizes, the parallelizing also on damaged bitstreams.
+   Prints one line per check and returns the number of failed checks.
+
+   Usage:
+   ~~~~~~
+   python setup.py build_tests
+   build/tests/kernels_test
+
+   History:
+   19.Oct.26    v1.0    First version.
+   19.Oct.26    v1.1    Bitstream conversions.
+
+  ============================================================================
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ugst-utl.h"
+
+/* The STL92 family, which ugst-utl.h names only when STL92 is defined */
+long serialize_right_justifiedstl92(short* par_buf, short* bit_stm, long n, long resol, char sync);
+long parallelize_right_justifiedstl92(short* bit_stm, short* par_buf, long bs_len, long resol, char sync);
+long serialize_left_justifiedstl92(short* par_buf, short* bit_stm, long n, long resol, char sync);
+long parallelize_left_justifiedstl92(short* bit_stm, short* par_buf, long bs_len, long resol, char sync);
+
+/* Lengths around the vectors of 8 and 16 samples, and odd ones */
+static const long lengths[] = { 0, 1, 7, 9, 15, 17, 31, 33, 255, 1001, 4099 };
+#define NLENGTHS (sizeof(lengths) / sizeof(lengths[0]))
+#define MAXLEN 4099
+
+static const char* level_name[] = { "scalar", "SSE2", "AVX2" };
+static int failed = 0;
+
+/* Prints the outcome of one check, and counts the failures */
+static void check(int ok, const char* what, int level)
+{
+    char line[200];
+
+    sprintf(line, "%s, %s", what, level_name[level]);
+    printf("%-60s %s\n", line, ok ? "ok" : "FAILED");
+    failed += !ok;
+}
+
+static unsigned lcg(unsigned* s)
+{
+    *s = *s * 1664525u + 1013904223u;
+    return *s >> 8;
+}
+
+static double uniform(unsigned* s)
+{
+    return lcg(s) / 16777216.0;
+}
+
+/* Random 16-bit samples, full scale */
+static void random16(short* x, long n, unsigned seed)
+{
+    long i;
+
+    for (i = 0; i < n; i++)
+        x[i] = (short)(lcg(&seed) & 0xFFFF);
+}
+
+/* Random floats past full scale, so that some clip, with a few halves
+   of an LSB, where rounding goes one way or the other */
+static void randomf(float* x, long n, unsigned seed)
+{
+    long i;
+
+    for (i = 0; i < n; i++)
+        if (lcg(&seed) % 8 == 0)
+            x[i] = (float)(((long)(lcg(&seed) % 65536) - 32768 + 0.5) / 32768.0);
+        else
+            x[i] = (float)(2.4 * uniform(&seed) - 1.2);
+}
+
+/*
+ * scale(), sh2fl(), sh2fl_alt(), fl2sh() and sh2sh_scale() at `level'
+ * against the scalar loops, for every length
+ */
+static void test_level(int level)
+{
+    static const short masks[] = { (short)0xFFFF, (short)0xFFFE, (short)0xFFF0 };
+    static const double factors[] = { 0.5, 1.0, 1.7, 3.0 };
+    static short x[MAXLEN], xa[MAXLEN], xb[MAXLEN], ya[MAXLEN], yb[MAXLEN];
+    static float f[MAXLEN], fa[MAXLEN], fb[MAXLEN];
+    int ok_scale = 1, ok_sh2fl = 1, ok_alt = 1, ok_round = 1, ok_trunc = 1, ok_fused = 1;
+    long r, l, n, ra, rb;
+    unsigned m, k;
+
+    for (l = 0; l < (long)NLENGTHS; l++) {
+        n = lengths[l];
+        random16(x, n, 10 + l);
+        randomf(f, n, 20 + l);
+
+        for (k = 0; k < sizeof(factors) / sizeof(factors[0]); k++) {
+            memcpy(fa, f, n * sizeof(float));
+            memcpy(fb, f, n * sizeof(float));
+            utl_simd(UTL_SIMD_NONE);
+            ra = scale(fa, n, factors[k]);
+            utl_simd(level);
+            rb = scale(fb, n, factors[k]);
+            ok_scale &= ra == rb && memcmp(fa, fb, n * sizeof(float)) == 0;
+
+            utl_simd(UTL_SIMD_NONE);
+            ra = sh2sh_scale(n, x, ya, factors[k], 16 - k, masks[k % 3]);
+            utl_simd(level);
+            rb = sh2sh_scale(n, x, yb, factors[k], 16 - k, masks[k % 3]);
+            ok_fused &= ra == rb && memcmp(ya, yb, n * sizeof(short)) == 0;
+        }
+
+        /* sh2fl() shifts its input in place below 16 bits */
+        for (r = 12; r <= 16; r++) {
+            for (k = 0; k < 2; k++) {
+                memcpy(xa, x, n * sizeof(short));
+                memcpy(xb, x, n * sizeof(short));
+                utl_simd(UTL_SIMD_NONE);
+                sh2fl(n, xa, fa, r, (char)k);
+                utl_simd(level);
+                sh2fl(n, xb, fb, r, (char)k);
+                ok_sh2fl &= memcmp(fa, fb, n * sizeof(float)) == 0 && memcmp(xa, xb, n * sizeof(short)) == 0;
+            }
+        }
+
+        for (m = 0; m < sizeof(masks) / sizeof(masks[0]); m++) {
+            utl_simd(UTL_SIMD_NONE);
+            sh2fl_alt(n, x, fa, masks[m]);
+            utl_simd(level);
+            sh2fl_alt(n, x, fb, masks[m]);
+            ok_alt &= memcmp(fa, fb, n * sizeof(float)) == 0;
+
+            /* fl2sh() takes samples in the 16-bit range */
+            memcpy(fa, f, n * sizeof(float));
+            scale(fa, n, 32768.0);
+            utl_simd(UTL_SIMD_NONE);
+            ra = fl2sh(n, fa, ya, 0.5 * (1 << m), masks[m]);
+            utl_simd(level);
+            rb = fl2sh(n, fa, yb, 0.5 * (1 << m), masks[m]);
+            ok_round &= ra == rb && memcmp(ya, yb, n * sizeof(short)) == 0;
+
+            utl_simd(UTL_SIMD_NONE);
+            ra = fl2sh(n, fa, ya, 0.0, masks[m]);
+            utl_simd(level);
+            rb = fl2sh(n, fa, yb, 0.0, masks[m]);
+            ok_trunc &= ra == rb && memcmp(ya, yb, n * sizeof(short)) == 0;
+        }
+    }
+
+    check(ok_scale, "scale()", level);
+    check(ok_sh2fl, "sh2fl(), 12 to 16 bits", level);
+    check(ok_alt, "sh2fl_alt()", level);
+    check(ok_round, "fl2sh(), rounded", level);
+    check(ok_trunc, "fl2sh(), truncated", level);
+    check(ok_fused, "sh2sh_scale()", level);
+}
+
+typedef long (*serialize_fn)(short*, short*, long, long, char);
+typedef long (*parallelize_fn)(short*, short*, long, long, char);
+
+static const struct {
+    const char* name;
+    serialize_fn serialize;
+    parallelize_fn parallelize;
+} families[] = {
+    { "right justified, STL96", serialize_right_justifiedstl96, parallelize_right_justifiedstl96 },
+    { "left justified, STL96", serialize_left_justifiedstl96, parallelize_left_justifiedstl96 },
+    { "right justified, STL92", serialize_right_justifiedstl92, parallelize_right_justifiedstl92 },
+    { "left justified, STL92", serialize_left_justifiedstl92, parallelize_left_justifiedstl92 },
+};
+
+/* Frames of samples, around the 8 and 16 softbits of the kernels */
+static const long frames[] = { 1, 2, 7, 8, 9, 15, 16, 17, 80, 159, 160, 321 };
+#define NFRAMES (sizeof(frames) / sizeof(frames[0]))
+#define MAXFRAME 321
+#define MAXBITS (MAXFRAME * 16 + 2)
+
+/*
+ * A bitstream damaged at random: softbits that are neither one nor
+ * zero, and sync, bad-frame and length words where softbits should be
+ */
+static void damage(short* bs, long len, unsigned seed)
+{
+    static const short words[] = { 0x6B21, 0x6B20, 0x0000, 0x0081, 0x007F, 0x0001, 0x00FF, 0x7FFF };
+    long i;
+
+    for (i = 0; i < len; i++)
+        if (lcg(&seed) % 64 == 0)
+            bs[i] = words[lcg(&seed) % (sizeof(words) / sizeof(words[0]))];
+}
+
+/*
+ * serialize_...() and parallelize_...() at `level' against the scalar
+ * loops, for resolutions 2 to 16, every frame size, with and without
+ * sync words: the same bitstreams, samples and return values
+ */
+static void test_bitstream(int level)
+{
+    static short x[MAXFRAME], ya[MAXFRAME], yb[MAXFRAME];
+    static short ba[MAXBITS + 32], bb[MAXBITS + 32];
+    int ok_ser, ok_par, ok_bad;
+    long resol, len, ra, rb, n, d;
+    unsigned f, l, sync, seed = 1;
+    char what[100];
+
+    for (f = 0; f < sizeof(families) / sizeof(families[0]); f++) {
+        ok_ser = ok_par = ok_bad = 1;
+        for (resol = 2; resol <= 16; resol++) {
+            for (l = 0; l < NFRAMES; l++) {
+                for (sync = 0; sync < 2; sync++) {
+                    n = frames[l];
+                    len = n * resol + 2 * sync;
+                    random16(x, n, seed++);
+
+                    /* The parallelizing may read a few words past a frame
+                       that is damaged: the same words for both */
+                    memset(ba, 0, sizeof(ba));
+                    memset(bb, 0, sizeof(bb));
+                    utl_simd(UTL_SIMD_NONE);
+                    ra = families[f].serialize(x, ba, n, resol, (char)sync);
+                    utl_simd(level);
+                    rb = families[f].serialize(x, bb, n, resol, (char)sync);
+                    ok_ser &= ra == rb && memcmp(ba, bb, sizeof(ba)) == 0;
+
+                    memset(ya, 0x55, sizeof(ya));
+                    memset(yb, 0x55, sizeof(yb));
+                    utl_simd(UTL_SIMD_NONE);
+                    ra = families[f].parallelize(ba, ya, len, resol, (char)sync);
+                    utl_simd(level);
+                    rb = families[f].parallelize(ba, yb, len, resol, (char)sync);
+                    ok_par &= ra == rb && memcmp(ya, yb, sizeof(ya)) == 0;
+
+                    /* Damaged, and with lengths that are not whole frames */
+                    damage(ba, len, seed++);
+                    for (d = -1; d <= 1; d++) {
+                        memset(ya, 0x55, sizeof(ya));
+                        memset(yb, 0x55, sizeof(yb));
+                        utl_simd(UTL_SIMD_NONE);
+                        ra = families[f].parallelize(ba, ya, len + d, resol, (char)sync);
+                        utl_simd(level);
+                        rb = families[f].parallelize(ba, yb, len + d, resol, (char)sync);
+                        ok_bad &= ra == rb && memcmp(ya, yb, sizeof(ya)) == 0;
+                    }
+                }
+            }
+        }
+        sprintf(what, "serialize, %s", families[f].name);
+        check(ok_ser, what, level);
+        sprintf(what, "parallelize, %s", families[f].name);
+        check(ok_par, what, level);
+        sprintf(what, "parallelize, damaged, %s", families[f].name);
+        check(ok_bad, what, level);
+    }
+}
+
+int main(void)
+{
+    int level;
+
+    /* Each level the processor has, against the scalar loops */
+    for (level = UTL_SIMD_SSE2; level <= UTL_SIMD_AVX2; level++)
+        if (utl_simd(level) == level) {
+            test_level(level);
+            test_bitstream(level);
+        }
+        else
+            printf("%-60s %s\n", level_name[level], "not run");
+    utl_simd(UTL_SIMD_AVX2);
+    return failed;
+}
@@ -0,0 +1,47 @@
+# samplerate_change() with MIX_SELECT and MIX_AVERAGE against the same
+# channels resampled on their own, and mixings that don't fit the file
+# refused with ValueError, without writing anything
+import os
+import sys
+import tempfile
+
+import pysv
+import wavtool
+
+
+def refused(name, call):
+    if os.path.exists('out.wav'):
+        os.remove('out.wav')
+    try:
+        call()
+    except ValueError:
+        assert not os.path.exists('out.wav'), '%s: output written' % name
+        print('%s: refused, ok' % name)
+        return
+    raise AssertionError('%s: not refused' % name)
+
+
+os.chdir(tempfile.mkdtemp())
+chans = [wavtool.to_int16(wavtool.speech(2, seed=ch + 1)) for ch in range(2)]
+wavtool.write('stereo.wav', wavtool.interleave(chans), channels=2)
+
+# One channel kept is that channel, as a mono file, resampled
+for ch in range(2):
+    wavtool.write('mono.wav', chans[ch])
+    pysv.samplerate_change('mono.wav', 'ref.wav', 8000)
+    pysv.samplerate_change('stereo.wav', 'out.wav', 8000, pysv.MIX_SELECT, ch)
+    assert wavtool.read('out.wav') == wavtool.read('ref.wav'), 'channel %d' % ch
+    print('channel %d selected: ok' % ch)
+
+# The average is mono, as long as either channel
+pysv.samplerate_change('stereo.wav', 'out.wav', 8000, pysv.MIX_AVERAGE)
+rate, nch, fmt, y = wavtool.read('out.wav')
+assert (rate, nch) == (8000, 1) and len(y) == len(wavtool.read('ref.wav')[3]), 'average'
+print('average: ok')
+
+refused('channel 2 of 2', lambda: pysv.samplerate_change('stereo.wav', 'out.wav', 8000, pysv.MIX_SELECT, 2))
+refused('channel -1', lambda: pysv.samplerate_change('stereo.wav', 'out.wav', 8000, pysv.MIX_SELECT, -1))
+refused('unknown mix', lambda: pysv.samplerate_change('stereo.wav', 'out.wav', 8000, 7))
+refused('matrix for 3 channels', lambda: pysv.samplerate_change_matrix('stereo.wav', 'out.wav', 8000, 3, [1, 0, 0]))
+refused('matrix of 3 weights', lambda: pysv.samplerate_change_matrix('stereo.wav', 'out.wav', 8000, 2, [1, 0, 0]))
+sys.exit(0)
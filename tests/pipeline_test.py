@@ -0,0 +1,79 @@
+# The I/O threads change nothing: calculate(), normalize() and
+# samplerate_change() with set_io_pipeline() on, off, and with blocks
+# of a few frames, on mapped files, and calculate() and
+# samplerate_change() on pipes, which are read through the blocks;
+# down to a file shorter than one block
+import os
+import sys
+import tempfile
+import threading
+
+import pysv
+import wavtool
+
+PIPELINES = ((0, 0), (4, 1048576), (2, 4096), (1, 6))
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def feed(src, fifo):
+    # Writes src into the named pipe fifo, from a thread of its own
+    def run():
+        with open(fifo, 'wb') as f:
+            f.write(read(src))
+    t = threading.Thread(target=run)
+    t.start()
+    return t
+
+
+def run(src, piped):
+    # The state of calculate(), and the bytes of normalize() and of
+    # samplerate_change(), of src; through a pipe when piped, but for
+    # normalize(), which reads its input twice
+    out = []
+    for k in range(3):
+        if piped and k == 1:
+            out.append(None)
+            continue
+        name = src
+        if piped:
+            name = 'in.fifo'
+            t = feed(src, name)
+        if k == 0:
+            st = pysv.calculate(name)
+            out.append(tuple(getattr(st, f) for f in wavtool.STATE_FIELDS))
+        elif k == 1:
+            pysv.normalize(name, 'norm.wav', -26)
+            out.append(read('norm.wav'))
+        else:
+            pysv.samplerate_change(name, 'sr.wav', 8000)
+            out.append(read('sr.wav'))
+        if piped:
+            t.join()
+    return out
+
+
+os.chdir(tempfile.mkdtemp())
+os.mkfifo('in.fifo')
+wavtool.write('long.wav', wavtool.to_int16(wavtool.speech(5)))
+wavtool.write('short.wav', wavtool.to_int16(wavtool.speech(0.02)))
+wavtool.write('float.wav', wavtool.speech(2), fmt='float')
+
+for src in ('long.wav', 'short.wav', 'float.wav'):
+    pysv.set_io_pipeline(0, 0)
+    ref = run(src, False)
+    assert ref[0][0] > 0, '%s: not measured' % src
+    for depth, block in PIPELINES:
+        pysv.set_io_pipeline(depth, block)
+        for piped in (False, True):
+            got = run(src, piped)
+            for what, a, b in zip(('calculate', 'normalize', 'samplerate_change'), got, ref):
+                assert a is None or a == b, '%s, %s, pipeline (%d, %d)%s: differs' % (
+                    src, what, depth, block, ', piped' if piped else '')
+    print('%s: ok' % src)
+
+pysv.set_io_pipeline()
+sys.exit(0)
@@ -0,0 +1,69 @@
+# calculate_range() and calculate_segments() against calculate() of
+# the same samples cut out to a file of their own
+import os
+import random
+import sys
+import tempfile
+
+import pysv
+import wavtool
+
+# The fields that do not depend on the envelope, which calculate_range()
+# carries over from the samples before `start'
+PLAIN_FIELDS = ('n', 'maxP', 'maxN', 'DClevel', 'rmsdB', 'rmsPkF')
+
+
+def check(name, a, b, tol=0.0, fields=wavtool.STATE_FIELDS):
+    err = wavtool.same_state(a, b, tol, fields)
+    assert err is None, '%s: %s' % (name, err)
+
+
+def cut(x, start, end, fmt):
+    wavtool.write('cut.wav', x[start:end], fmt=fmt)
+    return pysv.calculate('cut.wav')
+
+
+os.chdir(tempfile.mkdtemp())
+rnd = random.Random(5)
+x16 = wavtool.to_int16(wavtool.speech(12))
+for fmt, x in (('pcm16', x16), ('float', [v / 32768.0 for v in x16])):
+    wavtool.write('in.wav', x, fmt=fmt)
+    n = len(x)
+
+    # Small blocks, so that most segments span several of them
+    for block in (256, 16384):
+        assert pysv.calculate_index('in.wav', block) == 0, 'index'
+        check('%s, whole file' % fmt, pysv.calculate_range('in.wav', 0), pysv.calculate('in.wav'))
+
+        # From sample 0 the envelope starts from rest, as in a file of
+        # its own: every field agrees
+        for k in range(8):
+            end = rnd.randrange(1, n)
+            check('%s, block %d, [0, %d)' % (fmt, block, end),
+                  pysv.calculate_range('in.wav', 0, end), cut(x, 0, end, fmt))
+
+        # Elsewhere the sums and peaks are those of the samples alone
+        for k in range(8):
+            start = rnd.randrange(1, n - 1)
+            end = rnd.randrange(start + 1, n + 1)
+            check('%s, block %d, [%d, %d)' % (fmt, block, start, end),
+                  pysv.calculate_range('in.wav', start, end - start), cut(x, start, end, fmt),
+                  1e-12, PLAIN_FIELDS)
+        print('%s, range, block %d: ok' % (fmt, block))
+
+    # Segments are measured afresh: all fields, overlapping segments,
+    # segments at both ends of the file, and an empty one
+    starts, ends = [0, n - 100, 5000, 0, 7000], [1000, n, 9000, n, 7000]
+    for k in range(10):
+        s = rnd.randrange(0, n)
+        starts.append(s)
+        ends.append(rnd.randrange(s, n + 1))
+    states = pysv.calculate_segments('in.wav', starts, ends)
+    assert len(states) == len(starts), 'segments: %d' % len(states)
+    for s, e, st in zip(starts, ends, states):
+        if s == e:
+            assert st.n == 0 and st.ActiveSpeechLevel == -100, 'empty segment'
+        else:
+            check('%s, segment [%d, %d)' % (fmt, s, e), st, cut(x, s, e, fmt))
+    print('%s, segments: ok' % fmt)
+sys.exit(0)
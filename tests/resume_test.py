@@ -0,0 +1,49 @@
+# calculate_resume() and merge_states() against calculate()
+import os
+import sys
+import tempfile
+
+import pysv
+import wavtool
+
+
+def check(name, a, b, tol=0.0, fields=wavtool.STATE_FIELDS):
+    err = wavtool.same_state(a, b, tol, fields)
+    assert err is None, '%s: %s' % (name, err)
+    print('%s: ok' % name)
+
+
+os.chdir(tempfile.mkdtemp())
+x = wavtool.to_int16(wavtool.speech(8))
+wavtool.write('in.wav', x)
+ref = pysv.calculate('in.wav')
+
+# Checkpoints on the way change nothing, and a second run goes on from
+# the final one
+check('resume, first run', pysv.calculate_resume('in.wav', 'in.st', 5000), ref)
+check('resume, from the final checkpoint', pysv.calculate_resume('in.wav', 'in.st', 5000), ref)
+
+# A damaged state file is not gone on from: the file is measured afresh
+with open('in.st', 'rb') as f:
+    blob = bytearray(f.read())
+blob[len(blob) // 2] ^= 0x10
+with open('in.st', 'wb') as f:
+    f.write(blob)
+check('resume, damaged state file', pysv.calculate_resume('in.wav', 'in.st', 5000), ref)
+
+# Parts measured from their own starts merge to the count, peaks and
+# rms of the whole
+half = len(x) // 2
+wavtool.write('a.wav', x[:half])
+wavtool.write('b.wav', x[half:])
+pysv.calculate_resume('a.wav', 'a.st')
+pysv.calculate_resume('b.wav', 'b.st')
+check('merge of two parts', pysv.merge_states(['a.st', 'b.st']), ref, 1e-9,
+      ('n', 'maxP', 'maxN', 'DClevel', 'rmsdB', 'rmsPkF'))
+
+# Parts at different sampling rates are not merged
+wavtool.write('c.wav', x[half:], rate=8000)
+pysv.calculate_resume('c.wav', 'c.st')
+assert pysv.merge_states(['a.st', 'c.st']).n == 0, 'parts of two rates merged'
+print('merge of two rates refused: ok')
+sys.exit(0)
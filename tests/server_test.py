@@ -0,0 +1,92 @@
+# pysv.server with one worker, through pysv.client: measure, normalize
+# and resample of files and of samples in memory against the same calls
+# of pysv, a rate pair whose filters the worker kept against a fresh
+# design, and a worker that exits on an error replaced for the next request
+import os
+import struct
+import sys
+import tempfile
+import threading
+
+import pysv
+import wavtool
+from pysv.client import Client
+from pysv.server import Server, STATE_FIELDS
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def fields(state):
+    return dict((name, getattr(state, name)) for name in STATE_FIELDS)
+
+
+def pcm(x):
+    return struct.pack('<%dh' % len(x), *x)
+
+
+def samples(path):
+    # The samples of a 16-bit file, as bytes
+    return pcm(wavtool.read(path)[3])
+
+
+os.chdir(tempfile.mkdtemp())
+x = wavtool.to_int16(wavtool.speech(3))
+wavtool.write('in.wav', x)
+wavtool.write('other.wav', wavtool.to_int16(wavtool.speech(2, seed=2)))
+with open('bad.wav', 'wb') as f:
+    f.write(b'not a wave file' * 10)
+
+server = Server(os.path.abspath('pysv.sock'), workers=1)
+t = threading.Thread(target=server.serve_forever)
+t.start()
+try:
+    with Client(server.path) as c:
+        assert c.request(op='ping')['workers'] == 1, 'ping'
+
+        # Files
+        assert c.calculate('in.wav') == fields(pysv.calculate('in.wav')), 'measure'
+        st = c.normalize('in.wav', 'norm.wav', -30)
+        assert st == fields(pysv.normalize('in.wav', 'ref.wav', -30)), 'normalize state'
+        assert read('norm.wav') == read('ref.wav'), 'normalize'
+        c.samplerate_change('in.wav', 'sr.wav', 8000)
+        print('files: ok')
+
+        # The worker designed the 16 to 8 kHz filters for in.wav, and
+        # keeps them for other.wav; this process designs them afresh
+        c.samplerate_change('other.wav', 'kept.wav', 8000)
+        pysv.samplerate_change('other.wav', 'fresh.wav', 8000)
+        assert read('kept.wav') == read('fresh.wav'), 'kept filters'
+        pysv.samplerate_change('in.wav', 'ref.wav', 8000)
+        assert read('sr.wav') == read('ref.wav'), 'resample'
+        print('kept filters: ok')
+
+        # Samples, through shared memory
+        data = pcm(x)
+        assert c.calculate_samples(data, 16000) == fields(pysv.calculate('in.wav')), 'measure samples'
+        st, y = c.normalize_samples(data, 16000, targetdB=-30)
+        assert st == fields(pysv.normalize('in.wav', 'ref.wav', -30)), 'normalize samples state'
+        assert y == samples('ref.wav'), 'normalize samples'
+        assert c.samplerate_change_samples(data, 16000, 8000) == samples('sr.wav'), 'resample samples'
+        print('samples: ok')
+
+        # A file the converter can't open makes the worker exit: an error
+        # reply, and a new worker for the next request
+        try:
+            c.samplerate_change('bad.wav', 'out.wav', 8000)
+        except RuntimeError as e:
+            assert 'worker exited' in str(e), 'error reply: %s' % e
+        else:
+            raise AssertionError('worker exit not replied as an error')
+        assert c.calculate('in.wav') == fields(pysv.calculate('in.wav')), 'measure after a worker exit'
+        c.samplerate_change('in.wav', 'again.wav', 8000)
+        assert read('again.wav') == read('sr.wav'), 'resample after a worker exit'
+        print('worker exit: ok')
+finally:
+    server.shutdown()
+    server.server_close()
+    t.join()
+assert not os.path.exists('pysv.sock'), 'socket left'
+sys.exit(0)
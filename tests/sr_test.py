@@ -21,15 +21,13 @@ for i in range(len(file)):
     tmp_file = file[i].replace(".mp3", ".tmp")
     out_file = file[i].replace(".mp3", ".wav")
 
-    if sound.channels != 1:
-        sound = sound.set_channels(1)
-
-    if sound.frame_rate == 16000:
+    if sound.frame_rate == 16000 and sound.channels == 1:
         sound.export(out_file, format="wav")
     else:
         sound.export(tmp_file, format="wav")
         print("before")
-        pysv.samplerate_change(tmp_file, out_file, 16000)
+        # downmix to mono inside the resampler, ahead of the filters
+        pysv.samplerate_change(tmp_file, out_file, 16000, pysv.MIX_AVERAGE)
         os.remove(tmp_file)
 
         sound = AudioSegment.from_file(out_file, format='wav')
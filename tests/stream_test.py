@@ -0,0 +1,84 @@
+# Streamed conversions against the same conversion of a file: stdin to
+# stdout, inputs whose header leaves the sizes unknown, and headerless
+# PCM in and out, there and back
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+import pysv
+import wavtool
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def piped(call, data):
+    # The bytes a pysv call writes to stdout, fed `data' on stdin, in a
+    # process of its own
+    p = subprocess.run([sys.executable, '-c', 'import pysv; pysv.' + call],
+                       input=data, stdout=subprocess.PIPE, check=True)
+    return p.stdout
+
+
+def pcm(samples, fmt='pcm16'):
+    if fmt == 'float':
+        return struct.pack('<%df' % len(samples), *samples)
+    return struct.pack('<%dh' % len(samples), *samples)
+
+
+def check(name, a, b):
+    assert a == b, '%s: differs' % name
+    print('%s: ok' % name)
+
+
+os.chdir(tempfile.mkdtemp())
+x = wavtool.to_int16(wavtool.speech(3))
+wavtool.write('in.wav', x)
+pysv.samplerate_change('in.wav', 'ref.wav', 8000)
+ref = wavtool.read('ref.wav')
+
+# stdin to stdout: a wave file with unknown sizes, and the same samples
+out = piped("samplerate_change('-', '-', 8000)", read('in.wav'))
+assert struct.unpack_from('<I', out, 4)[0] == 0xFFFFFFFF, 'stdout: RIFF size written'
+assert struct.unpack_from('<I', out, 40)[0] == 0xFFFFFFFF, 'stdout: data size written'
+check('stdin to stdout', wavtool.parse(out), ref)
+
+# An input whose sizes are unknown runs to the end of the file, or of stdin
+b = bytearray(read('in.wav'))
+b[4:8] = b[40:44] = struct.pack('<I', 0xFFFFFFFF)
+with open('unknown.wav', 'wb') as f:
+    f.write(b)
+pysv.samplerate_change('unknown.wav', 'out.wav', 8000)
+check('unknown sizes, file', read('out.wav'), read('ref.wav'))
+check('unknown sizes, stdin', wavtool.parse(piped("samplerate_change('-', '-', 8000)", bytes(b))), ref)
+
+# Headerless input gives the samples of the wave file, as a wave file,
+# as headerless output, and through stdin and stdout
+with open('in.raw', 'wb') as f:
+    f.write(pcm(x))
+pysv.samplerate_change_pcm('in.raw', 'raw.wav', 8000, 16000, 1)
+check('raw to wav', wavtool.read('raw.wav'), ref)
+pysv.samplerate_change_pcm('in.raw', 'out.raw', 8000, 16000, 1, 16, False)
+check('raw to raw', read('out.raw'), pcm(ref[3]))
+out = piped("samplerate_change_pcm('-', '-', 8000, 16000, 1, 16, False)", read('in.raw'))
+check('raw, stdin to stdout', out, pcm(ref[3]))
+
+# And back to 16 kHz, as the wave file goes back
+pysv.samplerate_change('ref.wav', 'back.wav', 16000)
+pysv.samplerate_change_pcm('out.raw', 'back.raw', 16000, 8000, 1, 16, False)
+check('raw round trip', read('back.raw'), pcm(wavtool.read('back.wav')[3]))
+
+# Float and two channels
+chans = [x, wavtool.to_int16(wavtool.speech(3, seed=2))]
+y = [v / 32768.0 for v in wavtool.interleave(chans)]
+wavtool.write('stereo.wav', y, channels=2, fmt='float')
+pysv.samplerate_change('stereo.wav', 'stereo_ref.wav', 8000)
+with open('stereo.raw', 'wb') as f:
+    f.write(pcm(y, 'float'))
+pysv.samplerate_change_pcm('stereo.raw', 'stereo.raw.wav', 8000, 16000, 2, 32, True, True)
+check('float stereo raw to wav', wavtool.read('stereo.raw.wav'), wavtool.read('stereo_ref.wav'))
+sys.exit(0)
@@ -0,0 +1,71 @@
+# calculate_timeline() of a tone switched on and off: the number of
+# frames, the active flags of the frames well inside the bursts and the
+# pauses, and the envelope, rms and peak levels of a steady tone
+import math
+import os
+import sys
+import tempfile
+
+import pysv
+import wavtool
+
+RATE = 16000
+AMP = 0.1                       # peak of the tone, -20 dBov
+
+
+def burst(seconds, on, rate=RATE):
+    # 1 kHz tone at AMP, a whole number of periods, or digital silence
+    n = int(seconds * rate)
+    if not on:
+        return [0.0] * n
+    return [AMP * math.sin(2 * math.pi * 1000 * k / rate) for k in range(n)]
+
+
+def rows(path, frame_ms):
+    t = pysv.calculate_timeline(path, frame_ms)
+    return [t[k:k + 4] for k in range(0, len(t), 4)]
+
+
+os.chdir(tempfile.mkdtemp())
+
+# One second on, one second off, three times, and a few samples more
+x = []
+for k in range(3):
+    x += burst(1, True) + burst(1, False)
+x += burst(1, True)[:37]
+for fmt, samples in (('pcm16', wavtool.to_int16(x)), ('float', x)):
+    wavtool.write('in.wav', samples, fmt=fmt)
+    for frame_ms in (10, 20, 25):
+        length = RATE * frame_ms // 1000
+        r = rows('in.wav', frame_ms)
+        assert len(r) == (len(x) + length - 1) // length, '%s, %d ms: %d frames' % (fmt, frame_ms, len(r))
+
+        # Frames 50 ms into a burst are active, frames 500 ms into a
+        # pause (past the hangover and the fall of the envelope) are not
+        per_s = 1000 // frame_ms
+        for k in range(3):
+            on = r[2 * k * per_s + per_s // 20:(2 * k + 1) * per_s]
+            off = r[(2 * k + 1) * per_s + per_s // 2:(2 * k + 2) * per_s]
+            assert all(f[3] >= 0.5 for f in on), '%s, %d ms: burst %d not active' % (fmt, frame_ms, k)
+            assert all(f[3] < 0.5 for f in off), '%s, %d ms: pause %d active' % (fmt, frame_ms, k)
+
+        # The envelope settles at the mean of |x|; the rms and the peak
+        # are those of the sine, whole periods of which fill each frame
+        for f in r[per_s // 2:per_s]:
+            assert abs(f[0] - 20 * math.log10(2 * AMP / math.pi)) < 0.2, '%s: envelope %g' % (fmt, f[0])
+            assert abs(f[1] - 20 * math.log10(AMP / math.sqrt(2))) < 0.01, '%s: rms %g' % (fmt, f[1])
+            assert abs(f[2] - 20 * math.log10(AMP)) < 0.01, '%s: peak %g' % (fmt, f[2])
+        f = r[int(1.5 * per_s)]
+        assert f[1] < -150 and f[2] < -150, '%s: silence at %g, %g dB' % (fmt, f[1], f[2])
+    print('%s: ok' % fmt)
+
+# Frames of up to 65535 samples: 1365 ms at 48 kHz, but not 1400 ms
+wavtool.write('48k.wav', wavtool.to_int16(burst(3, True, 48000)), rate=48000)
+assert len(rows('48k.wav', 1365)) == 3, 'frames of 65520 samples'
+try:
+    rows('48k.wav', 1400)
+except ValueError:
+    print('frames of more than 65535 samples refused: ok')
+else:
+    raise AssertionError('frames of 67200 samples not refused')
+sys.exit(0)
@@ -0,0 +1,101 @@
+# trace_start() and trace_stop() around calculate(), normalize(),
+# samplerate_change() and normalize_corpus() with two workers, and
+# calculate() on a pipe: the trace is JSON, each thread begins and ends
+# its spans in turn, and the threads are named after what they do
+import collections
+import json
+import os
+import sys
+import tempfile
+import threading
+
+import pysv
+import wavtool
+
+
+def load(path):
+    # The events of the trace, and the names of the threads by tid
+    with open(path) as f:
+        d = json.load(f)
+    ev = d['traceEvents']
+    names = {e['tid']: e['args']['name'] for e in ev if e['ph'] == 'M' and e['name'] == 'thread_name'}
+    return [e for e in ev if e['ph'] != 'M'], names
+
+
+def spans(ev):
+    # The spans of each thread, as (thread, name, file), checking that
+    # every 'E' closes the last 'B' of its thread and that time goes on
+    open_, last, out = collections.defaultdict(list), {}, []
+    for e in ev:
+        tid = e['tid']
+        assert e['ts'] >= last.get(tid, 0), 'thread %d: back in time' % tid
+        last[tid] = e['ts']
+        if e['ph'] == 'B':
+            open_[tid].append(e)
+        else:
+            assert e['ph'] == 'E', 'unknown event %s' % e['ph']
+            assert open_[tid], 'thread %d: end without a begin' % tid
+            b = open_[tid].pop()
+            out.append((tid, b['name'], b.get('args', {}).get('file')))
+    for tid, left in open_.items():
+        assert not left, 'thread %d: %d spans not ended' % (tid, len(left))
+    return out
+
+
+os.chdir(tempfile.mkdtemp())
+os.mkfifo('in.fifo')
+wavtool.write('in.wav', wavtool.to_int16(wavtool.speech(2)))
+ins = ['c%d.wav' % k for k in range(3)]
+for k, name in enumerate(ins):
+    wavtool.write(name, wavtool.to_int16(wavtool.speech(1, seed=k + 1)))
+
+pysv.set_io_pipeline(4, 4096)
+assert pysv.trace_start('trace.json') == 0, 'trace_start'
+pysv.calculate('in.wav')
+pysv.normalize('in.wav', 'norm.wav', -26)
+pysv.samplerate_change('in.wav', 'sr.wav', 8000)
+assert pysv.normalize_corpus(ins, ['o%d.wav' % k for k in range(3)], -26, 2), 'normalize_corpus'
+
+
+def feed():
+    with open('in.fifo', 'wb') as f, open('in.wav', 'rb') as g:
+        f.write(g.read())
+
+
+t = threading.Thread(target=feed)
+t.start()
+pysv.calculate('in.fifo')
+t.join()
+assert pysv.trace_stop() == 0, 'trace_stop'
+assert pysv.trace_stop() == -1, 'trace_stop twice'
+
+ev, names = load('trace.json')
+s = spans(ev)
+print('JSON, spans begun and ended in turn: ok')
+
+# Every thread with events is named; the calls are on the main thread,
+# the files of the corpus on its workers, the blocks on the I/O threads
+assert all(e['tid'] in names for e in ev), 'thread without a name'
+by = collections.defaultdict(set)
+for tid, name, f in s:
+    by[names[tid]].add((name, f))
+assert {('actlevel', 'in.wav'), ('sv56demo', 'in.wav'), ('ssrc', 'in.wav'),
+        ('sv56demo_corpus', ins[0]), ('actlevel', 'in.fifo')} <= by['main'], 'calls on the main thread'
+assert len([n for n in names.values() if n == 'corpus worker']) == 2, 'two corpus workers'
+assert {f for name, f in by['corpus worker'] if name in ('actlevel', 'sv56demo')} <= set(ins), 'corpus files'
+assert {'touch', 'fetch'} <= {name for name, f in by['wav reader']}, 'reader blocks'
+assert {name for name, f in by['wav reader']} <= {'touch', 'fetch'}, 'reader spans'
+assert {name for name, f in by['wav writer']} == {'flush'}, 'writer spans'
+print('threads: %s: ok' % ', '.join(sorted(set(names.values()))))
+
+# A second trace holds the calls made while it runs, and no others
+assert pysv.trace_start('again.json') == 0, 'trace_start again'
+pysv.calculate('in.wav')
+assert pysv.trace_stop() == 0, 'trace_stop again'
+ev, names = load('again.json')
+calls = [(name, f) for tid, name, f in spans(ev) if f is not None]
+assert calls == [('actlevel', 'in.wav')], 'second trace: %s' % calls
+print('second trace: ok')
+
+pysv.set_io_pipeline()
+sys.exit(0)
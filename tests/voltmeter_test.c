@@ -0,0 +1,436 @@
+/*
+  ============================================================================
+   File: VOLTMETER_TEST.C                                     19.Oct.26 v1.4
+  ============================================================================
+
+                    UGST/ITU-T SPEECH VOLTMETER CHECKS
+
+   Description:
+   ~~~~~~~~~~~~
+   Checks the speech voltmeters against each other on synthetic
+   signals: the batch voltmeter against speech_voltmeter() called per
+   stream, the 16-bit voltmeter against the float one, and both against
+   the plain loop over the samples where runs are taken at once, and
+   checkpoints and merges of states against a single pass; files at
+   8 to 48 kHz through actlevel_volt() against the voltmeter set up
+   for their rate. Prints one line per check and returns the number of
+   failed checks. The files are written to the current directory and
+   removed; actlevel() appends its line to log.txt there.
+
+   Usage:
+   ~~~~~~
+   python setup.py build_tests
+   build/tests/voltmeter_test
+
+   History:
+   19.Oct.26    v1.0    First version: batch voltmeter.
+   19.Oct.26    v1.1    16-bit voltmeter.
+   19.Oct.26    v1.2    Runs of equal samples.
+   19.Oct.26    v1.3    Checkpoints and merges.
+   19.Oct.26    v1.4    Files at the rate of their header.
+
+  ============================================================================
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sv-p56.h"
+#include "sv-p56m.h"
+#include "sv56.h"
+
+static int failed = 0;
+
+/* Prints the outcome of one check, and counts the failures */
+static void check(int ok, const char* what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failed += !ok;
+}
+
+static unsigned lcg(unsigned* s)
+{
+    *s = *s * 1664525u + 1013904223u;
+    return *s >> 8;
+}
+
+static double uniform(unsigned* s)
+{
+    return lcg(s) / 16777216.0;
+}
+
+/*
+ * A speech-like signal of n 16-bit values, the same on every platform
+ * for a seed: noisy tone bursts of random level, and pauses of up to
+ * `pause' samples that are either digital silence, a constant (DC)
+ * level, or a low noise floor, so that runs of equal samples of every
+ * length show up.
+ */
+static void signal16(short* x, long n, unsigned seed, long pause)
+{
+    long i = 0, len, k;
+    double a, f, v;
+    int kind;
+
+    while (i < n) {
+        len = 100 + (long)(uniform(&seed) * 5000);
+        a = 30000 * uniform(&seed) * uniform(&seed);
+        f = 0.01 + 0.2 * uniform(&seed);
+        for (k = 0; k < len && i < n; k++, i++)
+            x[i] = (short)(a * sin(f * k) * sin(3.14159 * k / len) + 300 * (uniform(&seed) - 0.5));
+
+        len = 1 + (long)(uniform(&seed) * pause);
+        kind = (int)(uniform(&seed) * 3);
+        v = kind == 1 ? 2000 * (uniform(&seed) - 0.5) : 0;
+        for (k = 0; k < len && i < n; k++, i++)
+            x[i] = (short)(kind == 2 ? 8 * (uniform(&seed) - 0.5) : v);
+    }
+}
+
+/* The same signal as floats, normalized as sh2fl() does for 16 bits */
+static void signalf(float* y, long n, unsigned seed, long pause)
+{
+    short* x = (short*)malloc(n * sizeof(short));
+    long i;
+
+    signal16(x, n, seed, pause);
+    for (i = 0; i < n; i++)
+        y[i] = x[i] / 32768.0f;
+    free(x);
+}
+
+/* Relative difference of two values, 0 when both are 0 */
+static double rel(double a, double b)
+{
+    double m = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+    return m == 0 ? 0 : fabs(a - b) / m;
+}
+
+/*
+ * 1 when the accumulations of two states are the same: counts and
+ * peaks exactly, sums and the envelope (p, q) to `tol'. Runs of equal
+ * samples taken in closed form, and the exact integer sums of the
+ * 16-bit voltmeter, round differently from a loop over the samples.
+ */
+static int same_state(const SVP56_state* a, const SVP56_state* b, double tol)
+{
+    int j;
+
+    for (j = 0; j < 15; j++)
+        if (a->a[j] != b->a[j] || a->hang[j] != b->hang[j])
+            return 0;
+    return a->n == b->n && rel(a->s, b->s) <= tol && rel(a->sq, b->sq) <= tol && rel(a->p, b->p) <= tol &&
+           rel(a->q, b->q) <= tol && a->max == b->max && a->maxP == b->maxP && a->maxN == b->maxN;
+}
+
+/*
+ * The batch voltmeter, for a number of streams that is not a multiple
+ * of its tile, and blocks of odd sizes, against speech_voltmeter()
+ * called per stream on the same blocks; the batch runs sample by
+ * sample, so the envelopes agree to rounding and the levels to 1e-9 dB.
+ */
+static void test_batch(void)
+{
+    static const long blocks[] = { 160, 1, 7, 513, 64, 2000, 3 };
+    enum { STREAMS = 37, LEN = 60000 };
+    SVP56_multi_state multi;
+    SVP56_state* loop = (SVP56_state*)malloc(STREAMS * sizeof(SVP56_state));
+    SVP56_state lane;
+    float* x[STREAMS], * at[STREAMS];
+    long s, pos, len, b;
+    int ok = 1;
+
+    init_speech_voltmeter_multi(&multi, 8000, STREAMS, 0);
+    for (s = 0; s < STREAMS; s++) {
+        x[s] = (float*)malloc(LEN * sizeof(float));
+        signalf(x[s], LEN, 100 + s, 3000);
+        init_speech_voltmeter(&loop[s], 8000);
+    }
+
+    for (pos = 0, b = 0; pos < LEN; pos += len, b++) {
+        len = blocks[b % (sizeof(blocks) / sizeof(blocks[0]))];
+        if (len > LEN - pos)
+            len = LEN - pos;
+        for (s = 0; s < STREAMS; s++) {
+            at[s] = x[s] + pos;
+            speech_voltmeter(at[s], len, &loop[s]);
+        }
+        speech_voltmeter_batch(at, len, &multi);
+    }
+
+    for (s = 0; s < STREAMS; s++) {
+        ok &= fabs(speech_voltmeter_lane(&multi, s, &lane) - active_speech_level(&loop[s])) < 1e-9;
+        ok &= same_state(&lane, &loop[s], 1e-12);
+        free(x[s]);
+    }
+    check(ok, "batch: 37 streams, odd blocks, against the loop");
+
+    free_speech_voltmeter_multi(&multi);
+    free(loop);
+}
+
+/*
+ * The voltmeter of G.191, one sample at a time: Process 1 and 2 of P.56
+ * and the thresholds, with the constants of init_speech_voltmeter()
+ */
+static void reference(const float* x, long n, SVP56_state* state)
+{
+    double g = exp(-1.0 / (state->f * 0.03)), v;
+    SVP56_count I = (SVP56_count)floor(0.2 * state->f + 0.5);
+    long k;
+    int j;
+
+    for (k = 0; k < n; k++) {
+        v = x[k];
+        if (fabs(v) > state->max)
+            state->max = fabs(v);
+        if (v > state->maxP)
+            state->maxP = v;
+        if (v < state->maxN)
+            state->maxN = v;
+        state->sq += v * v;
+        state->s += v;
+        state->n++;
+        state->p = g * state->p + (1 - g) * fabs(v);
+        state->q = g * state->q + (1 - g) * state->p;
+        for (j = 0; j < 15; j++) {
+            if (state->q >= state->c[j]) {
+                state->a[j]++;
+                state->hang[j] = 0;
+            }
+            if (state->q < state->c[j] && state->hang[j] < I) {
+                state->a[j]++;
+                state->hang[j] += 1;
+            }
+        }
+    }
+}
+
+/*
+ * The float and 16-bit voltmeters, which take runs of equal samples
+ * in closed form, against the plain loop over the samples, on a signal
+ * with pauses of up to 1.25 s, in blocks of `block' samples. After
+ * every block, counts and peaks must be equal; sums and envelopes agree
+ * to 1e-9, relative, and the levels to 1e-9 dB.
+ */
+static void test_runs(double f, long block, const char* what)
+{
+    enum { LEN = 400000 };
+    short* x = (short*)malloc(LEN * sizeof(short));
+    float* y = (float*)malloc(LEN * sizeof(float));
+    SVP56_state sr, sf, si;
+    long pos, len, i;
+    int ok = 1;
+
+    signal16(x, LEN, 11, (long)(1.25 * f));
+    for (i = 0; i < LEN; i++)
+        y[i] = x[i] / 32768.0f;
+
+    init_speech_voltmeter(&sr, f);
+    init_speech_voltmeter(&sf, f);
+    init_speech_voltmeter(&si, f);
+    for (pos = 0, i = 0; pos < LEN; pos += len, i++) {
+        len = block > 0 ? block : 1 + (i * 7919) % 5000;
+        if (len > LEN - pos)
+            len = LEN - pos;
+        reference(y + pos, len, &sr);
+        speech_voltmeter(y + pos, len, &sf);
+        speech_voltmeter_int(x + pos, len, 16, &si);
+        ok &= fabs(active_speech_level(&sr) - active_speech_level(&sf)) < 1e-9;
+        ok &= fabs(active_speech_level(&sr) - active_speech_level(&si)) < 1e-9;
+        ok &= same_state(&sf, &sr, 1e-9) && same_state(&si, &sr, 1e-9);
+    }
+    check(ok, what);
+
+    free(x);
+    free(y);
+}
+
+/*
+ * speech_voltmeter_int() on 16-bit blocks against speech_voltmeter()
+ * on the same blocks as floats, for the blocks of actlevel() and for
+ * odd sizes; the states must be the same after every block.
+ */
+static void test_int(long block, const char* what)
+{
+    enum { LEN = 200000 };
+    short* x = (short*)malloc(LEN * sizeof(short));
+    float* y = (float*)malloc(LEN * sizeof(float));
+    SVP56_state si, sf;
+    double li, lf;
+    long pos, len, i;
+    int ok = 1;
+
+    signal16(x, LEN, 7, 20000);
+    for (i = 0; i < LEN; i++)
+        y[i] = x[i] / 32768.0f;
+
+    init_speech_voltmeter(&si, 16000);
+    init_speech_voltmeter(&sf, 16000);
+    for (pos = 0, i = 0; pos < LEN; pos += len, i++) {
+        len = block > 0 ? block : 1 + (i * 7919) % 1000;
+        if (len > LEN - pos)
+            len = LEN - pos;
+        li = speech_voltmeter_int(x + pos, len, 16, &si);
+        lf = speech_voltmeter(y + pos, len, &sf);
+        ok &= li == lf && same_state(&si, &sf, 0);
+    }
+    check(ok, what);
+
+    free(x);
+    free(y);
+}
+
+/*
+ * A pass saved to a checkpoint and restored, at block boundaries, then
+ * carried on, against the same pass without a stop: the states must be
+ * the same, and the position given back. A checkpoint with any byte
+ * changed, or cut short, is refused and leaves the state as it is.
+ */
+static void test_checkpoint(void)
+{
+    enum { LEN = 200000, BLOCK = 256 };
+    static const long cuts[] = { 0, BLOCK, 100 * BLOCK, LEN / BLOCK * BLOCK };
+    short* x = (short*)malloc(LEN * sizeof(short));
+    unsigned char blob[SVP56_STATE_BYTES];
+    SVP56_state whole, part, copy;
+    unsigned long long pos;
+    long c, i, len;
+    int ok = 1, refused = 1;
+
+    signal16(x, LEN, 13, 20000);
+    init_speech_voltmeter(&whole, 16000);
+    for (i = 0; i < LEN; i += BLOCK)
+        speech_voltmeter_int(x + i, LEN - i < BLOCK ? LEN - i : BLOCK, 16, &whole);
+
+    for (c = 0; c < (long)(sizeof(cuts) / sizeof(cuts[0])); c++) {
+        init_speech_voltmeter(&part, 16000);
+        for (i = 0; i < cuts[c]; i += BLOCK)
+            speech_voltmeter_int(x + i, BLOCK, 16, &part);
+        ok &= speech_voltmeter_save(&part, (unsigned long long)cuts[c], blob, sizeof(blob)) == SVP56_STATE_BYTES;
+
+        /* Restored over a state of another rate, with garbage in it */
+        init_speech_voltmeter(&part, 8000);
+        part.n = 12345;
+        part.q = 0.5;
+        ok &= speech_voltmeter_restore(&part, &pos, blob, sizeof(blob)) == 0 && pos == (unsigned long long)cuts[c];
+        for (i = (long)pos; i < LEN; i += BLOCK)
+            speech_voltmeter_int(x + i, LEN - i < BLOCK ? LEN - i : BLOCK, 16, &part);
+        ok &= same_state(&part, &whole, 0) && active_speech_level(&part) == active_speech_level(&whole);
+    }
+    check(ok, "checkpoint: saved, restored and carried on, against one pass");
+
+    /* Every byte changed in turn, then a blob cut short */
+    for (i = 0; i < SVP56_STATE_BYTES; i++) {
+        blob[i] ^= 0x10;
+        copy = part;
+        refused &= speech_voltmeter_restore(&part, &pos, blob, sizeof(blob)) == -1 &&
+                   memcmp(&copy, &part, sizeof(part)) == 0;
+        blob[i] ^= 0x10;
+    }
+    refused &= speech_voltmeter_restore(&part, &pos, blob, SVP56_STATE_BYTES - 1) == -1;
+    refused &= speech_voltmeter_save(&part, 0, blob, SVP56_STATE_BYTES - 1) == 0;
+    len = speech_voltmeter_restore(&part, &pos, blob, sizeof(blob));
+    check(refused && len == 0, "checkpoint: damaged or short blobs refused");
+
+    free(x);
+}
+
+/*
+ * Parts metered from fresh voltmeters and merged, against one pass:
+ * count and peaks exact, sums to rounding. A fresh envelope starts
+ * below that of the pass, and with no hangover, so that each part
+ * after the first counts less activity, by no more than a hangover
+ * and the rise of the envelope at its start (0.4 s together). A part
+ * of another rate is refused and leaves the merge as it is.
+ */
+static void test_merge(void)
+{
+    enum { LEN = 300000, PARTS = 3 };
+    float* y = (float*)malloc(LEN * sizeof(float));
+    SVP56_state whole, merged, part, copy;
+    SVP56_count less;
+    long k, from, to;
+    int ok = 1, j;
+
+    signalf(y, LEN, 17, 20000);
+    init_speech_voltmeter(&whole, 16000);
+    speech_voltmeter(y, LEN, &whole);
+
+    for (k = 0; k < PARTS; k++) {
+        from = LEN / PARTS * k;
+        to = k == PARTS - 1 ? LEN : LEN / PARTS * (k + 1);
+        init_speech_voltmeter(k == 0 ? &merged : &part, 16000);
+        speech_voltmeter(y + from, to - from, k == 0 ? &merged : &part);
+        if (k > 0)
+            ok &= speech_voltmeter_merge(&merged, &part) == 0;
+    }
+    ok &= merged.n == whole.n && merged.maxP == whole.maxP && merged.maxN == whole.maxN && merged.max == whole.max;
+    ok &= rel(merged.s, whole.s) < 1e-12 && rel(merged.sq, whole.sq) < 1e-12;
+    for (j = 0; j < 15; j++) {
+        less = whole.a[j] - merged.a[j];
+        ok &= merged.a[j] <= whole.a[j] && less <= (PARTS - 1) * 0.4 * 16000;
+    }
+    check(ok, "merge: fresh parts, against one pass");
+
+    init_speech_voltmeter(&part, 8000);
+    speech_voltmeter(y, 1000, &part);
+    copy = merged;
+    check(speech_voltmeter_merge(&merged, &part) == -1 && memcmp(&copy, &merged, sizeof(merged)) == 0,
+          "merge: a part of another rate refused");
+
+    free(y);
+}
+
+/*
+ * A 16-bit mono file at rate `f' through actlevel_volt(), against
+ * init_speech_voltmeter(f) and speech_voltmeter_int() on the same
+ * samples: the same counts and peaks, the envelope to rounding (the
+ * file is read in blocks), the same level, with the constants of f
+ */
+static void test_rate(long f, const char* what)
+{
+    enum { LEN = 100000 };
+    short* x = (short*)malloc(LEN * sizeof(short));
+    SVP56_state ref, volt, st;
+    char name[64];
+    FILE* fp;
+    int ok;
+
+    signal16(x, LEN, 13, f);
+    sprintf(name, "voltmeter_test_%ld.wav", f);
+    ok = (fp = fopen(name, "wb")) != NULL;
+    if (ok) {
+        ok = wav_write_header(fp, WAV_RIFF, WAV_FORMAT_PCM, 1, f, 16) > 0 &&
+             fwrite(x, sizeof(short), LEN, fp) == LEN && wav_write_sizes(fp, WAV_RIFF, 2) == 0;
+        fclose(fp);
+    }
+
+    init_speech_voltmeter(&ref, (double)f);
+    speech_voltmeter_int(x, LEN, 16, &ref);
+    ok = ok && actlevel_volt(name, &st, &volt) == 0;
+    ok = ok && volt.f == (float)f && same_state(&volt, &ref, 1e-12);
+    ok = ok && fabs(st.ActiveSpeechLevel - active_speech_level(&ref)) < 1e-9;
+    check(ok, what);
+
+    remove(name);
+    free(x);
+}
+
+int main(void)
+{
+    test_batch();
+    test_int(256, "int: 256-sample blocks, against float");
+    test_int(0, "int: odd blocks, against float");
+    test_runs(8000, 256, "runs: 8 kHz, 256-sample blocks, against the plain loop");
+    test_runs(16000, 0, "runs: 16 kHz, odd blocks, against the plain loop");
+    test_runs(48000, 4096, "runs: 48 kHz, 4096-sample blocks, against the plain loop");
+    test_runs(22050, 1000, "runs: 22.05 kHz, out of the table, against the plain loop");
+    test_checkpoint();
+    test_merge();
+    test_rate(8000, "rate: 8 kHz file, against the 8 kHz voltmeter");
+    test_rate(48000, "rate: 48 kHz file, against the 48 kHz voltmeter");
+    test_rate(11025, "rate: 11.025 kHz file, out of the table");
+    return failed;
+}
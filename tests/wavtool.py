@@ -0,0 +1,117 @@
+# Wave files for the *_test.py scripts: speech-like test signals, and
+# 16-bit or float samples in RIFF, RF64 or Wave64 containers
+import math
+import random
+import struct
+
+W64_TAIL = bytes.fromhex('f3acd3118cd100c04f8edb8a')
+W64_RIFF = b'riff' + bytes.fromhex('2e91cf11a5d628db04c10000')
+
+
+def speech(seconds, rate=16000, seed=1, level=0.3):
+    # Tone bursts with noise, pauses between them, and a few runs of
+    # equal samples (digital silence), as floats in [-1, 1)
+    rnd = random.Random(seed)
+    x = []
+    while len(x) < seconds * rate:
+        n = int(rate * rnd.uniform(0.1, 0.6))
+        f = rnd.uniform(100, 900)
+        a = level * rnd.uniform(0.2, 1.0)
+        for k in range(n):
+            env = math.sin(math.pi * k / n)
+            x.append(a * env * (math.sin(2 * math.pi * f * k / rate) + 0.3 * rnd.uniform(-1, 1)))
+        n = int(rate * rnd.uniform(0.05, 0.4))
+        if rnd.random() < 0.5:
+            x += [0.0] * n
+        else:
+            x += [0.001 * rnd.uniform(-1, 1) for k in range(n)]
+    return x[:int(seconds * rate)]
+
+
+def to_int16(x):
+    return [max(-32768, min(32767, int(round(v * 32768)))) for v in x]
+
+
+def interleave(channels):
+    return [v for frame in zip(*channels) for v in frame]
+
+
+def write(path, samples, rate=16000, channels=1, fmt='pcm16', container='riff'):
+    # samples are interleaved int16 values for pcm16, floats for float
+    if fmt == 'float':
+        data = struct.pack('<%df' % len(samples), *samples)
+        tag, bits = 3, 32
+    else:
+        data = struct.pack('<%dh' % len(samples), *samples)
+        tag, bits = 1, 16
+    align = channels * bits // 8
+    fmt_body = struct.pack('<HHIIHH', tag, channels, rate, rate * align, align, bits)
+    with open(path, 'wb') as f:
+        if container == 'w64':
+            fmt_chunk = b'fmt ' + W64_TAIL + struct.pack('<Q', 24 + 16) + fmt_body
+            size = 40 + len(fmt_chunk) + 24 + len(data)
+            f.write(W64_RIFF + struct.pack('<Q', size) + b'wave' + W64_TAIL + fmt_chunk)
+            f.write(b'data' + W64_TAIL + struct.pack('<Q', 24 + len(data)) + data)
+            f.write(b'\0' * (-len(data) % 8))
+        elif container == 'rf64':
+            ds64 = struct.pack('<QQQI', 4 + 36 + 24 + len(data), len(data), len(data) // align, 0)
+            f.write(b'RF64' + struct.pack('<I', 0xFFFFFFFF) + b'WAVE')
+            f.write(b'ds64' + struct.pack('<I', len(ds64)) + ds64)
+            f.write(b'fmt ' + struct.pack('<I', 16) + fmt_body)
+            f.write(b'data' + struct.pack('<I', 0xFFFFFFFF) + data)
+        else:
+            f.write(b'RIFF' + struct.pack('<I', 36 + len(data)) + b'WAVE')
+            f.write(b'fmt ' + struct.pack('<I', 16) + fmt_body)
+            f.write(b'data' + struct.pack('<I', len(data)) + data)
+
+
+def read(path):
+    # (rate, channels, fmt, interleaved samples) of a RIFF, RF64 or Wave64 file
+    with open(path, 'rb') as f:
+        return parse(f.read())
+
+
+def parse(b):
+    # read() of the bytes of a file; a data chunk of unknown size (0 or
+    # 0xFFFFFFFF, as written to a pipe) runs to the end
+    chunks = {}
+    if b[:16] == W64_RIFF:
+        off = 40
+        while off + 24 <= len(b):
+            size = struct.unpack_from('<Q', b, off + 16)[0]
+            chunks[b[off:off + 4]] = b[off + 24:off + size]
+            off += (size + 7) & ~7
+    else:
+        off, ds64 = 12, None
+        while off + 8 <= len(b):
+            cid, size = b[off:off + 4], struct.unpack_from('<I', b, off + 4)[0]
+            if cid == b'ds64':
+                ds64 = struct.unpack_from('<QQ', b, off + 8)[1]
+            if cid == b'data' and size == 0xFFFFFFFF and ds64 is not None:
+                size = ds64
+            elif cid == b'data' and size in (0, 0xFFFFFFFF):
+                size = len(b) - off - 8
+            chunks[cid] = b[off + 8:off + 8 + size]
+            off += 8 + size + (size & 1)
+    tag, channels, rate = struct.unpack_from('<HHI', chunks[b'fmt '])
+    if tag == 0xFFFE:
+        tag = struct.unpack_from('<H', chunks[b'fmt '], 24)[0]
+    data = chunks[b'data']
+    if tag == 3:
+        return rate, channels, 'float', list(struct.unpack('<%df' % (len(data) // 4), data))
+    return rate, channels, 'pcm16', list(struct.unpack('<%dh' % (len(data) // 2), data))
+
+
+# The fields that calculate() and its kin fill in
+STATE_FIELDS = ('n', 'maxP', 'maxN', 'DClevel', 'rmsdB', 'ActiveSpeechLevel',
+                'ActivityFactor', 'rmsPkF', 'ActPkF')
+
+
+def same_state(a, b, tol=0.0, fields=STATE_FIELDS):
+    # None when equal field by field, to `tol' relative to the larger
+    # magnitude (in dB for the levels); else the first difference
+    for k in fields:
+        x, y = getattr(a, k), getattr(b, k)
+        if abs(x - y) > tol * max(abs(x), abs(y), 1.0):
+            return '%s: %r != %r' % (k, x, y)
+    return None